@@ -0,0 +1,50 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BENCHMARK__BUILD_CONTEXT_HPP_
+#define BENCHMARK__BUILD_CONTEXT_HPP_
+
+#include <benchmark/benchmark.h>
+
+#include <xsimd/xsimd.hpp>
+
+#ifndef MPPIC_BUILD_ISA
+#define MPPIC_BUILD_ISA "unknown"
+#endif
+
+#ifndef MPPIC_BUILD_PARALLEL_BACKEND
+#define MPPIC_BUILD_PARALLEL_BACKEND "unknown"
+#endif
+
+/**
+ * @brief Runs the registered benchmarks with the build variant in the report context,
+ * so results from the ISA and parallel backend variants of the build can be compared
+ */
+#define MPPIC_BENCHMARK_MAIN() \
+  int main(int argc, char ** argv) \
+  { \
+    benchmark::AddCustomContext("mppic_isa", MPPIC_BUILD_ISA); \
+    benchmark::AddCustomContext("mppic_parallel_backend", MPPIC_BUILD_PARALLEL_BACKEND); \
+    benchmark::AddCustomContext("xsimd_arch", xsimd::default_arch::name()); \
+    benchmark::Initialize(&argc, argv); \
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) { \
+      return 1; \
+    } \
+    benchmark::RunSpecifiedBenchmarks(); \
+    benchmark::Shutdown(); \
+    return 0; \
+  } \
+  int main(int, char **)
+
+#endif  // BENCHMARK__BUILD_CONTEXT_HPP_
@@ -0,0 +1,521 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <geometry_msgs/msg/pose_stamped.hpp>
+#include <geometry_msgs/msg/twist.hpp>
+#include <nav_msgs/msg/path.hpp>
+#include <visualization_msgs/msg/marker_array.hpp>
+
+#include <nav2_costmap_2d/cost_values.hpp>
+#include <nav2_costmap_2d/costmap_2d.hpp>
+#include <nav2_costmap_2d/costmap_2d_ros.hpp>
+
+#include <xtensor/xrandom.hpp>
+
+#include "mppic/optimizer.hpp"
+#include "mppic/motion_models.hpp"
+
+#include "mppic/tools/distance_field.hpp"
+#include "mppic/tools/noise_generator.hpp"
+#include "mppic/tools/parameters_handler.hpp"
+#include "mppic/tools/path_handler.hpp"
+#include "mppic/tools/tiled_costmap.hpp"
+#include "mppic/tools/trajectory_visualizer.hpp"
+#include "mppic/tools/utils.hpp"
+
+#include "build_context.hpp"
+#include "utils.hpp"
+
+// Benchmarks of the stages of an MPPI cycle in isolation, swept over the batch size,
+// the time steps, the path length and the obstacle density. Arguments of the
+// optimizer stages are, in order: batch size, time steps, path points, and percent of
+// the costmap cells holding obstacle costs
+
+class RosLockGuard
+{
+public:
+  RosLockGuard() {rclcpp::init(0, nullptr);}
+  ~RosLockGuard() {rclcpp::shutdown();}
+};
+
+RosLockGuard g_rclcpp;
+
+namespace
+{
+
+struct ComponentSettings
+{
+  int batch_size;
+  int time_steps;
+  unsigned int path_points;
+  int obstacle_percent;
+  std::string motion_model;
+  std::vector<std::string> critics;
+};
+
+/**
+ * @class OptimizerHarness
+ * @brief Optimizer exposing its stages, run once on setup so that every stage has
+ * inputs of the shapes it sees in a cycle
+ */
+class OptimizerHarness : public mppi::Optimizer
+{
+public:
+  void prepareCycle(
+    const geometry_msgs::msg::PoseStamped & pose, const geometry_msgs::msg::Twist & speed,
+    const nav_msgs::msg::Path & plan)
+  {
+    prepare(pose, speed, plan, nullptr);
+    generateNoisedTrajectories();
+    critic_manager_.evalTrajectoriesScores(critics_data_);
+  }
+
+  void integrate() {integrateStateVelocities(generated_trajectories_, state_);}
+  void predict() {motion_model_->predict(state_);}
+  void applyConstraints() {motion_model_->applyConstraints(control_sequence_);}
+  void scoreCritics() {critic_manager_.evalTrajectoriesScores(critics_data_);}
+  void updateControls() {updateControlSequence();}
+  void smooth() {mppi::utils::savitskyGolayFilter(control_sequence_, control_history_, settings_);}
+
+  const mppi::models::State & getState() const {return state_;}
+  bool holonomic() const {return isHolonomic();}
+};
+
+/**
+ * @struct OptimizerSetup
+ * @brief Optimizer and everything it references, declared so they outlive it
+ */
+struct OptimizerSetup
+{
+  std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros;
+  std::shared_ptr<rclcpp_lifecycle::LifecycleNode> node;
+  std::unique_ptr<mppi::ParametersHandler> parameters_handler;
+  std::shared_ptr<OptimizerHarness> optimizer;
+};
+
+// Obstacle costs below the inscribed cost, so no trajectory of the sweep is in collision
+void addRandomObstacles(nav2_costmap_2d::Costmap2D * costmap, int obstacle_percent)
+{
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::uniform_int_distribution<int> cost(1, nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 1);
+  for (unsigned int mx = 0; mx != costmap->getSizeInCellsX(); mx++) {
+    for (unsigned int my = 0; my != costmap->getSizeInCellsY(); my++) {
+      if (percent(generator) < obstacle_percent) {
+        costmap->setCost(mx, my, static_cast<unsigned char>(cost(generator)));
+      }
+    }
+  }
+}
+
+OptimizerSetup setUpOptimizer(const ComponentSettings & s)
+{
+  OptimizerSetup setup;
+  TestCostmapSettings costmap_settings{200, 200};
+  setup.costmap_ros = getDummyCostmapRos(costmap_settings);
+  addRandomObstacles(setup.costmap_ros->getCostmap(), s.obstacle_percent);
+
+  TestOptimizerSettings optimizer_settings{s.batch_size, s.time_steps, 1, 10.0, s.motion_model,
+    true};
+  auto options = getOptimizerOptions(optimizer_settings, s.critics);
+  // Goal critics only score near the goal, which the longer paths are far from
+  auto & overrides = options.parameter_overrides();
+  overrides.emplace_back("dummy.GoalCritic.threshold_to_consider", 1000.0);
+  overrides.emplace_back("dummy.GoalAngleCritic.threshold_to_consider", 1000.0);
+  setup.node = getDummyNode(options);
+  setup.parameters_handler = std::make_unique<mppi::ParametersHandler>(setup.node);
+
+  setup.optimizer = std::make_shared<OptimizerHarness>();
+  std::weak_ptr<rclcpp_lifecycle::LifecycleNode> weak_ptr_node{setup.node};
+  setup.optimizer->initialize(
+    weak_ptr_node, setup.node->get_name(), setup.costmap_ros, setup.parameters_handler.get());
+
+  TestPose start_pose = costmap_settings.getCenterPose();
+  double path_step = costmap_settings.resolution;
+  TestPathSettings path_settings{start_pose, s.path_points, path_step, path_step};
+  auto pose = getDummyPointStamped(setup.node, start_pose);
+  auto path = getIncrementalDummyPath(setup.node, path_settings);
+  setup.optimizer->prepareCycle(pose, getDummyTwist(), path);
+  return setup;
+}
+
+ComponentSettings getSettings(
+  const benchmark::State & state, const std::string & motion_model = "DiffDrive",
+  const std::vector<std::string> & critics = {"GoalCritic"})
+{
+  return {static_cast<int>(state.range(0)), static_cast<int>(state.range(1)),
+    static_cast<unsigned int>(state.range(2)), static_cast<int>(state.range(3)), motion_model,
+    critics};
+}
+
+template<typename T>
+int64_t bytes(const T & tensor)
+{
+  return static_cast<int64_t>(tensor.size() * sizeof(typename T::value_type));
+}
+
+void rolloutSweep(benchmark::internal::Benchmark * b)
+{
+  b->ArgNames({"batch", "time_steps", "path", "obstacles"});
+  b->ArgsProduct({{500, 1000, 2000, 4000}, {28, 56, 84}, {50}, {0}});
+}
+
+void criticSweep(benchmark::internal::Benchmark * b)
+{
+  b->ArgNames({"batch", "time_steps", "path", "obstacles"});
+  b->ArgsProduct({{1000, 2000}, {56}, {50, 400}, {0, 10, 40}});
+}
+
+}  // namespace
+
+static void BM_NoiseGenerator(benchmark::State & state)
+{
+  // Exposes the generation the noise thread otherwise runs in the background
+  class NoiseGeneratorHarness : public mppi::NoiseGenerator
+  {
+public:
+    using NoiseGenerator::generateNoisedControls;
+  };
+
+  mppi::models::OptimizerSettings settings;
+  settings.batch_size = state.range(0);
+  settings.time_steps = state.range(1);
+  settings.model_dt = 0.05f;
+  settings.sampling_std = {0.2f, 0.2f, 0.4f};
+  settings.noise_sampler = state.range(2) ? mppi::models::NoiseSampler::Xoshiro :
+    mppi::models::NoiseSampler::Default;
+  const bool is_holonomic = false;
+
+  NoiseGeneratorHarness generator;
+  generator.initialize(settings, is_holonomic);
+  generator.reset(settings, is_holonomic);
+  generator.shutdown();
+
+  mppi::models::State controls;
+  controls.reset(settings.batch_size, settings.time_steps, is_holonomic);
+  mppi::models::ControlSequence sequence;
+  sequence.reset(settings.time_steps);
+
+  for (auto _ : state) {
+    generator.generateNoisedControls();
+    generator.setNoisedControls(controls, sequence);
+    benchmark::DoNotOptimize(controls.cvx.data());
+  }
+
+  // Two sampled channels, written as noises then read back into the controls
+  const int64_t samples = 2 * static_cast<int64_t>(settings.batch_size) * settings.time_steps;
+  state.SetItemsProcessed(state.iterations() * samples);
+  state.SetBytesProcessed(state.iterations() * samples * 3 * sizeof(float));
+}
+
+static void BM_IntegrateStateVelocities(benchmark::State & state, std::string motion_model)
+{
+  auto setup = setUpOptimizer(getSettings(state, motion_model));
+  auto & optimizer = *setup.optimizer;
+  const auto & s = optimizer.getState();
+
+  for (auto _ : state) {
+    optimizer.integrate();
+    benchmark::ClobberMemory();
+  }
+
+  // Velocities read and poses written
+  const int64_t inputs = bytes(s.vx) + bytes(s.wz) + (optimizer.holonomic() ? bytes(s.vy) : 0);
+  state.SetItemsProcessed(state.iterations() * s.vx.size());
+  state.SetBytesProcessed(state.iterations() * (inputs + 3 * bytes(s.vx)));
+}
+
+static void BM_MotionModelPredict(benchmark::State & state, std::string motion_model)
+{
+  auto setup = setUpOptimizer(getSettings(state, motion_model));
+  auto & optimizer = *setup.optimizer;
+  const auto & s = optimizer.getState();
+
+  for (auto _ : state) {
+    optimizer.predict();
+    benchmark::ClobberMemory();
+  }
+
+  // Controls read and velocities written
+  const int64_t channels = optimizer.holonomic() ? 3 : 2;
+  state.SetItemsProcessed(state.iterations() * s.vx.size());
+  state.SetBytesProcessed(state.iterations() * 2 * channels * bytes(s.vx));
+}
+
+static void BM_MotionModelApplyConstraints(benchmark::State & state, std::string motion_model)
+{
+  auto setup = setUpOptimizer(getSettings(state, motion_model));
+  auto & optimizer = *setup.optimizer;
+
+  for (auto _ : state) {
+    optimizer.applyConstraints();
+    benchmark::ClobberMemory();
+  }
+
+  const int64_t time_steps = state.range(1);
+  state.SetItemsProcessed(state.iterations() * time_steps);
+  state.SetBytesProcessed(state.iterations() * 3 * time_steps * sizeof(float));
+}
+
+static void BM_CriticScore(benchmark::State & state, std::string critic)
+{
+  auto setup = setUpOptimizer(getSettings(state, "DiffDrive", {critic}));
+  auto & optimizer = *setup.optimizer;
+  const auto & s = optimizer.getState();
+
+  for (auto _ : state) {
+    optimizer.scoreCritics();
+    benchmark::ClobberMemory();
+  }
+
+  // Critics read up to the poses and velocities of every trajectory point
+  state.SetItemsProcessed(state.iterations() * s.vx.size());
+  state.SetBytesProcessed(state.iterations() * 5 * bytes(s.vx));
+}
+
+// Layouts of the costmap lookups: linear costs, tiled costs, linear distance field and
+// tiled half precision distances
+static void BM_CostmapLookup(benchmark::State & state)
+{
+  const unsigned int cells = static_cast<unsigned int>(state.range(0));
+  const int64_t layout = state.range(1);
+  const float resolution = 0.05f;
+  nav2_costmap_2d::Costmap2D costmap(cells, cells, resolution, 0.0, 0.0);
+  addRandomObstacles(&costmap, 10);
+  for (unsigned int mx = 0; mx < cells; mx += 17) {
+    costmap.setCost(mx, (mx * 7) % cells, nav2_costmap_2d::LETHAL_OBSTACLE);
+  }
+  mppi::DistanceField field;
+  field.update(costmap, true);
+  mppi::TiledCostmap tiled;
+  tiled.update(costmap);
+  tiled.updateDistances(field);
+
+  // Rollouts fanning out from the map center, as trajectories of a local costmap do
+  const size_t batch_size = 2000, time_steps = 56;
+  std::vector<float> xs(batch_size * time_steps), ys(batch_size * time_steps);
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> heading(-M_PI, M_PI), turn(-0.1f, 0.1f);
+  const float center = cells * resolution / 2.0f;
+  for (size_t i = 0; i != batch_size; i++) {
+    float x = center, y = center, yaw = heading(generator);
+    for (size_t j = 0; j != time_steps; j++) {
+      yaw += turn(generator);
+      x += 0.025f * std::cos(yaw);
+      y += 0.025f * std::sin(yaw);
+      xs[i * time_steps + j] = x;
+      ys[i * time_steps + j] = y;
+    }
+  }
+
+  const float inv_resolution = 1.0f / resolution;
+  for (auto _ : state) {
+    float sum = 0.0f;
+    for (size_t k = 0; k != xs.size(); k++) {
+      if (layout == 0) {
+        const unsigned int mx = static_cast<unsigned int>(xs[k] * inv_resolution);
+        const unsigned int my = static_cast<unsigned int>(ys[k] * inv_resolution);
+        sum += mx < cells && my < cells ? costmap.getCost(mx, my) : 0;
+      } else if (layout == 1) {
+        sum += tiled.cost(xs[k], ys[k], 0);
+      } else if (layout == 2) {
+        sum += field.distance(xs[k], ys[k]);
+      } else {
+        sum += tiled.distance(xs[k], ys[k]);
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+
+  // Bytes of the map looked up, tiled maps being padded to whole tiles
+  const size_t tiles = (cells + mppi::TiledCostmap::tile_size - 1) / mppi::TiledCostmap::tile_size;
+  const size_t map_cells = layout % 2 == 0 ? static_cast<size_t>(cells) * cells :
+    tiles * tiles * mppi::TiledCostmap::tile_size * mppi::TiledCostmap::tile_size;
+  const size_t cell_bytes = layout == 2 ? sizeof(float) : layout == 3 ? sizeof(uint16_t) : 1;
+  state.counters["map_bytes"] = static_cast<double>(map_cells * cell_bytes);
+  state.SetItemsProcessed(state.iterations() * xs.size());
+}
+
+static void BM_UpdateControlSequence(benchmark::State & state)
+{
+  auto setup = setUpOptimizer(getSettings(state));
+  auto & optimizer = *setup.optimizer;
+  const auto & s = optimizer.getState();
+
+  for (auto _ : state) {
+    optimizer.updateControls();
+    benchmark::ClobberMemory();
+  }
+
+  // Sampled controls and costs weighted into the sequence
+  const int64_t channels = optimizer.holonomic() ? 3 : 2;
+  state.SetItemsProcessed(state.iterations() * s.cvx.size());
+  state.SetBytesProcessed(
+    state.iterations() * (channels * bytes(s.cvx) + state.range(0) * sizeof(float)));
+}
+
+static void BM_SavitskyGolayFilter(benchmark::State & state)
+{
+  auto setup = setUpOptimizer(getSettings(state));
+  auto & optimizer = *setup.optimizer;
+
+  for (auto _ : state) {
+    optimizer.smooth();
+    benchmark::ClobberMemory();
+  }
+
+  const int64_t time_steps = state.range(1);
+  state.SetItemsProcessed(state.iterations() * 3 * time_steps);
+  state.SetBytesProcessed(state.iterations() * 2 * 3 * time_steps * sizeof(float));
+}
+
+static void BM_PathHandlerTransformPath(benchmark::State & state)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("dummy");
+  node->declare_parameter("dummy.max_robot_pose_search_dist", rclcpp::ParameterValue(99999.9));
+  node->declare_parameter(
+    "dummy.incremental_path_handling", rclcpp::ParameterValue(state.range(1) != 0));
+  auto costmap_ros = getDummyCostmapRos(TestCostmapSettings{200, 200});
+  mppi::ParametersHandler parameters_handler(node);
+  auto path_handler =
+    getDummyPathHandler(node, costmap_ros, costmap_ros->getTfBuffer(), &parameters_handler);
+
+  // The robot stays on the first pose, so that no pose is ever pruned
+  const std::string frame = costmap_ros->getGlobalFrameID();
+  TestPathSettings path_settings{{1.0, 1.0}, static_cast<unsigned int>(state.range(0)), 0.01,
+    0.01};
+  auto path = getIncrementalDummyPath(node, path_settings);
+  path.header.frame_id = frame;
+  auto robot_pose = getDummyPointStamped(node, path_settings.start_pose);
+  robot_pose.header.frame_id = frame;
+  path_handler.setPath(path);
+
+  mppi::models::Path transformed;
+  for (auto _ : state) {
+    path_handler.transformPath(robot_pose, transformed);
+    benchmark::DoNotOptimize(transformed.x.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(
+    state.iterations() * state.range(0) * sizeof(geometry_msgs::msg::PoseStamped));
+}
+
+static void BM_TrajectoryVisualizerAdd(benchmark::State & state)
+{
+  rclcpp::NodeOptions options;
+  options.parameter_overrides(
+    {rclcpp::Parameter("dummy.TrajectoryVisualizer.time_step", 1)});
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("dummy", options);
+  mppi::ParametersHandler parameters_handler(node);
+  mppi::TrajectoryVisualizer visualizer;
+  visualizer.on_configure(node, "dummy", "map", &parameters_handler);
+  visualizer.on_activate();
+
+  // Trajectories are only added while someone listens
+  auto subscription = node->create_subscription<visualization_msgs::msg::MarkerArray>(
+    "/trajectories", 1, [](visualization_msgs::msg::MarkerArray::SharedPtr) {});
+
+  const size_t batch_size = state.range(0);
+  const size_t time_steps = state.range(1);
+  mppi::models::Trajectories trajectories;
+  trajectories.reset(batch_size, time_steps);
+  trajectories.x = xt::random::rand<float>({batch_size, time_steps}, 0.0f, 10.0f);
+  trajectories.y = xt::random::rand<float>({batch_size, time_steps}, 0.0f, 10.0f);
+
+  for (auto _ : state) {
+    visualizer.add(trajectories, 1);
+    state.PauseTiming();
+    visualizer.reset();
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * batch_size * time_steps);
+  state.SetBytesProcessed(state.iterations() * (bytes(trajectories.x) + bytes(trajectories.y)));
+  visualizer.on_deactivate();
+  visualizer.on_cleanup();
+}
+
+BENCHMARK(BM_NoiseGenerator)
+->ArgNames({"batch", "time_steps", "xoshiro"})
+->ArgsProduct({{500, 1000, 2000, 4000}, {28, 56, 84}, {0, 1}})
+->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_CAPTURE(BM_IntegrateStateVelocities, DiffDrive, std::string("DiffDrive"))
+->Apply(rolloutSweep)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_IntegrateStateVelocities, Omni, std::string("Omni"))
+->Apply(rolloutSweep)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_CAPTURE(BM_MotionModelPredict, DiffDrive, std::string("DiffDrive"))
+->Apply(rolloutSweep)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_MotionModelPredict, Omni, std::string("Omni"))
+->Apply(rolloutSweep)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_MotionModelPredict, Ackermann, std::string("Ackermann"))
+->Apply(rolloutSweep)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_CAPTURE(BM_MotionModelApplyConstraints, Ackermann, std::string("Ackermann"))
+->ArgNames({"batch", "time_steps", "path", "obstacles"})
+->ArgsProduct({{500}, {28, 56, 84}, {50}, {0}})
+->Unit(benchmark::kNanosecond);
+
+BENCHMARK_CAPTURE(BM_CriticScore, ConstraintCritic, std::string("ConstraintCritic"))
+->Apply(criticSweep)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_CriticScore, GoalCritic, std::string("GoalCritic"))
+->Apply(criticSweep)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_CriticScore, GoalAngleCritic, std::string("GoalAngleCritic"))
+->Apply(criticSweep)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_CriticScore, ObstaclesCritic, std::string("ObstaclesCritic"))
+->Apply(criticSweep)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_CriticScore, PathAlignCritic, std::string("PathAlignCritic"))
+->Apply(criticSweep)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_CriticScore, PathAngleCritic, std::string("PathAngleCritic"))
+->Apply(criticSweep)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_CriticScore, PathFollowCritic, std::string("PathFollowCritic"))
+->Apply(criticSweep)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_CriticScore, PreferForwardCritic, std::string("PreferForwardCritic"))
+->Apply(criticSweep)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_CriticScore, TwirlingCritic, std::string("TwirlingCritic"))
+->Apply(criticSweep)->Unit(benchmark::kMicrosecond);
+
+// 6 m, 12 m and 20 m square maps at 5 cm
+BENCHMARK(BM_CostmapLookup)
+->ArgNames({"cells", "layout"})
+->ArgsProduct({{120, 240, 400}, {0, 1, 2, 3}})
+->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_UpdateControlSequence)->Apply(rolloutSweep)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_SavitskyGolayFilter)
+->ArgNames({"batch", "time_steps", "path", "obstacles"})
+->ArgsProduct({{500}, {28, 56, 84}, {50}, {0}})
+->Unit(benchmark::kNanosecond);
+
+BENCHMARK(BM_PathHandlerTransformPath)
+->ArgNames({"path", "incremental"})
+->ArgsProduct({{100, 1000, 10000}, {0, 1}})
+->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_TrajectoryVisualizerAdd)
+->ArgNames({"batch", "time_steps"})
+->ArgsProduct({{500, 2000}, {28, 56, 84}})
+->Unit(benchmark::kMicrosecond);
+
+MPPIC_BENCHMARK_MAIN();
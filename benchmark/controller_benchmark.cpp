@@ -31,6 +31,7 @@
 #include "mppic/motion_models.hpp"
 #include "mppic/controller.hpp"
 
+#include "build_context.hpp"
 #include "utils.hpp"
 
 class RosLockGuard
@@ -235,4 +236,4 @@ BENCHMARK(BM_ObstaclesCritic)->Unit(benchmark::kMillisecond);
 BENCHMARK(BM_ObstaclesCriticPointFootprint)->Unit(benchmark::kMillisecond);
 BENCHMARK(BM_TwilringCritic)->Unit(benchmark::kMillisecond);
 
-BENCHMARK_MAIN();
+MPPIC_BENCHMARK_MAIN();
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <benchmark/benchmark.h>
+#include <array>
 #include <string>
 
 #include "gtest/gtest.h"
@@ -27,13 +28,18 @@
 
 #include <xtensor/xarray.hpp>
 #include <xtensor/xio.hpp>
+#include <xtensor/xrandom.hpp>
 #include <xtensor/xview.hpp>
 
 #include "mppic/optimizer.hpp"
 #include "mppic/motion_models.hpp"
 
 #include "mppic/tools/parameters_handler.hpp"
+#include "mppic/tools/rollout.hpp"
+#include "mppic/tools/tiled_tensor.hpp"
+#include "mppic/tools/utils.hpp"
 
+#include "build_context.hpp"
 #include "utils.hpp"
 
 class RosLockGuard
@@ -47,7 +53,8 @@ RosLockGuard g_rclcpp;
 
 void prepareAndRunBenchmark(
   bool consider_footprint, std::string motion_model,
-  std::vector<std::string> critics, benchmark::State & state)
+  std::vector<std::string> critics, benchmark::State & state,
+  const std::vector<rclcpp::Parameter> & extra_params = {})
 {
   int batch_size = 300;
   int time_steps = 12;
@@ -78,7 +85,10 @@ void prepareAndRunBenchmark(
   addObstacle(costmap, {obst_x, obst_y, obstacle_size, obstacle_cost});
 
   printInfo(optimizer_settings, path_settings, critics);
-  auto node = getDummyNode(optimizer_settings, critics);
+  auto options = getOptimizerOptions(optimizer_settings, critics);
+  auto & overrides = options.parameter_overrides();
+  overrides.insert(overrides.end(), extra_params.begin(), extra_params.end());
+  auto node = getDummyNode(options);
   auto parameters_handler = std::make_unique<mppi::ParametersHandler>(node);
   auto optimizer = getDummyOptimizer(node, costmap_ros, parameters_handler.get());
 
@@ -91,6 +101,7 @@ void prepareAndRunBenchmark(
   for (auto _ : state) {
     optimizer->evalControl(pose, velocity, path, dummy_goal_checker);
   }
+  state.counters["expected_cost"] = optimizer->getExpectedCost();
 }
 
 static void BM_DiffDrivePointFootprint(benchmark::State & state)
@@ -134,6 +145,29 @@ static void BM_Ackermann(benchmark::State & state)
   prepareAndRunBenchmark(consider_footprint, motion_model, critics, state);
 }
 
+// Single and two-stage sampling within the same compute budget, comparing the
+// expected costs they reach
+static void BM_SingleStageBudget(benchmark::State & state)
+{
+  std::vector<std::string> critics = {{"GoalCritic"}, {"ObstaclesCritic"},
+    {"PathAngleCritic"}, {"PathFollowCritic"}, {"PreferForwardCritic"}};
+  prepareAndRunBenchmark(
+    true, "DiffDrive", critics, state,
+    {rclcpp::Parameter("dummy.max_compute_time_ms", 20.0)});
+}
+
+static void BM_TwoStageBudget(benchmark::State & state)
+{
+  std::vector<std::string> critics = {{"GoalCritic"}, {"ObstaclesCritic"},
+    {"PathAngleCritic"}, {"PathFollowCritic"}, {"PreferForwardCritic"}};
+  prepareAndRunBenchmark(
+    true, "DiffDrive", critics, state,
+    {rclcpp::Parameter("dummy.max_compute_time_ms", 20.0),
+      rclcpp::Parameter("dummy.screening_batch_size", 1200),
+      rclcpp::Parameter("dummy.GoalCritic.stage", std::string("both")),
+      rclcpp::Parameter("dummy.ObstaclesCritic.stage", std::string("both"))});
+}
+
 static void BM_GoalCritic(benchmark::State & state)
 {
   bool consider_footprint = true;
@@ -197,10 +231,170 @@ static void BM_PathAngleCritic(benchmark::State & state)
   prepareAndRunBenchmark(consider_footprint, motion_model, critics, state);
 }
 
+mppi::models::Trajectories getDummyTrajectories(const TestCostmapSettings & costmap_settings)
+{
+  // Spread over the map and slightly beyond it, like sampled rollouts near the border
+  const float size_x = costmap_settings.cells_x * costmap_settings.resolution;
+  const float size_y = costmap_settings.cells_y * costmap_settings.resolution;
+  mppi::models::Trajectories trajectories;
+  trajectories.reset(2000, 56);
+  trajectories.x = xt::random::rand<float>({2000, 56}, -0.1f * size_x, 1.1f * size_x);
+  trajectories.y = xt::random::rand<float>({2000, 56}, -0.1f * size_y, 1.1f * size_y);
+  return trajectories;
+}
+
+static void BM_CostmapGatherScalar(benchmark::State & state)
+{
+  TestCostmapSettings costmap_settings{};
+  auto costmap = getDummyCostmap(costmap_settings);
+  auto trajectories = getDummyTrajectories(costmap_settings);
+  xt::xtensor<float, 2> costs = xt::zeros<float>(trajectories.x.shape());
+
+  for (auto _ : state) {
+    unsigned int mx, my;
+    for (size_t i = 0; i != costs.shape(0); i++) {
+      for (size_t j = 0; j != costs.shape(1); j++) {
+        costs(i, j) = costmap->worldToMap(trajectories.x(i, j), trajectories.y(i, j), mx, my) ?
+          costmap->getCost(mx, my) : nav2_costmap_2d::NO_INFORMATION;
+      }
+    }
+    benchmark::DoNotOptimize(costs.data());
+  }
+}
+
+static void BM_CostmapGatherBatched(benchmark::State & state)
+{
+  TestCostmapSettings costmap_settings{};
+  auto costmap = getDummyCostmap(costmap_settings);
+  auto trajectories = getDummyTrajectories(costmap_settings);
+  xt::xtensor<float, 2> costs = xt::zeros<float>(trajectories.x.shape());
+
+  for (auto _ : state) {
+    mppi::utils::gatherCosts(*costmap, trajectories, costs);
+    benchmark::DoNotOptimize(costs.data());
+  }
+}
+
+mppi::models::State getDummyState()
+{
+  mppi::models::State state;
+  state.reset(2000, 56);
+  state.vx = xt::random::randn<float>({2000, 56}, 0.2f, 0.5f);
+  state.vy = xt::random::randn<float>({2000, 56}, 0.0f, 0.3f);
+  state.wz = xt::random::randn<float>({2000, 56}, 0.0f, 1.5f);
+  state.pose.pose.orientation.w = 1.0;
+  return state;
+}
+
+static void BM_RolloutRowMajor(benchmark::State & state)
+{
+  auto velocities = getDummyState();
+  mppi::models::Trajectories trajectories;
+  trajectories.reset(2000, 56);
+
+  for (auto _ : state) {
+    mppi::rollout::integrate(trajectories, velocities, 0, 2000, 0.05f, true);
+    benchmark::DoNotOptimize(trajectories.x.data());
+  }
+}
+
+static void BM_RolloutTiled(benchmark::State & state)
+{
+  auto velocities = getDummyState();
+  mppi::TiledTensor vx, vy, wz, x, y, yaws;
+  vx.pack(velocities.vx);
+  vy.pack(velocities.vy);
+  wz.pack(velocities.wz);
+  x.reset(2000, 56);
+  y.reset(2000, 56);
+  yaws.reset(2000, 56);
+
+  for (auto _ : state) {
+    mppi::rollout::integrateTiles(
+      x, y, yaws, vx, vy, wz, velocities.pose.pose, 0, vx.tiles(), 0.05f, true);
+    benchmark::DoNotOptimize(x.at(0, 0));
+  }
+}
+
+// Previous smoother implementation, building an xarray for every filtered point
+void legacySavitskyGolayFilter(
+  mppi::models::ControlSequence & control_sequence,
+  std::array<mppi::models::Control, 2> & control_history)
+{
+  xt::xarray<float> filter = {-3.0, 12.0, 17.0, 12.0, -3.0};
+  filter /= 35.0;
+  const unsigned int num_sequences = control_sequence.vx.shape(0);
+
+  auto applyFilter = [&](const xt::xarray<float> & data) -> float {
+      return xt::sum(data * filter, {0}, xt::evaluation_strategy::immediate)();
+    };
+
+  auto applyFilterOverAxis =
+    [&](xt::xtensor<float, 1> & sequence, const float hist_0, const float hist_1) -> void
+    {
+      unsigned int idx = 0;
+      sequence(idx) = applyFilter({hist_0, hist_1, sequence(idx), sequence(idx + 1),
+          sequence(idx + 2)});
+      idx++;
+      sequence(idx) = applyFilter({hist_1, sequence(idx - 1), sequence(idx),
+          sequence(idx + 1), sequence(idx + 2)});
+      for (idx = 2; idx != num_sequences - 3; idx++) {
+        sequence(idx) = applyFilter({sequence(idx - 2), sequence(idx - 1), sequence(idx),
+            sequence(idx + 1), sequence(idx + 2)});
+      }
+      idx++;
+      sequence(idx) = applyFilter({sequence(idx - 2), sequence(idx - 1), sequence(idx),
+          sequence(idx + 1), sequence(idx + 1)});
+      idx++;
+      sequence(idx) = applyFilter({sequence(idx - 2), sequence(idx - 1), sequence(idx),
+          sequence(idx), sequence(idx)});
+    };
+
+  applyFilterOverAxis(control_sequence.vx, control_history[0].vx, control_history[1].vx);
+  applyFilterOverAxis(control_sequence.vy, control_history[0].vy, control_history[1].vy);
+  applyFilterOverAxis(control_sequence.wz, control_history[0].wz, control_history[1].wz);
+}
+
+mppi::models::ControlSequence getDummyControlSequence()
+{
+  mppi::models::ControlSequence sequence;
+  sequence.reset(56);
+  sequence.vx = xt::random::randn<float>({56}, 0.2f, 0.5f);
+  sequence.vy = xt::random::randn<float>({56}, 0.0f, 0.3f);
+  sequence.wz = xt::random::randn<float>({56}, 0.0f, 1.5f);
+  return sequence;
+}
+
+static void BM_SmootherLegacy(benchmark::State & state)
+{
+  auto sequence = getDummyControlSequence();
+  std::array<mppi::models::Control, 2> history{};
+
+  for (auto _ : state) {
+    legacySavitskyGolayFilter(sequence, history);
+    benchmark::DoNotOptimize(sequence.vx.data());
+  }
+}
+
+static void BM_Smoother(benchmark::State & state)
+{
+  auto sequence = getDummyControlSequence();
+  std::array<mppi::models::Control, 4> history{};
+  mppi::models::OptimizerSettings settings;
+  settings.smoothing_window = state.range(0);
+
+  for (auto _ : state) {
+    mppi::utils::savitskyGolayFilter(sequence, history, settings);
+    benchmark::DoNotOptimize(sequence.vx.data());
+  }
+}
+
 BENCHMARK(BM_DiffDrivePointFootprint)->Unit(benchmark::kMillisecond);
 BENCHMARK(BM_DiffDrive)->Unit(benchmark::kMillisecond);
 BENCHMARK(BM_Omni)->Unit(benchmark::kMillisecond);
 BENCHMARK(BM_Ackermann)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SingleStageBudget)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TwoStageBudget)->Unit(benchmark::kMillisecond);
 
 BENCHMARK(BM_GoalCritic)->Unit(benchmark::kMillisecond);
 BENCHMARK(BM_GoalAngleCritic)->Unit(benchmark::kMillisecond);
@@ -210,4 +404,13 @@ BENCHMARK(BM_ObstaclesCritic)->Unit(benchmark::kMillisecond);
 BENCHMARK(BM_ObstaclesCriticPointFootprint)->Unit(benchmark::kMillisecond);
 BENCHMARK(BM_TwilringCritic)->Unit(benchmark::kMillisecond);
 
-BENCHMARK_MAIN();
+BENCHMARK(BM_CostmapGatherScalar)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_CostmapGatherBatched)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_RolloutRowMajor)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RolloutTiled)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_SmootherLegacy)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Smoother)->Arg(5)->Arg(7)->Arg(9)->Unit(benchmark::kMicrosecond);
+
+MPPIC_BENCHMARK_MAIN();
@@ -0,0 +1,234 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <nav2_core/goal_checker.hpp>
+#include <nav2_costmap_2d/costmap_2d_ros.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <rclcpp_lifecycle/lifecycle_node.hpp>
+
+#include "mppic/optimizer.hpp"
+#include "mppic/tools/cycle_log.hpp"
+#include "mppic/tools/parameters_handler.hpp"
+
+#include "build_context.hpp"
+
+// Replays a cycle log recorded by the controller's record_cycles_path into an optimizer,
+// without spinning any executor, and reports the latency distribution of the cycles and
+// how far their commands are from the recorded ones. Parameters are those of the
+// controller_server, given as usual with --ros-args --params-file. Replay noises are
+// seeded as recorded and deterministic, so that two replays give identical commands
+// unless a change alters the outputs, unlike the recorded run whose noises were timing
+// dependent
+//
+// Usage: replay_benchmark <log> [--name <plugin>] [--commands <csv>] [--tolerance <value>]
+
+namespace
+{
+
+/**
+ * @class ReplayGoalChecker
+ * @brief Goal checker reporting the recorded tolerances
+ */
+class ReplayGoalChecker : public nav2_core::GoalChecker
+{
+public:
+  void initialize(
+    const rclcpp_lifecycle::LifecycleNode::WeakPtr & /*parent*/,
+    const std::string & /*plugin_name*/,
+    const std::shared_ptr<nav2_costmap_2d::Costmap2DROS>/*costmap_ros*/) override {}
+
+  void reset() override {}
+
+  bool isGoalReached(
+    const geometry_msgs::msg::Pose & /*query_pose*/,
+    const geometry_msgs::msg::Pose & /*goal_pose*/,
+    const geometry_msgs::msg::Twist & /*velocity*/) override {return false;}
+
+  bool getTolerances(
+    geometry_msgs::msg::Pose & pose_tolerance, geometry_msgs::msg::Twist & vel_tolerance) override
+  {
+    pose_tolerance = pose_tolerance_;
+    vel_tolerance = vel_tolerance_;
+    return true;
+  }
+
+  geometry_msgs::msg::Pose pose_tolerance_;
+  geometry_msgs::msg::Twist vel_tolerance_;
+};
+
+struct ReplayOptions
+{
+  std::string log_path;
+  std::string name{"FollowPath"};
+  std::string commands_path;
+  double tolerance{-1.0};
+};
+
+ReplayOptions parseOptions(const std::vector<std::string> & args)
+{
+  ReplayOptions options;
+  for (size_t i = 1; i < args.size(); i++) {
+    const bool has_value = i + 1 < args.size();
+    if (args[i] == "--name" && has_value) {
+      options.name = args[++i];
+    } else if (args[i] == "--commands" && has_value) {
+      options.commands_path = args[++i];
+    } else if (args[i] == "--tolerance" && has_value) {
+      options.tolerance = std::stod(args[++i]);
+    } else if (options.log_path.empty() && args[i].rfind("--", 0) != 0) {
+      options.log_path = args[i];
+    } else {
+      throw std::runtime_error("Unknown argument " + args[i] + "!");
+    }
+  }
+  if (options.log_path.empty()) {
+    throw std::runtime_error(
+            "Usage: replay_benchmark <log> [--name <plugin>] [--commands <csv>] "
+            "[--tolerance <value>] [--ros-args --params-file <params>]");
+  }
+  return options;
+}
+
+void printLatencies(const char * label, std::vector<int64_t> latencies)
+{
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+      const size_t i = static_cast<size_t>(p * static_cast<double>(latencies.size() - 1));
+      return static_cast<double>(latencies[i]) * 1e-3;
+    };
+  double mean = 0.0;
+  for (const auto latency : latencies) {
+    mean += static_cast<double>(latency) * 1e-3;
+  }
+  mean /= static_cast<double>(latencies.size());
+  std::printf(
+    "%-9s latency (us): mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n", label, mean,
+    percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+}
+
+int replay(const ReplayOptions & options)
+{
+  mppi::CycleLogReader reader(options.log_path);
+
+  // Seeded as recorded, and waiting for the noises so that replays repeat
+  rclcpp::NodeOptions node_options;
+  node_options.parameter_overrides(
+    {rclcpp::Parameter(options.name + ".noise_seed", static_cast<int>(reader.getNoiseSeed())),
+      rclcpp::Parameter(options.name + ".deterministic_noises", true)});
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>(
+    "controller_server", node_options);
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>("replay_costmap");
+  costmap_ros->on_configure(rclcpp_lifecycle::State{});
+  auto parameters_handler = std::make_unique<mppi::ParametersHandler>(node);
+
+  auto optimizer = std::make_unique<mppi::Optimizer>();
+  optimizer->initialize(node, options.name, costmap_ros, parameters_handler.get());
+
+  std::ofstream commands;
+  if (!options.commands_path.empty()) {
+    commands.open(options.commands_path);
+    commands << "cycle,failed,vx,vy,wz,latency_us,recorded_failed,recorded_vx,recorded_vy,"
+      "recorded_wz,recorded_latency_us\n";
+  }
+
+  ReplayGoalChecker goal_checker;
+  mppi::RecordedCycle cycle;
+  std::vector<int64_t> latencies, recorded_latencies;
+  size_t cycles = 0, identical = 0, failure_mismatches = 0;
+  double max_error = 0.0;
+
+  while (reader.next(cycle)) {
+    mppi::CycleLogReader::applyCostmap(cycle, *costmap_ros->getCostmap());
+    costmap_ros->setRobotFootprint(cycle.footprint);
+    goal_checker.pose_tolerance_ = cycle.pose_tolerance;
+    goal_checker.vel_tolerance_ = cycle.vel_tolerance;
+
+    geometry_msgs::msg::TwistStamped cmd;
+    bool failed = false;
+    const auto start = std::chrono::steady_clock::now();
+    try {
+      cmd = optimizer->evalControl(
+        cycle.robot_pose, cycle.robot_speed, cycle.plan, cycle.robot_pose.header.stamp,
+        cycle.has_goal_checker ? &goal_checker : nullptr);
+    } catch (const std::runtime_error &) {
+      failed = true;
+    }
+    const int64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+
+    latencies.push_back(latency);
+    recorded_latencies.push_back(cycle.latency_ns);
+    const auto & t = cmd.twist;
+    const auto & r = cycle.cmd;
+    if (failed != cycle.failed) {
+      failure_mismatches++;
+    } else {
+      const double error = std::max(
+        {std::abs(t.linear.x - r.linear.x), std::abs(t.linear.y - r.linear.y),
+          std::abs(t.angular.z - r.angular.z)});
+      max_error = std::max(max_error, error);
+      identical += error == 0.0 ? 1 : 0;
+    }
+
+    if (commands.is_open()) {
+      commands << cycles << ',' << failed << ',' << t.linear.x << ',' << t.linear.y << ',' <<
+        t.angular.z << ',' << latency * 1e-3 << ',' << cycle.failed << ',' << r.linear.x <<
+        ',' << r.linear.y << ',' << r.angular.z << ',' << cycle.latency_ns * 1e-3 << '\n';
+    }
+    cycles++;
+  }
+  optimizer->shutdown();
+
+  std::printf(
+    "Replayed %zu cycles of %s (isa %s, parallel backend %s, xsimd %s)\n", cycles,
+    options.log_path.c_str(), MPPIC_BUILD_ISA, MPPIC_BUILD_PARALLEL_BACKEND,
+    xsimd::default_arch::name());
+  printLatencies("Replayed", latencies);
+  printLatencies("Recorded", recorded_latencies);
+  std::printf(
+    "Commands: %zu identical to the recorded ones, max error %g, %zu failure mismatches\n",
+    identical, max_error, failure_mismatches);
+
+  const bool diverged = options.tolerance >= 0.0 &&
+    (max_error > options.tolerance || failure_mismatches != 0);
+  return diverged ? 1 : 0;
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+  int result = 1;
+  try {
+    result = replay(parseOptions(rclcpp::remove_ros_arguments(argc, argv)));
+  } catch (const std::exception & e) {
+    std::fprintf(stderr, "%s\n", e.what());
+  }
+  rclcpp::shutdown();
+  return result;
+}
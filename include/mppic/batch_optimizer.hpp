@@ -0,0 +1,139 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__BATCH_OPTIMIZER_HPP_
+#define MPPIC__BATCH_OPTIMIZER_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "builtin_interfaces/msg/time.hpp"
+#include "geometry_msgs/msg/pose_stamped.hpp"
+#include "geometry_msgs/msg/twist.hpp"
+#include "geometry_msgs/msg/twist_stamped.hpp"
+#include "nav2_core/goal_checker.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+#include "mppic/models/path.hpp"
+#include "mppic/optimizer.hpp"
+#include "mppic/tools/costmap_source.hpp"
+#include "mppic/tools/parameters_handler.hpp"
+#include "mppic/tools/thread_pool.hpp"
+
+namespace mppi
+{
+
+/**
+ * @struct mppi::RobotProblem
+ * @brief Inputs of a robot's cycle in a batch
+ */
+struct RobotProblem
+{
+  geometry_msgs::msg::PoseStamped robot_pose;
+  geometry_msgs::msg::Twist robot_speed;
+  // Swapped with the robot's previous path, as by Optimizer::evalControl
+  models::Path path;
+  builtin_interfaces::msg::Time stamp;
+  nav2_core::GoalChecker * goal_checker{nullptr};
+};
+
+/**
+ * @struct mppi::RobotCommand
+ * @brief Output of a robot's cycle in a batch
+ */
+struct RobotCommand
+{
+  geometry_msgs::msg::TwistStamped cmd;
+  bool failed{false};
+  std::string error;
+};
+
+/**
+ * @class mppi::BatchOptimizer
+ * @brief Steps the MPPI problems of many robots on a shared costmap together, such as
+ * in a fleet simulator. Each robot has a headless optimizer, with its own softmax and
+ * buffers, and the robots' cycles are scheduled over one shared worker pool. Robot
+ * optimizers run single threaded with inline noise generation, so a batch uses the
+ * pool's threads only, instead of a worker pool and a noise thread per robot
+ */
+class BatchOptimizer
+{
+public:
+  /**
+    * @brief Constructor for mppi::BatchOptimizer
+    */
+  BatchOptimizer() = default;
+
+  /**
+    * @brief Destructor for mppi::BatchOptimizer
+    */
+  ~BatchOptimizer() {shutdown();}
+
+  /**
+    * @brief Create the robots' optimizers and start the worker pool
+    * @param name Name of plugin, the namespace of the parameters
+    * @param costmap Costmap shared by the robots, owned by the caller
+    * @param robots Number of robots
+    * @param parameters Fully namespaced parameters of every robot's optimizer.
+    * Their worker_threads and noise_thread are overridden
+    * @param num_threads Threads of the shared pool, including the caller.
+    * 0 selects the hardware concurrency
+    */
+  void initialize(
+    const std::string & name, const HeadlessCostmap & costmap, size_t robots,
+    const std::vector<rclcpp::Parameter> & parameters, unsigned int num_threads);
+
+  /**
+    * @brief Stop the robots' optimizers and the worker pool
+    */
+  void shutdown();
+
+  /**
+    * @brief Number of robots
+    * @return Robots
+    */
+  size_t size() const {return optimizers_.size();}
+
+  /**
+    * @brief Compute every robot's control, robots being processed concurrently on the
+    * worker pool. A robot failing does not affect the others
+    * @param problems Inputs of each robot, of size size()
+    * @param commands Outputs of each robot, resized to size()
+    */
+  void evalControls(std::vector<RobotProblem> & problems, std::vector<RobotCommand> & commands);
+
+  /**
+    * @brief Optimizer of a robot, e.g. to reset it or set its speed limit
+    * @param robot Index of the robot
+    * @return Optimizer
+    */
+  Optimizer & getOptimizer(size_t robot) {return *optimizers_.at(robot);}
+
+  /**
+    * @brief Parameters handler of a robot, to change its parameters
+    * @param robot Index of the robot
+    * @return Parameters handler
+    */
+  ParametersHandler & getParametersHandler(size_t robot) {return *parameters_handlers_.at(robot);}
+
+protected:
+  ThreadPool thread_pool_;
+  std::vector<std::unique_ptr<ParametersHandler>> parameters_handlers_;
+  std::vector<std::unique_ptr<Optimizer>> optimizers_;
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__BATCH_OPTIMIZER_HPP_
@@ -17,16 +17,24 @@
 
 #include <string>
 #include <memory>
+#include <exception>
+#include <vector>
 
+#include "mppic/tools/cycle_log.hpp"
 #include "mppic/tools/path_handler.hpp"
 #include "mppic/optimizer.hpp"
+#include "mppic/tools/thread_placement.hpp"
+#include "mppic/tools/thread_pool.hpp"
+#include "mppic/tools/trace_recorder.hpp"
 #include "mppic/tools/trajectory_visualizer.hpp"
 #include "mppic/models/constraints.hpp"
 #include "mppic/tools/utils.hpp"
 
+#include "diagnostic_msgs/msg/diagnostic_array.hpp"
 #include "nav2_core/controller.hpp"
 #include "nav2_core/goal_checker.hpp"
 #include "rclcpp/rclcpp.hpp"
+#include "std_srvs/srv/trigger.hpp"
 
 namespace mppi
 {
@@ -100,11 +108,50 @@ public:
   void setSpeedLimit(const double & speed_limit, const bool & percentage) override;
 
 protected:
+  /**
+    * @brief Create an optimizer per hypothesis after the first, each with its own
+    * nominal control sequence
+    */
+  void initializeHypotheses();
+
+  /**
+    * @brief Run every hypothesis' optimizer concurrently on the transformed plan and
+    * keep the command of the one of lowest expected cost, whose control sequence then
+    * also seeds the main optimizer's next cycle
+    * @param robot_pose Robot pose
+    * @param robot_speed Robot speed
+    * @param stamp Timestamp of the command
+    * @param goal_checker Pointer to the goal checker for awareness if completed task
+    * @return Command of the best hypothesis and its optimizer
+    */
+  std::pair<geometry_msgs::msg::TwistStamped, Optimizer *> evalHypotheses(
+    const geometry_msgs::msg::PoseStamped & robot_pose,
+    const geometry_msgs::msg::Twist & robot_speed,
+    const builtin_interfaces::msg::Time & stamp, nav2_core::GoalChecker * goal_checker);
+
   /**
     * @brief Visualize trajectories
+    * @param optimizer Optimizer whose trajectories to visualize
     * @param transformed_plan Transformed input plan
+    * @param stamp Timestamp of the plan
     */
-  void visualize(nav_msgs::msg::Path transformed_plan);
+  void visualize(
+    Optimizer & optimizer, const models::Path & transformed_plan,
+    const builtin_interfaces::msg::Time & stamp);
+
+  /**
+    * @brief Publish the latency stats of the optimizer, at most once per stats period
+    */
+  void publishLatencyStats();
+
+  /**
+    * @brief Dump the cycles' trace to the trace dump path
+    * @param request Empty request
+    * @param response Whether the trace was written, and where or why not
+    */
+  void dumpTrace(
+    const std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+    std::shared_ptr<std_srvs::srv::Trigger::Response> response);
 
   std::string name_;
   rclcpp_lifecycle::LifecycleNode::WeakPtr parent_;
@@ -114,10 +161,44 @@ protected:
 
   std::unique_ptr<ParametersHandler> parameters_handler_;
   Optimizer optimizer_;
+
+  // Optimizers of the hypotheses after the main one, with their path copies and results
+  int hypotheses_count_;
+  std::vector<std::unique_ptr<Optimizer>> hypotheses_;
+  std::vector<models::Path> hypothesis_paths_;
+  std::vector<geometry_msgs::msg::TwistStamped> hypothesis_cmds_;
+  std::vector<std::exception_ptr> hypothesis_errors_;
+  ThreadPool hypothesis_pool_;
+
   PathHandler path_handler_;
+  // Filled by the path handler, then swapped with the optimizer's path every cycle
+  models::Path transformed_plan_;
   TrajectoryVisualizer trajectory_visualizer_;
+  // Lowest cost trajectories to visualize, reused every cycle
+  models::Trajectories top_trajectories_;
+  xt::xtensor<float, 1> top_costs_;
 
   bool visualize_;
+  bool publish_latency_stats_;
+  double latency_stats_period_;
+  rclcpp::Time last_latency_stats_time_;
+  std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<diagnostic_msgs::msg::DiagnosticArray>>
+  latency_stats_pub_;
+
+  // Inputs and outputs of every cycle, recorded for offline replay if a path is set
+  std::string record_cycles_path_;
+  CycleRecorder cycle_recorder_;
+
+  // Timeline of the stages of every thread, dumped on request
+  bool trace_events_;
+  std::string trace_dump_path_;
+  TraceRecorder trace_recorder_;
+  uint32_t cycle_trace_{0}, parameters_trace_{0};
+  rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr dump_trace_service_;
+
+  // Placement of the thread calling the controller, applied on its first cycle
+  models::ThreadPlacement control_placement_;
+  bool control_placed_{false};
 };
 
 }  // namespace mppi
@@ -15,16 +15,25 @@
 #ifndef MPPIC__CRITIC_DATA_HPP_
 #define MPPIC__CRITIC_DATA_HPP_
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <vector>
 #include <xtensor/xtensor.hpp>
 
 #include "geometry_msgs/msg/pose_stamped.hpp"
 #include "nav2_core/goal_checker.hpp"
+#include "mppic/models/batch_tensor.hpp"
 #include "mppic/models/state.hpp"
 #include "mppic/models/trajectories.hpp"
 #include "mppic/models/path.hpp"
 #include "mppic/motion_models.hpp"
+#include "mppic/tools/costmap_snapshot.hpp"
+#include "mppic/tools/cycle_context.hpp"
+#include "mppic/tools/kernels.hpp"
+#include "mppic/tools/path_index.hpp"
+#include "mppic/tools/thread_pool.hpp"
+#include "mppic/tools/workspace.hpp"
 
 
 namespace mppi
@@ -33,7 +42,8 @@ namespace mppi
 /**
  * @struct mppi::CriticData
  * @brief Data to pass to critics for scoring, including state, trajectories, path, costs, and
- * important parameters to share
+ * important parameters to share. Fields added here are also to be copied to the data of
+ * concurrently scored critics, in CriticManager::prepareCriticData
  */
 struct CriticData
 {
@@ -41,7 +51,7 @@ struct CriticData
   const models::Trajectories & trajectories;
   const models::Path & path;
 
-  xt::xtensor<float, 1> & costs;
+  models::BatchTensor<1> & costs;
   float & model_dt;
 
   bool fail_flag;
@@ -49,6 +59,36 @@ struct CriticData
   std::shared_ptr<MotionModel> motion_model;
   std::optional<std::vector<bool>> path_pts_valid;
   std::optional<size_t> furthest_reached_path_point;
+  ThreadPool * thread_pool{nullptr};
+  Workspace * workspace{nullptr};
+  const PathIndex * path_index{nullptr};
+
+  // Non-zero for trajectories found in collision, which later critics and the control
+  // update may skip. Empty if the caller does not track collisions
+  std::vector<uint8_t> dead_trajectories{};
+
+  // Whether critics may use the float-only fast_math kernels for angles
+  bool fast_math{false};
+
+  // Costmap copy of this cycle for all critics to read, if snapshots are enabled
+  CostmapSnapshot * costmap_snapshot{nullptr};
+
+  // Time step of each point if they grow along the horizon, null for a uniform model_dt
+  const xt::xtensor<float, 1> * model_dts{nullptr};
+
+  // Whether these are the coarse rollouts of two-stage sampling, which critics may
+  // score with cheaper approximations
+  bool screening{false};
+
+  // Whether the cycle is about to overrun its latency budget, so that expensive critics
+  // are skipped and critics avoid their costly checks, such as footprints
+  bool degraded{false};
+
+  // Results holding for all iterations of this cycle, null to compute them on every use
+  CycleContext * cycle_context{nullptr};
+
+  // SIMD kernels selected for this CPU, null for the baseline ones
+  const kernels::KernelSet * kernel_set{nullptr};
 };
 
 }  // namespace mppi
@@ -15,14 +15,18 @@
 #ifndef MPPIC__CRITIC_FUNCTION_HPP_
 #define MPPIC__CRITIC_FUNCTION_HPP_
 
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <memory>
 
 #include "rclcpp_lifecycle/lifecycle_node.hpp"
 #include "nav2_costmap_2d/costmap_2d_ros.hpp"
 
+#include "mppic/tools/costmap_source.hpp"
 #include "mppic/tools/parameters_handler.hpp"
 #include "mppic/critic_data.hpp"
+#include "mppic/tools/fused_scorer.hpp"
 
 namespace mppi::critics
 {
@@ -37,6 +41,18 @@ struct CollisionCost
   bool using_footprint{false};
 };
 
+/**
+ * @enum mppi::critics::CriticStage
+ * @brief Stages of two-stage sampling a critic scores in: screening of the coarse
+ * rollouts of a large batch, refinement of the full resolution survivors, or both
+ */
+enum class CriticStage : uint8_t
+{
+  Screening = 1,
+  Refinement = 2,
+  Both = 3
+};
+
 /**
  * @class mppi::critics::CriticFunction
  * @brief Abstract critic objective function to score trajectories
@@ -68,32 +84,82 @@ public:
     const std::string & name,
     std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros,
     ParametersHandler * param_handler)
+  {
+    on_configure(
+      parent, parent_name, name, std::make_shared<CostmapSource>(costmap_ros), param_handler);
+  }
+
+  /**
+    * @brief Configure critic on bringup
+    * @param parent WeakPtr to node, may be empty for headless optimizers
+    * @param parent_name name of the controller
+    * @param name Name of plugin
+    * @param costmap_source Costmap of environment
+    * @param dynamic_parameter_handler Parameter handler object
+    */
+  void on_configure(
+    rclcpp_lifecycle::LifecycleNode::WeakPtr parent,
+    const std::string & parent_name,
+    const std::string & name,
+    std::shared_ptr<CostmapSource> costmap_source,
+    ParametersHandler * param_handler)
   {
     parent_ = parent;
-    logger_ = parent_.lock()->get_logger();
+    if (auto node = parent_.lock()) {
+      logger_ = node->get_logger();
+    }
     name_ = name;
     parent_name_ = parent_name;
-    costmap_ros_ = costmap_ros;
-    costmap_ = costmap_ros_->getCostmap();
+    costmap_source_ = costmap_source;
+    costmap_ros_ = costmap_source_->getCostmapROS();
+    costmap_ = costmap_source_->getCostmap();
     parameters_handler_ = param_handler;
 
     auto getParam = parameters_handler_->getParamGetter(name_);
     getParam(enabled_, "enabled", true);
+    std::string stage;
+    getParam(stage, "stage", std::string("refine"), ParameterType::Static);
+    setStage(stage);
 
     initialize();
   }
 
+  /**
+    * @brief Whether the critic scores in a stage, all critics scoring in Both
+    * @param stage Stage to check
+    * @return Whether the critic scores in the stage
+    */
+  bool scoresIn(CriticStage stage) const
+  {
+    return static_cast<uint8_t>(stage_) & static_cast<uint8_t>(stage);
+  }
+
   /**
     * @brief Main function to score trajectory
     * @param data Critic data to use in scoring
     */
   virtual void score(CriticData & data) = 0;
 
+  /**
+    * @brief Add the critic's cost of this cycle as a term of a fused scorer, instead
+    * of scoring on its own
+    * @param data Critic data to use
+    * @param scorer Scorer to add the term to, unless the critic does not score this cycle
+    * @return Whether the critic is fusable, otherwise it must be scored on its own
+    */
+  virtual bool addFusedTerm(CriticData & /*data*/, FusedScorer & /*scorer*/) {return false;}
+
   /**
     * @brief Initialize critic
     */
   virtual void initialize() = 0;
 
+  /**
+    * @brief Whether the critic is enabled, disabled critics not scoring
+    * @return Whether enabled
+    */
+  bool isEnabled() const {return enabled_;}
+
   /**
     * @brief Get name of critic
     */
@@ -103,10 +169,32 @@ public:
   }
 
 protected:
+  /**
+    * @brief Set the stage of two-stage sampling the critic scores in
+    * @param stage Stage string: refine, screen or both
+    */
+  void setStage(const std::string & stage)
+  {
+    if (stage == "refine") {
+      stage_ = CriticStage::Refinement;
+    } else if (stage == "screen") {
+      stage_ = CriticStage::Screening;
+    } else if (stage == "both") {
+      stage_ = CriticStage::Both;
+    } else {
+      throw std::runtime_error(
+              "Critic stage " + stage + " is not valid! Valid options are refine, "
+              "screen or both");
+    }
+  }
+
   bool enabled_;
+  CriticStage stage_{CriticStage::Refinement};
   std::string name_, parent_name_;
   rclcpp_lifecycle::LifecycleNode::WeakPtr parent_;
+  // Null for headless optimizers, the costmap source reading either
   std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros_;
+  std::shared_ptr<CostmapSource> costmap_source_;
   nav2_costmap_2d::Costmap2D * costmap_{nullptr};
 
   ParametersHandler * parameters_handler_;
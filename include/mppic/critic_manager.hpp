@@ -16,6 +16,7 @@
 #define MPPIC__CRITIC_MANAGER_HPP_
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 #include <pluginlib/class_loader.hpp>
@@ -27,10 +28,13 @@
 #include "nav2_costmap_2d/costmap_2d_ros.hpp"
 #include "rclcpp_lifecycle/lifecycle_node.hpp"
 
+#include "mppic/tools/costmap_source.hpp"
+#include "mppic/tools/latency_profiler.hpp"
 #include "mppic/tools/parameters_handler.hpp"
 #include "mppic/tools/utils.hpp"
 #include "mppic/critic_data.hpp"
 #include "mppic/critic_function.hpp"
+#include "mppic/tools/fused_scorer.hpp"
 
 namespace mppi
 {
@@ -58,11 +62,31 @@ public:
     rclcpp_lifecycle::LifecycleNode::WeakPtr parent, const std::string & name,
     std::shared_ptr<nav2_costmap_2d::Costmap2DROS>, ParametersHandler *);
 
+  /**
+    * @brief Configure critic manager on bringup and load plugins
+    * @param parent WeakPtr to node, may be empty for headless optimizers
+    * @param name Name of plugin
+    * @param costmap_source Costmap of environment
+    * @param dynamic_parameter_handler Parameter handler object
+    */
+  void on_configure(
+    rclcpp_lifecycle::LifecycleNode::WeakPtr parent, const std::string & name,
+    std::shared_ptr<CostmapSource>, ParametersHandler *);
+
   /**
     * @brief Score trajectories by the set of loaded critic functions
     * @param CriticData Struct of necessary information to pass to the critic functions
+    * @param stage Stage of two-stage sampling to score, only its critics scoring.
+    * Every critic scores in Both, as in single-stage sampling
+    */
+  void evalTrajectoriesScores(
+    CriticData & data, critics::CriticStage stage = critics::CriticStage::Both);
+
+  /**
+    * @brief Time every critic into a profiler, registering an entry per critic on load
+    * @param profiler Profiler to record into, null to disable
     */
-  void evalTrajectoriesScores(CriticData & data) const;
+  void setLatencyProfiler(LatencyProfiler * profiler);
 
 protected:
   /**
@@ -71,7 +95,7 @@ protected:
   void getParams();
 
   /**
-    * @brief Load the critic plugins
+    * @brief Load the critics, the built-in ones directly and the others as plugins
     */
   virtual void loadCritics();
 
@@ -80,15 +104,62 @@ protected:
     */
   std::string getFullName(const std::string & name);
 
+  /**
+    * @brief Score with every critic concurrently on the worker pool, each into its
+    * own cost buffer, then reduce the buffers into data.costs in critic order
+    * @param CriticData Struct of necessary information to pass to the critic functions
+    * @param stage Stage of two-stage sampling to score
+    */
+  void evalTrajectoriesScoresConcurrently(CriticData & data, critics::CriticStage stage);
+
+  /**
+    * @brief Rebuild the list of enabled critics, if parameters changed since it was built
+    */
+  void updateActiveCritics();
+
+  /**
+    * @brief Critics scoring the data: the enabled ones, less the expensive ones if the
+    * cycle is degraded by the latency watchdog
+    * @param CriticData Struct of necessary information to pass to the critic functions
+    * @return Indices of the critics, in critic order
+    */
+  const std::vector<size_t> & scoringCritics(const CriticData & data) const
+  {
+    return data.degraded ? degraded_critics_ : active_critics_;
+  }
+
+  /**
+    * @brief Bind the per-critic data to data, with costs redirected to the critic's buffer
+    * @param CriticData Struct of necessary information to pass to the critic functions
+    */
+  void prepareCriticData(const CriticData & data);
+
 protected:
   rclcpp_lifecycle::LifecycleNode::WeakPtr parent_;
   std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros_;
+  std::shared_ptr<CostmapSource> costmap_source_;
   std::string name_;
 
   ParametersHandler * parameters_handler_;
   std::vector<std::string> critic_names_;
+  bool parallel_critics_{false};
+  bool fuse_critics_{false};
   std::unique_ptr<pluginlib::ClassLoader<critics::CriticFunction>> loader_;
   std::vector<std::unique_ptr<critics::CriticFunction>> critics_;
+  // Indices of the enabled critics, in critic order, rebuilt on parameter changes
+  std::vector<size_t> active_critics_;
+  bool active_critics_changed_{true};
+  // Critics the latency watchdog skips, and the enabled critics less them
+  std::vector<std::string> expensive_critic_names_;
+  std::vector<size_t> degraded_critics_;
+  LatencyProfiler * latency_profiler_{nullptr};
+  std::vector<size_t> critic_latency_ids_;
+  FusedScorer fused_scorer_;
+  size_t fused_latency_id_{0};
+
+  // Per-critic views of the critic data and their cost buffers, for concurrent scoring
+  std::vector<std::optional<CriticData>> critic_data_;
+  std::vector<models::BatchTensor<1>> critic_costs_;
 
   rclcpp::Logger logger_{rclcpp::get_logger("MPPIController")};
 };
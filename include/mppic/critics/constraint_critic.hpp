@@ -41,6 +41,14 @@ public:
    */
   void score(CriticData & data) override;
 
+  /**
+   * @brief Add the critic's cost of this cycle as a term of a fused scorer
+   * @param data Critic data to use
+   * @param scorer Scorer to add the term to, unless the critic does not score this cycle
+   * @return True, the critic is fusable
+   */
+  bool addFusedTerm(CriticData & data, FusedScorer & scorer) override;
+
   float getMaxVelConstraint() {return max_vel_;}
   float getMinVelConstraint() {return min_vel_;}
 
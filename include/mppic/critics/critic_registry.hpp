@@ -0,0 +1,44 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef MPPIC__CRITICS__CRITIC_REGISTRY_HPP_
+#define MPPIC__CRITICS__CRITIC_REGISTRY_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mppic/critic_function.hpp"
+
+namespace mppi::critics
+{
+
+/**
+ * @brief Create a critic built into this package directly, without looking it up
+ * and loading it through pluginlib
+ * @param name Name of the critic class, without its namespace
+ * @return Critic, or null if not a built-in critic
+ */
+std::unique_ptr<CriticFunction> createBuiltinCritic(const std::string & name);
+
+/**
+ * @brief Names of the built-in critics
+ * @return Critic class names, without their namespace
+ */
+std::vector<std::string> builtinCriticNames();
+
+}  // namespace mppi::critics
+
+#endif  // MPPIC__CRITICS__CRITIC_REGISTRY_HPP_
@@ -42,6 +42,14 @@ public:
    */
   void score(CriticData & data) override;
 
+  /**
+   * @brief Add the critic's cost of this cycle as a term of a fused scorer
+   * @param data Critic data to use
+   * @param scorer Scorer to add the term to, unless the critic does not score this cycle
+   * @return True, the critic is fusable
+   */
+  bool addFusedTerm(CriticData & data, FusedScorer & scorer) override;
+
 protected:
   float threshold_to_consider_{0};
   unsigned int power_{0};
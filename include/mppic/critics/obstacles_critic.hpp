@@ -15,12 +15,18 @@
 #ifndef MPPIC__CRITICS__OBSTACLES_CRITIC_HPP_
 #define MPPIC__CRITICS__OBSTACLES_CRITIC_HPP_
 
+#include <array>
 #include <memory>
+#include <utility>
+#include <vector>
 #include "nav2_costmap_2d/footprint_collision_checker.hpp"
 #include "nav2_costmap_2d/inflation_layer.hpp"
 
 #include "mppic/critic_function.hpp"
 #include "mppic/models/state.hpp"
+#include "mppic/tools/distance_field.hpp"
+#include "mppic/tools/footprint_stencils.hpp"
+#include "mppic/tools/tiled_costmap.hpp"
 #include "mppic/tools/utils.hpp"
 
 namespace mppi::critics
@@ -56,6 +62,12 @@ protected:
     */
   bool inCollision(float cost) const;
 
+  /**
+    * @brief Rebuild the table of what each costmap cost means for the current scoring,
+    * replacing per-point collision checks and cost inversions with a single load
+    */
+  void updateCostLookup();
+
   /**
     * @brief Get max useful cost
     * @return unsigned char Max cost
@@ -71,6 +83,16 @@ protected:
     */
   CollisionCost costAtPose(float x, float y, float theta);
 
+  /**
+    * @brief cost at a robot pose, given the already looked up cost at its center
+    * @param x X of pose
+    * @param y Y of pose
+    * @param theta theta of pose
+    * @param point_cost Costmap cost at the center of the pose
+    * @return Collision information at pose
+    */
+  CollisionCost costAtPose(float x, float y, float theta, float point_cost);
+
   /**
     * @brief Distance to obstacle from cost
     * @param cost Costmap cost
@@ -78,20 +100,131 @@ protected:
     */
   float distanceToObstacle(const CollisionCost & cost);
 
+  /**
+    * @brief Distance to obstacle at a robot pose from the distance field, comparable
+    * to distanceToObstacle. With footprint checking, the footprint outline is checked
+    * against the field when close enough to an obstacle to possibly collide
+    * @param x X of pose
+    * @param y Y of pose
+    * @param theta theta of pose
+    * @return float Distance to the obstacle, non-positive if in collision and
+    * max float if in free space
+    */
+  float distanceFieldClearance(float x, float y, float theta) const;
+
+  /**
+    * @brief Distance to obstacle at a robot pose from the distance field, as above
+    * but with the trigonometry of theta already known
+    * @param x X of pose
+    * @param y Y of pose
+    * @param cos_theta Cosine of theta of pose
+    * @param sin_theta Sine of theta of pose
+    * @return float Distance to the obstacle, non-positive if in collision and
+    * max float if in free space
+    */
+  float distanceFieldClearance(float x, float y, float cos_theta, float sin_theta) const;
+
+  /**
+    * @brief Clearance of the robot center alone, from its distance field distance
+    * @param center_distance Distance field distance at the robot center
+    * @return float Distance to the obstacle, as distanceFieldClearance
+    */
+  float centerClearance(float center_distance) const;
+
+  /**
+    * @brief Distance field distance at a point, from the tiled mirror if enabled
+    * @param x X of the point
+    * @param y Y of the point
+    * @return float Distance in meters
+    */
+  float fieldDistance(float x, float y) const
+  {
+    return use_tiled_costmap_ ? tiled_costmap_.distance(x, y) : distance_field_.distance(x, y);
+  }
+
+  /**
+    * @brief Bring the tiled mirror up to date with the costmap, or the distance field
+    * @param data Data to use
+    * @param field_rebuilt Whether the distance field was rebuilt this cycle
+    */
+  void updateTiledCostmap(const CriticData & data, bool field_rebuilt);
+
+  /**
+    * @brief Clearance of the footprint outline, bounded by the center distance
+    * @param x X of pose
+    * @param y Y of pose
+    * @param center_distance Distance field distance at the robot center
+    * @param cos_theta Cosine of theta of pose
+    * @param sin_theta Sine of theta of pose
+    * @return float Distance to the obstacle, as distanceFieldClearance
+    */
+  float footprintClearance(
+    float x, float y, float center_distance, float cos_theta, float sin_theta) const;
+
+  /**
+    * @brief Bound on the distance between consecutive points of the scored trajectories,
+    * from the fastest of their velocities and the longest time step
+    * @param data Data to use
+    * @return float Distance in meters
+    */
+  static float maxStep(const CriticData & data);
+
+  /**
+    * @brief Number of points following a point in free space which cannot leave it, as
+    * they cannot get within the free distance of an obstacle
+    * @param x X of the point
+    * @param y Y of the point
+    * @param free_distance Distance from obstacles beyond which a pose is in free space
+    * @param max_step Bound on the distance between consecutive points
+    * @return size_t Points which need no lookup
+    */
+  size_t clearPoints(float x, float y, float free_distance, float max_step) const;
+
+  /**
+    * @brief Sample the robot footprint outline at the distance field resolution
+    */
+  void updateFootprintSamples();
+
   /**
     * @brief Find the min cost of the inflation decay function for which the robot MAY be
     * in collision in any orientation
-    * @param costmap Costmap2DROS to get minimum inscribed cost (e.g. 128 in inflation layer documentation)
+    * @param costmap Costmap source to get minimum inscribed cost (e.g. 128 in inflation layer documentation)
     * @return double circumscribed cost, any higher than this and need to do full footprint collision checking
     * since some element of the robot could be in collision
     */
-  double findCircumscribedCost(std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap);
+  double findCircumscribedCost(const CostmapSource & costmap);
 
 protected:
+  static constexpr size_t point_costs_block_ = 64;
+
+  /**
+   * @struct mppi::critics::ObstaclesCritic::CostLookup
+   * @brief What a costmap cost means, as inCollision and distanceToObstacle give
+   */
+  struct CostLookup
+  {
+    bool collision{false};
+    // Distances to the obstacle, for a center point and for a footprint cost
+    float center_distance{0};
+    float footprint_distance{0};
+  };
+  std::array<CostLookup, 256> cost_lookup_;
+
   nav2_costmap_2d::FootprintCollisionChecker<nav2_costmap_2d::Costmap2D *>
   collision_checker_{nullptr};
 
   bool consider_footprint_{true};
+  // Whether the footprint is checked in the current scoring, not when screening or degraded
+  bool check_footprint_{true};
+  bool use_distance_field_{false};
+  bool use_footprint_stencils_{false};
+  bool clearance_skipping_{false};
+  bool use_tiled_costmap_{false};
+  FootprintStencils footprint_stencils_;
+  DistanceField distance_field_;
+  TiledCostmap tiled_costmap_;
+  std::vector<std::pair<float, float>> footprint_samples_;
+  float inscribed_radius_{0}, circumscribed_radius_{0};
   double collision_cost_{0};
   float inflation_scale_factor_{0}, inflation_radius_{0};
 
@@ -43,6 +43,14 @@ public:
    */
   void score(CriticData & data) override;
 
+  /**
+   * @brief Add the critic's cost of this cycle as a term of a fused scorer
+   * @param data Critic data to use
+   * @param scorer Scorer to add the term to, unless the critic does not score this cycle
+   * @return True, the critic is fusable
+   */
+  bool addFusedTerm(CriticData & data, FusedScorer & scorer) override;
+
 protected:
   double max_angle_to_furthest_{0};
   float threshold_to_consider_{0};
@@ -0,0 +1,77 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__MODELS__BATCH_TENSOR_HPP_
+#define MPPIC__MODELS__BATCH_TENSOR_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include <xtensor/xtensor.hpp>
+
+namespace mppi::models
+{
+
+/**
+ * @brief Tensor over the trajectories of the batch, its first axis. Its storage keeps its
+ * capacity when resized, so the batch shrinks and grows back within the size reserved
+ * for it without reallocating
+ */
+template<size_t N>
+using BatchTensor = xt::xtensor_container<
+  std::vector<float, XTENSOR_DEFAULT_ALLOCATOR(float)>, N, XTENSOR_DEFAULT_LAYOUT>;
+
+/**
+ * @brief Reserve the storage of a batch tensor for a larger batch
+ * @param tensor Tensor to reserve, of its final shape but for the first axis
+ * @param batch_size Largest number of trajectories the tensor will be resized to
+ */
+template<size_t N>
+inline void reserveBatch(BatchTensor<N> & tensor, size_t batch_size)
+{
+  size_t size = batch_size;
+  for (size_t d = 1; d != N; d++) {
+    size *= tensor.shape(d);
+  }
+  tensor.storage().reserve(size);
+}
+
+/**
+ * @brief Change the number of trajectories of a batch tensor, keeping the leading ones.
+ * Within the reserved size, this does not reallocate
+ * @param tensor Tensor to resize
+ * @param batch_size Number of trajectories
+ */
+template<size_t N>
+inline void resizeBatch(BatchTensor<N> & tensor, size_t batch_size)
+{
+  auto shape = tensor.shape();
+  shape[0] = batch_size;
+  tensor.resize(shape);
+}
+
+/**
+ * @brief Bytes reserved by a batch tensor, at least those of its current shape
+ * @param tensor Tensor
+ * @return Bytes
+ */
+template<size_t N>
+inline size_t reservedBytes(const BatchTensor<N> & tensor)
+{
+  return tensor.storage().capacity() * sizeof(float);
+}
+
+}  // namespace mppi::models
+
+#endif  // MPPIC__MODELS__BATCH_TENSOR_HPP_
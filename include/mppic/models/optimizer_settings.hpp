@@ -16,11 +16,62 @@
 #define MPPIC__MODELS__OPTIMIZER_SETTINGS_HPP_
 
 #include <cstddef>
+#include <vector>
+
 #include "mppic/models/constraints.hpp"
+#include "mppic/models/thread_placement.hpp"
 
 namespace mppi::models
 {
 
+/**
+ * @enum mppi::models::NoiseSampler
+ * @brief Backend generating the sampling noises
+ */
+enum class NoiseSampler
+{
+  Default,
+  Xoshiro
+};
+
+/**
+ * @enum mppi::models::StoragePrecision
+ * @brief Precision of stored scratch data, computed on in float either way
+ */
+enum class StoragePrecision
+{
+  Float32,
+  Float16
+};
+
+/**
+ * @enum mppi::models::NominalSequence
+ * @brief Control sequence each cycle's sampling is centered on: the previous cycle's
+ * optimum, standing still, reversing at the minimum speed, or driving along the path
+ * at the maximum speed
+ */
+enum class NominalSequence
+{
+  Previous,
+  Stop,
+  Reverse,
+  PathFeedforward
+};
+
+/**
+ * @enum mppi::models::WatchdogStep
+ * @brief Degradation of a cycle about to overrun its latency budget: skipping its
+ * visualization, dropping its remaining iterations, scoring without the expensive
+ * critics and footprint checks, or reusing the shifted previous control sequence
+ */
+enum class WatchdogStep
+{
+  SkipVisualization,
+  DropIterations,
+  DisableExpensiveCritics,
+  ReusePreviousSequence
+};
+
 /**
  * @struct mppi::models::OptimizerSettings
  * @brief Settings for the optimizer to use
@@ -31,13 +82,47 @@ struct OptimizerSettings
   models::ControlConstraints constraints{0, 0, 0, 0};
   models::SamplingStd sampling_std{0, 0, 0};
   float model_dt{0};
+  float model_dt_max{0};
   float temperature{0};
   float gamma{0};
   unsigned int batch_size{0};
+  bool adaptive_batch_size{false};
+  unsigned int min_batch_size{0};
+  unsigned int max_batch_size{0};
+  unsigned int batch_size_step{0};
+  unsigned int screening_batch_size{0};
+  unsigned int screening_time_stride{2};
   unsigned int time_steps{0};
   unsigned int iteration_count{0};
+  float max_compute_time_ms{0};
+  float min_cost_improvement{0};
+  unsigned int warm_start_samples{0};
+  unsigned int worker_threads{1};
+  ThreadPlacement worker_placement;
+  NoiseSampler noise_sampler{NoiseSampler::Default};
+  StoragePrecision noise_precision{StoragePrecision::Float32};
+  NominalSequence nominal_sequence{NominalSequence::Previous};
+  int noise_seed{-1};
+  bool deterministic_noises{false};
+  bool noise_thread{true};
+  ThreadPlacement noise_thread_placement;
+  float noise_bank_memory_mb{0};
+  float noise_correlation{0};
+  bool adaptive_sampling{false};
+  float adaptive_sampling_rate{0};
+  float min_sampling_std_ratio{0};
+  unsigned int smoothing_window{5};
+  bool constrain_samples{false};
+  bool fast_math{false};
+  bool store_yaw_trig{false};
+  bool costmap_snapshot{false};
   bool shift_control_sequence{false};
   size_t retry_attempt_limit{0};
+  bool fallback_recovery{false};
+  float fallback_std_scale{2.0f};
+  bool pipelined_rollouts{false};
+  float watchdog_budget_ms{0};
+  std::vector<WatchdogStep> watchdog_steps;
 };
 
 }  // namespace mppi::models
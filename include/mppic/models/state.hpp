@@ -17,6 +17,8 @@
 
 #include <xtensor/xtensor.hpp>
 
+#include "mppic/models/batch_tensor.hpp"
+
 #include <geometry_msgs/msg/pose_stamped.hpp>
 #include <geometry_msgs/msg/twist.hpp>
 
@@ -29,30 +31,66 @@ namespace mppi::models
  */
 struct State
 {
-  xt::xtensor<float, 2> vx;
-  xt::xtensor<float, 2> vy;
-  xt::xtensor<float, 2> wz;
+  BatchTensor<2> vx;
+  BatchTensor<2> vy;
+  BatchTensor<2> wz;
 
-  xt::xtensor<float, 2> cvx;
-  xt::xtensor<float, 2> cvy;
-  xt::xtensor<float, 2> cwz;
+  BatchTensor<2> cvx;
+  BatchTensor<2> cvy;
+  BatchTensor<2> cwz;
 
   geometry_msgs::msg::PoseStamped pose;
   geometry_msgs::msg::Twist speed;
 
+  // Duration of each time step, for motion models with dynamics, or null
+  const xt::xtensor<float, 1> * model_dts{nullptr};
+
   /**
     * @brief Reset state data
+    * @param lateral Whether to size the lateral velocities, only used by holonomic models
     */
-  void reset(unsigned int batch_size, unsigned int time_steps)
+  void reset(unsigned int batch_size, unsigned int time_steps, bool lateral = true)
   {
+    const unsigned int lateral_size = lateral ? batch_size : 0;
     vx = xt::zeros<float>({batch_size, time_steps});
-    vy = xt::zeros<float>({batch_size, time_steps});
+    vy = xt::zeros<float>({lateral_size, time_steps});
     wz = xt::zeros<float>({batch_size, time_steps});
 
     cvx = xt::zeros<float>({batch_size, time_steps});
-    cvy = xt::zeros<float>({batch_size, time_steps});
+    cvy = xt::zeros<float>({lateral_size, time_steps});
     cwz = xt::zeros<float>({batch_size, time_steps});
   }
+
+  /**
+    * @brief Reserve the storage for a larger batch, so resizing up to it does not reallocate
+    * @param batch_size Largest number of trajectories
+    */
+  void reserve(unsigned int batch_size)
+  {
+    // Lateral velocities are only sized for holonomic models
+    const unsigned int lateral_size = vy.shape(0) != 0 ? batch_size : 0;
+    reserveBatch(vx, batch_size);
+    reserveBatch(vy, lateral_size);
+    reserveBatch(wz, batch_size);
+    reserveBatch(cvx, batch_size);
+    reserveBatch(cvy, lateral_size);
+    reserveBatch(cwz, batch_size);
+  }
+
+  /**
+    * @brief Change the number of trajectories, keeping the leading ones
+    * @param batch_size Number of trajectories, within the reserved size not to reallocate
+    */
+  void resize(unsigned int batch_size)
+  {
+    const unsigned int lateral_size = vy.shape(0) != 0 ? batch_size : 0;
+    resizeBatch(vx, batch_size);
+    resizeBatch(vy, lateral_size);
+    resizeBatch(wz, batch_size);
+    resizeBatch(cvx, batch_size);
+    resizeBatch(cvy, lateral_size);
+    resizeBatch(cwz, batch_size);
+  }
 };
 }  // namespace mppi::models
 
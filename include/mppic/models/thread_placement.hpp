@@ -0,0 +1,60 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__MODELS__THREAD_PLACEMENT_HPP_
+#define MPPIC__MODELS__THREAD_PLACEMENT_HPP_
+
+#include <string>
+#include <vector>
+
+namespace mppi::models
+{
+
+/**
+ * @enum mppi::models::ThreadScheduling
+ * @brief Scheduling policy of a thread: the default time sharing one, or real-time
+ * first in first out
+ */
+enum class ThreadScheduling
+{
+  Other,
+  Fifo
+};
+
+/**
+ * @struct mppi::models::ThreadPlacement
+ * @brief CPUs a thread may run on and its scheduling. No CPUs and a zero priority
+ * leave the thread as inherited from its creator
+ */
+struct ThreadPlacement
+{
+  std::vector<int> cpus;
+  ThreadScheduling scheduling{ThreadScheduling::Other};
+  // Real-time priority in [1, 99] if first in first out, else nice value in [-20, 19]
+  int priority{0};
+};
+
+/**
+ * @struct mppi::models::ThreadPlacementReport
+ * @brief Placement a thread ended up with, and whether all of its configured one applied
+ */
+struct ThreadPlacementReport
+{
+  bool applied{true};
+  std::string description;
+};
+
+}  // namespace mppi::models
+
+#endif  // MPPIC__MODELS__THREAD_PLACEMENT_HPP_
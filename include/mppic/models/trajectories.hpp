@@ -18,6 +18,8 @@
 #include <xtensor/xtensor.hpp>
 #include <xtensor/xview.hpp>
 
+#include "mppic/models/batch_tensor.hpp"
+
 namespace mppi::models
 {
 
@@ -27,18 +29,68 @@ namespace mppi::models
  */
 struct Trajectories
 {
-  xt::xtensor<float, 2> x;
-  xt::xtensor<float, 2> y;
-  xt::xtensor<float, 2> yaws;
+  BatchTensor<2> x;
+  BatchTensor<2> y;
+  BatchTensor<2> yaws;
+  // Cosine and sine of the yaws, only sized when the rollout stores them
+  BatchTensor<2> yaw_cos;
+  BatchTensor<2> yaw_sin;
 
   /**
     * @brief Reset state data
+    * @param yaw_trig Whether to also size the cosine and sine of the yaws
     */
-  void reset(unsigned int batch_size, unsigned int time_steps)
+  void reset(unsigned int batch_size, unsigned int time_steps, bool yaw_trig = false)
   {
     x = xt::zeros<float>({batch_size, time_steps});
     y = xt::zeros<float>({batch_size, time_steps});
     yaws = xt::zeros<float>({batch_size, time_steps});
+    if (yaw_trig) {
+      yaw_cos = xt::ones<float>({batch_size, time_steps});
+      yaw_sin = xt::zeros<float>({batch_size, time_steps});
+    } else {
+      yaw_cos = BatchTensor<2>::from_shape({0, 0});
+      yaw_sin = BatchTensor<2>::from_shape({0, 0});
+    }
+  }
+
+  /**
+    * @brief Reserve the storage for a larger batch, so resizing up to it does not reallocate
+    * @param batch_size Largest number of trajectories
+    */
+  void reserve(unsigned int batch_size)
+  {
+    if (hasYawTrig()) {
+      reserveBatch(yaw_cos, batch_size);
+      reserveBatch(yaw_sin, batch_size);
+    }
+    reserveBatch(x, batch_size);
+    reserveBatch(y, batch_size);
+    reserveBatch(yaws, batch_size);
+  }
+
+  /**
+    * @brief Change the number of trajectories, keeping the leading ones
+    * @param batch_size Number of trajectories, within the reserved size not to reallocate
+    */
+  void resize(unsigned int batch_size)
+  {
+    if (hasYawTrig()) {
+      resizeBatch(yaw_cos, batch_size);
+      resizeBatch(yaw_sin, batch_size);
+    }
+    resizeBatch(x, batch_size);
+    resizeBatch(y, batch_size);
+    resizeBatch(yaws, batch_size);
+  }
+
+  /**
+    * @brief Whether the cosine and sine of the yaws are stored
+    * @return True if yaw_cos and yaw_sin match the yaws
+    */
+  bool hasYawTrig() const
+  {
+    return yaw_cos.shape() == yaws.shape() && yaw_sin.shape() == yaws.shape();
   }
 };
 
@@ -15,15 +15,17 @@
 #ifndef MPPIC__MOTION_MODELS_HPP_
 #define MPPIC__MOTION_MODELS_HPP_
 
+#include <cstddef>
 #include <cstdint>
+#include <limits>
 
 #include "mppic/models/control_sequence.hpp"
 #include "mppic/models/state.hpp"
 #include <xtensor/xmath.hpp>
-#include <xtensor/xmasked_view.hpp>
 #include <xtensor/xview.hpp>
 #include <xtensor/xnoalias.hpp>
 
+#include "mppic/tools/kernels.hpp"
 #include "mppic/tools/parameters_handler.hpp"
 
 namespace mppi
@@ -50,21 +52,41 @@ public:
    * @brief With input velocities, find the vehicle's output velocities
    * @param state Contains control velocities to use to populate vehicle velocities
    */
-  virtual void predict(models::State & state)
+  void predict(models::State & state)
+  {
+    predict(state, 0, state.vx.shape(0));
+  }
+
+  /**
+   * @brief With input velocities, find the vehicle's output velocities for
+   * a contiguous range of trajectories in the batch
+   * @param state Contains control velocities to use to populate vehicle velocities
+   * @param begin First trajectory of the range
+   * @param end Past-the-end trajectory of the range
+   */
+  virtual void predict(models::State & state, size_t begin, size_t end)
   {
     using namespace xt::placeholders;  // NOLINT
-    xt::noalias(xt::view(state.vx, xt::all(), xt::range(1, _))) =
-      xt::view(state.cvx, xt::all(), xt::range(0, -1));
+    const auto rows = xt::range(begin, end);
+    xt::noalias(xt::view(state.vx, rows, xt::range(1, _))) =
+      xt::view(state.cvx, rows, xt::range(0, -1));
 
-    xt::noalias(xt::view(state.wz, xt::all(), xt::range(1, _))) =
-      xt::view(state.cwz, xt::all(), xt::range(0, -1));
+    xt::noalias(xt::view(state.wz, rows, xt::range(1, _))) =
+      xt::view(state.cwz, rows, xt::range(0, -1));
 
     if (isHolonomic()) {
-      xt::noalias(xt::view(state.vy, xt::all(), xt::range(1, _))) =
-        xt::view(state.cvy, xt::all(), xt::range(0, -1));
+      xt::noalias(xt::view(state.vy, rows, xt::range(1, _))) =
+        xt::view(state.cvy, rows, xt::range(0, -1));
     }
   }
 
+  /**
+   * @brief Whether the propagated velocities depend on the initial ones, rather than
+   * only on the controls
+   * @return True if the velocities of a rollout depend on the robot speed
+   */
+  virtual bool dependsOnInitialVelocities() const {return false;}
+
   /**
    * @brief Whether the motion model is holonomic, using Y axis
    * @return Bool If holonomic
@@ -76,6 +98,24 @@ public:
    * @param control_sequence Control sequence to apply constraints to
    */
   virtual void applyConstraints(models::ControlSequence & /*control_sequence*/) {}
+
+  /**
+   * @brief Apply hard vehicle constraints to the sampled controls of a contiguous range
+   * of trajectories in the batch, so that they are feasible before being rolled out
+   * @param state Contains the sampled controls to apply constraints to
+   * @param begin First trajectory of the range
+   * @param end Past-the-end trajectory of the range
+   */
+  virtual void applyConstraints(models::State & /*state*/, size_t /*begin*/, size_t /*end*/) {}
+
+  /**
+   * @brief Set the SIMD kernels of the batched model operations
+   * @param kernel_set Kernel set to use
+   */
+  void setKernels(const kernels::KernelSet & kernel_set) {kernels_ = &kernel_set;}
+
+protected:
+  const kernels::KernelSet * kernels_{&kernels::baselineKernels()};
 };
 
 /**
@@ -109,11 +149,24 @@ public:
    */
   void applyConstraints(models::ControlSequence & control_sequence) override
   {
-    auto & vx = control_sequence.vx;
-    auto & wz = control_sequence.wz;
+    kernels::limitTurningRate(
+      kernels::baselineKernels(), control_sequence.vx.data(), control_sequence.wz.data(),
+      control_sequence.vx.size(), min_turning_r_);
+  }
 
-    auto view = xt::masked_view(wz, xt::fabs(vx) / xt::fabs(wz) > min_turning_r_);
-    view = xt::sign(wz) * vx / min_turning_r_;
+  /**
+   * @brief Apply hard vehicle constraints to the sampled controls of a range of trajectories
+   * @param state Contains the sampled controls to apply constraints to
+   * @param begin First trajectory of the range
+   * @param end Past-the-end trajectory of the range
+   */
+  void applyConstraints(models::State & state, size_t begin, size_t end) override
+  {
+    // Rows are contiguous, so the range is constrained as a single run of controls
+    const size_t time_steps = state.cvx.shape(1);
+    kernels::limitTurningRate(
+      *kernels_, state.cvx.data() + begin * time_steps, state.cwz.data() + begin * time_steps,
+      (end - begin) * time_steps, min_turning_r_);
   }
 
   /**
@@ -170,6 +223,118 @@ public:
   }
 };
 
+/**
+ * @class mppi::AccelLimitedMotionModel
+ * @brief Motion model whose velocities move towards the controls of the previous time
+ * step by at most their acceleration limits, rather than reaching them at once
+ */
+class AccelLimitedMotionModel : public MotionModel
+{
+public:
+  /**
+    * @brief Constructor for mppi::AccelLimitedMotionModel
+    * @param param_handler Parameters handler reading the acceleration limits
+    * @param holonomic Whether the model uses the Y axis
+    */
+  AccelLimitedMotionModel(ParametersHandler * param_handler, bool holonomic)
+  : holonomic_(holonomic)
+  {
+    // Static, as the model is replaced whenever the motion model changes
+    auto getParam = param_handler->getParamGetter("AccelerationConstraints");
+    getParam(ax_max_, "ax_max", 3.0, ParameterType::Static);
+    getParam(ay_max_, "ay_max", 3.0, ParameterType::Static);
+    getParam(az_max_, "az_max", 3.5, ParameterType::Static);
+  }
+
+  /**
+   * @brief Whether the motion model is holonomic, using Y axis
+   * @return Bool If holonomic
+   */
+  bool isHolonomic() override
+  {
+    return holonomic_;
+  }
+
+  /**
+   * @brief With input velocities, find the vehicle's output velocities for
+   * a contiguous range of trajectories in the batch, within acceleration limits.
+   * Without the durations of the time steps, the controls are reached at once
+   * @param state Contains control velocities to use to populate vehicle velocities
+   * @param begin First trajectory of the range
+   * @param end Past-the-end trajectory of the range
+   */
+  void predict(models::State & state, size_t begin, size_t end) override
+  {
+    if (state.model_dts == nullptr) {
+      MotionModel::predict(state, begin, end);
+      return;
+    }
+
+    auto limit = [](float accel) {
+        return accel > 0.0f ? accel : std::numeric_limits<float>::infinity();
+      };
+    const kernels::DynamicsView view{state.cvx.data(), state.cvy.data(), state.cwz.data(),
+      state.vx.data(), state.vy.data(), state.wz.data(), state.vx.shape(1),
+      state.model_dts->data(), limit(ax_max_), limit(ay_max_), limit(az_max_)};
+    kernels::limitAcceleration(*kernels_, view, begin, end, holonomic_);
+  }
+
+  /**
+   * @brief Whether the propagated velocities depend on the initial ones
+   * @return True, as each velocity is reached from the previous one
+   */
+  bool dependsOnInitialVelocities() const override {return true;}
+
+  /**
+   * @brief Get the acceleration limits
+   * @param ax_max Longitudinal acceleration limit
+   * @param ay_max Lateral acceleration limit
+   * @param az_max Angular acceleration limit
+   */
+  void getAccelerationLimits(float & ax_max, float & ay_max, float & az_max) const
+  {
+    ax_max = ax_max_;
+    ay_max = ay_max_;
+    az_max = az_max_;
+  }
+
+private:
+  bool holonomic_;
+  float ax_max_{0};
+  float ay_max_{0};
+  float az_max_{0};
+};
+
+/**
+ * @class mppi::AccelLimitedDiffDriveMotionModel
+ * @brief Differential drive motion model with acceleration limits
+ */
+class AccelLimitedDiffDriveMotionModel : public AccelLimitedMotionModel
+{
+public:
+  /**
+    * @brief Constructor for mppi::AccelLimitedDiffDriveMotionModel
+    * @param param_handler Parameters handler reading the acceleration limits
+    */
+  explicit AccelLimitedDiffDriveMotionModel(ParametersHandler * param_handler)
+  : AccelLimitedMotionModel(param_handler, false) {}
+};
+
+/**
+ * @class mppi::AccelLimitedOmniMotionModel
+ * @brief Omnidirectional motion model with acceleration limits
+ */
+class AccelLimitedOmniMotionModel : public AccelLimitedMotionModel
+{
+public:
+  /**
+    * @brief Constructor for mppi::AccelLimitedOmniMotionModel
+    * @param param_handler Parameters handler reading the acceleration limits
+    */
+  explicit AccelLimitedOmniMotionModel(ParametersHandler * param_handler)
+  : AccelLimitedMotionModel(param_handler, true) {}
+};
+
 }  // namespace mppi
 
 #endif  // MPPIC__MOTION_MODELS_HPP_
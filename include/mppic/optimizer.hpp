@@ -15,8 +15,14 @@
 #ifndef MPPIC__OPTIMIZER_HPP_
 #define MPPIC__OPTIMIZER_HPP_
 
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <xtensor/xtensor.hpp>
 #include <xtensor/xview.hpp>
@@ -37,13 +43,47 @@
 #include "mppic/models/state.hpp"
 #include "mppic/models/trajectories.hpp"
 #include "mppic/models/path.hpp"
+#include "mppic/tools/costmap_snapshot.hpp"
+#include "mppic/tools/costmap_source.hpp"
+#include "mppic/tools/cycle_context.hpp"
+#include "mppic/tools/kernels.hpp"
+#include "mppic/tools/latency_profiler.hpp"
 #include "mppic/tools/noise_generator.hpp"
 #include "mppic/tools/parameters_handler.hpp"
+#include "mppic/tools/thread_placement.hpp"
+#include "mppic/tools/thread_pool.hpp"
+#include "mppic/tools/trace_recorder.hpp"
+#include "mppic/tools/workspace.hpp"
 #include "mppic/tools/utils.hpp"
 
 namespace mppi
 {
 
+/**
+ * @struct mppi::MemoryUsage
+ * @brief Bytes held by a component of the optimizer
+ */
+struct MemoryUsage
+{
+  std::string component;
+  size_t bytes{0};
+};
+
+/**
+ * @struct mppi::WatchdogStats
+ * @brief Counters of the latency watchdog since configuration: cycles run, cycles which
+ * overran the budget anyway, and how often each degradation was applied
+ */
+struct WatchdogStats
+{
+  size_t cycles{0};
+  size_t overruns{0};
+  size_t skipped_visualizations{0};
+  size_t dropped_iterations{0};
+  size_t disabled_expensive_critics{0};
+  size_t reused_sequences{0};
+};
+
 /**
  * @class mppi::Optimizer
  * @brief Main algorithm optimizer of the MPPI Controller
@@ -74,6 +114,18 @@ public:
     std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros,
     ParametersHandler * dynamic_parameters_handler);
 
+  /**
+   * @brief Initializes a headless optimizer, without a node or Costmap2DROS, for
+   * lightweight instances such as many optimizers in a process. Parameters are read
+   * from a headless parameters handler, whose start() is to be called after
+   * @param name Name of plugin, the namespace of its parameters
+   * @param costmap Costmap of environment, owned by the caller
+   * @param dynamic_parameter_handler Parameter handler object
+   */
+  void initialize(
+    const std::string & name, const HeadlessCostmap & costmap,
+    ParametersHandler * dynamic_parameters_handler);
+
   /**
    * @brief Shutdown for optimizer at process end
    */
@@ -92,12 +144,44 @@ public:
     const geometry_msgs::msg::Twist & robot_speed, const nav_msgs::msg::Path & plan,
     nav2_core::GoalChecker * goal_checker);
 
+  /**
+   * @brief Compute control using MPPI algorithm on a path already in tensor form.
+   * The path is swapped with the previous cycle's, so neither is copied and the
+   * caller gets buffers back to fill for the next cycle
+   * @param robot_pose Pose of the robot at given time
+   * @param robot_speed Speed of the robot at given time
+   * @param path Path to track, in the costmap frame
+   * @param stamp Timestamp of the path
+   * @param goal_checker Object to check if goal is completed
+   * @return TwistStamped of the MPPI control
+   */
+  geometry_msgs::msg::TwistStamped evalControl(
+    const geometry_msgs::msg::PoseStamped & robot_pose,
+    const geometry_msgs::msg::Twist & robot_speed, models::Path & path,
+    const builtin_interfaces::msg::Time & stamp, nav2_core::GoalChecker * goal_checker);
+
+  /**
+   * @brief Get the path tracked in the last cycle
+   * @return Path
+   */
+  const models::Path & getPath() const;
+
   /**
    * @brief Get the trajectories generated in a cycle for visualization
    * @return Set of trajectories evaluated in cycle
    */
   models::Trajectories & getGeneratedTrajectories();
 
+  /**
+   * @brief Get the lowest cost trajectories of the last iteration, by increasing cost.
+   * Selected in linear time over the batch, then only they are sorted and copied
+   * @param count Number of trajectories, clamped to the batch size
+   * @param trajectories Trajectories to fill, only reallocated if their shape changes
+   * @param costs Costs of the trajectories to fill
+   */
+  void getTopTrajectories(
+    size_t count, models::Trajectories & trajectories, xt::xtensor<float, 1> & costs);
+
   /**
    * @brief Get the optimal trajectory for a cycle for visualization
    * @return Optimal trajectory
@@ -111,17 +195,168 @@ public:
    */
   void setSpeedLimit(double speed_limit, bool percentage);
 
+  /**
+   * @brief Get the latency instrumentation of the optimizer stages and critics
+   * @return Latency profiler
+   */
+  const LatencyProfiler & getLatencyProfiler() const;
+
+  /**
+   * @brief Trace the optimizer stages, critics and noise generation into a timeline
+   * @param recorder Recorder to trace into, null to stop tracing
+   */
+  void setTraceRecorder(TraceRecorder * recorder);
+
+  /**
+   * @brief With pipelined rollouts, start sampling and rolling out the next cycle's first
+   * iteration in the background, from the shifted control sequence and relative to the
+   * robot pose, for the next cycle to only move them to the measured pose and speed.
+   * The cycle's trajectories are overwritten, so this is called once they were used
+   */
+  void startPreroll();
+
+  /**
+   * @brief Wait for the background pre-roll, if running, before the optimizer or its
+   * parameters are otherwise used
+   */
+  void finishPreroll();
+
+  /**
+   * @brief Get the counters of the latency watchdog
+   * @return Watchdog counters
+   */
+  const WatchdogStats & getWatchdogStats() const {return watchdog_stats_;}
+
+  /**
+   * @brief Whether the latency watchdog skipped the visualization of the last cycle
+   * @return True if the last cycle should not be visualized
+   */
+  bool isVisualizationSkipped() const {return watchdog_.skip_visualization;}
+
+  /**
+   * @brief Get the bytes held by the batch sized buffers of the optimizer, per component
+   * @return Memory usage of the state, trajectories, noises, noise bank, workspace,
+   * warm start, costs and costmap snapshot, in that order
+   */
+  std::vector<MemoryUsage> getMemoryUsage() const;
+
   /**
    * @brief Reset the optimization problem to initial conditions
    */
   void reset();
 
+  /**
+   * @brief Set the control sequence each cycle starts from
+   * @param nominal Nominal control sequence
+   */
+  void setNominalSequence(models::NominalSequence nominal);
+
+  /**
+   * @brief Get the expected cost of the last cycle's control sequence, i.e. the
+   * softmax weighted cost of the samples it averages. Comparable between optimizers
+   * configured with the same critics
+   * @return Expected cost
+   */
+  float getExpectedCost() const;
+
+  /**
+   * @brief Seed the noise sampler was seeded with, to record for replays
+   * @return Seed
+   */
+  unsigned int getNoiseSeed() const;
+
+  /**
+   * @brief CPUs and scheduling of the worker threads, for other pools to place theirs alike
+   * @return Worker placement
+   */
+  const models::ThreadPlacement & getWorkerPlacement() const {return settings_.worker_placement;}
+
+  /**
+   * @brief Get the control sequence, shifted for the next cycle if shifting is on
+   * @return Control sequence
+   */
+  const models::ControlSequence & getControlSequence() const;
+
+  /**
+   * @brief Get the time step of each point of the horizon
+   * @return Time steps, uniform unless model_dt_max is set
+   */
+  const xt::xtensor<float, 1> & getModelDts() const;
+
+  /**
+   * @brief Replace the control sequence, e.g. with a better one found by another optimizer
+   * @param control_sequence Control sequence, of the optimizer's time steps
+   */
+  void setControlSequence(const models::ControlSequence & control_sequence);
+
 protected:
+  /**
+   * @brief Initializes optimizer from either costmap source
+   * @param parent WeakPtr to node, empty if headless
+   * @param name Name of plugin
+   * @param costmap_source Costmap of environment
+   * @param dynamic_parameter_handler Parameter handler object
+   */
+  void configure(
+    rclcpp_lifecycle::LifecycleNode::WeakPtr parent, const std::string & name,
+    std::shared_ptr<CostmapSource> costmap_source,
+    ParametersHandler * dynamic_parameters_handler);
+
   /**
    * @brief Main function to generate, score, and return trajectories
    */
   void optimize();
 
+  /**
+   * @brief Run a single generate, score and update iteration
+   */
+  void iterate();
+
+  /**
+   * @brief Iterate until the compute time budget is used up or the expected cost
+   * stops improving, keeping the best control sequence found
+   */
+  void optimizeWithinBudget();
+
+  /**
+   * @brief Whether the next cycle's first iteration can be rolled out ahead, its
+   * sampling and velocities not depending on the next cycle's inputs
+   * @return True if pipelining applies
+   */
+  bool canPreroll() const;
+
+  /**
+   * @brief Sample and roll out the next cycle's first iteration, from a robot at the
+   * origin without speed
+   */
+  void prerollNextCycle();
+
+  /**
+   * @brief Take the pre-rolled trajectories for this iteration if there are, moving them
+   * to the measured pose after its first step at the measured speed
+   * @return False if the iteration generates its trajectories
+   */
+  bool usePrerolledTrajectories();
+
+  /**
+   * @brief Background thread running the requested pre-rolls
+   */
+  void prerollThread();
+
+  /**
+   * @brief Start watching a cycle's latency, after its preparation
+   * @param start Start of the cycle
+   */
+  void startWatchdog(std::chrono::steady_clock::time_point start);
+
+  /**
+   * @brief Check before an iteration whether it would overrun the latency budget, and if
+   * so apply the next degradation of the configured order
+   * @param iterations Iterations already run by this optimization
+   * @return False if the remaining iterations are to be dropped
+   */
+  bool watchdogAllowsIteration(size_t iterations);
+
   /**
    * @brief Prepare state information on new request for trajectory rollouts
    * @param robot_pose Pose of the robot at given time
@@ -134,6 +369,23 @@ protected:
     const geometry_msgs::msg::Twist & robot_speed,
     const nav_msgs::msg::Path & plan, nav2_core::GoalChecker * goal_checker);
 
+  /**
+   * @brief Prepare state information on new request for trajectory rollouts
+   * @param robot_pose Pose of the robot at given time
+   * @param robot_speed Speed of the robot at given time
+   * @param path Path to track, swapped with the previous one
+   * @param goal_checker Object to check if goal is completed
+   */
+  void prepare(
+    const geometry_msgs::msg::PoseStamped & robot_pose,
+    const geometry_msgs::msg::Twist & robot_speed,
+    models::Path & path, nav2_core::GoalChecker * goal_checker);
+
+  /**
+   * @brief Replace the control sequence by the nominal one, unless it is the previous
+   */
+  void seedNominalSequence();
+
   /**
    * @brief Obtain the main controller's parameters
    */
@@ -145,12 +397,139 @@ protected:
    */
   void setMotionModel(const std::string & model);
 
+  /**
+   * @brief Set the backend generating the sampling noises
+   * @param sampler Sampler string to use
+   */
+  void setNoiseSampler(const std::string & sampler);
+
+  /**
+   * @brief Set the order the latency watchdog degrades a cycle in
+   * @param steps Degradation strings to use
+   */
+  void setWatchdogSteps(const std::vector<std::string> & steps);
+
+  /**
+   * @brief Set the storage precision of the sampling noises
+   * @param precision Precision string to use
+   */
+  void setNoisePrecision(const std::string & precision);
+
+  /**
+   * @brief Log the placement a thread ended up with, warning if not fully applied
+   * @param thread Name of the thread
+   * @param report Placement report of the thread
+   */
+  void logPlacement(const std::string & thread, const models::ThreadPlacementReport & report) const;
+
+  /**
+   * @brief Select the SIMD kernels of the hot routines for this CPU
+   * @param name Kernel set name, or auto for the widest this CPU supports
+   */
+  void setSimdKernels(const std::string & name);
+
   /**
    * @brief Shift the optimal control sequence after processing for
-   * next iterations initial conditions after execution
+   * next iterations initial conditions after execution. Shifts in place,
+   * repeating the last control, so no storage is reallocated. Growing time
+   * steps are instead resampled one controller period later
    */
   void shiftControlSequence();
 
+  /**
+   * @brief Compute the time steps of the horizon and what shifting resamples from
+   */
+  void updateModelDts();
+
+  /**
+   * @brief Compute the coarse time steps of two-stage sampling, none if it is disabled
+   */
+  void resetScreening();
+
+  struct BatchBuffers;
+
+  /**
+   * @brief Size and reserve batch buffers for their settings and holonomy, touching
+   * nothing else, so that they may be built on any thread
+   * @param buffers Buffers to build
+   */
+  void buildBuffers(BatchBuffers & buffers) const;
+
+  /**
+   * @brief Swap the batch buffers with the optimizer's
+   * @param buffers Buffers to swap in, holding the previous ones after
+   */
+  void swapBuffers(BatchBuffers & buffers);
+
+  /**
+   * @brief Take the buffers staged by the last parameter change if they fit the settings
+   * @return Staged buffers, or null if none fit
+   */
+  std::unique_ptr<BatchBuffers> takeStagedBuffers();
+
+  /**
+   * @brief Snapshot the settings deferred parameter changes lead to, the parameters lock
+   * held, for their buffers and noises to be built aside
+   * @param parameters Parameter changes
+   * @return Work building them off the lock, or empty if they reallocate nothing
+   */
+  std::function<void()> stageParameterChanges(const std::vector<rclcpp::Parameter> & parameters);
+
+  /**
+   * @brief Whether settings change the shapes of the buffers or the time discretization
+   * from the applied ones
+   * @param settings Settings to compare
+   * @param holonomic Holonomy of their motion model
+   * @return True if structural
+   */
+  bool isStructuralChange(const models::OptimizerSettings & settings, bool holonomic) const;
+
+  /**
+   * @brief Whether settings change the sampling distribution from the applied ones
+   * @param settings Settings to compare
+   * @return True if the noises are to be regenerated
+   */
+  bool isNoiseChange(const models::OptimizerSettings & settings) const;
+
+  /**
+   * @brief Apply dynamic parameter changes: buffers are only reallocated by structural
+   * changes, such as of batch_size, time_steps or motion_model, and noises are only
+   * regenerated by changes of the sampling distribution
+   */
+  void applyParameterChanges();
+
+  /**
+   * @brief Reallocate for the current settings, keeping the control sequence resampled
+   * to the new time steps, held at its last value past its previous horizon
+   */
+  void resize();
+
+  /**
+   * @brief Two-stage sampling: sample the screening batch, roll it out at the coarse
+   * time step and score it with the screening critics, then keep the lowest cost
+   * batch_size samples as the controls of the state to refine
+   */
+  void screenSamples();
+
+  /**
+   * @brief Keep the lowest cost sampled control sequences of the last iteration
+   * to seed the next one
+   */
+  void saveWarmStartSamples();
+
+  /**
+   * @brief Replace the last sampled control sequences of the batch with
+   * the kept warm start samples
+   */
+  void applyWarmStartSamples();
+
+  /**
+   * @brief On fallback recovery retries, widen the sampled deviations from the control
+   * sequence by fallback_std_scale per attempt, and replace the first samples of the
+   * batch by stop, reverse and rotate in place primitives
+   */
+  void applyRecoverySamples();
+
   /**
    * @brief updates generated trajectories with noised trajectories
    * from the last cycle's optimal control
@@ -168,12 +547,28 @@ protected:
    */
   void updateStateVelocities(models::State & state) const;
 
+  /**
+   * @brief  Update velocities in state for a range of trajectories
+   * @param state fill state with velocities on each step
+   * @param begin First trajectory of the range
+   * @param end Past-the-end trajectory of the range
+   */
+  void updateStateVelocities(models::State & state, size_t begin, size_t end) const;
+
   /**
    * @brief  Update initial velocity in state
    * @param state fill state
    */
   void updateInitialStateVelocities(models::State & state) const;
 
+  /**
+   * @brief  Update initial velocity in state for a range of trajectories
+   * @param state fill state
+   * @param begin First trajectory of the range
+   * @param end Past-the-end trajectory of the range
+   */
+  void updateInitialStateVelocities(models::State & state, size_t begin, size_t end) const;
+
   /**
    * @brief predict velocities in state using model
    * for time horizon equal to timesteps
@@ -181,6 +576,15 @@ protected:
    */
   void propagateStateVelocitiesFromInitials(models::State & state) const;
 
+  /**
+   * @brief predict velocities in state using model for a range of trajectories
+   * @param state fill state
+   * @param begin First trajectory of the range
+   * @param end Past-the-end trajectory of the range
+   */
+  void propagateStateVelocitiesFromInitials(
+    models::State & state, size_t begin, size_t end) const;
+
   /**
    * @brief Rollout velocities in state to poses
    * @param trajectories to rollout
@@ -190,6 +594,17 @@ protected:
     models::Trajectories & trajectories,
     const models::State & state) const;
 
+  /**
+   * @brief Rollout velocities in state to poses for a range of trajectories
+   * @param trajectories to rollout, already sized to the state
+   * @param state fill state
+   * @param begin First trajectory of the range
+   * @param end Past-the-end trajectory of the range
+   */
+  void integrateStateVelocities(
+    models::Trajectories & trajectories,
+    const models::State & state, size_t begin, size_t end) const;
+
   /**
    * @brief Rollout velocities in state to poses
    * @param trajectories to rollout
@@ -205,6 +620,13 @@ protected:
    */
   void updateControlSequence();
 
+  /**
+   * @brief Update control sequence, specialized on whether the motion model is
+   * holonomic so that lateral controls cost nothing otherwise
+   */
+  template<bool Holonomic>
+  void updateControlSequence();
+
   /**
    * @brief Convert control sequence to a twist commant
    * @param stamp Timestamp to use
@@ -225,6 +647,55 @@ protected:
    */
   void setOffset(double controller_frequency);
 
+  /**
+   * @brief Settings for the noise generator, which samples for the largest batch
+   * in adaptive batch size mode so that resizing the batch never resamples noises
+   * @return Noise generator settings
+   */
+  models::OptimizerSettings getNoiseSettings() const;
+
+  /**
+   * @brief Settings for the noise generator of the given optimizer settings
+   * @param settings Optimizer settings
+   * @return Noise generator settings
+   */
+  static models::OptimizerSettings getNoiseSettings(const models::OptimizerSettings & settings);
+
+  /**
+   * @brief Largest batch size the rollout buffers are reserved for, the maximum one
+   * in adaptive batch size mode
+   * @return Batch size
+   */
+  unsigned int getMaxBatchSize() const;
+
+  /**
+   * @brief Largest batch size the rollout buffers of the given settings are reserved for
+   * @param settings Optimizer settings
+   * @return Batch size
+   */
+  static unsigned int getMaxBatchSize(const models::OptimizerSettings & settings);
+
+  /**
+   * @brief Resize the batch dimension of the rollout buffers, within the storage
+   * reserved on reset so that nothing is reallocated
+   * @param batch_size New batch size
+   */
+  void setBatchSize(unsigned int batch_size);
+
+  /**
+   * @brief In adaptive batch size mode, grow or shrink the batch by steps so that
+   * a cycle fits within the controller period. The new size is only applied on the
+   * next cycle, as the trajectories of this one are still to be visualized
+   * @param cycle_time Duration of the last evalControl, in seconds
+   */
+  void adaptBatchSize(double cycle_time);
+
+  /**
+   * @brief Apply the batch size chosen by adaptBatchSize, if any, before a new cycle
+   * or its pre-roll samples the batch
+   */
+  void applyPendingBatchSize();
+
   /**
    * @brief Perform fallback behavior to try to recover from a set of trajectories in collision
    * @param fail Whether the system failed to recover from
@@ -233,28 +704,168 @@ protected:
 
 protected:
   rclcpp_lifecycle::LifecycleNode::WeakPtr parent_;
+  // Null for headless optimizers, the costmap source reading either
   std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros_;
+  std::shared_ptr<CostmapSource> costmap_source_;
   nav2_costmap_2d::Costmap2D * costmap_;
+  CostmapSnapshot costmap_snapshot_;
   std::string name_;
 
   std::shared_ptr<MotionModel> motion_model_;
+  bool is_holonomic_{false};
 
   ParametersHandler * parameters_handler_;
   CriticManager critic_manager_;
   NoiseGenerator noise_generator_;
+  ThreadPool thread_pool_;
+  Workspace workspace_;
+  PathIndex path_index_;
+  const kernels::KernelSet * kernels_{nullptr};
+  CycleContext cycle_context_;
+  CycleContext screening_cycle_context_;
+
+  /**
+   * @struct mppi::Optimizer::LatencyStages
+   * @brief Profiler entry ids of the evalControl stages
+   */
+  struct LatencyStages
+  {
+    size_t eval_control{0}, prepare{0}, noise{0}, rollout{0}, critics{0}, update{0}, smoothing{0},
+      screening{0}, preroll{0};
+  };
+
+  /**
+   * @struct mppi::Optimizer::SoftmaxPartial
+   * @brief Streaming softmax state of a batch chunk: its min cost, the normalizer and
+   * weighted cost of its trajectories relative to it, and its weight in the batch
+   */
+  struct SoftmaxPartial
+  {
+    float min_cost;
+    float normalizer;
+    float weighted_cost;
+    float scale;
+  };
+
+  /**
+   * @struct mppi::Optimizer::Watchdog
+   * @brief Latency watchdog state of the current cycle
+   */
+  struct Watchdog
+  {
+    std::chrono::steady_clock::time_point start, last_check;
+    // Duration of the last iteration, which the next one is expected to take
+    std::chrono::steady_clock::duration iteration_time{0};
+    bool skip_visualization{false};
+    bool drop_iterations{false};
+    bool reused_sequence{false};
+    models::ControlSequence previous_sequence;
+  };
+
+  /**
+   * @struct mppi::Optimizer::WarmStart
+   * @brief Lowest cost sampled control sequences of the last iteration
+   */
+  struct WarmStart
+  {
+    xt::xtensor<float, 2> vx, vy, wz;
+    size_t count{0};
+    std::vector<size_t> ids;
+  };
+
+  LatencyProfiler latency_profiler_;
+  TraceRecorder * trace_recorder_{nullptr};
+  LatencyStages latency_stages_;
 
   models::OptimizerSettings settings_;
+  // Settings the buffers and noises were last sized and generated for
+  models::OptimizerSettings applied_settings_;
+  bool applied_holonomic_{false};
+  double controller_period_{0};
+  unsigned int headroom_cycles_{0};
+  // Batch size to apply on the next cycle, or 0 if unchanged
+  unsigned int pending_batch_size_{0};
+  size_t fallback_attempts_{0};
+  Watchdog watchdog_;
+  WatchdogStats watchdog_stats_;
+
+  // Pipelined rollouts: the background thread and whether the trajectories it rolled out
+  // are still valid for the next cycle
+  std::thread preroll_thread_;
+  std::mutex preroll_lock_;
+  std::condition_variable preroll_cond_;
+  bool preroll_requested_{false};
+  bool preroll_stop_{false};
+  // Only accessed by the pre-roll thread once started
+  bool preroll_placed_{false};
+  bool preroll_ready_{false};
 
   models::State state_;
   models::ControlSequence control_sequence_;
-  std::array<mppi::models::Control, 2> control_history_;
+  models::ControlSequence best_control_sequence_;
+  models::ControlSequence sampling_variances_;
+  // Importance sampling gains of the adapted per time step deviations
+  models::ControlSequence sampling_gains_;
+  float weighted_cost_{0};
+  WarmStart warm_start_;
+  // Enough history for the largest smoothing window
+  std::array<mppi::models::Control, 4> control_history_;
   models::Trajectories generated_trajectories_;
   models::Path path_;
-  xt::xtensor<float, 1> costs_;
+  models::BatchTensor<1> costs_;
+  std::vector<size_t> top_ids_;
+  xt::xtensor<float, 1> model_dts_;
+  // Point and interpolation weight towards the next one each point shifts from,
+  // empty for uniform time steps
+  std::vector<size_t> shift_ids_;
+  std::vector<float> shift_weights_;
+  xt::xtensor<float, 3> partial_controls_;
+  std::vector<SoftmaxPartial> softmax_partials_;
 
   CriticData critics_data_ =
   {state_, generated_trajectories_, path_, costs_, settings_.model_dt, false, nullptr, nullptr,
-    std::nullopt, std::nullopt};  /// Caution, keep references
+    std::nullopt, std::nullopt, &thread_pool_, &workspace_,
+    &path_index_};  /// Caution, keep references
+
+  // Two-stage sampling: full resolution controls of the screening batch, its coarse
+  // rollouts and their costs, and the ids of the samples surviving to refinement
+  models::State screening_samples_;
+  models::State screening_state_;
+  models::Trajectories screening_trajectories_;
+  models::BatchTensor<1> screening_costs_;
+  xt::xtensor<float, 1> screening_dts_;
+  float screening_model_dt_{0};
+  std::vector<size_t> screening_ids_;
+
+  CriticData screening_data_ =
+  {screening_state_, screening_trajectories_, path_, screening_costs_, screening_model_dt_,
+    false, nullptr, nullptr, std::nullopt, std::nullopt, &thread_pool_, &workspace_,
+    &path_index_};  /// Caution, keep references
+
+  /**
+   * @struct mppi::Optimizer::BatchBuffers
+   * @brief Batch buffers reallocated by structural changes, shaped for the settings and
+   * holonomy they hold
+   */
+  struct BatchBuffers
+  {
+    models::OptimizerSettings settings;
+    bool holonomic{false};
+    // As many workspace buffers as the critics grew the replaced workspace to
+    size_t workspace_buffers{0};
+    models::State state;
+    models::Trajectories generated_trajectories;
+    models::BatchTensor<1> costs;
+    Workspace workspace;
+    models::State screening_samples;
+    models::State screening_state;
+    models::Trajectories screening_trajectories;
+    models::BatchTensor<1> screening_costs;
+  };
+
+  // Buffers of a deferred structural change, built on the node's executor
+  std::mutex staging_lock_;
+  std::unique_ptr<BatchBuffers> staged_buffers_;
 
   rclcpp::Logger logger_{rclcpp::get_logger("MPPIController")};
 };
@@ -0,0 +1,135 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__COSTMAP_SNAPSHOT_HPP_
+#define MPPIC__TOOLS__COSTMAP_SNAPSHOT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "nav2_costmap_2d/costmap_2d.hpp"
+
+namespace mppi
+{
+
+/**
+ * @class mppi::CostmapSnapshot
+ * @brief Copy of the costmap taken once per cycle under its lock, so that all critics
+ * read the same map. The copy is diffed against the previous one in tiles: only changed
+ * rows of tiles are copied, and a version counter plus per tile versions let derived
+ * structures skip or limit their rebuild to what changed. A change of geometry or of
+ * unknown space tracking marks the whole map as changed
+ */
+class CostmapSnapshot
+{
+public:
+  static constexpr unsigned int tile_size = 32;
+
+  /**
+    * @brief Constructor for mppi::CostmapSnapshot
+    */
+  CostmapSnapshot() = default;
+
+  /**
+    * @brief Bring the snapshot up to date with the costmap
+    * @param costmap Live costmap, locked while copied
+    * @param track_unknown Whether unknown space is traversable
+    * @return True if anything changed since the last update
+    */
+  bool update(nav2_costmap_2d::Costmap2D & costmap, bool track_unknown);
+
+  /**
+    * @brief Snapshot of the costmap, valid until the next update
+    * @return Costmap copy
+    */
+  nav2_costmap_2d::Costmap2D * getCostmap() {return &map_;}
+  const nav2_costmap_2d::Costmap2D & costmap() const {return map_;}
+
+  /**
+    * @brief Whether unknown space was traversable at the last update
+    * @return Unknown space tracking
+    */
+  bool isTrackingUnknown() const {return track_unknown_;}
+
+  /**
+    * @brief Version of the snapshot, bumped by every update that changed something.
+    * 0 before the first update
+    * @return Version
+    */
+  uint64_t version() const {return version_;}
+
+  /**
+    * @brief Whether the last update changed anything
+    * @return True if changed
+    */
+  bool changed() const {return changed_;}
+
+  /**
+    * @brief Whether the tile of a cell changed after the given version, so that a
+    * value derived from it at that version is stale
+    * @param mx Cell X index
+    * @param my Cell Y index
+    * @param version Version the derived value was computed at
+    * @return True if changed since
+    */
+  bool changedSince(unsigned int mx, unsigned int my, uint64_t version) const
+  {
+    return tile_versions_[(my / tile_size) * tiles_x_ + mx / tile_size] > version;
+  }
+
+  /**
+    * @brief Cell bounds of the tiles changed by the last update
+    * @param min_x Lowest changed cell X index
+    * @param min_y Lowest changed cell Y index
+    * @param max_x Past-the-end changed cell X index
+    * @param max_y Past-the-end changed cell Y index
+    * @return False if the last update changed nothing
+    */
+  bool getDirtyBounds(
+    unsigned int & min_x, unsigned int & min_y, unsigned int & max_x, unsigned int & max_y) const;
+
+  /**
+    * @brief Number of tiles changed by the last update
+    * @return Changed tile count
+    */
+  size_t dirtyTiles() const {return dirty_tiles_;}
+
+  /**
+    * @brief Bytes held by the copied costmap and the tile versions
+    * @return Bytes
+    */
+  size_t getMemoryUsage() const;
+
+protected:
+  /**
+    * @brief Mark a tile as changed by the current update
+    */
+  void markDirty(unsigned int tx, unsigned int ty, uint64_t version);
+
+  nav2_costmap_2d::Costmap2D map_;
+  bool track_unknown_{false};
+
+  uint64_t version_{0};
+  bool changed_{false};
+
+  unsigned int tiles_x_{0}, tiles_y_{0};
+  std::vector<uint64_t> tile_versions_;
+  size_t dirty_tiles_{0};
+  unsigned int dirty_min_x_{0}, dirty_min_y_{0}, dirty_max_x_{0}, dirty_max_y_{0};
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__COSTMAP_SNAPSHOT_HPP_
@@ -0,0 +1,139 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__COSTMAP_SOURCE_HPP_
+#define MPPIC__TOOLS__COSTMAP_SOURCE_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "geometry_msgs/msg/point.hpp"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/costmap_2d_ros.hpp"
+
+namespace mppi
+{
+
+/**
+ * @struct mppi::HeadlessCostmap
+ * @brief Costmap given directly rather than through a Costmap2DROS, so the optimizer
+ * runs without a ROS context. The costmap is owned by the caller, which may update it
+ * between cycles, or during them under its mutex with costmap snapshots enabled
+ */
+struct HeadlessCostmap
+{
+  nav2_costmap_2d::Costmap2D * costmap{nullptr};
+  std::vector<geometry_msgs::msg::Point> footprint;
+  bool track_unknown{false};
+  std::string base_frame_id{"base_link"};
+
+  // Inflation the costmap obstacles were inflated with, a non-positive scaling factor
+  // if not inflated, as nav2's InflationLayer does
+  double inflation_scaling_factor{0.0};
+  double inflation_radius{0.0};
+};
+
+/**
+ * @class mppi::CostmapSource
+ * @brief Costmap, footprint and inflation of the environment, read either from a
+ * Costmap2DROS or from a headless costmap
+ */
+class CostmapSource
+{
+public:
+  /**
+    * @brief Constructor reading a Costmap2DROS
+    * @param costmap_ros Costmap2DROS of the environment
+    */
+  explicit CostmapSource(std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros);
+
+  /**
+    * @brief Constructor reading a headless costmap, throws if it has no costmap
+    * @param costmap Headless costmap settings
+    */
+  explicit CostmapSource(const HeadlessCostmap & costmap);
+
+  /**
+    * @brief Costmap of the environment
+    * @return Costmap
+    */
+  nav2_costmap_2d::Costmap2D * getCostmap() const {return costmap_;}
+
+  /**
+    * @brief Costmap2DROS the source reads, null if headless
+    * @return Costmap2DROS
+    */
+  const std::shared_ptr<nav2_costmap_2d::Costmap2DROS> & getCostmapROS() const
+  {
+    return costmap_ros_;
+  }
+
+  /**
+    * @brief Footprint of the robot
+    * @return Footprint polygon, in the robot frame
+    */
+  std::vector<geometry_msgs::msg::Point> getRobotFootprint() const;
+
+  /**
+    * @brief Radius of the largest circle inside the footprint
+    * @return Inscribed radius
+    */
+  double getInscribedRadius() const;
+
+  /**
+    * @brief Radius of the smallest circle containing the footprint
+    * @return Circumscribed radius
+    */
+  double getCircumscribedRadius() const;
+
+  /**
+    * @brief Whether unknown space is traversable
+    * @return Unknown space tracking
+    */
+  bool isTrackingUnknown() const;
+
+  /**
+    * @brief Frame of the commands
+    * @return Robot base frame
+    */
+  std::string getBaseFrameID() const;
+
+  /**
+    * @brief Inflation of the costmap obstacles: from its InflationLayer if a Costmap2DROS,
+    * otherwise as given
+    * @param scaling_factor Cost scaling factor of the inflation
+    * @param radius Inflation radius
+    * @return False if the costmap is not inflated
+    */
+  bool getInflation(double & scaling_factor, double & radius) const;
+
+  /**
+    * @brief Cost the costmap inflation gives to a distance from the nearest obstacle
+    * @param distance Distance in cells
+    * @return Cost, -1 if the costmap is not inflated
+    */
+  double computeInflatedCost(double distance) const;
+
+protected:
+  std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros_;
+  nav2_costmap_2d::Costmap2D * costmap_{nullptr};
+  HeadlessCostmap headless_;
+  double inscribed_radius_{0.0};
+  double circumscribed_radius_{0.0};
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__COSTMAP_SOURCE_HPP_
@@ -0,0 +1,112 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__CYCLE_CONTEXT_HPP_
+#define MPPIC__TOOLS__CYCLE_CONTEXT_HPP_
+
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace mppi
+{
+
+/**
+ * @class mppi::CycleContext
+ * @brief Memoized results that only depend on the robot state, the path and the goal,
+ * so they hold for all iterations of an evalControl cycle. Critics may run concurrently,
+ * so lookups are guarded. Cleared when the optimizer prepares a new cycle
+ */
+class CycleContext
+{
+public:
+  /**
+    * @brief Constructor for mppi::CycleContext
+    */
+  CycleContext() = default;
+
+  /**
+    * @brief Forget all memoized results, keeping the storage
+    */
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    goal_checker_tolerance_.reset();
+    tolerances_.clear();
+    path_initial_point_.reset();
+  }
+
+  /**
+    * @brief Whether the robot is within a position tolerance to the goal
+    * @param tolerance Tolerance the result is memoized for
+    * @param compute Computes the result if not memoized yet
+    * @return Memoized result
+    */
+  template<typename Compute>
+  bool withinTolerance(float tolerance, Compute && compute)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto & [memoized_tolerance, within] : tolerances_) {
+      if (memoized_tolerance == tolerance) {
+        return within;
+      }
+    }
+    const bool within = compute();
+    tolerances_.emplace_back(tolerance, within);
+    return within;
+  }
+
+  /**
+    * @brief Whether the robot is within the goal checker's position tolerance to the goal
+    * @param compute Computes the result if not memoized yet
+    * @return Memoized result
+    */
+  template<typename Compute>
+  bool withinGoalCheckerTolerance(Compute && compute)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!goal_checker_tolerance_) {
+      goal_checker_tolerance_ = compute();
+    }
+    return *goal_checker_tolerance_;
+  }
+
+  /**
+    * @brief Path point nearest to the first point of the trajectories
+    * @param compute Computes the point if not memoized yet
+    * @return Memoized path point index
+    */
+  template<typename Compute>
+  size_t pathInitialPoint(Compute && compute)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!path_initial_point_) {
+      path_initial_point_ = compute();
+    }
+    return *path_initial_point_;
+  }
+
+protected:
+  std::mutex mutex_;
+  std::optional<bool> goal_checker_tolerance_;
+  // Few distinct tolerances are used by the critics, so a linear scan is enough
+  std::vector<std::pair<float, bool>> tolerances_;
+  std::optional<size_t> path_initial_point_;
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__CYCLE_CONTEXT_HPP_
@@ -0,0 +1,167 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__CYCLE_LOG_HPP_
+#define MPPIC__TOOLS__CYCLE_LOG_HPP_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "geometry_msgs/msg/point.hpp"
+#include "geometry_msgs/msg/pose.hpp"
+#include "geometry_msgs/msg/pose_stamped.hpp"
+#include "geometry_msgs/msg/twist.hpp"
+#include "nav2_core/goal_checker.hpp"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+
+#include "mppic/models/path.hpp"
+
+namespace mppi
+{
+
+/**
+ * @struct mppi::RecordedCycle
+ * @brief Inputs and output of a controller cycle, as stored in a cycle log
+ */
+struct RecordedCycle
+{
+  geometry_msgs::msg::PoseStamped robot_pose;
+  geometry_msgs::msg::Twist robot_speed;
+  models::Path plan;
+
+  // Tolerances of the goal checker, if the cycle had one
+  bool has_goal_checker{false};
+  geometry_msgs::msg::Pose pose_tolerance;
+  geometry_msgs::msg::Twist vel_tolerance;
+
+  std::vector<geometry_msgs::msg::Point> footprint;
+
+  // Whole costmap if its geometry changed or on the first cycle, else the changed cells
+  bool full_costmap{false};
+  unsigned int size_x{0}, size_y{0};
+  double resolution{0}, origin_x{0}, origin_y{0};
+  std::vector<unsigned char> costs;
+  std::vector<std::pair<uint32_t, unsigned char>> changed_cells;
+
+  bool failed{false};
+  geometry_msgs::msg::Twist cmd;
+  int64_t latency_ns{0};
+};
+
+/**
+ * @class mppi::CycleRecorder
+ * @brief Appends the inputs and output of every controller cycle to a compact binary
+ * log, for latency and output regressions to be replayed offline. The costmap is stored
+ * whole once, then as the cells changed since the previously recorded cycle
+ */
+class CycleRecorder
+{
+public:
+  /**
+    * @brief Constructor for mppi::CycleRecorder
+    */
+  CycleRecorder() = default;
+
+  /**
+    * @brief Start a new log, throws if the file cannot be written
+    * @param file_path Log file to create
+    * @param noise_seed Seed of the optimizer's noise sampler
+    */
+  void open(const std::string & file_path, int64_t noise_seed);
+
+  /**
+    * @brief Close the log, if open
+    */
+  void close();
+
+  /**
+    * @brief Whether a log is open
+    * @return True if recording
+    */
+  bool isOpen() const {return file_.is_open();}
+
+  /**
+    * @brief Capture the inputs of a cycle, before the optimizer takes the plan
+    * @param robot_pose Robot pose
+    * @param robot_speed Robot speed
+    * @param plan Transformed plan
+    * @param goal_checker Goal checker of the cycle, or null
+    * @param costmap Costmap of the cycle, locked while diffed
+    * @param footprint Robot footprint
+    */
+  void capture(
+    const geometry_msgs::msg::PoseStamped & robot_pose,
+    const geometry_msgs::msg::Twist & robot_speed, const models::Path & plan,
+    nav2_core::GoalChecker * goal_checker, nav2_costmap_2d::Costmap2D & costmap,
+    const std::vector<geometry_msgs::msg::Point> & footprint);
+
+  /**
+    * @brief Write the captured cycle with its output
+    * @param cmd Command computed, ignored if failed
+    * @param failed Whether the optimizer failed to find a command
+    * @param latency_ns Wall time of the cycle
+    */
+  void write(const geometry_msgs::msg::Twist & cmd, bool failed, int64_t latency_ns);
+
+protected:
+  std::ofstream file_;
+  RecordedCycle cycle_;
+  // Costmap as last recorded, to diff the next cycle's against
+  std::vector<unsigned char> recorded_costs_;
+};
+
+/**
+ * @class mppi::CycleLogReader
+ * @brief Reads back the cycles of a log written by mppi::CycleRecorder
+ */
+class CycleLogReader
+{
+public:
+  /**
+    * @brief Open a log, throws if it cannot be read or is not a cycle log
+    * @param file_path Log file to read
+    */
+  explicit CycleLogReader(const std::string & file_path);
+
+  /**
+    * @brief Seed of the noise sampler of the recorded run
+    * @return Seed
+    */
+  int64_t getNoiseSeed() const {return noise_seed_;}
+
+  /**
+    * @brief Read the next cycle, throws if the log is truncated
+    * @param cycle Cycle to fill
+    * @return False once all cycles were read
+    */
+  bool next(RecordedCycle & cycle);
+
+  /**
+    * @brief Bring a costmap to the state recorded with a cycle
+    * @param cycle Cycle read
+    * @param costmap Costmap holding the state of the previous cycle read
+    */
+  static void applyCostmap(const RecordedCycle & cycle, nav2_costmap_2d::Costmap2D & costmap);
+
+protected:
+  std::ifstream file_;
+  int64_t noise_seed_{-1};
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__CYCLE_LOG_HPP_
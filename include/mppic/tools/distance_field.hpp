@@ -0,0 +1,175 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__DISTANCE_FIELD_HPP_
+#define MPPIC__TOOLS__DISTANCE_FIELD_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "mppic/tools/costmap_snapshot.hpp"
+
+namespace mppi
+{
+
+/**
+ * @class mppi::DistanceField
+ * @brief Euclidean distance field to the nearest obstacle cell of a costmap, so that
+ * clearance queries are a single lookup. Obstacles are lethal cells and, if unknown
+ * space is not tracked, unknown cells. Rebuilt only when the costmap contents change
+ */
+class DistanceField
+{
+public:
+  /**
+    * @brief Constructor for mppi::DistanceField
+    */
+  DistanceField() = default;
+
+  /**
+    * @brief Rebuild the distance field if the costmap changed since the last update
+    * @param costmap Costmap to build from
+    * @param track_unknown Whether unknown space is traversable
+    * @return True if the field was rebuilt
+    */
+  bool update(const nav2_costmap_2d::Costmap2D & costmap, bool track_unknown);
+
+  /**
+    * @brief Rebuild the distance field if the snapshot changed since the last update.
+    * The snapshot version replaces fingerprinting the map, so an unchanged map costs nothing
+    * @param snapshot Costmap snapshot to build from
+    * @return True if the field was rebuilt
+    */
+  bool update(const CostmapSnapshot & snapshot);
+
+  /**
+    * @brief Distance from a cell center to the nearest obstacle cell center
+    * @param mx Cell X index
+    * @param my Cell Y index
+    * @return Distance in meters, 0 in obstacle cells
+    */
+  float distanceAtCell(unsigned int mx, unsigned int my) const
+  {
+    return distances_[my * size_x_ + mx];
+  }
+
+  /**
+    * @brief Distance from a world point to the nearest obstacle cell center.
+    * Outside of the map, space is considered unknown
+    * @param wx X in world frame
+    * @param wy Y in world frame
+    * @return Distance in meters
+    */
+  float distance(float wx, float wy) const
+  {
+    const float fx = (wx - origin_x_) * inv_resolution_;
+    const float fy = (wy - origin_y_) * inv_resolution_;
+    if (fx < 0.0f || fy < 0.0f || fx >= size_x_ || fy >= size_y_) {
+      return outside_distance_;
+    }
+    return distanceAtCell(static_cast<unsigned int>(fx), static_cast<unsigned int>(fy));
+  }
+
+  /**
+    * @brief Radius around a world point within which every point is at least a distance
+    * from the nearest obstacle, accounting for the cell quantization of the field and,
+    * if unknown space is an obstacle, for the space outside of the map
+    * @param wx X in world frame
+    * @param wy Y in world frame
+    * @param min_distance Distance in meters all points of the radius are at least from
+    * the nearest obstacle
+    * @return Radius in meters, non-positive if none
+    */
+  float clearRadius(float wx, float wy, float min_distance) const
+  {
+    const float fx = (wx - origin_x_) * inv_resolution_;
+    const float fy = (wy - origin_y_) * inv_resolution_;
+    if (fx < 0.0f || fy < 0.0f || fx >= size_x_ || fy >= size_y_) {
+      return 0.0f;
+    }
+    // Points are within half a cell diagonal of the center their distance is taken at
+    float radius = distanceAtCell(static_cast<unsigned int>(fx), static_cast<unsigned int>(fy)) -
+      min_distance - static_cast<float>(M_SQRT2) * resolution_;
+    if (outside_distance_ < min_distance) {
+      const float edge = std::min({fx, fy, size_x_ - fx, size_y_ - fy}) * resolution_;
+      radius = std::min(radius, edge);
+    }
+    return radius;
+  }
+
+  /**
+    * @brief Number of times the field was rebuilt
+    * @return Rebuild count
+    */
+  size_t getUpdateCount() const {return update_count_;}
+
+  /**
+    * @brief Map resolution of the field
+    * @return Resolution in meters per cell
+    */
+  float getResolution() const {return resolution_;}
+
+  /**
+    * @brief Size of the field in cells
+    * @return Cell counts along X and Y
+    */
+  unsigned int getSizeInCellsX() const {return size_x_;}
+  unsigned int getSizeInCellsY() const {return size_y_;}
+
+  /**
+    * @brief Distance of the points outside of the map
+    * @return Distance in meters, 0 if unknown space is an obstacle
+    */
+  float getOutsideDistance() const {return outside_distance_;}
+
+protected:
+  /**
+    * @brief One dimensional squared distance transform (Felzenszwalb & Huttenlocher)
+    * of the `size` samples of f at the given stride, written back in place
+    */
+  void transform1D(float * f, size_t size, size_t stride);
+
+  /**
+    * @brief Rebuild the field from the costmap contents
+    */
+  void build(const nav2_costmap_2d::Costmap2D & costmap, bool track_unknown);
+
+  /**
+    * @brief Cheap fingerprint of the costmap contents and geometry
+    */
+  static uint64_t fingerprint(const nav2_costmap_2d::Costmap2D & costmap, bool track_unknown);
+
+  std::vector<float> distances_;
+  std::vector<float> line_, envelope_;
+  std::vector<int> vertices_;
+
+  unsigned int size_x_{0}, size_y_{0};
+  float origin_x_{0}, origin_y_{0};
+  float resolution_{0}, inv_resolution_{0};
+  float outside_distance_{0};
+
+  uint64_t fingerprint_{0};
+  // Version of the snapshot built from, 0 if built from a costmap
+  uint64_t snapshot_version_{0};
+  size_t update_count_{0};
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__DISTANCE_FIELD_HPP_
@@ -0,0 +1,312 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__FAST_MATH_HPP_
+#define MPPIC__TOOLS__FAST_MATH_HPP_
+
+#include <cmath>
+#include <cstddef>
+
+#include <xsimd/xsimd.hpp>
+
+/**
+ * Float-only trigonometry and angle wrapping, written once for scalars and for
+ * xsimd::batch<float> of any architecture so the same kernels serve tails, vector
+ * lanes and the runtime dispatched kernel sets. Nothing is promoted to double and
+ * no lane branches: range reduction is Cody-Waite with a three-part constant,
+ * results are picked with selects.
+ *
+ * Accuracy against the double precision std versions, as checked by the tests:
+ *  - wrapAngle: absolute error below 1e-6 rad for |angle| <= 1e3, result in [-pi, pi]
+ *  - sin, cos, sincos: absolute error below 1e-6 for |angle| <= 1e3
+ *  - atan2: absolute error below 1e-6 rad for any finite input, atan2(0, 0) = 0
+ * Reduction stays exact up to |angle| of about 6e4, past which errors grow with the angle
+ *
+ * The kernel translation units built with wider instruction set flags, which define
+ * MPPIC_KERNELS_TARGET, only get the templates: the non-template scalar and array
+ * functions would be inline functions shared with baseline code
+ */
+namespace mppi::fast_math
+{
+
+namespace detail
+{
+
+#ifndef MPPIC_KERNELS_TARGET
+using simd_t = xsimd::batch<float>;
+#endif
+
+constexpr float pi = 3.14159265358979323846f;
+constexpr float half_pi = 1.57079632679489661923f;
+constexpr float quarter_pi = 0.78539816339744830962f;
+constexpr float inv_two_pi = 0.15915494309189533577f;
+constexpr float two_over_pi = 0.63661977236758134308f;
+constexpr float tan_eighth_pi = 0.41421356237309504880f;
+
+// 2 pi and pi / 2 split so that multiples of the leading parts are exact
+constexpr float two_pi_1 = 6.28125f;
+constexpr float two_pi_2 = 1.93500518798828125e-3f;
+constexpr float two_pi_3 = 3.019915981956752864e-7f;
+constexpr float half_pi_1 = 1.5703125f;
+constexpr float half_pi_2 = 4.837512969970703125e-4f;
+constexpr float half_pi_3 = 7.54978995489188216e-8f;
+
+#ifndef MPPIC_KERNELS_TARGET
+inline float select(bool condition, float if_true, float if_false)
+{
+  return condition ? if_true : if_false;
+}
+
+inline float nearbyint(float value) {return std::nearbyint(value);}
+inline float floor(float value) {return std::floor(value);}
+inline float abs(float value) {return std::fabs(value);}
+inline float min(float lhs, float rhs) {return std::fmin(lhs, rhs);}
+inline float max(float lhs, float rhs) {return std::fmax(lhs, rhs);}
+#endif
+
+template<typename Arch, typename Mask>
+inline xsimd::batch<float, Arch> select(
+  const Mask & condition, const xsimd::batch<float, Arch> & if_true,
+  const xsimd::batch<float, Arch> & if_false)
+{
+  return xsimd::select(condition, if_true, if_false);
+}
+
+template<typename Arch>
+inline xsimd::batch<float, Arch> nearbyint(const xsimd::batch<float, Arch> & value)
+{
+  return xsimd::nearbyint(value);
+}
+
+template<typename Arch>
+inline xsimd::batch<float, Arch> floor(const xsimd::batch<float, Arch> & value)
+{
+  return xsimd::floor(value);
+}
+
+template<typename Arch>
+inline xsimd::batch<float, Arch> abs(const xsimd::batch<float, Arch> & value)
+{
+  return xsimd::abs(value);
+}
+
+template<typename Arch>
+inline xsimd::batch<float, Arch> min(
+  const xsimd::batch<float, Arch> & lhs, const xsimd::batch<float, Arch> & rhs)
+{
+  return xsimd::min(lhs, rhs);
+}
+
+template<typename Arch>
+inline xsimd::batch<float, Arch> max(
+  const xsimd::batch<float, Arch> & lhs, const xsimd::batch<float, Arch> & rhs)
+{
+  return xsimd::max(lhs, rhs);
+}
+
+/**
+ * @brief Sine and cosine on [-pi / 4, pi / 4], minimax polynomials of Cephes sinf / cosf
+ */
+template<typename T>
+inline void sincosKernel(const T & r, T & sin, T & cos)
+{
+  const T z = r * r;
+  sin = ((T(-1.9515295891e-4f) * z + T(8.3321608736e-3f)) * z - T(1.6666654611e-1f)) * z * r + r;
+  cos = ((T(2.443315711809948e-5f) * z - T(1.388731625493765e-3f)) * z +
+    T(4.166664568298827e-2f)) * z * z - T(0.5f) * z + T(1.0f);
+}
+
+/**
+ * @brief Arc tangent on [0, 1], minimax polynomial of Cephes atanf
+ */
+template<typename T>
+inline T atanKernel(const T & a)
+{
+  // atan(a) = pi / 4 + atan((a - 1) / (a + 1)) keeps the polynomial within tan(pi / 8)
+  const auto big = a > T(tan_eighth_pi);
+  const T reduced = detail::select(big, (a - T(1.0f)) / (a + T(1.0f)), a);
+  const T offset = detail::select(big, T(quarter_pi), T(0.0f));
+  const T z = reduced * reduced;
+  return offset + ((((T(8.05374449538e-2f) * z - T(1.38776856032e-1f)) * z +
+         T(1.99777106478e-1f)) * z - T(3.33329491539e-1f)) * z * reduced + reduced);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Wrap an angle to [-pi, pi]
+ * @param angle Angle in radians
+ * @return Wrapped angle
+ */
+template<typename T>
+inline T wrapAngle(const T & angle)
+{
+  const T k = detail::nearbyint(angle * T(detail::inv_two_pi));
+  return ((angle - k * T(detail::two_pi_1)) - k * T(detail::two_pi_2)) - k * T(detail::two_pi_3);
+}
+
+/**
+ * @brief Shortest angular distance from one angle to another, in [-pi, pi]
+ * @param from Start angle
+ * @param to End angle
+ * @return Shortest distance between angles
+ */
+template<typename T>
+inline T shortestAngularDistance(const T & from, const T & to)
+{
+  return wrapAngle(to - from);
+}
+
+/**
+ * @brief Sine and cosine of an angle, sharing the range reduction
+ * @param angle Angle in radians
+ * @param sin Sine of the angle
+ * @param cos Cosine of the angle
+ */
+template<typename T>
+inline void sincos(const T & angle, T & sin, T & cos)
+{
+  const T q = detail::nearbyint(angle * T(detail::two_over_pi));
+  const T r =
+    ((angle - q * T(detail::half_pi_1)) - q * T(detail::half_pi_2)) - q * T(detail::half_pi_3);
+
+  T s, c;
+  detail::sincosKernel(r, s, c);
+
+  // Quadrant in [0, 4): odd quadrants swap sine and cosine, then signs follow the quadrant
+  const T quadrant = q - T(4.0f) * detail::floor(q * T(0.25f));
+  const auto swap = quadrant == T(1.0f) || quadrant == T(3.0f);
+  sin = detail::select(swap, c, s);
+  cos = detail::select(swap, s, c);
+  sin = detail::select(quadrant >= T(2.0f), -sin, sin);
+  cos = detail::select(quadrant == T(1.0f) || quadrant == T(2.0f), -cos, cos);
+}
+
+/**
+ * @brief Sine of an angle
+ * @param angle Angle in radians
+ * @return Sine
+ */
+template<typename T>
+inline T sin(const T & angle)
+{
+  T s, c;
+  sincos(angle, s, c);
+  return s;
+}
+
+/**
+ * @brief Cosine of an angle
+ * @param angle Angle in radians
+ * @return Cosine
+ */
+template<typename T>
+inline T cos(const T & angle)
+{
+  T s, c;
+  sincos(angle, s, c);
+  return c;
+}
+
+/**
+ * @brief Angle of the vector (x, y), in [-pi, pi]
+ * @param y Y component
+ * @param x X component
+ * @return Angle in radians
+ */
+template<typename T>
+inline T atan2(const T & y, const T & x)
+{
+  const T ax = detail::abs(x);
+  const T ay = detail::abs(y);
+  const T high = detail::max(ax, ay);
+  const T low = detail::min(ax, ay);
+  const T ratio = low / detail::select(high == T(0.0f), T(1.0f), high);
+
+  T angle = detail::atanKernel(ratio);
+  angle = detail::select(ay > ax, T(detail::half_pi) - angle, angle);
+  angle = detail::select(x < T(0.0f), T(detail::pi) - angle, angle);
+  return detail::select(y < T(0.0f), -angle, angle);
+}
+
+#ifndef MPPIC_KERNELS_TARGET
+/**
+ * @brief Wrap angles to [-pi, pi], may be done in place
+ * @param angles Angles in radians
+ * @param wrapped Wrapped angles
+ * @param size Number of angles
+ */
+inline void wrapAngles(const float * angles, float * wrapped, size_t size)
+{
+  constexpr size_t lanes = detail::simd_t::size;
+  size_t i = 0;
+  for (; i + lanes <= size; i += lanes) {
+    wrapAngle(detail::simd_t::load_unaligned(angles + i)).store_unaligned(wrapped + i);
+  }
+  for (; i != size; i++) {
+    wrapped[i] = wrapAngle(angles[i]);
+  }
+}
+
+/**
+ * @brief Sines and cosines of angles
+ * @param angles Angles in radians
+ * @param sin Sines, may alias the angles
+ * @param cos Cosines
+ * @param size Number of angles
+ */
+inline void sincos(const float * angles, float * sin, float * cos, size_t size)
+{
+  constexpr size_t lanes = detail::simd_t::size;
+  size_t i = 0;
+  for (; i + lanes <= size; i += lanes) {
+    detail::simd_t s, c;
+    sincos(detail::simd_t::load_unaligned(angles + i), s, c);
+    s.store_unaligned(sin + i);
+    c.store_unaligned(cos + i);
+  }
+  for (; i != size; i++) {
+    float s, c;
+    sincos(angles[i], s, c);
+    sin[i] = s;
+    cos[i] = c;
+  }
+}
+
+/**
+ * @brief Angles of vectors, may be done in place of either component
+ * @param y Y components
+ * @param x X components
+ * @param angles Angles in radians
+ * @param size Number of vectors
+ */
+inline void atan2(const float * y, const float * x, float * angles, size_t size)
+{
+  constexpr size_t lanes = detail::simd_t::size;
+  size_t i = 0;
+  for (; i + lanes <= size; i += lanes) {
+    atan2(
+      detail::simd_t::load_unaligned(y + i),
+      detail::simd_t::load_unaligned(x + i)).store_unaligned(angles + i);
+  }
+  for (; i != size; i++) {
+    angles[i] = atan2(y[i], x[i]);
+  }
+}
+
+#endif
+
+}  // namespace mppi::fast_math
+
+#endif  // MPPIC__TOOLS__FAST_MATH_HPP_
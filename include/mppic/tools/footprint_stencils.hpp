@@ -0,0 +1,89 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__FOOTPRINT_STENCILS_HPP_
+#define MPPIC__TOOLS__FOOTPRINT_STENCILS_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "geometry_msgs/msg/point.hpp"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+
+namespace mppi
+{
+
+/**
+ * @class mppi::FootprintStencils
+ * @brief Robot footprint outline rasterized into costmap cell offsets at a set of yaw
+ * bins, so that a footprint cost check is a loop over precomputed cell lookups instead
+ * of transforming and rasterizing the footprint at every pose. There are enough bins
+ * for the outline to move by less than a cell between two of them. Rebuilt only when
+ * the footprint or the costmap geometry change
+ */
+class FootprintStencils
+{
+public:
+  /**
+    * @brief Constructor for mppi::FootprintStencils
+    */
+  FootprintStencils() = default;
+
+  /**
+    * @brief Rebuild the stencils if the footprint, or the resolution or size of the
+    * costmap, changed since the last update
+    * @param footprint Footprint polygon, in the robot frame
+    * @param costmap Costmap the stencils will look up
+    * @return True if the stencils were rebuilt
+    */
+  bool update(
+    const std::vector<geometry_msgs::msg::Point> & footprint,
+    const nav2_costmap_2d::Costmap2D & costmap);
+
+  /**
+    * @brief Cost of the footprint outline at a pose, as FootprintCollisionChecker's
+    * footprintCostAtPose gives for the pose at the center of its cell and at the yaw
+    * of its bin: lethal if any outline cell is, otherwise the highest outline cost
+    * @param costmap Costmap to look up, of the geometry of the last update
+    * @param x X of pose
+    * @param y Y of pose
+    * @param theta theta of pose
+    * @param cost Cost of the footprint
+    * @return False if the outline may leave the map, for the pose to be checked exactly
+    */
+  bool footprintCost(
+    const nav2_costmap_2d::Costmap2D & costmap, float x, float y, float theta,
+    float & cost) const;
+
+  /**
+    * @brief Number of yaw bins
+    * @return Bins, 0 before the first update
+    */
+  size_t getBinCount() const {return bin_starts_.empty() ? 0 : bin_starts_.size() - 1;}
+
+protected:
+  std::vector<geometry_msgs::msg::Point> footprint_;
+  double resolution_{0};
+  unsigned int size_x_{0}, size_y_{0};
+
+  // Linear cell offsets of each bin's outline from the center cell, bin after bin
+  std::vector<size_t> bin_starts_;
+  std::vector<int> offsets_;
+  // Largest offset of an outline cell from the center cell along either axis
+  int extent_{0};
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__FOOTPRINT_STENCILS_HPP_
@@ -0,0 +1,102 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__FUSED_SCORER_HPP_
+#define MPPIC__TOOLS__FUSED_SCORER_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "mppic/critic_data.hpp"
+
+namespace mppi
+{
+
+/**
+ * @struct mppi::FusedTerm
+ * @brief Cost term of a built-in trajectory critic for a cycle, as a reduction over
+ * the time steps of each trajectory, with the critic's weight and power
+ */
+struct FusedTerm
+{
+  enum class Type
+  {
+    GoalDistance,
+    GoalAngle,
+    PathAngle,
+    Twirling,
+    PreferForward,
+    Constraint
+  };
+
+  Type type{Type::GoalDistance};
+  float weight{0};
+  unsigned int power{1};
+  // Target point of the goal and path terms, target angle of the goal angle term
+  float x{0}, y{0}, yaw{0};
+  // Velocity bounds of the constraint term, with no turning radius bound if 0
+  float max_vel{0}, min_vel{0}, min_turning_r{0};
+  bool holonomic{false};
+};
+
+/**
+ * @class mppi::FusedScorer
+ * @brief Scores the terms of fusable critics in a single sweep over the batch: each
+ * trajectory's rows are read once while cache resident and reduced for every term,
+ * instead of each critic streaming the whole batch through its own tensor expressions
+ */
+class FusedScorer
+{
+public:
+  /**
+    * @brief Constructor for mppi::FusedScorer
+    */
+  FusedScorer() = default;
+
+  /**
+    * @brief Forget the terms of the previous cycle
+    */
+  void clear() {terms_.clear();}
+
+  /**
+    * @brief Add a term to score
+    * @param term Term of a critic
+    */
+  void add(const FusedTerm & term) {terms_.push_back(term);}
+
+  /**
+    * @brief Number of terms to score
+    * @return Size
+    */
+  size_t size() const {return terms_.size();}
+
+  /**
+    * @brief Add the cost of every term to the costs of the trajectories not found in
+    * collision by an earlier critic
+    * @param data Critic data to score
+    */
+  void score(CriticData & data) const;
+
+protected:
+  /**
+    * @brief Cost of a term for a trajectory
+    */
+  float scoreTrajectory(const FusedTerm & term, const CriticData & data, size_t i) const;
+
+  std::vector<FusedTerm> terms_;
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__FUSED_SCORER_HPP_
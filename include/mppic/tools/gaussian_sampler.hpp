@@ -0,0 +1,97 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__GAUSSIAN_SAMPLER_HPP_
+#define MPPIC__TOOLS__GAUSSIAN_SAMPLER_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <xtensor/xtensor.hpp>
+
+#include "mppic/tools/kernels.hpp"
+
+namespace mppi
+{
+
+/**
+ * @class mppi::GaussianSampler
+ * @brief Fast normal distribution sampler. Runs a fixed number of interleaved xoshiro128+
+ * streams, so generation vectorizes and sequences do not depend on the SIMD width,
+ * and applies a vectorized Box-Muller transform writing directly into the destination
+ */
+class GaussianSampler
+{
+public:
+  /**
+    * @brief Constructor for mppi::GaussianSampler
+    * @param seed Seed of the lane streams
+    */
+  explicit GaussianSampler(uint64_t seed = 0) {this->seed(seed);}
+
+  /**
+    * @brief Reseed all lane streams, for reproducible sequences
+    * @param seed Seed to use
+    */
+  void seed(uint64_t seed);
+
+  /**
+    * @brief Fill a buffer with zero mean normally distributed samples
+    * @param data Buffer to fill
+    * @param size Number of samples
+    * @param std_dev Standard deviation of the samples
+    */
+  void fill(float * data, size_t size, float std_dev);
+
+  /**
+    * @brief Fill a tensor with zero mean normally distributed samples
+    * @param tensor Tensor to fill, already sized
+    * @param std_dev Standard deviation of the samples
+    */
+  void fill(xt::xtensor<float, 2> & tensor, float std_dev)
+  {
+    fill(tensor.data(), tensor.size(), std_dev);
+  }
+
+  /**
+    * @brief Set the SIMD kernels of the Box-Muller transform
+    * @param kernel_set Kernels to run, or nullptr for the baseline ones
+    */
+  void setKernels(const kernels::KernelSet * kernel_set) {kernels_ = kernel_set;}
+
+protected:
+  // As wide as the widest kernels, which all divide it
+  static constexpr size_t lanes_ = 16;
+
+  /**
+    * @brief Advance every lane stream, writing one uniform (0, 1] sample per lane
+    * @param uniforms Output samples
+    */
+  void nextUniforms(std::array<float, lanes_> & uniforms);
+
+  /**
+    * @brief Generate 2 * lanes_ normal samples with the Box-Muller transform
+    * @param out Destination of the samples
+    * @param std_dev Standard deviation of the samples
+    */
+  void nextNormals(float * out, float std_dev);
+
+  std::array<uint32_t, lanes_> s0_, s1_, s2_, s3_;
+  const kernels::KernelSet * kernels_{nullptr};
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__GAUSSIAN_SAMPLER_HPP_
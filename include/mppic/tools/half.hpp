@@ -0,0 +1,100 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__HALF_HPP_
+#define MPPIC__TOOLS__HALF_HPP_
+
+#include <cstdint>
+#include <cstring>
+
+namespace mppi
+{
+
+/**
+ * @brief Convert a float to IEEE 754 half precision bits, rounding to nearest even.
+ * Halves keep 11 significant bits, a relative error of at most 2^-11, and saturate to
+ * infinity beyond 65504. Conversions are bit manipulations (F. Giesen), so storage in
+ * half precision does not depend on hardware support
+ * @param value Float to convert
+ * @return Half precision bits
+ */
+inline uint16_t floatToHalf(float value)
+{
+  constexpr uint32_t infinity = 255u << 23;
+  constexpr uint32_t half_max = (127u + 16u) << 23;
+  constexpr uint32_t denormal_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+
+  uint32_t half;
+  if (bits >= half_max) {
+    // Infinity stays infinity, NaN becomes a quiet NaN
+    half = bits > infinity ? 0x7e00u : 0x7c00u;
+  } else if (bits < (113u << 23)) {
+    // Subnormal or zero half: let the float addition do the rounding
+    float magnitude, magic;
+    std::memcpy(&magnitude, &bits, sizeof(bits));
+    std::memcpy(&magic, &denormal_magic, sizeof(magic));
+    magnitude += magic;
+    std::memcpy(&bits, &magnitude, sizeof(bits));
+    half = bits - denormal_magic;
+  } else {
+    // Rebias the exponent and round the dropped mantissa bits to nearest even
+    const uint32_t mantissa_odd = (bits >> 13) & 1u;
+    bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfffu + mantissa_odd;
+    half = bits >> 13;
+  }
+
+  return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+/**
+ * @brief Convert IEEE 754 half precision bits to a float, exactly
+ * @param half Half precision bits
+ * @return Float value
+ */
+inline float halfToFloat(uint16_t half)
+{
+  constexpr uint32_t shifted_exponent = 0x7c00u << 13;
+  constexpr uint32_t magic = 113u << 23;
+
+  uint32_t bits = (static_cast<uint32_t>(half) & 0x7fffu) << 13;
+  const uint32_t exponent = bits & shifted_exponent;
+  bits += (127u - 15u) << 23;
+
+  if (exponent == shifted_exponent) {
+    // Infinity or NaN
+    bits += (128u - 16u) << 23;
+  } else if (exponent == 0) {
+    // Zero or subnormal, renormalized by a float subtraction
+    bits += 1u << 23;
+    float value, offset;
+    std::memcpy(&value, &bits, sizeof(bits));
+    std::memcpy(&offset, &magic, sizeof(offset));
+    value -= offset;
+    std::memcpy(&bits, &value, sizeof(bits));
+  }
+
+  bits |= (static_cast<uint32_t>(half) & 0x8000u) << 16;
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__HALF_HPP_
@@ -0,0 +1,209 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__KERNELS_HPP_
+#define MPPIC__TOOLS__KERNELS_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Registry of the hot SIMD kernels compiled for several instruction sets, so one
+ * binary picks the widest set the CPU supports at runtime. The baseline set is built
+ * with the flags of the whole library; wider sets are compiled in their own
+ * translation units with their own flags and only called once the CPU is checked.
+ * Kernels take raw views only, and process whole SIMD batches: callers go through
+ * the functions below, which finish the remainder in baseline code
+ */
+namespace mppi::kernels
+{
+
+/**
+ * @struct mppi::kernels::RolloutView
+ * @brief Row-major batch x time inputs and outputs of a rollout, with its initial pose.
+ * vy is only read if holonomic, yaw_cos and yaw_sin are null unless stored
+ */
+struct RolloutView
+{
+  const float * vx;
+  const float * vy;
+  const float * wz;
+  float * x;
+  float * y;
+  float * yaws;
+  float * yaw_cos;
+  float * yaw_sin;
+  size_t time_steps;
+  float x0, y0, yaw0, cos0, sin0;
+  float model_dt;
+  const float * model_dts;  // Time step of each point, or null for a uniform model_dt
+};
+
+/**
+ * @struct mppi::kernels::DynamicsView
+ * @brief Row-major batch x time controls and velocities of a rollout, the velocities
+ * of the first time step set. vy and cvy are only accessed if holonomic
+ */
+struct DynamicsView
+{
+  const float * cvx;
+  const float * cvy;
+  const float * cwz;
+  float * vx;
+  float * vy;
+  float * wz;
+  size_t time_steps;
+  const float * model_dts;  // Duration of each time step
+  float ax_max, ay_max, az_max;  // Velocity change limits per second, infinite if unlimited
+};
+
+/**
+ * @struct mppi::kernels::CostmapView
+ * @brief Char map of a costmap and its geometry
+ */
+struct CostmapView
+{
+  const unsigned char * char_map;
+  unsigned int size_x, size_y;
+  float origin_x, origin_y, resolution;
+  float out_of_bounds_cost;
+};
+
+/**
+ * @struct mppi::kernels::KernelSet
+ * @brief Kernels compiled for an instruction set. Each returns how many leading rows,
+ * points or values it processed, a multiple of its batch size
+ */
+struct KernelSet
+{
+  const char * name;
+  const char * arch;
+
+  size_t (* integrate)(
+    const RolloutView & view, size_t begin, size_t end, bool is_holonomic, bool fast_math);
+  size_t (* gather_costs)(
+    const CostmapView & costmap, const float * x, const float * y, float * costs, size_t size);
+  size_t (* box_muller)(
+    const float * u1, const float * u2, float * cos_out, float * sin_out, size_t size,
+    float std_dev);
+  size_t (* weighted_sum)(
+    float weight, const float * values, float * sum, float * sq_sum, size_t size);
+  size_t (* limit_turning_rate)(const float * vx, float * wz, size_t size, float inv_radius);
+  size_t (* limit_acceleration)(
+    const DynamicsView & view, size_t begin, size_t end, bool is_holonomic);
+};
+
+/**
+ * @brief Kernels built with the flags of the library, which any CPU running it supports
+ * @return Kernel set
+ */
+const KernelSet & baselineKernels();
+
+/**
+ * @brief Names of the kernel sets compiled in and supported by this CPU, widest first
+ * @return Kernel set names
+ */
+std::vector<std::string> availableKernels();
+
+/**
+ * @brief Find a kernel set by name, throws if not compiled in or unsupported by this CPU
+ * @param name Kernel set name, or "auto" for the widest available
+ * @return Kernel set
+ */
+const KernelSet & selectKernels(const std::string & name);
+
+/**
+ * @brief Rollout velocities to poses for a range of trajectories
+ * @param kernel_set Kernel set to use
+ * @param view Rollout inputs and outputs
+ * @param begin First trajectory of the range
+ * @param end Past-the-end trajectory of the range
+ * @param is_holonomic Whether the lateral velocity should be integrated
+ * @param fast_math Whether to wrap yaws and take their sine and cosine with fast_math
+ */
+void integrate(
+  const KernelSet & kernel_set, const RolloutView & view, size_t begin, size_t end,
+  bool is_holonomic, bool fast_math);
+
+/**
+ * @brief Velocities following the controls of the previous time step within acceleration
+ * limits, for a range of trajectories, in a single pass over time for all axes
+ * @param kernel_set Kernel set to use
+ * @param view Rollout controls and velocities
+ * @param begin First trajectory of the range
+ * @param end Past-the-end trajectory of the range
+ * @param is_holonomic Whether the lateral velocity should be limited as well
+ */
+void limitAcceleration(
+  const KernelSet & kernel_set, const DynamicsView & view, size_t begin, size_t end,
+  bool is_holonomic);
+
+/**
+ * @brief Look up the costmap cost of a set of world points
+ * @param kernel_set Kernel set to use
+ * @param costmap Costmap to look up
+ * @param x X world coordinates of the points
+ * @param y Y world coordinates of the points
+ * @param costs Output costs of the points
+ * @param size Number of points
+ */
+void gatherCosts(
+  const KernelSet & kernel_set, const CostmapView & costmap, const float * x, const float * y,
+  float * costs, size_t size);
+
+/**
+ * @brief Box-Muller transform of uniform (0, 1] samples into normal samples
+ * @param kernel_set Kernel set to use
+ * @param u1 Uniform samples setting the radius
+ * @param u2 Uniform samples setting the angle
+ * @param cos_out Normal samples from the cosine of the angle
+ * @param sin_out Normal samples from the sine of the angle
+ * @param size Number of samples of each input and output
+ * @param std_dev Standard deviation of the normal samples
+ */
+void boxMuller(
+  const KernelSet & kernel_set, const float * u1, const float * u2, float * cos_out,
+  float * sin_out, size_t size, float std_dev);
+
+/**
+ * @brief Accumulate weighted values, and optionally weighted squared values, as
+ * the softmax weighting of the sampled controls does
+ * @param kernel_set Kernel set to use
+ * @param weight Weight of the values
+ * @param values Values to accumulate
+ * @param sum Weighted sums to add to
+ * @param sq_sum Weighted sums of squares to add to, or null
+ * @param size Number of values
+ */
+void weightedSum(
+  const KernelSet & kernel_set, float weight, const float * values, float * sum, float * sq_sum,
+  size_t size);
+
+/**
+ * @brief Clamp angular velocities to the turning rate a minimum turning radius allows at
+ * their linear velocities, |wz| <= |vx| / min_turning_r, without branching or dividing
+ * by the angular velocities
+ * @param kernel_set Kernel set to use
+ * @param vx Linear velocities
+ * @param wz Angular velocities to clamp in place
+ * @param size Number of velocities
+ * @param min_turning_r Minimum turning radius, no clamping if not positive
+ */
+void limitTurningRate(
+  const KernelSet & kernel_set, const float * vx, float * wz, size_t size, float min_turning_r);
+
+}  // namespace mppi::kernels
+
+#endif  // MPPIC__TOOLS__KERNELS_HPP_
@@ -0,0 +1,387 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__KERNELS_IMPL_HPP_
+#define MPPIC__TOOLS__KERNELS_IMPL_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <xsimd/xsimd.hpp>
+
+#include "mppic/tools/fast_math.hpp"
+#include "mppic/tools/kernels.hpp"
+
+/**
+ * Implementations of the registered kernels, templated on the xsimd architecture.
+ * Translation units compiled with wider instruction set flags include this header only,
+ * defining MPPIC_KERNELS_TARGET beforehand. An inline function they share with baseline
+ * code could otherwise be kept from their copy by the linker, and crash baseline callers
+ * on CPUs without their instructions. So their code lives in an inline namespace of
+ * their own, and the scalar helpers and the std algorithms they use are left out of them
+ */
+#ifdef MPPIC_KERNELS_TARGET
+#define MPPIC_KERNELS_NAMESPACE MPPIC_KERNELS_TARGET
+#else
+#define MPPIC_KERNELS_NAMESPACE baseline
+#endif
+
+namespace mppi::kernels::detail
+{
+
+inline namespace MPPIC_KERNELS_NAMESPACE
+{
+
+#ifndef MPPIC_KERNELS_TARGET
+inline float normalizeAngle(float angle)
+{
+  const float theta = std::fmod(angle + static_cast<float>(M_PI), static_cast<float>(2.0 * M_PI));
+  return theta <= 0.0f ? theta + static_cast<float>(M_PI) : theta - static_cast<float>(M_PI);
+}
+
+inline void sincos(float angle, float & sin, float & cos)
+{
+  sin = std::sin(angle);
+  cos = std::cos(angle);
+}
+
+inline float clampDelta(float delta, float limit)
+{
+  return std::min(std::max(delta, -limit), limit);
+}
+#endif
+
+template<typename Arch>
+inline xsimd::batch<float, Arch> normalizeAngle(const xsimd::batch<float, Arch> & angle)
+{
+  using simd_t = xsimd::batch<float, Arch>;
+  const simd_t pi(static_cast<float>(M_PI));
+  const simd_t theta = xsimd::fmod(angle + pi, simd_t(static_cast<float>(2.0 * M_PI)));
+  return xsimd::select(theta <= simd_t(0.0f), theta + pi, theta - pi);
+}
+
+template<typename Arch>
+inline void sincos(
+  const xsimd::batch<float, Arch> & angle, xsimd::batch<float, Arch> & sin,
+  xsimd::batch<float, Arch> & cos)
+{
+  auto && result = xsimd::sincos(angle);
+  sin = result.first;
+  cos = result.second;
+}
+
+/**
+ * @brief Wrap the running yaw and update its sine and cosine, with the std / xsimd
+ * functions or the float-only fast_math kernels
+ */
+template<bool FastMath, typename T>
+inline T wrapAndSincos(const T & yaw_sum, T & sin, T & cos)
+{
+  if constexpr (FastMath) {
+    const T yaw = fast_math::wrapAngle(yaw_sum);
+    fast_math::sincos(yaw, sin, cos);
+    return yaw;
+  } else {
+    const T yaw = normalizeAngle(yaw_sum);
+    sincos(yaw, sin, cos);
+    return yaw;
+  }
+}
+
+/**
+ * @brief Integrate a group of trajectories in a single sweep over time, keeping
+ * the running pose of each trajectory in registers. If the trajectories store the
+ * cosine and sine of their yaws, the running yaw is kept wrapped step by step and
+ * its cosine and sine, computed anyway for the next step, are stored alongside
+ * @param view Rollout inputs and outputs
+ * @param load Callable returning the T-wide lane values of an input at a time step
+ * @param store Callable writing T-wide lane values into an output at a time step
+ */
+template<typename T, bool Holonomic, bool FastMath, typename Load, typename Store>
+inline void integrateLanes(const RolloutView & view, Load && load, Store && store)
+{
+  const T yaw0(view.yaw0);
+  const T x0(view.x0);
+  const T y0(view.y0);
+
+  T yaw_cos(view.cos0);
+  T yaw_sin(view.sin0);
+  T x_sum(0.0f), y_sum(0.0f);
+
+  // Incrementally wrapped yaw when storing trig, else the unbounded sum offset by yaw0
+  const bool yaw_trig = view.yaw_cos != nullptr;
+  T yaw_sum = yaw_trig ? yaw0 : T(0.0f);
+  const T yaw_offset = yaw_trig ? T(0.0f) : yaw0;
+
+  for (size_t t = 0; t != view.time_steps; t++) {
+    const T dt(view.model_dts ? view.model_dts[t] : view.model_dt);
+    const T vx = load(view.vx, t);
+    T dx = vx * yaw_cos;
+    T dy = vx * yaw_sin;
+
+    if constexpr (Holonomic) {
+      const T vy = load(view.vy, t);
+      dx = dx - vy * yaw_sin;
+      dy = dy + vy * yaw_cos;
+    }
+
+    x_sum = x_sum + dx * dt;
+    y_sum = y_sum + dy * dt;
+    yaw_sum = yaw_sum + load(view.wz, t) * dt;
+
+    const T yaw = wrapAndSincos<FastMath>(yaw_sum + yaw_offset, yaw_sin, yaw_cos);
+    store(view.x, t, x_sum + x0);
+    store(view.y, t, y_sum + y0);
+    store(view.yaws, t, yaw);
+
+    if (yaw_trig) {
+      yaw_sum = yaw;
+      store(view.yaw_cos, t, yaw_cos);
+      store(view.yaw_sin, t, yaw_sin);
+    }
+  }
+}
+
+template<typename Arch>
+inline xsimd::batch<float, Arch> clampDelta(const xsimd::batch<float, Arch> & delta, float limit)
+{
+  using simd_t = xsimd::batch<float, Arch>;
+  return xsimd::min(xsimd::max(delta, simd_t(-limit)), simd_t(limit));
+}
+
+/**
+ * @brief Move the velocities of a group of trajectories towards the controls of the
+ * previous time step, by at most their acceleration limit over that time step. All axes
+ * are updated in the same sweep over time, keeping the running velocities in registers
+ * @param view Rollout controls and velocities
+ * @param load Callable returning the T-wide lane values of an input at a time step
+ * @param store Callable writing T-wide lane values into an output at a time step
+ */
+template<typename T, bool Holonomic, typename Load, typename Store>
+inline void accelerateLanes(const DynamicsView & view, Load && load, Store && store)
+{
+  T vx = load(view.vx, 0);
+  T wz = load(view.wz, 0);
+  T vy = Holonomic ? load(view.vy, 0) : T(0.0f);
+
+  for (size_t t = 1; t < view.time_steps; t++) {
+    const float dt = view.model_dts[t - 1];
+    vx = vx + clampDelta(load(view.cvx, t - 1) - vx, view.ax_max * dt);
+    wz = wz + clampDelta(load(view.cwz, t - 1) - wz, view.az_max * dt);
+    store(view.vx, t, vx);
+    store(view.wz, t, wz);
+
+    if constexpr (Holonomic) {
+      vy = vy + clampDelta(load(view.cvy, t - 1) - vy, view.ay_max * dt);
+      store(view.vy, t, vy);
+    }
+  }
+}
+
+/**
+ * @struct mppi::kernels::detail::ArchKernels
+ * @brief Kernels of the registry for an xsimd architecture, processing whole batches
+ */
+template<typename Arch>
+struct ArchKernels
+{
+  using simd_t = xsimd::batch<float, Arch>;
+  using index_t = xsimd::batch<int32_t, Arch>;
+  static constexpr size_t lanes = simd_t::size;
+  static_assert(index_t::size == lanes, "Index and coordinate batches must match");
+
+  template<bool Holonomic, bool FastMath>
+  static size_t integrateRows(const RolloutView & view, size_t begin, size_t end)
+  {
+    const size_t time_steps = view.time_steps;
+    float buffer[lanes];
+    size_t row = begin;
+
+    // A lane per trajectory row, gathered and scattered across the rows
+    auto load_lanes = [&](const float * tensor, size_t t) {
+        const float * src = tensor + row * time_steps + t;
+        for (size_t l = 0; l != lanes; l++) {
+          buffer[l] = src[l * time_steps];
+        }
+        return simd_t::load_unaligned(buffer);
+      };
+
+    auto store_lanes = [&](float * tensor, size_t t, const simd_t & value) {
+        value.store_unaligned(buffer);
+        float * dst = tensor + row * time_steps + t;
+        for (size_t l = 0; l != lanes; l++) {
+          dst[l * time_steps] = buffer[l];
+        }
+      };
+
+    for (; row + lanes <= end; row += lanes) {
+      integrateLanes<simd_t, Holonomic, FastMath>(view, load_lanes, store_lanes);
+    }
+    return row - begin;
+  }
+
+  static size_t integrate(
+    const RolloutView & view, size_t begin, size_t end, bool is_holonomic, bool fast_math)
+  {
+    if (is_holonomic && fast_math) {
+      return integrateRows<true, true>(view, begin, end);
+    } else if (is_holonomic) {
+      return integrateRows<true, false>(view, begin, end);
+    } else if (fast_math) {
+      return integrateRows<false, true>(view, begin, end);
+    }
+    return integrateRows<false, false>(view, begin, end);
+  }
+
+  template<bool Holonomic>
+  static size_t accelerateRows(const DynamicsView & view, size_t begin, size_t end)
+  {
+    const size_t time_steps = view.time_steps;
+    float buffer[lanes];
+    size_t row = begin;
+
+    auto load_lanes = [&](const float * tensor, size_t t) {
+        const float * src = tensor + row * time_steps + t;
+        for (size_t l = 0; l != lanes; l++) {
+          buffer[l] = src[l * time_steps];
+        }
+        return simd_t::load_unaligned(buffer);
+      };
+
+    auto store_lanes = [&](float * tensor, size_t t, const simd_t & value) {
+        value.store_unaligned(buffer);
+        float * dst = tensor + row * time_steps + t;
+        for (size_t l = 0; l != lanes; l++) {
+          dst[l * time_steps] = buffer[l];
+        }
+      };
+
+    for (; row + lanes <= end; row += lanes) {
+      accelerateLanes<simd_t, Holonomic>(view, load_lanes, store_lanes);
+    }
+    return row - begin;
+  }
+
+  static size_t limitAcceleration(
+    const DynamicsView & view, size_t begin, size_t end, bool is_holonomic)
+  {
+    return is_holonomic ?
+           accelerateRows<true>(view, begin, end) : accelerateRows<false>(view, begin, end);
+  }
+
+  static size_t gatherCosts(
+    const CostmapView & costmap, const float * x, const float * y, float * costs, size_t size)
+  {
+    const simd_t origin_x(costmap.origin_x);
+    const simd_t origin_y(costmap.origin_y);
+    const simd_t resolution(costmap.resolution);
+    const simd_t max_x(static_cast<float>(costmap.size_x));
+    const simd_t max_y(static_cast<float>(costmap.size_y));
+    const index_t size_x(static_cast<int32_t>(costmap.size_x));
+
+    // Plain arrays, as the std::array members would be inline functions shared across targets
+    int32_t indices[lanes];
+    float gathered[lanes];
+    size_t i = 0;
+    for (; i + lanes <= size; i += lanes) {
+      const simd_t fx = (simd_t::load_unaligned(x + i) - origin_x) / resolution;
+      const simd_t fy = (simd_t::load_unaligned(y + i) - origin_y) / resolution;
+
+      // NaN coordinates fail every comparison and so end up out of bounds as well
+      const auto in_bounds = (fx >= simd_t(0.0f)) & (fy >= simd_t(0.0f)) &
+        (fx < max_x) & (fy < max_y);
+
+      // Non-negative, so truncation matches Costmap2D::worldToMap
+      const index_t mx = xsimd::to_int(xsimd::select(in_bounds, fx, simd_t(0.0f)));
+      const index_t my = xsimd::to_int(xsimd::select(in_bounds, fy, simd_t(0.0f)));
+      (my * size_x + mx).store_unaligned(indices);
+
+      for (size_t l = 0; l != lanes; l++) {
+        gathered[l] = costmap.char_map[indices[l]];
+      }
+      xsimd::select(
+        in_bounds, simd_t::load_unaligned(gathered),
+        simd_t(costmap.out_of_bounds_cost)).store_unaligned(costs + i);
+    }
+    return i;
+  }
+
+  static size_t boxMuller(
+    const float * u1, const float * u2, float * cos_out, float * sin_out, size_t size,
+    float std_dev)
+  {
+    size_t i = 0;
+    for (; i + lanes <= size; i += lanes) {
+      const simd_t radius =
+        xsimd::sqrt(simd_t(-2.0f) * xsimd::log(simd_t::load_unaligned(u1 + i))) *
+        simd_t(std_dev);
+      auto && sin_cos =
+        xsimd::sincos(simd_t(static_cast<float>(2.0 * M_PI)) * simd_t::load_unaligned(u2 + i));
+      (radius * sin_cos.second).store_unaligned(cos_out + i);
+      (radius * sin_cos.first).store_unaligned(sin_out + i);
+    }
+    return i;
+  }
+
+  static size_t weightedSum(
+    float weight, const float * values, float * sum, float * sq_sum, size_t size)
+  {
+    const simd_t w(weight);
+    size_t i = 0;
+    for (; i + lanes <= size; i += lanes) {
+      const simd_t v = simd_t::load_unaligned(values + i);
+      const simd_t weighted = w * v;
+      (simd_t::load_unaligned(sum + i) + weighted).store_unaligned(sum + i);
+      if (sq_sum) {
+        (simd_t::load_unaligned(sq_sum + i) + weighted * v).store_unaligned(sq_sum + i);
+      }
+    }
+    return i;
+  }
+
+  static size_t limitTurningRate(const float * vx, float * wz, size_t size, float inv_radius)
+  {
+    const simd_t inv_r(inv_radius);
+    size_t i = 0;
+    for (; i + lanes <= size; i += lanes) {
+      const simd_t max_wz = xsimd::abs(simd_t::load_unaligned(vx + i)) * inv_r;
+      const simd_t clamped = xsimd::max(simd_t::load_unaligned(wz + i), -max_wz);
+      xsimd::min(clamped, max_wz).store_unaligned(wz + i);
+    }
+    return i;
+  }
+};
+
+/**
+ * @brief Kernel set of an xsimd architecture
+ * @param name Name of the set, as selected by parameter
+ * @return Kernel set
+ */
+template<typename Arch>
+KernelSet makeKernelSet(const char * name)
+{
+  return {name, Arch::name(), &ArchKernels<Arch>::integrate, &ArchKernels<Arch>::gatherCosts,
+    &ArchKernels<Arch>::boxMuller, &ArchKernels<Arch>::weightedSum,
+    &ArchKernels<Arch>::limitTurningRate, &ArchKernels<Arch>::limitAcceleration};
+}
+
+}  // namespace MPPIC_KERNELS_NAMESPACE
+
+}  // namespace mppi::kernels::detail
+
+#undef MPPIC_KERNELS_NAMESPACE
+
+#endif  // MPPIC__TOOLS__KERNELS_IMPL_HPP_
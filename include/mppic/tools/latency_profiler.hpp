@@ -0,0 +1,185 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__LATENCY_PROFILER_HPP_
+#define MPPIC__TOOLS__LATENCY_PROFILER_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "mppic/tools/trace_recorder.hpp"
+
+namespace mppi
+{
+
+/**
+ * @struct mppi::LatencyStats
+ * @brief Latency summary of a profiled stage over its rolling window, in microseconds
+ */
+struct LatencyStats
+{
+  std::string name;
+  size_t count{0};
+  float p50{0};
+  float p99{0};
+  float max{0};
+};
+
+/**
+ * @class mppi::LatencyProfiler
+ * @brief Always-on latency instrumentation of the controller stages and critics.
+ * Each named entry keeps its last window_size samples in a fixed ring, so recording
+ * is cheap and never allocates; percentiles are only computed when stats are read.
+ * Recording and reading are expected from the control thread
+ */
+class LatencyProfiler
+{
+public:
+  static constexpr size_t window_size = 256;
+
+  /**
+    * @brief Constructor for mppi::LatencyProfiler
+    */
+  LatencyProfiler() = default;
+
+  /**
+    * @brief Register a named entry, or find an already registered one
+    * @param name Name of the stage or critic
+    * @return Id to record into
+    */
+  size_t addEntry(const std::string & name);
+
+  /**
+    * @brief Record a sample into an entry
+    * @param id Entry id
+    * @param microseconds Duration of the sample
+    */
+  void record(size_t id, float microseconds)
+  {
+    Entry & entry = entries_[id];
+    entry.samples[entry.count % window_size] = microseconds;
+    entry.count++;
+  }
+
+  /**
+    * @brief Also record every timed sample as a span of a trace, named after its entry
+    * @param recorder Recorder to trace into, null to stop tracing
+    */
+  void setTraceRecorder(TraceRecorder * recorder);
+
+  /**
+    * @brief Trace a timed sample, if tracing
+    * @param id Entry id
+    * @param begin Start of the sample
+    * @param end End of the sample
+    */
+  void trace(
+    size_t id, std::chrono::steady_clock::time_point begin,
+    std::chrono::steady_clock::time_point end)
+  {
+    if (trace_recorder_) {
+      trace_recorder_->record(trace_names_[id], begin, end);
+    }
+  }
+
+  /**
+    * @brief Forget all recorded samples, keeping the entries
+    */
+  void reset();
+
+  /**
+    * @brief Stats of all entries, in registration order
+    * @return Stats
+    */
+  std::vector<LatencyStats> getStats() const;
+
+  /**
+    * @brief Stats of a single entry
+    * @param name Name of the entry
+    * @return Stats, or nullopt if no such entry is registered
+    */
+  std::optional<LatencyStats> getStats(const std::string & name) const;
+
+protected:
+  /**
+   * @struct mppi::LatencyProfiler::Entry
+   * @brief Rolling window of samples of a named entry
+   */
+  struct Entry
+  {
+    std::string name;
+    std::array<float, window_size> samples;
+    size_t count{0};
+  };
+
+  /**
+    * @brief Compute the stats of an entry over its window
+    */
+  static LatencyStats computeStats(const Entry & entry);
+
+  std::vector<Entry> entries_;
+  TraceRecorder * trace_recorder_{nullptr};
+  // Trace name of every entry, if tracing
+  std::vector<uint32_t> trace_names_;
+};
+
+/**
+ * @class mppi::ScopedLatencyTimer
+ * @brief Records the time from construction to destruction into a profiler entry, and
+ * its trace if it has one. A null profiler makes it a no-op
+ */
+class ScopedLatencyTimer
+{
+public:
+  /**
+    * @brief Constructor for mppi::ScopedLatencyTimer, starting the timer
+    * @param profiler Profiler to record into, may be null
+    * @param id Entry id to record into
+    */
+  ScopedLatencyTimer(LatencyProfiler * profiler, size_t id)
+  : profiler_(profiler), id_(id)
+  {
+    if (profiler_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  /**
+    * @brief Destructor for mppi::ScopedLatencyTimer, recording the elapsed time
+    */
+  ~ScopedLatencyTimer()
+  {
+    if (profiler_) {
+      const auto end = std::chrono::steady_clock::now();
+      profiler_->record(id_, std::chrono::duration<float, std::micro>(end - start_).count());
+      profiler_->trace(id_, start_, end);
+    }
+  }
+
+  ScopedLatencyTimer(const ScopedLatencyTimer &) = delete;
+  ScopedLatencyTimer & operator=(const ScopedLatencyTimer &) = delete;
+
+protected:
+  LatencyProfiler * profiler_;
+  size_t id_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__LATENCY_PROFILER_HPP_
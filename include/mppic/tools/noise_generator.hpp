@@ -15,11 +15,17 @@
 #ifndef MPPIC__TOOLS__NOISE_GENERATOR_HPP_
 #define MPPIC__TOOLS__NOISE_GENERATOR_HPP_
 
+#include <array>
+#include <atomic>
 #include <string>
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <optional>
 #include <condition_variable>
+#include <cstdint>
+#include <random>
+#include <vector>
 
 #include <xtensor/xtensor.hpp>
 #include <xtensor/xview.hpp>
@@ -27,13 +33,20 @@
 #include "mppic/models/optimizer_settings.hpp"
 #include <mppic/models/control_sequence.hpp>
 #include <mppic/models/state.hpp>
+#include "mppic/tools/gaussian_sampler.hpp"
+#include "mppic/tools/kernels.hpp"
+#include "mppic/tools/thread_placement.hpp"
+#include "mppic/tools/thread_pool.hpp"
+#include "mppic/tools/trace_recorder.hpp"
 
 namespace mppi
 {
 
 /**
  * @class mppi::NoiseGenerator
- * @brief Generates noise trajectories from optimal trajectory
+ * @brief Generates noise trajectories from optimal trajectory. Noises are produced on
+ * a background thread into a ring of three preallocated buffers (triple buffering),
+ * published with atomics so the consumer never blocks on noise generation
  */
 class NoiseGenerator
 {
@@ -44,11 +57,16 @@ public:
   NoiseGenerator() = default;
 
   /**
-   * @brief Initialize noise generator with settings and model types
+   * @brief Initialize noise generator with settings and model types, seeding the
+   * samplers from settings.noise_seed if non-negative
    * @param settings Settings of controller
    * @param is_holonomic If base is holonomic
+   * @param thread_pool Optional worker pool to apply noises to the batch in chunks
+   * @param kernel_set SIMD kernels of the Xoshiro sampler, or nullptr for the baseline ones
    */
-  void initialize(mppi::models::OptimizerSettings & settings, bool is_holonomic);
+  void initialize(
+    mppi::models::OptimizerSettings & settings, bool is_holonomic,
+    ThreadPool * thread_pool = nullptr, const kernels::KernelSet * kernel_set = nullptr);
 
   /**
    * @brief Shutdown noise generator thread
@@ -62,44 +80,273 @@ public:
   void generateNextNoises();
 
   /**
-   * @brief set noised control_sequence to state controls
+   * @brief set noised control_sequence to state controls, using the latest
+   * completed noises without blocking
    * @return noises vx, vy, wz
    */
   void setNoisedControls(models::State & state, const models::ControlSequence & control_sequence);
 
   /**
-   * @brief Reset noise generator with settings and model types
+   * @brief Number of times no newly completed noises were available, so the
+   * previous ones were reused instead of waiting for the noise thread
+   * @return Wait count since construction
+   */
+  size_t getWaitCount() const {return wait_count_;}
+
+  /**
+   * @brief Seed of the samplers, drawn from the system random device unless configured
+   * @return Seed
+   */
+  unsigned int getSeed() const {return seed_;}
+
+  /**
+   * @brief Number of noise sequences in the precomputed noise bank
+   * @return Bank size, 0 if the noise bank is disabled
+   */
+  size_t getNoiseBankSize() const {return bank_size_;}
+
+  /**
+   * @brief Placement the noise thread ended up with when it started
+   * @return Report, that of a default placement if there is no noise thread
+   */
+  const models::ThreadPlacementReport & getPlacementReport() const {return placement_report_;}
+
+  /**
+   * @brief Bytes held by the noise buffers and their generation scratch
+   * @return Bytes
+   */
+  size_t getMemoryUsage() const;
+
+  /**
+   * @brief Bytes held by the precomputed noise bank
+   * @return Bytes, 0 if the noise bank is disabled
+   */
+  size_t getNoiseBankMemoryUsage() const;
+
+  /**
+   * @brief In adaptive sampling mode, move the per time step sampling deviations
+   * towards the ones of the weighted samples, by the adaptive sampling rate.
+   * Deviations stay between the minimum ratio of the configured ones and the configured ones
+   * @param variances Per time step variances of the weighted samples around the
+   * updated control sequence
+   */
+  void adaptSamplingStd(const models::ControlSequence & variances);
+
+  /**
+   * @brief Per time step scales of the configured sampling deviations applied to the noises
+   * @return Scales, all ones unless in adaptive sampling mode
+   */
+  const models::ControlSequence & getSamplingScales() const {return sampling_scales_;}
+
+  /**
+   * @brief Reset noise generator with settings and model types, rebuilding the
+   * noise bank if enabled and its settings changed
    * @param settings Settings of controller
    * @param is_holonomic If base is holonomic
    */
   void reset(mppi::models::OptimizerSettings & settings, bool is_holonomic);
 
+  /**
+   * @brief Build the noise storage of new settings aside, on any thread, for the reset
+   * to these settings to swap it in rather than allocate
+   * @param settings Settings of controller
+   * @param is_holonomic If base is holonomic
+   * @param sample_bank Whether to sample the noise bank too, from generators of its own
+   */
+  void stage(
+    const mppi::models::OptimizerSettings & settings, bool is_holonomic, bool sample_bank);
+
+  /**
+   * @brief Whether the noise bank was sampled for settings, so that a reset keeps it
+   * @param settings Settings of controller
+   * @param is_holonomic If base is holonomic
+   * @return True if the bank is kept
+   */
+  bool isNoiseBankCurrent(
+    const mppi::models::OptimizerSettings & settings, bool is_holonomic) const;
+
+  /**
+   * @brief Trace the generations of the noise thread into a timeline
+   * @param recorder Recorder to trace into, null to stop tracing
+   */
+  void setTraceRecorder(TraceRecorder * recorder);
+
 protected:
+  struct Noises
+  {
+    xt::xtensor<float, 2> vx;
+    xt::xtensor<float, 2> vy;
+    xt::xtensor<float, 2> wz;
+
+    // Used instead of the above with half noise precision
+    xt::xtensor<uint16_t, 2> vx_half;
+    xt::xtensor<uint16_t, 2> vy_half;
+    xt::xtensor<uint16_t, 2> wz_half;
+  };
+
+  static constexpr size_t half_chunk_rows_ = 64;
+
+  static constexpr unsigned int num_buffers_ = 3;
+  static constexpr unsigned int index_mask_ = 3;
+  static constexpr unsigned int fresh_flag_ = 4;
+
   /**
    * @brief Thread to execute noise generation process
+   * @param placement CPUs and scheduling to apply before generating
    */
-  void noiseThread();
+  void noiseThread(const models::ThreadPlacement & placement);
 
   /**
    * @brief Generate random controls by gaussian noise with mean in
-   * control_sequence_
+   * control_sequence_ into the back buffer, then publish it
    *
    * @return tensor of shape [ batch_size_, time_steps_, 2]
    * where 2 stands for v, w
    */
   void generateNoisedControls();
 
-  xt::xtensor<float, 2> noises_vx_;
-  xt::xtensor<float, 2> noises_vy_;
-  xt::xtensor<float, 2> noises_wz_;
+  /**
+   * @brief Sample zero mean gaussian noises with the selected backend
+   * @param noises Tensor to fill
+   * @param rows Number of noise sequences to sample
+   * @param std_dev Standard deviation of the noises
+   */
+  void sampleNoises(xt::xtensor<float, 2> & noises, size_t rows, float std_dev);
+
+  /**
+   * @brief Sample zero mean gaussian noises with the backend of settings from the given
+   * generators
+   * @param noises Tensor to fill
+   * @param rows Number of noise sequences to sample
+   * @param std_dev Standard deviation of the noises
+   * @param settings Settings of controller
+   * @param engine Generator of the default backend
+   * @param sampler Generator of the Xoshiro backend
+   */
+  static void sampleNoises(
+    xt::xtensor<float, 2> & noises, size_t rows, float std_dev,
+    const mppi::models::OptimizerSettings & settings, std::mt19937 & engine,
+    GaussianSampler & sampler);
+
+  /**
+   * @brief Fill noises with sequences picked from the noise bank at random rows
+   * and random circular time offsets, without sampling
+   * @param noises Noises to fill, already sized
+   */
+  void pickBankNoises(Noises & noises);
+
+  /**
+   * @brief Copy a sequence picked from a noise bank at a random row and random
+   * circular time offset
+   * @param bank Bank channel to pick from
+   * @param dst Sequence to fill
+   */
+  void pickBankSequence(const xt::xtensor<float, 2> & bank, float * dst);
+
+  /**
+   * @brief Generate the noises in float a chunk of rows at a time and store them in
+   * half precision, so that no full batch of float noises is ever held
+   * @param noises Noises to fill, half precision storage already sized
+   */
+  void generateHalfNoises(Noises & noises);
+
+  /**
+   * @brief Low pass filter noise sequences over time by noise_correlation,
+   * keeping their variance
+   * @param noises Tensor to filter in place
+   */
+  void correlateNoises(xt::xtensor<float, 2> & noises) const;
+
+  /**
+   * @brief Regenerate the noise bank if its settings changed, bounded in
+   * memory by settings noise_bank_memory_mb
+   */
+  void updateNoiseBank();
+
+  /**
+   * @brief Sample a noise bank bounded in memory by settings noise_bank_memory_mb
+   * @param settings Settings of controller
+   * @param is_holonomic If base is holonomic
+   * @param engine Generator of the default backend
+   * @param sampler Generator of the Xoshiro backend
+   * @param bank Bank to fill, emptied if disabled
+   * @return Bank size, 0 if the noise bank is disabled
+   */
+  static size_t sampleNoiseBank(
+    const mppi::models::OptimizerSettings & settings, bool is_holonomic,
+    std::mt19937 & engine, GaussianSampler & sampler, Noises & bank);
+
+  /**
+   * @brief Whether noise banks sampled for two settings are the same, and so the noise
+   * storage of these settings
+   * @return True if the same
+   */
+  static bool isSameNoiseBank(
+    const mppi::models::OptimizerSettings & a, bool a_holonomic,
+    const mppi::models::OptimizerSettings & b, bool b_holonomic);
+
+  /**
+   * @brief Size the noise buffers and their generation scratch for settings, only the
+   * storage of the configured precision, lateral only if holonomic
+   * @param settings Settings of controller
+   * @param is_holonomic If base is holonomic
+   * @param noises Buffers to size
+   * @param half_chunk Scratch to size
+   */
+  static void allocateNoises(
+    const mppi::models::OptimizerSettings & settings, bool is_holonomic,
+    std::array<Noises, num_buffers_> & noises, xt::xtensor<float, 2> & half_chunk);
+
+  std::array<Noises, num_buffers_> noises_;
+  unsigned int front_{0};  // Read by the consumer
+  unsigned int back_{1};  // Written by the noise thread
+  std::atomic<unsigned int> latest_{2};  // Last completed buffer, flagged if not yet consumed
+  std::atomic<size_t> wait_count_{0};
+  // Set by a reset until the consumer took the first noises generated after it
+  bool awaiting_noises_{false};
+
+  unsigned int seed_{0};
+  std::mt19937 engine_;
+  GaussianSampler sampler_;
+
+  Noises bank_;
+  xt::xtensor<float, 2> half_chunk_;
+  size_t bank_size_{0};
+  std::optional<mppi::models::OptimizerSettings> bank_settings_;
+  bool bank_holonomic_{false};
+
+  // Storage of a reset built aside by stage, with the bank if it was sampled too
+  struct Staging
+  {
+    mppi::models::OptimizerSettings settings;
+    bool is_holonomic{false};
+    std::array<Noises, num_buffers_> noises;
+    xt::xtensor<float, 2> half_chunk;
+    std::optional<Noises> bank;
+    size_t bank_size{0};
+  };
+  std::mutex staging_lock_;
+  std::unique_ptr<Staging> staging_;
+  std::atomic<unsigned int> stage_count_{0};
+  const kernels::KernelSet * kernel_set_{nullptr};
 
   mppi::models::OptimizerSettings settings_;
+  models::ControlSequence sampling_scales_;
+  // Filter gains of each time step, on the previous noise and on the fresh one
+  std::vector<float> correlation_gains_;
+  std::vector<float> innovation_gains_;
   bool is_holonomic_;
+  ThreadPool * thread_pool_{nullptr};
 
   std::thread noise_thread_;
   std::condition_variable noise_cond_;
   std::mutex noise_lock_;
-  bool active_{false}, ready_{false};
+  bool active_{false}, ready_{false}, generating_{false};
+  // Guarded by the noise lock, as the noise thread reads it
+  TraceRecorder * trace_recorder_{nullptr};
+  uint32_t trace_name_{0};
+  models::ThreadPlacementReport placement_report_;
+  bool placed_{false};
 };
 
 }  // namespace mppi
@@ -15,7 +15,10 @@
 #ifndef MPPIC__TOOLS__PARAMETERS_HANDLER_HPP_
 #define MPPIC__TOOLS__PARAMETERS_HANDLER_HPP_
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <mutex>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
@@ -42,8 +45,12 @@ class ParametersHandler
 {
 public:
   using get_param_func_t = void (const rclcpp::Parameter & param);
+  // Reason a parameter value is rejected, or empty if it is valid
+  using verify_param_func_t = std::string (const rclcpp::Parameter & param);
   using post_callback_t = void ();
   using pre_callback_t = void ();
+  // Work building what changes lead to off the lock, or empty if there is nothing to build
+  using stage_callback_t = std::function<void()> (const std::vector<rclcpp::Parameter> & params);
 
   /**
     * @brief Constructor for mppi::ParametersHandler
@@ -57,19 +64,78 @@ public:
   explicit ParametersHandler(
     const rclcpp_lifecycle::LifecycleNode::WeakPtr & parent);
 
+  /**
+    * @brief Constructor for mppi::ParametersHandler without a node, for headless
+    * optimizers. Parameters not given take their defaults, and are changed by calling
+    * dynamicParamsCallback directly
+    * @param parameters Fully namespaced parameters, such as FollowPath.batch_size
+    * @param node_name Namespace of the handler's own parameters
+    */
+  explicit ParametersHandler(
+    const std::vector<rclcpp::Parameter> & parameters,
+    const std::string & node_name = "controller_server");
+
+  /**
+    * @brief Whether parameters are read from a parameter list rather than a node
+    * @return True if headless
+    */
+  bool isHeadless() const {return headless_;}
+
   /**
     * @brief Starts processing dynamic parameter changes
+    * @param defer_changes Queue the node's parameter changes while a control cycle holds
+    * the lock, instead of waiting for it in the parameter service. They are applied by
+    * applyPendingChanges at the start of the next cycle, or by a retry on the node's
+    * executor once the cycle is over, so an idle controller applies them too. What they
+    * reallocate is first built off the lock by the stage callbacks, so that applying them
+    * only swaps it in and a cycle starting meanwhile does not wait for the reallocation
     */
-  void start();
+  void start(bool defer_changes = false);
 
   /**
-    * @brief Dynamic parameter callback
+    * @brief Dynamic parameter callback. Rejects all the changes if one of them does
+    * not pass its verifiers
     * @param parameter Parameter changes to process
     * @return Set Parameter Result
     */
   rcl_interfaces::msg::SetParametersResult dynamicParamsCallback(
     std::vector<rclcpp::Parameter> parameters);
 
+  /**
+    * @brief Deferred dynamic parameter callback, verifying and queueing the changes, then
+    * staging and applying them right away unless a control cycle holds the lock
+    * @param parameter Parameter changes to process
+    * @return Set Parameter Result
+    */
+  rcl_interfaces::msg::SetParametersResult deferParamsCallback(
+    std::vector<rclcpp::Parameter> parameters);
+
+  /**
+    * @brief Apply the staged parameter changes, with their pre and post callbacks, on the
+    * calling thread. Changes queued but not staged yet are snapshotted and left to build on
+    * the node's executor, or built right away by a headless handler. Only checks a flag if
+    * none are queued
+    * @return Whether changes were applied
+    */
+  bool applyPendingChanges();
+
+  /**
+    * @brief Verify parameter changes against the type of their settings and the
+    * verifiers added for them. Parameters not handled here are accepted
+    * @param parameters Parameter changes to verify
+    * @return Set Parameter Result, unsuccessful with the reasons of the rejected values
+    */
+  rcl_interfaces::msg::SetParametersResult verifyParameters(
+    const std::vector<rclcpp::Parameter> & parameters) const;
+
+  /**
+    * @brief Add a check of the values a dynamic parameter may be set to, such as a range
+    * @param name Name of parameter
+    * @param verifier Callable returning the reason a value is rejected, or an empty string
+    */
+  template<typename T>
+  void addParamVerifier(const std::string & name, T && verifier);
+
   /**
     * @brief Get an object to retreive parameters
     * @param ns Namespace to get parameters within
@@ -92,7 +158,27 @@ public:
   void addPreCallback(T && callback);
 
   /**
-    * @brief Set a parameter to a dynamic parameter callback
+    * @brief Set a callback staging deferred parameter changes. It is called with the lock
+    * held to snapshot cheaply what the changes lead to, and returns the work building it,
+    * which runs off the lock. The changes are applied once all of it is built
+    * @param callback Callback function
+    */
+  template<typename T>
+  void addStageCallback(T && callback);
+
+  /**
+    * @brief Copy of settings with the parameter changes applied to its members bound to
+    * them, the bound settings being left unchanged
+    * @param settings Settings to copy, whose members were bound by setDynamicParamCallback
+    * @param parameters Parameter changes to apply to the copy
+    * @return Changed copy of the settings
+    */
+  template<typename T>
+  T stageSettings(const T & settings, const std::vector<rclcpp::Parameter> & parameters) const;
+
+  /**
+    * @brief Set a parameter to a dynamic parameter callback. Settings of several objects,
+    * such as concurrent optimizers, may be bound to the same parameter, each being updated
     * @param setting Parameter
     * @param name Name of parameter
     */
@@ -109,7 +195,8 @@ public:
   }
 
   /**
-    * @brief Set a parameter to a dynamic parameter callback
+    * @brief Add a dynamic parameter callback, called after those added before for the
+    * same parameter
     * @param name Name of parameter
     * @param callback Parameter callback
     */
@@ -146,6 +233,43 @@ protected:
   template<typename T>
   static auto as(const rclcpp::Parameter & parameter);
 
+  /**
+    * @brief Parameter type a setting is converted from
+    * @return Parameter type, not set if any is converted
+    */
+  template<typename T>
+  static rclcpp::ParameterType typeOf();
+
+  /**
+    * @brief Apply parameter changes with their pre and post callbacks, the lock held
+    * @param parameters Parameter changes to apply
+    */
+  void applyChanges(const std::vector<rclcpp::Parameter> & parameters);
+
+  /**
+    * @brief Take the staged parameter changes
+    * @return Parameter changes staged since the last call
+    */
+  std::vector<rclcpp::Parameter> takeStagedChanges();
+
+  /**
+    * @brief Snapshot the queued parameter changes with the stage callbacks, the lock held.
+    * Changes with nothing to build are staged right away. One set of changes is staged at
+    * a time, so that each is snapshotted from the settings the previous one left
+    */
+  void snapshotPendingChanges();
+
+  /**
+    * @brief Run the work of the snapshotted parameter changes off the lock, then stage them
+    */
+  void buildPendingChanges();
+
+  /**
+    * @brief Stage and apply the queued parameter changes while no control cycle holds the
+    * lock, retrying later otherwise
+    */
+  void processPendingChanges();
+
   std::mutex parameters_change_mutex_;
   rclcpp::Logger logger_{rclcpp::get_logger("MPPIController")};
   rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr
@@ -154,12 +278,34 @@ protected:
   std::string node_name_;
 
   bool verbose_{false};
-
-  std::unordered_map<std::string, std::function<get_param_func_t>>
+  bool headless_{false};
+
+  // Changes queued by the parameter service, then snapshotted while their storage is built,
+  // then staged for the control thread to apply
+  std::mutex pending_mutex_;
+  std::vector<rclcpp::Parameter> pending_parameters_;
+  std::vector<rclcpp::Parameter> building_parameters_;
+  std::vector<std::function<void()>> stage_builds_;
+  std::vector<rclcpp::Parameter> staged_parameters_;
+  std::atomic<bool> has_pending_{false};
+  rclcpp::TimerBase::SharedPtr retry_timer_;
+  std::unordered_map<std::string, rclcpp::Parameter> headless_parameters_;
+
+  std::unordered_map<std::string, std::vector<std::function<get_param_func_t>>>
   get_param_callbacks_;
+  // Settings bound to each parameter, with the assignment of a value to a copy of one
+  struct SettingBinding
+  {
+    const void * setting;
+    std::function<void(void * setting, const rclcpp::Parameter & param)> assign;
+  };
+  std::unordered_map<std::string, std::vector<SettingBinding>> dynamic_settings_;
+  std::unordered_map<std::string, std::vector<std::function<verify_param_func_t>>>
+  verify_param_callbacks_;
 
   std::vector<std::function<pre_callback_t>> pre_callbacks_;
   std::vector<std::function<post_callback_t>> post_callbacks_;
+  std::vector<std::function<stage_callback_t>> stage_callbacks_;
 };
 
 inline auto ParametersHandler::getParamGetter(const std::string & ns)
@@ -176,7 +322,13 @@ inline auto ParametersHandler::getParamGetter(const std::string & ns)
 template<typename T>
 void ParametersHandler::addDynamicParamCallback(const std::string & name, T && callback)
 {
-  get_param_callbacks_[name] = callback;
+  get_param_callbacks_[name].push_back(callback);
+}
+
+template<typename T>
+void ParametersHandler::addParamVerifier(const std::string & name, T && verifier)
+{
+  verify_param_callbacks_[name].push_back(verifier);
 }
 
 template<typename T>
@@ -191,12 +343,56 @@ void ParametersHandler::addPreCallback(T && callback)
   pre_callbacks_.push_back(callback);
 }
 
+template<typename T>
+void ParametersHandler::addStageCallback(T && callback)
+{
+  stage_callbacks_.push_back(callback);
+}
+
+template<typename T>
+T ParametersHandler::stageSettings(
+  const T & settings, const std::vector<rclcpp::Parameter> & parameters) const
+{
+  // Members bound within the settings are found at the same offset in the copy
+  T staged = settings;
+  const auto * begin = reinterpret_cast<const char *>(&settings);
+  const auto * end = begin + sizeof(T);
+  std::less<const char *> less;
+  for (const auto & param : parameters) {
+    auto bindings = dynamic_settings_.find(param.get_name());
+    if (bindings == dynamic_settings_.end()) {
+      continue;
+    }
+
+    for (const auto & binding : bindings->second) {
+      const auto * setting = static_cast<const char *>(binding.setting);
+      if (!less(setting, begin) && less(setting, end)) {
+        binding.assign(reinterpret_cast<char *>(&staged) + (setting - begin), param);
+      }
+    }
+  }
+  return staged;
+}
+
 template<typename SettingT, typename ParamT>
 void ParametersHandler::getParam(
   SettingT & setting, const std::string & name,
   ParamT default_value,
   ParameterType param_type)
 {
+  if (headless_) {
+    auto parameter = headless_parameters_.find(name);
+    if (parameter != headless_parameters_.end()) {
+      setting = static_cast<SettingT>(as<ParamT>(parameter->second));
+    } else {
+      setting = static_cast<SettingT>(default_value);
+    }
+    if (param_type == ParameterType::Dynamic) {
+      setDynamicParamCallback(setting, name);
+    }
+    return;
+  }
+
   auto node = node_.lock();
 
   nav2_util::declare_parameter_if_not_declared(
@@ -221,9 +417,18 @@ void ParametersHandler::setParam(
 template<typename T>
 void ParametersHandler::setDynamicParamCallback(T & setting, const std::string & name)
 {
-  if (get_param_callbacks_.find(name) != get_param_callbacks_.end()) {
+  // Each setting is bound once, however often it is got
+  auto & settings = dynamic_settings_[name];
+  if (std::any_of(
+      settings.begin(), settings.end(),
+      [&setting](const SettingBinding & binding) {return binding.setting == &setting;}))
+  {
     return;
   }
+  settings.push_back(
+    {&setting, [](void * target, const rclcpp::Parameter & param) {
+        *static_cast<T *>(target) = as<T>(param);
+      }});
 
   auto callback = [this, &setting, name](const rclcpp::Parameter & param) {
       setting = as<T>(param);
@@ -235,6 +440,21 @@ void ParametersHandler::setDynamicParamCallback(T & setting, const std::string &
 
   addDynamicParamCallback(name, callback);
 
+  // Values of another type would throw on conversion, and negative ones wrap around
+  addParamVerifier(
+    name, [name](const rclcpp::Parameter & param) {
+      const auto type = typeOf<T>();
+      if (type != rclcpp::ParameterType::PARAMETER_NOT_SET && param.get_type() != type) {
+        return name + " needs to be of type " + rclcpp::to_string(type);
+      }
+      if constexpr (std::is_unsigned_v<T> && !std::is_same_v<T, bool>) {
+        if (param.as_int() < 0) {
+          return name + " needs to be non-negative";
+        }
+      }
+      return std::string();
+    });
+
   if (verbose_) {
     RCLCPP_INFO(logger_, "Dynamic Parameter added %s", name.c_str());
   }
@@ -262,6 +482,30 @@ auto ParametersHandler::as(const rclcpp::Parameter & parameter)
   }
 }
 
+template<typename T>
+rclcpp::ParameterType ParametersHandler::typeOf()
+{
+  if constexpr (std::is_same_v<T, bool>) {
+    return rclcpp::ParameterType::PARAMETER_BOOL;
+  } else if constexpr (std::is_integral_v<T>) {
+    return rclcpp::ParameterType::PARAMETER_INTEGER;
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return rclcpp::ParameterType::PARAMETER_DOUBLE;
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    return rclcpp::ParameterType::PARAMETER_STRING;
+  } else if constexpr (std::is_same_v<T, std::vector<int64_t>>) {
+    return rclcpp::ParameterType::PARAMETER_INTEGER_ARRAY;
+  } else if constexpr (std::is_same_v<T, std::vector<double>>) {
+    return rclcpp::ParameterType::PARAMETER_DOUBLE_ARRAY;
+  } else if constexpr (std::is_same_v<T, std::vector<std::string>>) {
+    return rclcpp::ParameterType::PARAMETER_STRING_ARRAY;
+  } else if constexpr (std::is_same_v<T, std::vector<bool>>) {
+    return rclcpp::ParameterType::PARAMETER_BOOL_ARRAY;
+  } else {
+    return rclcpp::ParameterType::PARAMETER_NOT_SET;
+  }
+}
+
 }  // namespace mppi
 
 #endif  // MPPIC__TOOLS__PARAMETERS_HANDLER_HPP_
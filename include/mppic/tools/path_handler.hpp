@@ -15,20 +15,25 @@
 #ifndef MPPIC__TOOLS__PATH_HANDLER_HPP_
 #define MPPIC__TOOLS__PATH_HANDLER_HPP_
 
+#include <algorithm>
 #include <vector>
 #include <utility>
 #include <string>
 #include <memory>
+#include <optional>
 
 #include "rclcpp_lifecycle/lifecycle_node.hpp"
 #include "tf2_ros/buffer.h"
 #include "geometry_msgs/msg/pose_stamped.hpp"
+#include "geometry_msgs/msg/transform_stamped.hpp"
 #include "nav_msgs/msg/path.hpp"
 #include "builtin_interfaces/msg/time.hpp"
 #include "nav2_costmap_2d/costmap_2d_ros.hpp"
 #include "nav2_util/geometry_utils.hpp"
 
+#include "mppic/models/path.hpp"
 #include "mppic/tools/parameters_handler.hpp"
+#include "mppic/tools/trace_recorder.hpp"
 
 namespace mppi
 {
@@ -36,6 +41,32 @@ namespace mppi
 using PathIterator = std::vector<geometry_msgs::msg::PoseStamped>::iterator;
 using PathRange = std::pair<PathIterator, PathIterator>;
 
+/**
+ * @struct mppi::TransformCacheStats
+ * @brief Counts of the plan to costmap transform lookups served from the cache,
+ * looked up in TF, and failed, and of the plan poses transformed or reused from the
+ * previous cycles by incremental path handling
+ */
+struct TransformCacheStats
+{
+  size_t hits{0};
+  size_t misses{0};
+  size_t failures{0};
+  size_t transformed_poses{0};
+  size_t reused_poses{0};
+};
+
+/**
+ * @struct mppi::PlanarPose
+ * @brief Costmap frame position and yaw of a plan pose, as held by the path tensors
+ */
+struct PlanarPose
+{
+  float x;
+  float y;
+  float yaw;
+};
+
 /**
  * @class mppi::PathHandler
  * @brief Manager of incoming reference paths for transformation and processing
@@ -74,7 +105,13 @@ public:
   void setPath(const nav_msgs::msg::Path & plan);
 
   /**
-    * @brief Get reference path
+    * @brief Set new reference path, taking over its poses without copying them
+    * @param Plan Path to use
+    */
+  void setPath(nav_msgs::msg::Path && plan);
+
+  /**
+    * @brief Get reference path, without its pruned poses
     * @return Path
     */
   nav_msgs::msg::Path & getPath();
@@ -87,6 +124,28 @@ public:
    */
   nav_msgs::msg::Path transformPath(const geometry_msgs::msg::PoseStamped & robot_pose);
 
+  /**
+   * @brief transform global plan to local applying constraints straight into path
+   * tensors, with a single planar transform of the plan to the costmap frame,
+   * then prune global plan. With incremental path handling, only the poses newly
+   * entering the window are transformed while the transform is unchanged
+   * @param robot_pose Pose of robot
+   * @param path Path to fill in the costmap frame, only reallocated if its size changes
+   */
+  void transformPath(const geometry_msgs::msg::PoseStamped & robot_pose, models::Path & path);
+
+  /**
+   * @brief Get the stats of the plan to costmap transform cache
+   * @return Stats
+   */
+  const TransformCacheStats & getTransformCacheStats() const;
+
+  /**
+   * @brief Trace the path transforms into a timeline
+   * @param recorder Recorder to trace into, null to stop tracing
+   */
+  void setTraceRecorder(TraceRecorder * recorder);
+
 protected:
   /**
     * @brief Transform a pose to another frame
@@ -125,6 +184,116 @@ protected:
     PathIterator begin, PathIterator end,
     const builtin_interfaces::msg::Time & stamp);
 
+  /**
+    * @brief Transform a plan to the costmap reference frame, looking the transform up
+    * once and reusing the poses transformed in previous cycles while it is unchanged,
+    * so only the poses newly entering the window are transformed
+    * @param begin Start of path to transform
+    * @param end End of path to transform
+    * @param stamp Timestamp to use for transformation
+    * @return output path in costmap reference frame
+    */
+  nav_msgs::msg::Path
+  transformPlanPosesIncrementally(
+    PathIterator begin, PathIterator end,
+    const builtin_interfaces::msg::Time & stamp);
+
+  /**
+    * @brief Get the transform of the plan to the costmap frame, looked up in TF only
+    * once per stamp. The latest transform, asked for by a zero stamp, is always looked up
+    * @param stamp Timestamp to use for transformation
+    * @param transform Output transform
+    * @return Bool if successful
+    */
+  bool lookupPlanTransform(
+    const builtin_interfaces::msg::Time & stamp,
+    geometry_msgs::msg::TransformStamped & transform);
+
+  /**
+    * @brief Forget the poses transformed in previous cycles
+    */
+  void resetTransformCache();
+
+  /**
+   * @struct mppi::PathHandler::TransformedPoses
+   * @brief Costmap frame poses of the global plan poses from begin on, transformed
+   * alike in previous cycles. They are stored from start on, the cached poses before it
+   * being dropped, and compacted once mostly dropped, as the global plan is
+   */
+  template<typename PoseT>
+  struct TransformedPoses
+  {
+    std::vector<PoseT> poses;
+    size_t start{0};
+    size_t begin{0};
+    std::optional<geometry_msgs::msg::TransformStamped> transform;
+
+    size_t size() const {return poses.size() - start;}
+
+    const PoseT * data() const {return poses.data() + start;}
+
+    void clear()
+    {
+      poses.clear();
+      start = 0;
+      begin = 0;
+      transform.reset();
+    }
+
+    /**
+      * @brief Move the window to the global plan poses [first, last), keeping the cached
+      * ones it still holds if transformed by the same transform
+      * @param new_transform Transform of the plan to the costmap frame of this cycle
+      * @param first Index of the first global plan pose of the window
+      * @param last Index past the last global plan pose of the window
+      * @return Number of cached poses kept, those of the window after them are to be added
+      */
+    size_t advance(
+      const geometry_msgs::msg::TransformStamped & new_transform, size_t first, size_t last)
+    {
+      if (!transform || !isSameTransform(*transform, new_transform) ||
+        first < begin || first > begin + size())
+      {
+        clear();
+        begin = first;
+        transform = new_transform;
+      }
+
+      start += first - begin;
+      begin = first;
+      if (2 * start > poses.size()) {
+        poses.erase(poses.begin(), poses.begin() + start);
+        start = 0;
+      }
+      poses.resize(start + std::min(size(), last - first));
+      return size();
+    }
+
+    /**
+      * @brief Keep the cached poses aligned with the global plan once its leading poses
+      * are dropped, forgetting them if some of them were dropped
+      * @param count Number of leading poses dropped from the global plan
+      */
+    void dropPlanPoses(size_t count)
+    {
+      if (begin < count) {
+        clear();
+      } else {
+        begin -= count;
+      }
+    }
+  };
+
+  /**
+    * @brief Whether two transforms are the same, frames included
+    * @param a Transform
+    * @param b Transform
+    * @return Bool if the same
+    */
+  static bool isSameTransform(
+    const geometry_msgs::msg::TransformStamped & a,
+    const geometry_msgs::msg::TransformStamped & b);
+
   /**
     * @brief Get global plan within window of the local costmap size
     * @param global_pose Robot pose
@@ -138,17 +307,37 @@ protected:
     */
   void pruneGlobalPlan(const PathIterator end);
 
+  /**
+    * @brief Drop the pruned poses from the stored global plan
+    */
+  void compactGlobalPlan();
+
   std::string name_;
   std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_;
   std::shared_ptr<tf2_ros::Buffer> tf_buffer_;
   ParametersHandler * parameters_handler_;
 
   nav_msgs::msg::Path global_plan_;
+  // Poses of the global plan before this index are pruned
+  size_t plan_start_{0};
   rclcpp::Logger logger_{rclcpp::get_logger("MPPIController")};
 
   double max_robot_pose_search_dist_{0};
   double prune_distance_{0};
   double transform_tolerance_{0};
+  bool incremental_{false};
+
+  // Poses transformed in previous cycles by incremental path handling, as poses for
+  // the path message and planar poses for the path tensors
+  TransformedPoses<geometry_msgs::msg::PoseStamped> cached_poses_;
+  TransformedPoses<PlanarPose> cached_planar_poses_;
+
+  std::optional<geometry_msgs::msg::TransformStamped> plan_transform_;
+  builtin_interfaces::msg::Time plan_transform_stamp_;
+  TransformCacheStats transform_cache_stats_;
+
+  TraceRecorder * trace_recorder_{nullptr};
+  uint32_t trace_name_{0};
 };
 }  // namespace mppi
 
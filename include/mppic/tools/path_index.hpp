@@ -0,0 +1,107 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__PATH_INDEX_HPP_
+#define MPPIC__TOOLS__PATH_INDEX_HPP_
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "mppic/models/path.hpp"
+
+namespace mppi
+{
+
+/**
+ * @class mppi::PathIndex
+ * @brief Uniform grid over the points of a path for exact nearest path point queries.
+ * Built once per cycle and shared by the critics, so a query only visits the grid
+ * cells around the query point instead of the whole path
+ */
+class PathIndex
+{
+public:
+  /**
+   * @struct mppi::PathIndex::Nearest
+   * @brief Result of a nearest path point query
+   */
+  struct Nearest
+  {
+    size_t idx{0};
+    float dist_sq{std::numeric_limits<float>::max()};
+  };
+
+  /**
+    * @brief Constructor for mppi::PathIndex
+    */
+  PathIndex() = default;
+
+  /**
+    * @brief Index the points of a path, reusing the storage of a previous build
+    * @param path Path to index
+    */
+  void build(const models::Path & path);
+
+  /**
+    * @brief Find the nearest of the first `end` path points. Ties are broken towards
+    * the lowest index, like a linear scan over the path
+    * @param x X of the query point
+    * @param y Y of the query point
+    * @param end Number of leading path points to consider
+    * @return Index and squared distance of the nearest point, index 0 and
+    * max distance if no point is considered
+    */
+  Nearest nearest(float x, float y, size_t end) const;
+
+  /**
+    * @brief Find the nearest path point
+    * @param x X of the query point
+    * @param y Y of the query point
+    * @return Index and squared distance of the nearest point
+    */
+  Nearest nearest(float x, float y) const {return nearest(x, y, size_);}
+
+  /**
+    * @brief Number of indexed path points
+    * @return Size
+    */
+  size_t size() const {return size_;}
+
+  /**
+    * @brief Size of a grid cell
+    * @return Cell size in meters
+    */
+  float getCellSize() const {return cell_size_;}
+
+protected:
+  /**
+    * @brief Check the points of a cell against the current best
+    */
+  void scanCell(int cx, int cy, float x, float y, size_t end, Nearest & best) const;
+
+  size_t size_{0};
+  float min_x_{0}, min_y_{0};
+  float cell_size_{1}, inv_cell_size_{1};
+  int cells_x_{0}, cells_y_{0};
+
+  // Points sorted by cell, ascending index within a cell
+  std::vector<size_t> cell_starts_;
+  std::vector<size_t> ids_;
+  std::vector<float> xs_, ys_;
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__PATH_INDEX_HPP_
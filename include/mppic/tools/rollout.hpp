@@ -0,0 +1,234 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__ROLLOUT_HPP_
+#define MPPIC__TOOLS__ROLLOUT_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+#include <xsimd/xsimd.hpp>
+#include <xtensor/xtensor.hpp>
+#include <xtensor/xview.hpp>
+
+#include "mppic/models/state.hpp"
+#include "mppic/models/trajectories.hpp"
+#include "mppic/tools/fast_math.hpp"
+#include "mppic/tools/kernels.hpp"
+#include "mppic/tools/kernels_impl.hpp"
+#include "mppic/tools/tiled_tensor.hpp"
+#include "mppic/tools/utils.hpp"
+
+namespace mppi::rollout
+{
+
+namespace detail
+{
+
+using kernels::detail::wrapAndSincos;
+
+template<bool Holonomic, bool FastMath>
+inline void integrateTiles(
+  TiledTensor & x, TiledTensor & y, TiledTensor & yaws,
+  const TiledTensor & vx, const TiledTensor & vy, const TiledTensor & wz,
+  const geometry_msgs::msg::Pose & pose, size_t begin, size_t end, float model_dt,
+  const float * model_dts)
+{
+  using simd_t = TiledTensor::simd_t;
+
+  const double initial_yaw = tf2::getYaw(pose.orientation);
+  const simd_t yaw0(static_cast<float>(initial_yaw));
+  const simd_t x0(static_cast<float>(pose.position.x));
+  const simd_t y0(static_cast<float>(pose.position.y));
+
+  const size_t time_steps = vx.timeSteps();
+  for (size_t tile = begin; tile != end; tile++) {
+    simd_t yaw_cos(static_cast<float>(std::cos(initial_yaw)));
+    simd_t yaw_sin(static_cast<float>(std::sin(initial_yaw)));
+    simd_t yaw_sum(0.0f), x_sum(0.0f), y_sum(0.0f);
+
+    for (size_t t = 0; t != time_steps; t++) {
+      const simd_t dt(model_dts ? model_dts[t] : model_dt);
+      const simd_t v = vx.load(tile, t);
+      simd_t dx = v * yaw_cos;
+      simd_t dy = v * yaw_sin;
+
+      if constexpr (Holonomic) {
+        const simd_t lateral = vy.load(tile, t);
+        dx = dx - lateral * yaw_sin;
+        dy = dy + lateral * yaw_cos;
+      }
+
+      x_sum = x_sum + dx * dt;
+      y_sum = y_sum + dy * dt;
+      yaw_sum = yaw_sum + wz.load(tile, t) * dt;
+
+      const simd_t yaw = wrapAndSincos<FastMath>(yaw_sum + yaw0, yaw_sin, yaw_cos);
+      x.store(tile, t, x_sum + x0);
+      y.store(tile, t, y_sum + y0);
+      yaws.store(tile, t, yaw);
+    }
+  }
+}
+
+}  // namespace detail
+
+/**
+ * @brief Rollout velocities in state to poses for a range of trajectories.
+ * Fused kernel vectorized across trajectories: each trajectory's running yaw, x and y
+ * are kept in registers and x, y, yaws are written in one pass over time
+ * @param trajectories to rollout, already sized to the state
+ * @param state fill state
+ * @param begin First trajectory of the range
+ * @param end Past-the-end trajectory of the range
+ * @param model_dt Time step of the model
+ * @param is_holonomic Whether the lateral velocity should be integrated
+ * @param fast_math Whether to wrap yaws and take their sine and cosine with fast_math
+ * @param model_dts Time step of each point, or nullptr for a uniform model_dt
+ * @param kernel_set Kernels to run, or nullptr for the baseline ones
+ */
+inline void integrate(
+  models::Trajectories & trajectories, const models::State & state,
+  size_t begin, size_t end, float model_dt, bool is_holonomic, bool fast_math = false,
+  const float * model_dts = nullptr, const kernels::KernelSet * kernel_set = nullptr)
+{
+  const double initial_yaw = tf2::getYaw(state.pose.pose.orientation);
+  const bool yaw_trig = trajectories.hasYawTrig();
+
+  kernels::RolloutView view;
+  view.vx = state.vx.data();
+  view.vy = state.vy.data();
+  view.wz = state.wz.data();
+  view.x = trajectories.x.data();
+  view.y = trajectories.y.data();
+  view.yaws = trajectories.yaws.data();
+  view.yaw_cos = yaw_trig ? trajectories.yaw_cos.data() : nullptr;
+  view.yaw_sin = yaw_trig ? trajectories.yaw_sin.data() : nullptr;
+  view.time_steps = state.vx.shape(1);
+  view.x0 = static_cast<float>(state.pose.pose.position.x);
+  view.y0 = static_cast<float>(state.pose.pose.position.y);
+  view.yaw0 = static_cast<float>(initial_yaw);
+  view.cos0 = static_cast<float>(std::cos(initial_yaw));
+  view.sin0 = static_cast<float>(std::sin(initial_yaw));
+  view.model_dt = model_dt;
+  view.model_dts = model_dts;
+
+  kernels::integrate(
+    kernel_set ? *kernel_set : kernels::baselineKernels(), view, begin, end, is_holonomic,
+    fast_math);
+}
+
+/**
+ * @brief Rollout tiled velocities to tiled poses for a range of tiles. Same kernel as
+ * integrate, but a time step of a tile is a single aligned load or store instead of
+ * a gather or scatter across trajectory rows
+ * @param x Tiled x of the trajectories, already sized to the velocities
+ * @param y Tiled y of the trajectories, already sized to the velocities
+ * @param yaws Tiled yaws of the trajectories, already sized to the velocities
+ * @param vx Tiled longitudinal velocities
+ * @param vy Tiled lateral velocities, only read if holonomic
+ * @param wz Tiled angular velocities
+ * @param pose Initial pose of the trajectories
+ * @param begin First tile of the range
+ * @param end Past-the-end tile of the range
+ * @param model_dt Time step of the model
+ * @param is_holonomic Whether the lateral velocity should be integrated
+ * @param fast_math Whether to wrap yaws and take their sine and cosine with fast_math
+ * @param model_dts Time step of each point, or nullptr for a uniform model_dt
+ */
+inline void integrateTiles(
+  TiledTensor & x, TiledTensor & y, TiledTensor & yaws,
+  const TiledTensor & vx, const TiledTensor & vy, const TiledTensor & wz,
+  const geometry_msgs::msg::Pose & pose, size_t begin, size_t end, float model_dt,
+  bool is_holonomic, bool fast_math = false, const float * model_dts = nullptr)
+{
+  const float dt = model_dt;
+  const float * dts = model_dts;
+  if (is_holonomic && fast_math) {
+    detail::integrateTiles<true, true>(x, y, yaws, vx, vy, wz, pose, begin, end, dt, dts);
+  } else if (is_holonomic) {
+    detail::integrateTiles<true, false>(x, y, yaws, vx, vy, wz, pose, begin, end, dt, dts);
+  } else if (fast_math) {
+    detail::integrateTiles<false, true>(x, y, yaws, vx, vy, wz, pose, begin, end, dt, dts);
+  } else {
+    detail::integrateTiles<false, false>(x, y, yaws, vx, vy, wz, pose, begin, end, dt, dts);
+  }
+}
+
+/**
+ * @brief Reference rollout of velocities in state to poses for a range of trajectories,
+ * one full-tensor pass per operation. Used to validate the fused kernel
+ * @param trajectories to rollout, already sized to the state
+ * @param state fill state
+ * @param begin First trajectory of the range
+ * @param end Past-the-end trajectory of the range
+ * @param model_dt Time step of the model
+ * @param is_holonomic Whether the lateral velocity should be integrated
+ * @param model_dts Time step of each point, or nullptr for a uniform model_dt
+ */
+inline void integrateReference(
+  models::Trajectories & trajectories, const models::State & state,
+  size_t begin, size_t end, float model_dt, bool is_holonomic,
+  const float * model_dts = nullptr)
+{
+  using namespace xt::placeholders;  // NOLINT
+
+  const double initial_yaw = tf2::getYaw(state.pose.pose.orientation);
+  const auto rows = xt::range(begin, end);
+
+  auto dts = xt::xtensor<float, 1>::from_shape({state.vx.shape(1)});
+  if (model_dts) {
+    std::copy(model_dts, model_dts + dts.size(), dts.begin());
+  } else {
+    dts.fill(model_dt);
+  }
+
+  const auto vx = xt::view(state.vx, rows, xt::all());
+  const auto vy = xt::view(state.vy, rows, xt::all());
+  const auto wz = xt::view(state.wz, rows, xt::all());
+
+  auto traj_x = xt::view(trajectories.x, rows, xt::all());
+  auto traj_y = xt::view(trajectories.y, rows, xt::all());
+  auto traj_yaws = xt::view(trajectories.yaws, rows, xt::all());
+
+  xt::noalias(traj_yaws) =
+    utils::normalize_angles(xt::cumsum(wz * dts, 1) + initial_yaw);
+
+  const auto yaws_cutted = xt::view(traj_yaws, xt::all(), xt::range(0, -1));
+
+  const std::array<size_t, 2> shape = {end - begin, state.vx.shape(1)};
+  auto && yaw_cos = xt::xtensor<float, 2>::from_shape(shape);
+  auto && yaw_sin = xt::xtensor<float, 2>::from_shape(shape);
+  xt::noalias(xt::view(yaw_cos, xt::all(), 0)) = std::cos(initial_yaw);
+  xt::noalias(xt::view(yaw_sin, xt::all(), 0)) = std::sin(initial_yaw);
+  xt::noalias(xt::view(yaw_cos, xt::all(), xt::range(1, _))) = xt::cos(yaws_cutted);
+  xt::noalias(xt::view(yaw_sin, xt::all(), xt::range(1, _))) = xt::sin(yaws_cutted);
+
+  auto && dx = xt::eval(vx * yaw_cos);
+  auto && dy = xt::eval(vx * yaw_sin);
+
+  if (is_holonomic) {
+    dx = dx - vy * yaw_sin;
+    dy = dy + vy * yaw_cos;
+  }
+
+  xt::noalias(traj_x) = state.pose.pose.position.x + xt::cumsum(dx * dts, 1);
+  xt::noalias(traj_y) = state.pose.pose.position.y + xt::cumsum(dy * dts, 1);
+}
+
+}  // namespace mppi::rollout
+
+#endif  // MPPIC__TOOLS__ROLLOUT_HPP_
@@ -0,0 +1,110 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__SAVITZKY_GOLAY_HPP_
+#define MPPIC__TOOLS__SAVITZKY_GOLAY_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+namespace mppi::utils
+{
+
+/**
+ * @struct mppi::utils::SavitzkyGolayCoefficients
+ * @brief Quadratic Savitzky-Golay smoothing coefficients of a 5, 7 or 9 point window
+ */
+template<unsigned int Window>
+struct SavitzkyGolayCoefficients;
+
+template<>
+struct SavitzkyGolayCoefficients<5>
+{
+  static constexpr std::array<float, 5> values =
+  {-3.0f / 35.0f, 12.0f / 35.0f, 17.0f / 35.0f, 12.0f / 35.0f, -3.0f / 35.0f};
+};
+
+template<>
+struct SavitzkyGolayCoefficients<7>
+{
+  static constexpr std::array<float, 7> values =
+  {-2.0f / 21.0f, 3.0f / 21.0f, 6.0f / 21.0f, 7.0f / 21.0f, 6.0f / 21.0f, 3.0f / 21.0f,
+    -2.0f / 21.0f};
+};
+
+template<>
+struct SavitzkyGolayCoefficients<9>
+{
+  static constexpr std::array<float, 9> values =
+  {-21.0f / 231.0f, 14.0f / 231.0f, 39.0f / 231.0f, 54.0f / 231.0f, 59.0f / 231.0f,
+    54.0f / 231.0f, 39.0f / 231.0f, 14.0f / 231.0f, -21.0f / 231.0f};
+};
+
+/**
+ * @brief Smooth the axes of a sequence together, in place and without allocating.
+ * Each point is smoothed from the already smoothed points before it, preceded by the
+ * history, and the points after it, the last one repeated past the end
+ * @param sequences Axes to smooth, each of size points
+ * @param history Per axis, the Window / 2 points preceding the sequence, oldest first
+ * @param size Number of points of each axis
+ */
+template<unsigned int Window, size_t Axes>
+inline void savitzkyGolaySmooth(
+  const std::array<float *, Axes> & sequences,
+  const std::array<std::array<float, Window / 2>, Axes> & history, size_t size)
+{
+  constexpr auto & coefficients = SavitzkyGolayCoefficients<Window>::values;
+  constexpr int half = Window / 2;
+  const int points = static_cast<int>(size);
+
+  // Points whose window reaches past either end of the sequence
+  auto smoothEdge = [&](int idx) {
+      for (size_t axis = 0; axis != Axes; axis++) {
+        float value = 0.0f;
+        for (int k = 0; k != static_cast<int>(Window); k++) {
+          const int j = idx + k - half;
+          const float sample = j < 0 ?
+            history[axis][half + j] : sequences[axis][std::min(j, points - 1)];
+          value += coefficients[k] * sample;
+        }
+        sequences[axis][idx] = value;
+      }
+    };
+
+  const int interior_begin = std::min(half, points);
+  const int interior_end = std::max(points - half, interior_begin);
+  for (int idx = 0; idx != interior_begin; idx++) {
+    smoothEdge(idx);
+  }
+
+  for (int idx = interior_begin; idx != interior_end; idx++) {
+    for (size_t axis = 0; axis != Axes; axis++) {
+      const float * window = sequences[axis] + idx - half;
+      float value = 0.0f;
+      for (int k = 0; k != static_cast<int>(Window); k++) {
+        value += coefficients[k] * window[k];
+      }
+      sequences[axis][idx] = value;
+    }
+  }
+
+  for (int idx = interior_end; idx != points; idx++) {
+    smoothEdge(idx);
+  }
+}
+
+}  // namespace mppi::utils
+
+#endif  // MPPIC__TOOLS__SAVITZKY_GOLAY_HPP_
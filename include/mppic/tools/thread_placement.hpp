@@ -0,0 +1,56 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__THREAD_PLACEMENT_HPP_
+#define MPPIC__TOOLS__THREAD_PLACEMENT_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mppic/models/thread_placement.hpp"
+
+namespace mppi
+{
+
+/**
+ * @brief Placement from its parameters, throws if they are not valid
+ * @param cpus CPUs the thread may run on, empty for those it inherits
+ * @param scheduling Scheduling policy, "other" or "fifo"
+ * @param priority Real-time priority if "fifo", nice value otherwise
+ * @return Placement
+ */
+models::ThreadPlacement makeThreadPlacement(
+  const std::vector<int64_t> & cpus, const std::string & scheduling, int priority);
+
+/**
+ * @brief Pin the calling thread to the CPUs of a placement and set its scheduling.
+ * Placements the process is not permitted, as real-time scheduling often is, are
+ * reported rather than thrown, so that the controller still runs
+ * @param placement Placement to apply
+ * @param report Placement the thread ended up with, and what could not be applied
+ * @return False if any of the placement could not be applied
+ */
+bool applyThreadPlacement(const models::ThreadPlacement & placement, std::string & report);
+
+/**
+ * @brief Describe the placement of the calling thread: the CPUs it may run on, their
+ * NUMA nodes, and its scheduling policy and priority
+ * @return Description
+ */
+std::string describeThreadPlacement();
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__THREAD_PLACEMENT_HPP_
@@ -0,0 +1,161 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__THREAD_POOL_HPP_
+#define MPPIC__TOOLS__THREAD_POOL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mppic/models/thread_placement.hpp"
+
+namespace mppi
+{
+
+/**
+ * @class mppi::ThreadPool
+ * @brief Fixed set of worker threads splitting the trajectory batch into
+ * contiguous chunks. The calling thread always processes chunks as well, so a pool
+ * of size 1 has no workers and runs everything inline.
+ */
+class ThreadPool
+{
+public:
+  /**
+    * @brief Constructor for mppi::ThreadPool
+    */
+  ThreadPool() = default;
+
+  /**
+    * @brief Destructor for mppi::ThreadPool
+    */
+  ~ThreadPool() {shutdown();}
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  /**
+    * @brief Start worker threads
+    * @param num_threads Total number of threads to use, including the caller.
+    * 0 selects the hardware concurrency
+    * @param placement CPUs and scheduling the workers apply as they start
+    */
+  void initialize(unsigned int num_threads, const models::ThreadPlacement & placement = {});
+
+  /**
+    * @brief Stop and join worker threads
+    */
+  void shutdown();
+
+  /**
+    * @brief Number of threads processing chunks, including the caller
+    * @return Pool size
+    */
+  size_t size() const {return workers_.size() + 1;}
+
+  /**
+    * @brief Placement each worker ended up with when it started
+    * @return Reports, one per worker
+    */
+  const std::vector<models::ThreadPlacementReport> & getPlacementReports() const
+  {
+    return placement_reports_;
+  }
+
+  /**
+    * @brief Split [0, size) into at most `size()` contiguous chunks and
+    * process them concurrently, blocking until all chunks are done. The first exception
+    * thrown by a chunk, on any thread, is rethrown once all threads are done; chunks not
+    * yet started are then skipped
+    * @param size Number of elements (e.g. trajectories) to split
+    * @param func Callable with signature void(size_t begin, size_t end)
+    */
+  template<typename Func>
+  void parallelFor(size_t size, Func && func)
+  {
+    const size_t num_chunks = std::min(this->size(), size);
+    if (num_chunks <= 1) {
+      func(size_t{0}, size);
+      return;
+    }
+
+    auto job = [&](size_t chunk) {
+        func(chunk * size / num_chunks, (chunk + 1) * size / num_chunks);
+      };
+    run(num_chunks, &invoke<decltype(job)>, &job);
+  }
+
+protected:
+  using job_t = void (*)(void * context, size_t chunk);
+
+  /**
+    * @brief Type-erased trampoline to call a job without heap allocation
+    */
+  template<typename Job>
+  static void invoke(void * context, size_t chunk)
+  {
+    (*static_cast<Job *>(context))(chunk);
+  }
+
+  /**
+    * @brief Publish a job to the workers and process chunks until done
+    * @param num_chunks Number of chunks in the job
+    * @param job Function to call per chunk
+    * @param context Opaque job state
+    */
+  void run(size_t num_chunks, job_t job, void * context);
+
+  /**
+    * @brief Claim and process chunks of the current job until none are left, keeping
+    * the first exception thrown
+    */
+  void processChunks();
+
+  /**
+    * @brief Worker thread waiting for jobs
+    * @param index Index of the worker
+    * @param seen_generation Job generation at the time the worker was started
+    * @param placement Placement to apply before waiting for jobs
+    */
+  void workerThread(
+    size_t index, size_t seen_generation, const models::ThreadPlacement & placement);
+
+  std::vector<std::thread> workers_;
+  std::mutex lock_;
+  std::condition_variable start_cond_;
+  std::condition_variable done_cond_;
+
+  job_t job_{nullptr};
+  void * job_context_{nullptr};
+  size_t num_chunks_{0};
+  std::atomic<size_t> next_chunk_{0};
+  size_t pending_workers_{0};
+  size_t generation_{0};
+  // First exception thrown by a chunk of the current job, guarded by the lock
+  std::exception_ptr job_error_;
+  bool active_{false};
+
+  std::vector<models::ThreadPlacementReport> placement_reports_;
+  size_t started_workers_{0};
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__THREAD_POOL_HPP_
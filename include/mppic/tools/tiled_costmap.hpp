@@ -0,0 +1,184 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__TILED_COSTMAP_HPP_
+#define MPPIC__TOOLS__TILED_COSTMAP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "mppic/tools/costmap_snapshot.hpp"
+#include "mppic/tools/distance_field.hpp"
+#include "mppic/tools/half.hpp"
+
+namespace mppi
+{
+
+/**
+ * @class mppi::TiledCostmap
+ * @brief Compact mirror of a costmap and its distance field, stored in square tiles laid
+ * out in Morton order, so that the lookups of nearby rollout points land in the same few
+ * cache lines whichever way the trajectories head. Costs are kept as bytes and distances
+ * as half precision floats, half the size of the distance field's
+ */
+class TiledCostmap
+{
+public:
+  // Same tiles as the snapshot's, so that its changed tiles are copied one to one
+  static constexpr unsigned int tile_size = CostmapSnapshot::tile_size;
+
+  /**
+    * @brief Constructor for mppi::TiledCostmap
+    */
+  TiledCostmap() = default;
+
+  /**
+    * @brief Copy the tiles of the snapshot changed since the last update, or the whole
+    * snapshot if its geometry changed
+    * @param snapshot Costmap snapshot to mirror
+    * @return True if anything was copied
+    */
+  bool update(const CostmapSnapshot & snapshot);
+
+  /**
+    * @brief Copy the whole costmap, which has no record of its changes
+    * @param costmap Costmap to mirror
+    */
+  void update(const nav2_costmap_2d::Costmap2D & costmap);
+
+  /**
+    * @brief Copy the distances of a field built from the mirrored costmap
+    * @param field Distance field of the same geometry as the costmap
+    */
+  void updateDistances(const DistanceField & field);
+
+  /**
+    * @brief Cost of a cell
+    * @param mx Cell X index
+    * @param my Cell Y index
+    * @return Cost
+    */
+  unsigned char costAtCell(unsigned int mx, unsigned int my) const
+  {
+    return costs_[index(mx, my)];
+  }
+
+  /**
+    * @brief Cost at a world point
+    * @param wx X in world frame
+    * @param wy Y in world frame
+    * @param outside_cost Cost outside of the map
+    * @return Cost
+    */
+  unsigned char cost(float wx, float wy, unsigned char outside_cost) const
+  {
+    unsigned int mx, my;
+    return worldToMap(wx, wy, mx, my) ? costAtCell(mx, my) : outside_cost;
+  }
+
+  /**
+    * @brief Distance from a world point to the nearest obstacle cell center, as given by
+    * the distance field, to the relative precision of half floats
+    * @param wx X in world frame
+    * @param wy Y in world frame
+    * @return Distance in meters
+    */
+  float distance(float wx, float wy) const
+  {
+    unsigned int mx, my;
+    return worldToMap(wx, wy, mx, my) ?
+           halfToFloat(distances_[index(mx, my)]) : outside_distance_;
+  }
+
+  /**
+    * @brief Whether distances were copied since the geometry last changed
+    * @return True if distances are valid
+    */
+  bool hasDistances() const {return has_distances_;}
+
+  /**
+    * @brief Number of cells copied by the last update
+    * @return Copied cell count
+    */
+  size_t getCopiedCells() const {return copied_cells_;}
+
+  /**
+    * @brief Bytes held by the mirrored costs and distances
+    * @return Bytes
+    */
+  size_t getMemoryUsage() const;
+
+  /**
+    * @brief Interleave the bits of tile coordinates, for tiles close in both axes to have
+    * close indices
+    * @param tx Tile X index
+    * @param ty Tile Y index
+    * @return Morton code
+    */
+  static uint32_t mortonCode(uint16_t tx, uint16_t ty);
+
+protected:
+  /**
+    * @brief Position of a cell in the mirror: its tile's offset, then row major in the tile
+    */
+  size_t index(unsigned int mx, unsigned int my) const
+  {
+    return tile_offsets_[(my / tile_size) * tiles_x_ + mx / tile_size] +
+           (my % tile_size) * tile_size + mx % tile_size;
+  }
+
+  bool worldToMap(float wx, float wy, unsigned int & mx, unsigned int & my) const
+  {
+    const float fx = (wx - origin_x_) * inv_resolution_;
+    const float fy = (wy - origin_y_) * inv_resolution_;
+    if (fx < 0.0f || fy < 0.0f || fx >= size_x_ || fy >= size_y_) {
+      return false;
+    }
+    mx = static_cast<unsigned int>(fx);
+    my = static_cast<unsigned int>(fy);
+    return true;
+  }
+
+  /**
+    * @brief Lay out the tiles of a costmap geometry, returns false if it did not change
+    */
+  bool resize(const nav2_costmap_2d::Costmap2D & costmap);
+
+  /**
+    * @brief Copy the costs of a tile from the costmap
+    */
+  void copyTile(const nav2_costmap_2d::Costmap2D & costmap, unsigned int tx, unsigned int ty);
+
+  // Padded to whole tiles, the padding is never looked up
+  std::vector<unsigned char> costs_;
+  std::vector<uint16_t> distances_;
+  std::vector<size_t> tile_offsets_;
+
+  unsigned int size_x_{0}, size_y_{0};
+  unsigned int tiles_x_{0}, tiles_y_{0};
+  float origin_x_{0}, origin_y_{0};
+  float resolution_{0}, inv_resolution_{0};
+  float outside_distance_{0};
+  bool has_distances_{false};
+
+  // Version of the snapshot mirrored, 0 if none
+  uint64_t snapshot_version_{0};
+  size_t copied_cells_{0};
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__TILED_COSTMAP_HPP_
@@ -0,0 +1,150 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__TILED_TENSOR_HPP_
+#define MPPIC__TOOLS__TILED_TENSOR_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include <xsimd/xsimd.hpp>
+#include <xtensor/xtensor.hpp>
+
+namespace mppi
+{
+
+/**
+ * @class mppi::TiledTensor
+ * @brief Batch x time tensor laid out in tiles of tile_size trajectories, each tile
+ * interleaving its trajectories time step by time step. A time step of a tile is then
+ * one aligned SIMD register, so per time step kernels load it directly instead of
+ * gathering across rows, and a tile of a few kilobytes stays cache resident while it
+ * is rolled out and scored. The last tile is padded with zeros
+ */
+class TiledTensor
+{
+public:
+  using simd_t = xsimd::batch<float>;
+  static constexpr size_t tile_size = simd_t::size;
+
+  /**
+    * @brief Constructor for mppi::TiledTensor
+    */
+  TiledTensor() = default;
+
+  /**
+    * @brief Size the tensor, reusing its storage when large enough, and zero it
+    * @param batch_size Number of trajectories
+    * @param time_steps Number of time steps
+    */
+  void reset(size_t batch_size, size_t time_steps);
+
+  /**
+    * @brief Copy a row-major batch x time tensor in, sizing the tiles to it
+    * @param tensor Tensor to copy
+    */
+  template<typename Tensor>
+  void pack(const Tensor & tensor) {pack(tensor.data(), tensor.shape(0), tensor.shape(1));}
+
+  /**
+    * @brief Copy row-major batch x time values in, sizing the tiles to them
+    * @param data Values to copy
+    * @param batch_size Number of trajectories
+    * @param time_steps Number of time steps
+    */
+  void pack(const float * data, size_t batch_size, size_t time_steps);
+
+  /**
+    * @brief Copy out to a row-major batch x time tensor, sized to the tiles
+    * @param tensor Tensor to fill
+    */
+  template<typename Tensor>
+  void unpack(Tensor & tensor) const
+  {
+    if (tensor.shape(0) != batch_size_ || tensor.shape(1) != time_steps_) {
+      tensor.resize({batch_size_, time_steps_});
+    }
+    unpack(tensor.data());
+  }
+
+  /**
+    * @brief Copy out to row-major batch x time values, of the size of the tiles
+    * @param data Values to fill
+    */
+  void unpack(float * data) const;
+
+  /**
+    * @brief Number of trajectories
+    * @return Batch size
+    */
+  size_t batchSize() const {return batch_size_;}
+
+  /**
+    * @brief Number of time steps
+    * @return Time steps
+    */
+  size_t timeSteps() const {return time_steps_;}
+
+  /**
+    * @brief Number of tiles, the last one possibly partial
+    * @return Tile count
+    */
+  size_t tiles() const {return (batch_size_ + tile_size - 1) / tile_size;}
+
+  /**
+    * @brief Values of a tile at a time step, one per trajectory of the tile
+    * @param tile Tile index
+    * @param t Time step
+    * @return Pointer to tile_size aligned values
+    */
+  float * at(size_t tile, size_t t) {return data_.data() + (tile * time_steps_ + t) * tile_size;}
+  const float * at(size_t tile, size_t t) const
+  {
+    return data_.data() + (tile * time_steps_ + t) * tile_size;
+  }
+
+  /**
+    * @brief Load the values of a tile at a time step
+    * @param tile Tile index
+    * @param t Time step
+    * @return SIMD register of values
+    */
+  simd_t load(size_t tile, size_t t) const {return simd_t::load_aligned(at(tile, t));}
+
+  /**
+    * @brief Store the values of a tile at a time step
+    * @param tile Tile index
+    * @param t Time step
+    * @param values SIMD register of values
+    */
+  void store(size_t tile, size_t t, const simd_t & values) {values.store_aligned(at(tile, t));}
+
+  /**
+    * @brief Element access by trajectory and time step
+    * @param i Trajectory
+    * @param t Time step
+    * @return Reference to the element
+    */
+  float & operator()(size_t i, size_t t) {return at(i / tile_size, t)[i % tile_size];}
+  float operator()(size_t i, size_t t) const {return at(i / tile_size, t)[i % tile_size];}
+
+protected:
+  size_t batch_size_{0};
+  size_t time_steps_{0};
+  std::vector<float, xsimd::aligned_allocator<float>> data_;
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__TILED_TENSOR_HPP_
@@ -0,0 +1,220 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__TRACE_RECORDER_HPP_
+#define MPPIC__TOOLS__TRACE_RECORDER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mppi
+{
+
+/**
+ * @struct mppi::TraceEvent
+ * @brief Span of time a thread spent in a named stage
+ */
+struct TraceEvent
+{
+  uint32_t name{0};
+  uint32_t thread{0};
+  int64_t begin_ns{0};
+  int64_t duration_ns{0};
+};
+
+/**
+ * @class mppi::TraceRecorder
+ * @brief Optional timeline of the stages run by every thread, dumped in the Chrome
+ * trace event JSON format that Perfetto and chrome://tracing open. Each thread writes
+ * into its own ring of the last events, without locks once it recorded its first event.
+ * Disabled, recording is a single relaxed load
+ */
+class TraceRecorder
+{
+public:
+  /**
+    * @brief Constructor for mppi::TraceRecorder
+    */
+  TraceRecorder();
+
+  /**
+    * @brief Start or stop recording
+    * @param enabled Whether events are recorded
+    */
+  void setEnabled(bool enabled) {enabled_.store(enabled, std::memory_order_relaxed);}
+
+  /**
+    * @brief Whether events are recorded
+    * @return True if enabled
+    */
+  bool isEnabled() const {return enabled_.load(std::memory_order_relaxed);}
+
+  /**
+    * @brief Number of events each thread keeps, applied to the threads which did not
+    * record yet
+    * @param size Events per thread
+    */
+  void setBufferSize(size_t size);
+
+  /**
+    * @brief Register a stage name, or find an already registered one
+    * @param name Name of the stage
+    * @return Id to record with
+    */
+  uint32_t addName(const std::string & name);
+
+  /**
+    * @brief Name the calling thread in the timeline, if recording
+    * @param name Thread name
+    */
+  void nameThread(const std::string & name);
+
+  /**
+    * @brief Record a span of the calling thread, if recording
+    * @param name Name id
+    * @param begin Start of the span
+    * @param end End of the span
+    */
+  void record(
+    uint32_t name, std::chrono::steady_clock::time_point begin,
+    std::chrono::steady_clock::time_point end)
+  {
+    if (!isEnabled()) {
+      return;
+    }
+    ThreadBuffer & buffer = threadBuffer();
+    const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    TraceEvent & event = buffer.events[head % buffer.events.size()];
+    event.name = name;
+    event.thread = buffer.thread;
+    event.begin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - epoch_).count();
+    event.duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    buffer.head.store(head + 1, std::memory_order_release);
+  }
+
+  /**
+    * @brief Events still held by the threads' rings, oldest first for each thread.
+    * Events overwritten while collected are dropped
+    * @return Events
+    */
+  std::vector<TraceEvent> collect() const;
+
+  /**
+    * @brief Name of a registered stage
+    * @param name Name id
+    * @return Name
+    */
+  std::string getName(uint32_t name) const;
+
+  /**
+    * @brief Write the held events as a Chrome trace event JSON document
+    * @param stream Stream to write to
+    * @return Number of events written
+    */
+  size_t writeJson(std::ostream & stream) const;
+
+  /**
+    * @brief Write the held events to a Chrome trace event JSON file
+    * @param file_path File to write
+    * @return Number of events written, throws if the file cannot be written
+    */
+  size_t dump(const std::string & file_path) const;
+
+protected:
+  /**
+   * @struct mppi::TraceRecorder::ThreadBuffer
+   * @brief Ring of the last events of a thread, written by that thread alone
+   */
+  struct ThreadBuffer
+  {
+    std::thread::id id;
+    uint32_t thread{0};
+    std::string name;
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> head{0};
+  };
+
+  /**
+    * @brief Ring of the calling thread, registered on its first event
+    */
+  ThreadBuffer & threadBuffer();
+
+  /**
+    * @brief Find or register the ring of the calling thread
+    */
+  ThreadBuffer & registerThread();
+
+  const uint64_t id_;
+  const std::chrono::steady_clock::time_point epoch_;
+  std::atomic<bool> enabled_{false};
+
+  // Guards the registration of names and threads, never taken by recording threads
+  // which already have a ring
+  mutable std::mutex lock_;
+  size_t buffer_size_{65536};
+  std::vector<std::string> names_;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+/**
+ * @class mppi::ScopedTrace
+ * @brief Records the span from construction to destruction into a trace recorder.
+ * A null or disabled recorder makes it a no-op
+ */
+class ScopedTrace
+{
+public:
+  /**
+    * @brief Constructor for mppi::ScopedTrace, starting the span
+    * @param recorder Recorder to record into, may be null
+    * @param name Name id to record with
+    */
+  ScopedTrace(TraceRecorder * recorder, uint32_t name)
+  : recorder_(recorder && recorder->isEnabled() ? recorder : nullptr), name_(name)
+  {
+    if (recorder_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  /**
+    * @brief Destructor for mppi::ScopedTrace, recording the span
+    */
+  ~ScopedTrace()
+  {
+    if (recorder_) {
+      recorder_->record(name_, start_, std::chrono::steady_clock::now());
+    }
+  }
+
+  ScopedTrace(const ScopedTrace &) = delete;
+  ScopedTrace & operator=(const ScopedTrace &) = delete;
+
+protected:
+  TraceRecorder * recorder_;
+  uint32_t name_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__TRACE_RECORDER_HPP_
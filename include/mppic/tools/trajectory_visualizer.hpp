@@ -15,8 +15,15 @@
 #ifndef MPPIC__TOOLS__TRAJECTORY_VISUALIZER_HPP_
 #define MPPIC__TOOLS__TRAJECTORY_VISUALIZER_HPP_
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
+#include <vector>
 #include <xtensor/xtensor.hpp>
 
 #include "nav_msgs/msg/path.hpp"
@@ -25,7 +32,9 @@
 #include "tf2_geometry_msgs/tf2_geometry_msgs.hpp"
 
 #include "mppic/tools/parameters_handler.hpp"
+#include "mppic/tools/trace_recorder.hpp"
 #include "mppic/tools/utils.hpp"
+#include "mppic/models/path.hpp"
 #include "mppic/models/trajectories.hpp"
 
 namespace mppi
@@ -33,7 +42,14 @@ namespace mppi
 
 /**
  * @class mppi::TrajectoryVisualizer
- * @brief Visualizes trajectories for debugging
+ * @brief Visualizes trajectories for debugging. Trajectories are either drawn as
+ * one sphere marker per point, or as one line strip marker per trajectory with per
+ * vertex colors. Markers are only built when they have subscribers and are due by
+ * the publish rate, and their storage is reused from cycle to cycle.
+ *
+ * Added trajectories are copied, downsampled, to a frame. In async mode, frames are
+ * handed to a publisher thread through a triple buffer: the caller never waits, and
+ * a frame not yet taken when the next one is handed off is dropped
  */
 class TrajectoryVisualizer
 {
@@ -43,6 +59,11 @@ public:
     */
   TrajectoryVisualizer() = default;
 
+  /**
+    * @brief Destructor for mppi::TrajectoryVisualizer, stopping the publisher thread
+    */
+  ~TrajectoryVisualizer() {stopPublisherThread();}
+
   /**
     * @brief Configure trajectory visualizer
     * @param parent WeakPtr to node
@@ -81,30 +102,163 @@ public:
     */
   void add(const models::Trajectories & trajectories);
 
+  /**
+    * @brief Add candidate trajectories to visualize, with a given step between them
+    * @param trajectories Candidate trajectories
+    * @param trajectory_step Step between trajectories to visualize, 1 for all of them
+    */
+  void add(const models::Trajectories & trajectories, size_t trajectory_step);
+
+  /**
+    * @brief Number of lowest cost trajectories to visualize instead of every
+    * trajectory_step-th one
+    * @return Trajectory count, 0 to visualize every trajectory_step-th one
+    */
+  size_t getTopTrajectoriesCount() const {return top_trajectories_;}
+
+  /**
+    * @brief Whether trajectories added this cycle will be published: they have
+    * subscribers and are due by the publish rate. Decided once per cycle
+    * @return Whether to add trajectories
+    */
+  bool shouldVisualizeTrajectories();
+
   /**
     * @brief Visualize the plan
     * @param plan Plan to visualize
     */
   void visualize(const nav_msgs::msg::Path & plan);
 
+  /**
+    * @brief Visualize the plan, only building its message if it has subscribers
+    * @param plan Plan to visualize, in the visualizer's frame
+    * @param stamp Timestamp of the plan
+    */
+  void visualize(const models::Path & plan, const builtin_interfaces::msg::Time & stamp);
+
   /**
     * @brief Reset object
     */
   void reset();
 
+  /**
+    * @brief Number of frames dropped in async mode, handed off before the publisher
+    * thread took the previous one
+    * @return Dropped frame count
+    */
+  size_t getDroppedFrames() const {return dropped_frames_;}
+
+  /**
+    * @brief Trace the adding and publishing of the frames into a timeline, set before
+    * activation as the publisher thread reads it
+    * @param recorder Recorder to trace into, null to stop tracing
+    */
+  void setTraceRecorder(TraceRecorder * recorder);
+
 protected:
+  /**
+   * @struct mppi::TrajectoryVisualizer::Strips
+   * @brief Vertices of downsampled trajectories, each with its shade in [0, 1)
+   */
+  struct Strips
+  {
+    std::vector<float> x, y, shade;
+    std::vector<size_t> ends;
+
+    void clear()
+    {
+      x.clear();
+      y.clear();
+      shade.clear();
+      ends.clear();
+    }
+  };
+
+  /**
+   * @struct mppi::TrajectoryVisualizer::Frame
+   * @brief Everything published in a cycle
+   */
+  struct Frame
+  {
+    bool trajectories{false};
+    Strips candidates;
+    Strips optimal;
+
+    bool path{false};
+    std::vector<float> path_x, path_y, path_yaws;
+    builtin_interfaces::msg::Time stamp;
+  };
+
+  /**
+    * @brief Build and publish the markers of a frame, then its path if it has one
+    * @param frame Frame to publish
+    */
+  void publishFrame(const Frame & frame);
+
+  /**
+    * @brief Publish the frame being added to, on this thread or handing it off
+    */
+  void commitFrame();
+
+  /**
+    * @brief Thread publishing the frames handed off in async mode
+    */
+  void publisherThread();
+
+  /**
+    * @brief Stop the publisher thread if running
+    */
+  void stopPublisherThread();
+
+  /**
+    * @brief Take the next marker of the cycle, reusing the storage of a previous
+    * cycle's marker when there is one
+    * @param type Marker type
+    * @return Marker with its header, id, type and action set, and no points
+    */
+  visualization_msgs::msg::Marker & nextMarker(int32_t type);
+
+
   std::string frame_id_;
   std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<visualization_msgs::msg::MarkerArray>>
   trajectories_publisher_;
   std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<nav_msgs::msg::Path>> transformed_path_pub_;
 
-  std::unique_ptr<visualization_msgs::msg::MarkerArray> points_;
+  // Only used by the thread publishing frames
+  visualization_msgs::msg::MarkerArray markers_;
+  size_t used_markers_{0};
   int marker_id_ = 0;
 
+  std::optional<bool> publish_due_;
+
+  static constexpr unsigned int num_frames_ = 3;
+  static constexpr unsigned int index_mask_ = 3;
+  static constexpr unsigned int fresh_flag_ = 4;
+
+  std::array<Frame, num_frames_> frames_;
+  unsigned int back_{0};  // Added to by the caller
+  unsigned int front_{1};  // Published by the publisher thread
+  std::atomic<unsigned int> latest_{2};  // Last handed off frame, flagged if not yet taken
+  std::atomic<size_t> dropped_frames_{0};
+
+  std::thread publisher_thread_;
+  std::condition_variable publisher_cond_;
+  std::mutex publisher_lock_;
+  bool active_{false}, ready_{false};
+
   ParametersHandler * parameters_handler_;
+  rclcpp::Clock::SharedPtr clock_;
+  std::optional<rclcpp::Time> last_publish_time_;
 
   size_t trajectory_step_{0};
   size_t time_step_{0};
+  size_t top_trajectories_{0};
+  bool line_strips_{false};
+  double publish_rate_{0};
+  bool async_{false};
+
+  TraceRecorder * trace_recorder_{nullptr};
+  uint32_t add_trace_{0}, commit_trace_{0}, publish_trace_{0};
 
   rclcpp::Logger logger_{rclcpp::get_logger("MPPIController")};
 };
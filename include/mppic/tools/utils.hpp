@@ -16,12 +16,17 @@
 #define MPPIC__TOOLS__UTILS_HPP_
 
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
 #include <string>
 #include <limits>
 #include <memory>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <xsimd/xsimd.hpp>
 #include <xtensor/xarray.hpp>
 #include <xtensor/xnorm.hpp>
 #include <xtensor/xmath.hpp>
@@ -45,8 +50,13 @@
 #include "mppic/models/optimizer_settings.hpp"
 #include "mppic/models/control_sequence.hpp"
 #include "mppic/models/path.hpp"
+#include "mppic/models/trajectories.hpp"
 #include "builtin_interfaces/msg/time.hpp"
 #include "mppic/critic_data.hpp"
+#include "mppic/tools/costmap_source.hpp"
+#include "mppic/tools/kernels.hpp"
+#include "mppic/tools/savitzky_golay.hpp"
+#include "mppic/tools/workspace.hpp"
 
 namespace mppi::utils
 {
@@ -190,6 +200,25 @@ inline models::Path toTensor(const nav_msgs::msg::Path & path)
   return result;
 }
 
+/**
+ * @brief Time step of each point of the horizon, growing linearly from model_dt at
+ * the first point to model_dt_max at the last one, or uniform if model_dt_max is unset
+ * @param settings Settings of the optimizer
+ * @return Time steps
+ */
+inline xt::xtensor<float, 1> getModelDts(const models::OptimizerSettings & settings)
+{
+  const size_t time_steps = settings.time_steps;
+  auto dts = xt::xtensor<float, 1>::from_shape({time_steps});
+  const float first = settings.model_dt;
+  const float last = settings.model_dt_max > 0.0f ? settings.model_dt_max : first;
+  for (size_t t = 0; t != time_steps; t++) {
+    const float ratio = time_steps > 1 ? static_cast<float>(t) / (time_steps - 1) : 0.0f;
+    dts(t) = first + (last - first) * ratio;
+  }
+  return dts;
+}
+
 /**
  * @brief Check if the robot pose is within the Goal Checker's tolerances to goal
  * @param global_checker Pointer to the goal checker
@@ -256,6 +285,36 @@ inline bool withinPositionGoalTolerance(
   return false;
 }
 
+/**
+ * @brief Check if the robot pose is within the Goal Checker's tolerances to goal,
+ * memoized for the cycle if the data has a cycle context
+ * @param data Data to use
+ * @return bool If robot is within goal checker tolerances to the goal
+ */
+inline bool withinPositionGoalTolerance(const CriticData & data)
+{
+  auto compute = [&]() {
+      return withinPositionGoalTolerance(data.goal_checker, data.state.pose.pose, data.path);
+    };
+  return data.cycle_context ? data.cycle_context->withinGoalCheckerTolerance(compute) : compute();
+}
+
+/**
+ * @brief Check if the robot pose is within tolerance to the goal, memoized for the
+ * cycle if the data has a cycle context
+ * @param pose_tolerance Pose tolerance to use
+ * @param data Data to use
+ * @return bool If robot is within tolerance to the goal
+ */
+inline bool withinPositionGoalTolerance(float pose_tolerance, const CriticData & data)
+{
+  auto compute = [&]() {
+      return withinPositionGoalTolerance(pose_tolerance, data.state.pose.pose, data.path);
+    };
+  return data.cycle_context ?
+         data.cycle_context->withinTolerance(pose_tolerance, compute) : compute();
+}
+
 /**
   * @brief normalize
   * Normalizes the angle to be -M_PI circle to +M_PI circle
@@ -292,35 +351,191 @@ auto shortest_angular_distance(
 }
 
 /**
- * @brief Evaluate furthest point idx of data.path which is
- * nearset to some trajectory in data.trajectories
+ * @brief Integrate a batch x time expression over the horizon, weighting each point
+ * by its time step. Reduced lazily into the given buffer, so nothing is allocated
+ * @param expression Expression to integrate
  * @param data Data to use
- * @return Idx of furthest path point reached by a set of trajectories
+ * @param sums Integral of each trajectory, of the batch size
  */
-inline size_t findPathFurthestReachedPoint(const CriticData & data)
+template<typename E>
+inline void sumOverTime(E && expression, const CriticData & data, models::BatchTensor<1> & sums)
+{
+  if (data.model_dts) {
+    xt::noalias(sums) = xt::sum(std::forward<E>(expression) * *data.model_dts, {1});
+  } else {
+    xt::noalias(sums) = xt::sum(std::forward<E>(expression) * data.model_dt, {1});
+  }
+}
+
+/**
+ * @brief Split a batch range over the worker pool shared through the critic data,
+ * or process it inline on the caller if no pool is set
+ * @param data Data to use
+ * @param size Number of trajectories to split
+ * @param func Callable with signature void(size_t begin, size_t end)
+ */
+template<typename Func>
+inline void parallelFor(const CriticData & data, size_t size, Func && func)
+{
+  if (data.thread_pool) {
+    data.thread_pool->parallelFor(size, std::forward<Func>(func));
+  } else {
+    func(size_t{0}, size);
+  }
+}
+
+// Points per block of meanOverTime, which callables can size their own buffers with
+constexpr size_t time_block = 64;
+
+/**
+ * @brief Mean over the horizon of a value of each trajectory point. The values are
+ * computed a block of points at a time into a stack buffer, so that no batch x time
+ * temporary is allocated, and the batch is split over the worker pool
+ * @param data Data to use
+ * @param means Mean of each trajectory, of the batch size
+ * @param values Callable with signature void(size_t i, size_t begin, size_t size,
+ * float * out) writing the values of the points [begin, begin + size) of trajectory i
+ */
+template<typename Values>
+inline void meanOverTime(
+  const CriticData & data, models::BatchTensor<1> & means, Values && values)
 {
-  const auto traj_x = xt::view(data.trajectories.x, xt::all(), -1, xt::newaxis());
-  const auto traj_y = xt::view(data.trajectories.y, xt::all(), -1, xt::newaxis());
+  constexpr size_t block = time_block;
+  const size_t time_steps = data.trajectories.x.shape(1);
+  parallelFor(
+    data, means.shape(0), [&](size_t begin, size_t end) {
+      float out[block];
+      for (size_t i = begin; i != end; i++) {
+        float sum = 0.0f;
+        for (size_t t = 0; t < time_steps; t += block) {
+          const size_t size = std::min(block, time_steps - t);
+          values(i, t, size, out);
+          for (size_t k = 0; k != size; k++) {
+            sum += out[k];
+          }
+        }
+        means(i) = time_steps != 0 ? sum / static_cast<float>(time_steps) : 0.0f;
+      }
+    });
+}
 
-  const auto dx = data.path.x - traj_x;
-  const auto dy = data.path.y - traj_y;
+/**
+ * @brief Furthest of the nearest path points of a set of query points, the nearest of
+ * each breaking ties towards the lowest index like a linear scan. Query points are
+ * processed in blocks, vectorized over the block, scanning the path in order: as the
+ * path is no shorter than the chord between two of its points, the path points closer
+ * along the path to the last one scanned than its least distance to a query point beyond
+ * its current nearest cannot be nearer to any point of the block, and are skipped
+ * @param path Path to search
+ * @param x X of the query points
+ * @param y Y of the query points
+ * @param stride Distance between two query points in x and y
+ * @param size Number of query points
+ * @param workspace Workspace to lease the path lengths from, or nullptr to allocate them
+ * @return Idx of the furthest nearest path point, 0 without path or query points
+ */
+inline size_t findFurthestNearestPathPoint(
+  const models::Path & path, const float * x, const float * y, size_t stride, size_t size,
+  Workspace * workspace = nullptr)
+{
+  const size_t path_size = path.x.shape(0);
+  if (path_size == 0) {
+    return 0;
+  }
 
-  const auto dists = dx * dx + dy * dy;
+  std::vector<float> path_lengths;
+  if (workspace) {
+    workspace->acquirePathLengths(path_lengths, path_size);
+  } else {
+    path_lengths.assign(path_size, 0.0f);
+  }
+  for (size_t j = 1; j != path_size; j++) {
+    const float dx = path.x(j) - path.x(j - 1);
+    const float dy = path.y(j) - path.y(j - 1);
+    path_lengths[j] = path_lengths[j - 1] + std::sqrt(dx * dx + dy * dy);
+  }
 
-  size_t max_id_by_trajectories = 0;
-  double min_distance_by_path = std::numeric_limits<float>::max();
+  // Margin over the float rounding of the distances and lengths, so skips stay exact
+  constexpr float margin = 1e-4f;
+  constexpr size_t block = 16;
+  std::array<float, block> qx, qy, best_sq, best_dist;
+  std::array<size_t, block> best_id;
+  size_t furthest = 0;
+
+  for (size_t begin = 0; begin < size; begin += block) {
+    const size_t n = std::min(block, size - begin);
+    for (size_t l = 0; l != n; l++) {
+      qx[l] = x[(begin + l) * stride];
+      qy[l] = y[(begin + l) * stride];
+    }
+    best_sq.fill(std::numeric_limits<float>::max());
+    best_dist.fill(std::numeric_limits<float>::max());
+    best_id.fill(0);
+
+    size_t j = 0;
+    while (j < path_size) {
+      const float px = path.x(j);
+      const float py = path.y(j);
+      float slack = std::numeric_limits<float>::max();
+      for (size_t l = 0; l != n; l++) {
+        const float dx = qx[l] - px;
+        const float dy = qy[l] - py;
+        const float dist_sq = dx * dx + dy * dy;
+        const float dist = std::sqrt(dist_sq);
+        const bool nearer = dist_sq < best_sq[l];
+        best_sq[l] = nearer ? dist_sq : best_sq[l];
+        best_dist[l] = nearer ? dist : best_dist[l];
+        best_id[l] = nearer ? j : best_id[l];
+        slack = std::min(slack, dist - best_dist[l]);
+      }
 
-  for (size_t i = 0; i < dists.shape(0); i++) {
-    size_t min_id_by_path = 0;
-    for (size_t j = 0; j < dists.shape(1); j++) {
-      if (dists(i, j) < min_distance_by_path) {
-        min_distance_by_path = dists(i, j);
-        min_id_by_path = j;
+      const float reach = path_lengths[j] + slack - margin;
+      j++;
+      if (reach > path_lengths[j - 1]) {
+        j = static_cast<size_t>(
+          std::lower_bound(path_lengths.begin() + j, path_lengths.end(), reach) -
+          path_lengths.begin());
       }
     }
-    max_id_by_trajectories = std::max(max_id_by_trajectories, min_id_by_path);
+
+    for (size_t l = 0; l != n; l++) {
+      furthest = std::max(furthest, best_id[l]);
+    }
+  }
+
+  if (workspace) {
+    workspace->releasePathLengths(path_lengths);
+  }
+  return furthest;
+}
+
+/**
+ * @brief Evaluate furthest point idx of data.path which is
+ * nearset to some trajectory in data.trajectories
+ * @param data Data to use
+ * @return Idx of furthest path point reached by a set of trajectories
+ */
+inline size_t findPathFurthestReachedPoint(const CriticData & data)
+{
+  const size_t time_steps = data.trajectories.x.shape(1);
+  const size_t batch_size = data.trajectories.x.shape(0);
+  if (time_steps == 0) {
+    return 0;
+  }
+
+  if (data.path_index) {
+    size_t max_id_by_trajectories = 0;
+    for (size_t i = 0; i < batch_size; i++) {
+      const auto nearest = data.path_index->nearest(
+        data.trajectories.x(i, time_steps - 1), data.trajectories.y(i, time_steps - 1));
+      max_id_by_trajectories = std::max(max_id_by_trajectories, nearest.idx);
+    }
+    return max_id_by_trajectories;
   }
-  return max_id_by_trajectories;
+
+  return findFurthestNearestPathPoint(
+    data.path, data.trajectories.x.data() + time_steps - 1,
+    data.trajectories.y.data() + time_steps - 1, time_steps, batch_size, data.workspace);
 }
 
 /**
@@ -331,21 +546,30 @@ inline size_t findPathFurthestReachedPoint(const CriticData & data)
  */
 inline size_t findPathTrajectoryInitialPoint(const CriticData & data)
 {
-  // First point should be the same for all trajectories from initial conditions
-  const auto dx = data.path.x - data.trajectories.x(0, 0);
-  const auto dy = data.path.y - data.trajectories.y(0, 0);
-  const auto dists = dx * dx + dy * dy;
-
-  double min_distance_by_path = std::numeric_limits<float>::max();
-  size_t min_id = 0;
-  for (size_t j = 0; j < dists.shape(0); j++) {
-    if (dists(j) < min_distance_by_path) {
-      min_distance_by_path = dists(j);
-      min_id = j;
-    }
-  }
+  // First point should be the same for all trajectories from initial conditions,
+  // and for all iterations of a cycle
+  auto compute = [&]() -> size_t {
+      if (data.path_index) {
+        return data.path_index->nearest(data.trajectories.x(0, 0), data.trajectories.y(0, 0)).idx;
+      }
+
+      const auto dx = data.path.x - data.trajectories.x(0, 0);
+      const auto dy = data.path.y - data.trajectories.y(0, 0);
+      const auto dists = dx * dx + dy * dy;
+
+      double min_distance_by_path = std::numeric_limits<float>::max();
+      size_t min_id = 0;
+      for (size_t j = 0; j < dists.shape(0); j++) {
+        if (dists(j) < min_distance_by_path) {
+          min_distance_by_path = dists(j);
+          min_id = j;
+        }
+      }
+
+      return min_id;
+    };
 
-  return min_id;
+  return data.cycle_context ? data.cycle_context->pathInitialPoint(compute) : compute();
 }
 
 /**
@@ -362,15 +586,22 @@ inline void setPathFurthestPointIfNotSet(CriticData & data)
 /**
  * @brief evaluate path costs
  * @param data Data to use
+ * @param costmap_source Costmap read when the cycle has no snapshot
  */
-inline void findPathCosts(
-  CriticData & data,
-  std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros)
+inline void findPathCosts(CriticData & data, const CostmapSource & costmap_source)
 {
-  auto * costmap = costmap_ros->getCostmap();
+  // The cycle's snapshot if any, so path validity agrees with what the critics read
+  auto * costmap = data.costmap_snapshot ?
+    data.costmap_snapshot->getCostmap() : costmap_source.getCostmap();
+  const bool is_tracking_unknown = data.costmap_snapshot ?
+    data.costmap_snapshot->isTrackingUnknown() : costmap_source.isTrackingUnknown();
   unsigned int map_x, map_y;
   const size_t path_segments_count = data.path.x.shape(0) - 1;
-  data.path_pts_valid = std::vector<bool>(path_segments_count - 1, false);
+  if (data.workspace) {
+    data.workspace->acquirePathValidity(data.path_pts_valid, path_segments_count);
+  } else {
+    data.path_pts_valid = std::vector<bool>(path_segments_count, false);
+  }
   for (unsigned int idx = 0; idx < path_segments_count; idx++) {
     const auto path_x = data.path.x(idx);
     const auto path_y = data.path.y(idx);
@@ -388,8 +619,6 @@ inline void findPathCosts(
         (*data.path_pts_valid)[idx] = false;
         continue;
       case (NO_INFORMATION):
-        const bool is_tracking_unknown =
-          costmap_ros->getLayeredCostmap()->isTrackingUnknown();
         (*data.path_pts_valid)[idx] = is_tracking_unknown ? true : false;
         continue;
     }
@@ -401,14 +630,100 @@ inline void findPathCosts(
 /**
  * @brief evaluate path costs if it is not set
  * @param data Data to use
+ * @param costmap_source Costmap read when the cycle has no snapshot
+ */
+inline void setPathCostsIfNotSet(CriticData & data, const CostmapSource & costmap_source)
+{
+  if (!data.path_pts_valid) {
+    findPathCosts(data, costmap_source);
+  }
+}
+
+/**
+ * @brief evaluate path costs if it is not set
+ * @param data Data to use
+ * @param costmap_ros Costmap2DROS read when the cycle has no snapshot
  */
 inline void setPathCostsIfNotSet(
   CriticData & data,
   std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros)
 {
   if (!data.path_pts_valid) {
-    findPathCosts(data, costmap_ros);
+    findPathCosts(data, CostmapSource(costmap_ros));
+  }
+}
+
+/**
+ * @brief Look up the costmap cost of a set of world points at once. Map indices are
+ * computed a SIMD batch at a time, then the costs are gathered from the char map.
+ * Points outside of the map get out_of_bounds_cost
+ * @param costmap Costmap to look up
+ * @param x X world coordinates of the points
+ * @param y Y world coordinates of the points
+ * @param costs Output costs of the points
+ * @param size Number of points
+ * @param out_of_bounds_cost Cost of points outside of the map
+ * @param kernel_set Kernels to run, or nullptr for the baseline ones
+ */
+inline void gatherCosts(
+  const nav2_costmap_2d::Costmap2D & costmap, const float * x, const float * y,
+  float * costs, size_t size, float out_of_bounds_cost = nav2_costmap_2d::NO_INFORMATION,
+  const kernels::KernelSet * kernel_set = nullptr)
+{
+  kernels::CostmapView view;
+  view.char_map = costmap.getCharMap();
+  view.size_x = costmap.getSizeInCellsX();
+  view.size_y = costmap.getSizeInCellsY();
+  view.origin_x = static_cast<float>(costmap.getOriginX());
+  view.origin_y = static_cast<float>(costmap.getOriginY());
+  view.resolution = static_cast<float>(costmap.getResolution());
+  view.out_of_bounds_cost = out_of_bounds_cost;
+  kernels::gatherCosts(
+    kernel_set ? *kernel_set : kernels::baselineKernels(), view, x, y, costs, size);
+}
+
+/**
+ * @brief Look up the costmap cost of every point of a range of trajectories
+ * @param costmap Costmap to look up
+ * @param trajectories Trajectories to look up
+ * @param costs Output batch x time costs, resized to the trajectories shape
+ * @param begin First trajectory of the range
+ * @param end One past the last trajectory of the range
+ * @param out_of_bounds_cost Cost of points outside of the map
+ * @param kernel_set Kernels to run, or nullptr for the baseline ones
+ */
+inline void gatherCosts(
+  const nav2_costmap_2d::Costmap2D & costmap, const models::Trajectories & trajectories,
+  xt::xtensor<float, 2> & costs, size_t begin, size_t end,
+  float out_of_bounds_cost = nav2_costmap_2d::NO_INFORMATION,
+  const kernels::KernelSet * kernel_set = nullptr)
+{
+  if (costs.shape() != trajectories.x.shape()) {
+    costs.resize(trajectories.x.shape());
   }
+
+  const size_t offset = begin * trajectories.x.shape(1);
+  gatherCosts(
+    costmap, trajectories.x.data() + offset, trajectories.y.data() + offset,
+    costs.data() + offset, (end - begin) * trajectories.x.shape(1), out_of_bounds_cost,
+    kernel_set);
+}
+
+/**
+ * @brief Look up the costmap cost of every trajectory point
+ * @param costmap Costmap to look up
+ * @param trajectories Trajectories to look up
+ * @param costs Output batch x time costs, resized to the trajectories shape
+ * @param out_of_bounds_cost Cost of points outside of the map
+ * @param kernel_set Kernels to run, or nullptr for the baseline ones
+ */
+inline void gatherCosts(
+  const nav2_costmap_2d::Costmap2D & costmap, const models::Trajectories & trajectories,
+  xt::xtensor<float, 2> & costs, float out_of_bounds_cost = nav2_costmap_2d::NO_INFORMATION,
+  const kernels::KernelSet * kernel_set = nullptr)
+{
+  gatherCosts(
+    costmap, trajectories, costs, 0, trajectories.x.shape(0), out_of_bounds_cost, kernel_set);
 }
 
 /**
@@ -429,20 +744,17 @@ inline double posePointAngle(const geometry_msgs::msg::Pose & pose, double point
 }
 
 /**
- * @brief Apply Savisky-Golay filter to optimal trajectory
+ * @brief Apply Savisky-Golay filter to optimal trajectory, with the settings' window
  * @param control_sequence Sequence to apply filter to
- * @param control_history Recent set of controls for edge-case handling
+ * @param control_history Recent set of controls for edge-case handling, oldest first
  * @param Settings Settings to use
  */
+template<size_t History>
 inline void savitskyGolayFilter(
   models::ControlSequence & control_sequence,
-  std::array<mppi::models::Control, 2> & control_history,
+  std::array<mppi::models::Control, History> & control_history,
   const models::OptimizerSettings & settings)
 {
-  // Savitzky-Golay Quadratic, 5-point Coefficients
-  xt::xarray<float> filter = {-3.0, 12.0, 17.0, 12.0, -3.0};
-  filter /= 35.0;
-
   const unsigned int num_sequences = control_sequence.vx.shape(0);
 
   // Too short to smooth meaningfully
@@ -450,69 +762,36 @@ inline void savitskyGolayFilter(
     return;
   }
 
-  auto applyFilter = [&](const xt::xarray<float> & data) -> float {
-      return xt::sum(data * filter, {0}, immediate)();
-    };
-
-  auto applyFilterOverAxis =
-    [&](xt::xtensor<float, 1> & sequence, const float hist_0, const float hist_1) -> void
-    {
-      unsigned int idx = 0;
-      sequence(idx) = applyFilter(
-      {
-        hist_0,
-        hist_1,
-        sequence(idx),
-        sequence(idx + 1),
-        sequence(idx + 2)});
-
-      idx++;
-      sequence(idx) = applyFilter(
-      {
-        hist_1,
-        sequence(idx - 1),
-        sequence(idx),
-        sequence(idx + 1),
-        sequence(idx + 2)});
-
-      for (idx = 2; idx != num_sequences - 3; idx++) {
-        sequence(idx) = applyFilter(
-        {
-          sequence(idx - 2),
-          sequence(idx - 1),
-          sequence(idx),
-          sequence(idx + 1),
-          sequence(idx + 2)});
+  auto smooth = [&](auto window) {
+      constexpr unsigned int half = decltype(window)::value / 2;
+      // The oldest control is repeated if fewer than half a window are kept
+      std::array<std::array<float, half>, 3> history;
+      for (size_t k = 0; k != half; k++) {
+        const auto & control = control_history[k + History >= half ? k + History - half : 0];
+        history[0][k] = control.vx;
+        history[1][k] = control.vy;
+        history[2][k] = control.wz;
       }
-
-      idx++;
-      sequence(idx) = applyFilter(
-      {
-        sequence(idx - 2),
-        sequence(idx - 1),
-        sequence(idx),
-        sequence(idx + 1),
-        sequence(idx + 1)});
-
-      idx++;
-      sequence(idx) = applyFilter(
-      {
-        sequence(idx - 2),
-        sequence(idx - 1),
-        sequence(idx),
-        sequence(idx),
-        sequence(idx)});
+      savitzkyGolaySmooth<decltype(window)::value, 3>(
+        {control_sequence.vx.data(), control_sequence.vy.data(), control_sequence.wz.data()},
+        history, num_sequences);
     };
 
-  // Filter trajectories
-  applyFilterOverAxis(control_sequence.vx, control_history[0].vx, control_history[1].vx);
-  applyFilterOverAxis(control_sequence.vy, control_history[0].vy, control_history[1].vy);
-  applyFilterOverAxis(control_sequence.wz, control_history[0].wz, control_history[1].wz);
+  switch (settings.smoothing_window) {
+    case 7:
+      smooth(std::integral_constant<unsigned int, 7>{});
+      break;
+    case 9:
+      smooth(std::integral_constant<unsigned int, 9>{});
+      break;
+    default:
+      smooth(std::integral_constant<unsigned int, 5>{});
+  }
 
   // Update control history
   unsigned int offset = settings.shift_control_sequence ? 1 : 0;
-  control_history[0] = control_history[1];
-  control_history[1] = {
+  std::rotate(control_history.begin(), control_history.begin() + 1, control_history.end());
+  control_history.back() = {
     control_sequence.vx(offset),
     control_sequence.vy(offset),
     control_sequence.wz(offset)};
@@ -0,0 +1,179 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPPIC__TOOLS__WORKSPACE_HPP_
+#define MPPIC__TOOLS__WORKSPACE_HPP_
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include <xtensor/xtensor.hpp>
+
+#include "mppic/models/batch_tensor.hpp"
+
+namespace mppi
+{
+
+class Workspace;
+
+/**
+ * @class mppi::ScratchBuffer
+ * @brief Batch sized scratch tensor leased from a Workspace and returned to it
+ * when going out of scope. Without a workspace, the buffer owns its own storage
+ */
+class ScratchBuffer
+{
+public:
+  /**
+    * @brief Constructor for mppi::ScratchBuffer
+    * @param workspace Workspace to lease the buffer from, may be nullptr
+    * @param size Number of elements of the buffer
+    */
+  ScratchBuffer(Workspace * workspace, size_t size);
+
+  /**
+    * @brief Destructor for mppi::ScratchBuffer, returning the buffer to the workspace
+    */
+  ~ScratchBuffer();
+
+  ScratchBuffer(const ScratchBuffer &) = delete;
+  ScratchBuffer & operator=(const ScratchBuffer &) = delete;
+
+  models::BatchTensor<1> & operator*() {return *buffer_;}
+  models::BatchTensor<1> * operator->() {return buffer_;}
+
+protected:
+  Workspace * workspace_;
+  size_t slot_{0};
+  models::BatchTensor<1> local_;
+  models::BatchTensor<1> * buffer_;
+};
+
+/**
+ * @class mppi::Workspace
+ * @brief Preallocated scratch memory shared by the optimizer and the critics,
+ * sized on reset so that steady state iterations do not allocate
+ */
+class Workspace
+{
+public:
+  /**
+    * @brief Constructor for mppi::Workspace
+    */
+  Workspace() = default;
+
+  Workspace(const Workspace &) = delete;
+  Workspace & operator=(const Workspace &) = delete;
+
+  /**
+    * @brief Size the scratch buffers for a new batch size
+    * @param batch_size Number of trajectories in the batch
+    * @param max_batch_size Largest batch size to reserve the buffers for, if above batch_size,
+    * so that leasing buffers of any batch size up to it does not reallocate
+    * @param num_buffers Number of buffers to hold at least, such as those of a workspace
+    * this one is built to replace
+    */
+  void reset(size_t batch_size, size_t max_batch_size = 0, size_t num_buffers = 0);
+
+  /**
+    * @brief Swap the batch buffers with another workspace, such as one sized on another
+    * thread, keeping the path storage. Neither may have buffers leased
+    * @param other Workspace to swap with
+    */
+  void swap(Workspace & other);
+
+  /**
+    * @brief Lease a zeroed scratch buffer of the given size
+    * @param size Number of elements, normally the batch size
+    * @return Buffer returned to the workspace when destroyed
+    */
+  ScratchBuffer batchBuffer(size_t size) {return ScratchBuffer(this, size);}
+
+  /**
+    * @brief Move the path validity storage into the critic data for reuse
+    * @param path_pts_valid Critic data path validity to fill, resized to size
+    * @param size Number of path points
+    */
+  void acquirePathValidity(std::optional<std::vector<bool>> & path_pts_valid, size_t size);
+
+  /**
+    * @brief Move the path validity storage back from the critic data, clearing it
+    * @param path_pts_valid Critic data path validity to reclaim
+    */
+  void releasePathValidity(std::optional<std::vector<bool>> & path_pts_valid);
+
+  /**
+    * @brief Move the path lengths storage out for reuse
+    * @param path_lengths Vector to fill, resized to size and zeroed
+    * @param size Number of path points
+    */
+  void acquirePathLengths(std::vector<float> & path_lengths, size_t size);
+
+  /**
+    * @brief Move the path lengths storage back for the next use
+    * @param path_lengths Vector to reclaim
+    */
+  void releasePathLengths(std::vector<float> & path_lengths);
+
+  /**
+    * @brief Number of batch buffers owned by the workspace
+    * @return Number of buffers
+    */
+  size_t numBatchBuffers() const {return buffers_.size();}
+
+  /**
+    * @brief Bytes held by the batch buffers and the path validity and lengths storage
+    * @return Bytes
+    */
+  size_t getMemoryUsage() const;
+
+protected:
+  friend class ScratchBuffer;
+
+  /**
+    * @brief Find a free buffer slot, growing the workspace if all are leased
+    * @param size Number of elements of the buffer
+    * @return Slot index
+    */
+  size_t acquire(size_t size);
+
+  /**
+    * @brief Size a buffer, within its reserved storage not to reallocate
+    * @param buffer Buffer to size
+    * @param size Number of elements
+    */
+  void sizeBuffer(models::BatchTensor<1> & buffer, size_t size) const;
+
+  /**
+    * @brief Return a buffer slot to the workspace
+    * @param slot Slot index
+    */
+  void release(size_t slot);
+
+  static constexpr size_t initial_batch_buffers_ = 4;
+
+  size_t reserved_size_{0};
+  mutable std::mutex lock_;
+  std::deque<models::BatchTensor<1>> buffers_;
+  std::vector<bool> leased_;
+  std::vector<bool> path_validity_;
+  std::vector<float> path_lengths_;
+};
+
+}  // namespace mppi
+
+#endif  // MPPIC__TOOLS__WORKSPACE_HPP_
@@ -0,0 +1,83 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/batch_optimizer.hpp"
+
+#include <mutex>
+#include <stdexcept>
+
+namespace mppi
+{
+
+void BatchOptimizer::initialize(
+  const std::string & name, const HeadlessCostmap & costmap, size_t robots,
+  const std::vector<rclcpp::Parameter> & parameters, unsigned int num_threads)
+{
+  shutdown();
+  optimizers_.clear();
+  parameters_handlers_.clear();
+
+  // Robots are the unit of parallelism, each running single threaded on a pool thread
+  auto robot_parameters = parameters;
+  robot_parameters.emplace_back(name + ".worker_threads", 1);
+  robot_parameters.emplace_back(name + ".noise_thread", false);
+
+  for (size_t i = 0; i != robots; i++) {
+    parameters_handlers_.push_back(std::make_unique<ParametersHandler>(robot_parameters));
+    optimizers_.push_back(std::make_unique<Optimizer>());
+    optimizers_.back()->initialize(name, costmap, parameters_handlers_.back().get());
+    parameters_handlers_.back()->start();
+  }
+
+  thread_pool_.initialize(num_threads);
+}
+
+void BatchOptimizer::shutdown()
+{
+  for (auto & optimizer : optimizers_) {
+    optimizer->shutdown();
+  }
+  thread_pool_.shutdown();
+}
+
+void BatchOptimizer::evalControls(
+  std::vector<RobotProblem> & problems, std::vector<RobotCommand> & commands)
+{
+  if (problems.size() != optimizers_.size()) {
+    throw std::runtime_error("Batch optimizer needs one problem per robot!");
+  }
+  commands.resize(optimizers_.size());
+
+  thread_pool_.parallelFor(
+    optimizers_.size(), [&](size_t begin, size_t end) {
+      for (size_t i = begin; i != end; i++) {
+        auto & problem = problems[i];
+        auto & command = commands[i];
+        command.failed = false;
+        command.error.clear();
+        // Failures are reported per robot, as exceptions cannot leave the pool threads
+        try {
+          std::lock_guard<std::mutex> lock(*parameters_handlers_[i]->getLock());
+          command.cmd = optimizers_[i]->evalControl(
+            problem.robot_pose, problem.robot_speed, problem.path, problem.stamp,
+            problem.goal_checker);
+        } catch (const std::exception & e) {
+          command.failed = true;
+          command.error = e.what();
+        }
+      }
+    });
+}
+
+}  // namespace mppi
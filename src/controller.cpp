@@ -13,12 +13,18 @@
 // limitations under the License.
 
 #include <stdint.h>
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <functional>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 #include "mppic/controller.hpp"
 #include "mppic/tools/utils.hpp"
 
-// #define BENCHMARK_TESTING
-
 namespace mppi
 {
 
@@ -37,13 +43,49 @@ void MPPIController::configure(
   // Get high-level controller parameters
   auto getParam = parameters_handler_->getParamGetter(name_);
   getParam(visualize_, "visualize", false);
+  getParam(publish_latency_stats_, "publish_latency_stats", false);
+  getParam(latency_stats_period_, "latency_stats_period", 1.0);
+  getParam(hypotheses_count_, "hypotheses", 1, ParameterType::Static);
+  getParam(record_cycles_path_, "record_cycles_path", std::string(""), ParameterType::Static);
+  getParam(trace_events_, "trace_events", false);
+  int trace_buffer_size;
+  getParam(trace_buffer_size, "trace_buffer_size", 65536, ParameterType::Static);
+  getParam(trace_dump_path_, "trace_dump_path", std::string("/tmp/mppi_trace.json"));
+  trace_recorder_.setBufferSize(static_cast<size_t>(std::max(trace_buffer_size, 1)));
+  trace_recorder_.setEnabled(trace_events_);
+  cycle_trace_ = trace_recorder_.addName("computeVelocityCommands");
+  parameters_trace_ = trace_recorder_.addName("applyParameterChanges");
+  std::vector<int64_t> control_cpus;
+  std::string control_scheduling;
+  int control_priority;
+  getParam(control_cpus, "control_thread_cpus", std::vector<int64_t>{}, ParameterType::Static);
+  getParam(
+    control_scheduling, "control_thread_scheduling", std::string("other"),
+    ParameterType::Static);
+  getParam(control_priority, "control_thread_priority", 0, ParameterType::Static);
+  control_placement_ = makeThreadPlacement(control_cpus, control_scheduling, control_priority);
+  control_placed_ = false;
 
   // Configure composed objects
   optimizer_.initialize(parent_, name_, costmap_ros_, parameters_handler_.get());
+  optimizer_.setTraceRecorder(&trace_recorder_);
+  initializeHypotheses();
   path_handler_.initialize(parent_, name_, costmap_ros_, tf_buffer_, parameters_handler_.get());
+  path_handler_.setTraceRecorder(&trace_recorder_);
   trajectory_visualizer_.on_configure(
     parent_, name_,
     costmap_ros_->getGlobalFrameID(), parameters_handler_.get());
+  trajectory_visualizer_.setTraceRecorder(&trace_recorder_);
+  latency_stats_pub_ =
+    node->create_publisher<diagnostic_msgs::msg::DiagnosticArray>("latency_stats", 1);
+  last_latency_stats_time_ = node->now();
+  dump_trace_service_ = node->create_service<std_srvs::srv::Trigger>(
+    "dump_trace", std::bind(
+      &MPPIController::dumpTrace, this, std::placeholders::_1, std::placeholders::_2));
+  if (!record_cycles_path_.empty()) {
+    cycle_recorder_.open(record_cycles_path_, optimizer_.getNoiseSeed());
+    RCLCPP_INFO(logger_, "Recording controller cycles to %s", record_cycles_path_.c_str());
+  }
 
   RCLCPP_INFO(logger_, "Configured MPPI Controller: %s", name_.c_str());
 }
@@ -51,7 +93,15 @@ void MPPIController::configure(
 void MPPIController::cleanup()
 {
   optimizer_.shutdown();
+  for (auto & hypothesis : hypotheses_) {
+    hypothesis->shutdown();
+  }
+  hypotheses_.clear();
+  hypothesis_pool_.shutdown();
   trajectory_visualizer_.on_cleanup();
+  cycle_recorder_.close();
+  latency_stats_pub_.reset();
+  dump_trace_service_.reset();
   parameters_handler_.reset();
   RCLCPP_INFO(logger_, "Cleaned up MPPI Controller: %s", name_.c_str());
 }
@@ -59,19 +109,101 @@ void MPPIController::cleanup()
 void MPPIController::activate()
 {
   trajectory_visualizer_.on_activate();
-  parameters_handler_->start();
+  latency_stats_pub_->on_activate();
+  parameters_handler_->start(true);
   RCLCPP_INFO(logger_, "Activated MPPI Controller: %s", name_.c_str());
 }
 
 void MPPIController::deactivate()
 {
   trajectory_visualizer_.on_deactivate();
+  latency_stats_pub_->on_deactivate();
   RCLCPP_INFO(logger_, "Deactivated MPPI Controller: %s", name_.c_str());
 }
 
 void MPPIController::reset()
 {
   optimizer_.reset();
+  for (auto & hypothesis : hypotheses_) {
+    hypothesis->reset();
+  }
+}
+
+void MPPIController::initializeHypotheses()
+{
+  // The main optimizer starts from its previous optimum
+  static constexpr std::array<models::NominalSequence, 3> nominals = {
+    models::NominalSequence::PathFeedforward, models::NominalSequence::Stop,
+    models::NominalSequence::Reverse};
+  if (hypotheses_count_ < 1 || hypotheses_count_ > static_cast<int>(nominals.size()) + 1) {
+    throw std::runtime_error("Hypotheses needs to be between 1 and 4");
+  }
+
+  hypotheses_.clear();
+  // Bound to the same parameters as the main optimizer, so they follow its changes
+  for (int i = 1; i < hypotheses_count_; i++) {
+    auto optimizer = std::make_unique<Optimizer>();
+    optimizer->initialize(parent_, name_, costmap_ros_, parameters_handler_.get());
+    optimizer->setNominalSequence(nominals[i - 1]);
+    optimizer->setTraceRecorder(&trace_recorder_);
+    hypotheses_.push_back(std::move(optimizer));
+  }
+
+  hypothesis_paths_.resize(hypotheses_.size());
+  hypothesis_cmds_.resize(hypotheses_.size() + 1);
+  hypothesis_errors_.resize(hypotheses_.size() + 1);
+  if (!hypotheses_.empty()) {
+    hypothesis_pool_.initialize(hypotheses_count_, optimizer_.getWorkerPlacement());
+  }
+}
+
+std::pair<geometry_msgs::msg::TwistStamped, Optimizer *> MPPIController::evalHypotheses(
+  const geometry_msgs::msg::PoseStamped & robot_pose,
+  const geometry_msgs::msg::Twist & robot_speed,
+  const builtin_interfaces::msg::Time & stamp, nav2_core::GoalChecker * goal_checker)
+{
+  auto optimizer = [this](size_t i) -> Optimizer & {
+      return i == 0 ? optimizer_ : *hypotheses_[i - 1];
+    };
+
+  // Every optimizer swaps its path, so all but the main one get a copy
+  for (auto & path : hypothesis_paths_) {
+    path = transformed_plan_;
+  }
+
+  const size_t count = hypotheses_.size() + 1;
+  hypothesis_pool_.parallelFor(
+    count, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i != end; i++) {
+        hypothesis_errors_[i] = nullptr;
+        try {
+          auto & path = i == 0 ? transformed_plan_ : hypothesis_paths_[i - 1];
+          hypothesis_cmds_[i] =
+            optimizer(i).evalControl(robot_pose, robot_speed, path, stamp, goal_checker);
+        } catch (...) {
+          hypothesis_errors_[i] = std::current_exception();
+        }
+      }
+    });
+
+  size_t best = count;
+  float best_cost = std::numeric_limits<float>::max();
+  for (size_t i = 0; i != count; i++) {
+    if (!hypothesis_errors_[i] && optimizer(i).getExpectedCost() < best_cost) {
+      best = i;
+      best_cost = optimizer(i).getExpectedCost();
+    }
+  }
+
+  // Only fails if every hypothesis failed
+  if (best == count) {
+    std::rethrow_exception(hypothesis_errors_[0]);
+  }
+
+  if (best != 0) {
+    optimizer_.setControlSequence(optimizer(best).getControlSequence());
+  }
+  return {hypothesis_cmds_[best], &optimizer(best)};
 }
 
 geometry_msgs::msg::TwistStamped MPPIController::computeVelocityCommands(
@@ -79,34 +211,182 @@ geometry_msgs::msg::TwistStamped MPPIController::computeVelocityCommands(
   const geometry_msgs::msg::Twist & robot_speed,
   nav2_core::GoalChecker * goal_checker)
 {
-#ifdef BENCHMARK_TESTING
-  auto start = std::chrono::system_clock::now();
-#endif
-
+  // Parameter changes are applied between cycles, so parameter updates never wait on a
+  // cycle. Their reallocations are built beforehand off the lock, so applying them only
+  // swaps the buffers in. Every change first waits for the optimizers' pre-rolls, which
+  // read their settings unlocked
+  if (!control_placed_) {
+    // The controller server's thread is only known once it calls in
+    models::ThreadPlacementReport report;
+    report.applied = applyThreadPlacement(control_placement_, report.description);
+    if (report.applied) {
+      RCLCPP_INFO(logger_, "Control thread placement: %s", report.description.c_str());
+    } else {
+      RCLCPP_WARN(
+        logger_, "Control thread placement could not be fully applied: %s",
+        report.description.c_str());
+    }
+    control_placed_ = true;
+  }
+  trace_recorder_.nameThread("control");
+  ScopedTrace cycle_trace(&trace_recorder_, cycle_trace_);
+  optimizer_.finishPreroll();
+  for (auto & hypothesis : hypotheses_) {
+    hypothesis->finishPreroll();
+  }
+  {
+    ScopedTrace trace(&trace_recorder_, parameters_trace_);
+    parameters_handler_->applyPendingChanges();
+  }
   std::lock_guard<std::mutex> lock(*parameters_handler_->getLock());
-  nav_msgs::msg::Path transformed_plan = path_handler_.transformPath(robot_pose);
+  // Tracing is started or stopped by its parameter, the next spans being recorded or not
+  trace_recorder_.setEnabled(trace_events_);
+  path_handler_.transformPath(robot_pose, transformed_plan_);
+
+  // The optimizer takes the plan, so it is captured beforehand
+  const bool record = cycle_recorder_.isOpen();
+  if (record) {
+    cycle_recorder_.capture(
+      robot_pose, robot_speed, transformed_plan_, goal_checker, *costmap_ros_->getCostmap(),
+      costmap_ros_->getRobotFootprint());
+  }
+
+  const auto & stamp = robot_pose.header.stamp;
+  const auto start = std::chrono::steady_clock::now();
+  auto latency = [&start]() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    };
+  geometry_msgs::msg::TwistStamped cmd;
+  Optimizer * best = &optimizer_;
+  try {
+    if (hypotheses_.empty()) {
+      cmd = optimizer_.evalControl(
+        robot_pose, robot_speed, transformed_plan_, stamp, goal_checker);
+    } else {
+      std::tie(cmd, best) = evalHypotheses(robot_pose, robot_speed, stamp, goal_checker);
+    }
+  } catch (...) {
+    if (record) {
+      cycle_recorder_.write(cmd.twist, true, latency());
+    }
+    throw;
+  }
+
+  if (record) {
+    cycle_recorder_.write(cmd.twist, false, latency());
+  }
 
-  geometry_msgs::msg::TwistStamped cmd =
-    optimizer_.evalControl(robot_pose, robot_speed, transformed_plan, goal_checker);
+  if (publish_latency_stats_) {
+    publishLatencyStats();
+  }
 
-#ifdef BENCHMARK_TESTING
-  auto end = std::chrono::system_clock::now();
-  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-  RCLCPP_INFO(logger_, "Control loop execution time: %ld [ms]", duration);
-#endif
+  // Unless the latency watchdog skipped it, the cycle being about to overrun
+  if (visualize_ && !best->isVisualizationSkipped()) {
+    visualize(*best, best->getPath(), stamp);
+  }
 
-  if (visualize_) {
-    visualize(std::move(transformed_plan));
+  // Once this cycle's trajectories were used, the next cycle's rollouts can start
+  optimizer_.startPreroll();
+  for (auto & hypothesis : hypotheses_) {
+    hypothesis->startPreroll();
   }
 
   return cmd;
 }
 
-void MPPIController::visualize(nav_msgs::msg::Path transformed_plan)
+void MPPIController::visualize(
+  Optimizer & optimizer, const models::Path & transformed_plan,
+  const builtin_interfaces::msg::Time & stamp)
 {
-  trajectory_visualizer_.add(optimizer_.getGeneratedTrajectories());
-  trajectory_visualizer_.add(optimizer_.getOptimizedTrajectory());
-  trajectory_visualizer_.visualize(std::move(transformed_plan));
+  // The optimal trajectory is integrated only if it is to be published
+  if (trajectory_visualizer_.shouldVisualizeTrajectories()) {
+    const size_t top_trajectories = trajectory_visualizer_.getTopTrajectoriesCount();
+    if (top_trajectories > 0) {
+      optimizer.getTopTrajectories(top_trajectories, top_trajectories_, top_costs_);
+      trajectory_visualizer_.add(top_trajectories_, 1);
+    } else {
+      trajectory_visualizer_.add(optimizer.getGeneratedTrajectories());
+    }
+    trajectory_visualizer_.add(optimizer.getOptimizedTrajectory());
+  }
+  trajectory_visualizer_.visualize(transformed_plan, stamp);
+}
+
+void MPPIController::publishLatencyStats()
+{
+  auto node = parent_.lock();
+  const rclcpp::Time now = node->now();
+  if ((now - last_latency_stats_time_).seconds() < latency_stats_period_ ||
+    latency_stats_pub_->get_subscription_count() == 0)
+  {
+    return;
+  }
+  last_latency_stats_time_ = now;
+
+  auto msg = std::make_unique<diagnostic_msgs::msg::DiagnosticArray>();
+  msg->header.stamp = now;
+  for (const auto & stats : optimizer_.getLatencyProfiler().getStats()) {
+    diagnostic_msgs::msg::DiagnosticStatus status;
+    status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+    status.name = name_ + ": " + stats.name;
+    status.message = "Latency in microseconds";
+    auto addValue = [&](const std::string & key, const std::string & value) {
+        diagnostic_msgs::msg::KeyValue key_value;
+        key_value.key = key;
+        key_value.value = value;
+        status.values.push_back(key_value);
+      };
+    addValue("count", std::to_string(stats.count));
+    addValue("p50", std::to_string(stats.p50));
+    addValue("p99", std::to_string(stats.p99));
+    addValue("max", std::to_string(stats.max));
+    msg->status.push_back(std::move(status));
+  }
+
+  const auto & watchdog = optimizer_.getWatchdogStats();
+  if (watchdog.cycles > 0) {
+    diagnostic_msgs::msg::DiagnosticStatus status;
+    status.level = watchdog.overruns > 0 ?
+      diagnostic_msgs::msg::DiagnosticStatus::WARN : diagnostic_msgs::msg::DiagnosticStatus::OK;
+    status.name = name_ + ": Watchdog";
+    status.message = "Cycles and degradations since configuration";
+    auto addValue = [&](const std::string & key, size_t value) {
+        diagnostic_msgs::msg::KeyValue key_value;
+        key_value.key = key;
+        key_value.value = std::to_string(value);
+        status.values.push_back(key_value);
+      };
+    addValue("cycles", watchdog.cycles);
+    addValue("overruns", watchdog.overruns);
+    addValue("skipped_visualizations", watchdog.skipped_visualizations);
+    addValue("dropped_iterations", watchdog.dropped_iterations);
+    addValue("disabled_expensive_critics", watchdog.disabled_expensive_critics);
+    addValue("reused_sequences", watchdog.reused_sequences);
+    msg->status.push_back(std::move(status));
+  }
+  latency_stats_pub_->publish(std::move(msg));
+}
+
+void MPPIController::dumpTrace(
+  const std::shared_ptr<std_srvs::srv::Trigger::Request>/*request*/,
+  std::shared_ptr<std_srvs::srv::Trigger::Response> response)
+{
+  std::string file_path;
+  {
+    std::lock_guard<std::mutex> lock(*parameters_handler_->getLock());
+    file_path = trace_dump_path_;
+  }
+
+  try {
+    const size_t events = trace_recorder_.dump(file_path);
+    response->success = true;
+    response->message = "Wrote " + std::to_string(events) + " trace events to " + file_path;
+  } catch (const std::runtime_error & e) {
+    response->success = false;
+    response->message = e.what();
+  }
+  RCLCPP_INFO(logger_, "%s", response->message.c_str());
 }
 
 void MPPIController::setPlan(const nav_msgs::msg::Path & path)
@@ -117,6 +397,9 @@ void MPPIController::setPlan(const nav_msgs::msg::Path & path)
 void MPPIController::setSpeedLimit(const double & speed_limit, const bool & percentage)
 {
   optimizer_.setSpeedLimit(speed_limit, percentage);
+  for (auto & hypothesis : hypotheses_) {
+    hypothesis->setSpeedLimit(speed_limit, percentage);
+  }
 }
 
 }  // namespace mppi
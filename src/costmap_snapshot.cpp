@@ -0,0 +1,125 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/costmap_snapshot.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace mppi
+{
+
+bool CostmapSnapshot::update(nav2_costmap_2d::Costmap2D & costmap, bool track_unknown)
+{
+  std::unique_lock<nav2_costmap_2d::Costmap2D::mutex_t> lock(*costmap.getMutex());
+
+  const unsigned int size_x = costmap.getSizeInCellsX();
+  const unsigned int size_y = costmap.getSizeInCellsY();
+  const bool geometry_changed = version_ == 0 ||
+    size_x != map_.getSizeInCellsX() || size_y != map_.getSizeInCellsY() ||
+    costmap.getResolution() != map_.getResolution() ||
+    costmap.getOriginX() != map_.getOriginX() || costmap.getOriginY() != map_.getOriginY() ||
+    track_unknown != track_unknown_;
+
+  const uint64_t next_version = version_ + 1;
+  dirty_tiles_ = 0;
+  const unsigned char * src = costmap.getCharMap();
+
+  if (geometry_changed) {
+    map_.resizeMap(
+      size_x, size_y, costmap.getResolution(), costmap.getOriginX(), costmap.getOriginY());
+    std::memcpy(map_.getCharMap(), src, static_cast<size_t>(size_x) * size_y);
+    track_unknown_ = track_unknown;
+
+    tiles_x_ = (size_x + tile_size - 1) / tile_size;
+    tiles_y_ = (size_y + tile_size - 1) / tile_size;
+    tile_versions_.assign(static_cast<size_t>(tiles_x_) * tiles_y_, next_version);
+    dirty_tiles_ = tile_versions_.size();
+    dirty_min_x_ = dirty_min_y_ = 0;
+    dirty_max_x_ = size_x;
+    dirty_max_y_ = size_y;
+  } else {
+    // Rows of tiles are compared and copied one tile wide segment at a time
+    unsigned char * dst = map_.getCharMap();
+    for (unsigned int ty = 0; ty != tiles_y_; ty++) {
+      const unsigned int y_end = std::min(size_y, (ty + 1) * tile_size);
+      for (unsigned int tx = 0; tx != tiles_x_; tx++) {
+        const unsigned int x_begin = tx * tile_size;
+        const size_t width = std::min(size_x, x_begin + tile_size) - x_begin;
+        bool dirty = false;
+        for (unsigned int y = ty * tile_size; y != y_end; y++) {
+          const size_t offset = static_cast<size_t>(y) * size_x + x_begin;
+          if (std::memcmp(dst + offset, src + offset, width) != 0) {
+            std::memcpy(dst + offset, src + offset, width);
+            dirty = true;
+          }
+        }
+        if (dirty) {
+          markDirty(tx, ty, next_version);
+        }
+      }
+    }
+  }
+
+  changed_ = dirty_tiles_ != 0;
+  if (changed_) {
+    version_ = next_version;
+  }
+  return changed_;
+}
+
+void CostmapSnapshot::markDirty(unsigned int tx, unsigned int ty, uint64_t version)
+{
+  tile_versions_[static_cast<size_t>(ty) * tiles_x_ + tx] = version;
+
+  const unsigned int min_x = tx * tile_size;
+  const unsigned int min_y = ty * tile_size;
+  const unsigned int max_x = std::min(map_.getSizeInCellsX(), min_x + tile_size);
+  const unsigned int max_y = std::min(map_.getSizeInCellsY(), min_y + tile_size);
+  if (dirty_tiles_ == 0) {
+    dirty_min_x_ = min_x;
+    dirty_min_y_ = min_y;
+    dirty_max_x_ = max_x;
+    dirty_max_y_ = max_y;
+  } else {
+    dirty_min_x_ = std::min(dirty_min_x_, min_x);
+    dirty_min_y_ = std::min(dirty_min_y_, min_y);
+    dirty_max_x_ = std::max(dirty_max_x_, max_x);
+    dirty_max_y_ = std::max(dirty_max_y_, max_y);
+  }
+  dirty_tiles_++;
+}
+
+bool CostmapSnapshot::getDirtyBounds(
+  unsigned int & min_x, unsigned int & min_y, unsigned int & max_x, unsigned int & max_y) const
+{
+  if (dirty_tiles_ == 0) {
+    return false;
+  }
+
+  min_x = dirty_min_x_;
+  min_y = dirty_min_y_;
+  max_x = dirty_max_x_;
+  max_y = dirty_max_y_;
+  return true;
+}
+
+size_t CostmapSnapshot::getMemoryUsage() const
+{
+  const size_t cells = static_cast<size_t>(map_.getSizeInCellsX()) * map_.getSizeInCellsY();
+  return cells * sizeof(unsigned char) + tile_versions_.size() * sizeof(uint64_t);
+}
+
+}  // namespace mppi
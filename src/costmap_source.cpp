@@ -0,0 +1,135 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/costmap_source.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "nav2_costmap_2d/footprint.hpp"
+#include "nav2_costmap_2d/inflation_layer.hpp"
+
+namespace mppi
+{
+
+namespace
+{
+
+std::shared_ptr<nav2_costmap_2d::InflationLayer> findInflationLayer(
+  const std::shared_ptr<nav2_costmap_2d::Costmap2DROS> & costmap_ros)
+{
+  std::shared_ptr<nav2_costmap_2d::InflationLayer> result;
+  auto plugins = costmap_ros->getLayeredCostmap()->getPlugins();
+  for (auto layer = plugins->begin(); layer != plugins->end(); ++layer) {
+    auto inflation_layer = std::dynamic_pointer_cast<nav2_costmap_2d::InflationLayer>(*layer);
+    if (inflation_layer) {
+      result = inflation_layer;
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+CostmapSource::CostmapSource(std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros)
+: costmap_ros_(std::move(costmap_ros))
+{
+  costmap_ = costmap_ros_->getCostmap();
+}
+
+CostmapSource::CostmapSource(const HeadlessCostmap & costmap)
+: costmap_(costmap.costmap), headless_(costmap)
+{
+  if (!costmap_) {
+    throw std::runtime_error("Headless costmap source has no costmap!");
+  }
+  if (!headless_.footprint.empty()) {
+    nav2_costmap_2d::calculateMinAndMaxDistances(
+      headless_.footprint, inscribed_radius_, circumscribed_radius_);
+  }
+}
+
+std::vector<geometry_msgs::msg::Point> CostmapSource::getRobotFootprint() const
+{
+  return costmap_ros_ ? costmap_ros_->getRobotFootprint() : headless_.footprint;
+}
+
+double CostmapSource::getInscribedRadius() const
+{
+  return costmap_ros_ ?
+         costmap_ros_->getLayeredCostmap()->getInscribedRadius() : inscribed_radius_;
+}
+
+double CostmapSource::getCircumscribedRadius() const
+{
+  return costmap_ros_ ?
+         costmap_ros_->getLayeredCostmap()->getCircumscribedRadius() : circumscribed_radius_;
+}
+
+bool CostmapSource::isTrackingUnknown() const
+{
+  return costmap_ros_ ?
+         costmap_ros_->getLayeredCostmap()->isTrackingUnknown() : headless_.track_unknown;
+}
+
+std::string CostmapSource::getBaseFrameID() const
+{
+  return costmap_ros_ ? costmap_ros_->getBaseFrameID() : headless_.base_frame_id;
+}
+
+bool CostmapSource::getInflation(double & scaling_factor, double & radius) const
+{
+  if (!costmap_ros_) {
+    scaling_factor = headless_.inflation_scaling_factor;
+    radius = headless_.inflation_radius;
+    return scaling_factor > 0.0;
+  }
+
+  auto inflation_layer = findInflationLayer(costmap_ros_);
+  if (!inflation_layer) {
+    return false;
+  }
+  scaling_factor = inflation_layer->getCostScalingFactor();
+  radius = inflation_layer->getInflationRadius();
+  return true;
+}
+
+double CostmapSource::computeInflatedCost(double distance) const
+{
+  if (costmap_ros_) {
+    auto inflation_layer = findInflationLayer(costmap_ros_);
+    return inflation_layer ? inflation_layer->computeCost(distance) : -1.0;
+  }
+
+  if (headless_.inflation_scaling_factor <= 0.0) {
+    return -1.0;
+  }
+
+  // Decay of nav2_costmap_2d::InflationLayer::computeCost
+  using namespace nav2_costmap_2d;  // NOLINT
+  if (distance == 0.0) {
+    return LETHAL_OBSTACLE;
+  }
+  const double metric_distance = distance * costmap_->getResolution();
+  if (metric_distance <= inscribed_radius_) {
+    return INSCRIBED_INFLATED_OBSTACLE;
+  }
+  const double factor =
+    std::exp(-1.0 * headless_.inflation_scaling_factor * (metric_distance - inscribed_radius_));
+  return static_cast<unsigned char>((INSCRIBED_INFLATED_OBSTACLE - 1) * factor);
+}
+
+}  // namespace mppi
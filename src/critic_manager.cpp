@@ -14,49 +14,107 @@
 
 #include "mppic/critic_manager.hpp"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <xtensor/xnoalias.hpp>
+
+#include "mppic/critics/critic_registry.hpp"
+
 namespace mppi
 {
 
 void CriticManager::on_configure(
   rclcpp_lifecycle::LifecycleNode::WeakPtr parent, const std::string & name,
   std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros, ParametersHandler * param_handler)
+{
+  on_configure(parent, name, std::make_shared<CostmapSource>(costmap_ros), param_handler);
+}
+
+void CriticManager::on_configure(
+  rclcpp_lifecycle::LifecycleNode::WeakPtr parent, const std::string & name,
+  std::shared_ptr<CostmapSource> costmap_source, ParametersHandler * param_handler)
 {
   parent_ = parent;
-  costmap_ros_ = costmap_ros;
+  costmap_source_ = costmap_source;
+  costmap_ros_ = costmap_source_->getCostmapROS();
   name_ = name;
-  auto node = parent_.lock();
-  logger_ = node->get_logger();
+  if (auto node = parent_.lock()) {
+    logger_ = node->get_logger();
+  }
   parameters_handler_ = param_handler;
 
   getParams();
   loadCritics();
+
+  // Critics may be enabled or disabled dynamically, which only takes effect between cycles
+  active_critics_changed_ = true;
+  parameters_handler_->addPostCallback([this]() {active_critics_changed_ = true;});
 }
 
 void CriticManager::getParams()
 {
-  auto node = parent_.lock();
   auto getParam = parameters_handler_->getParamGetter(name_);
   getParam(critic_names_, "critics", std::vector<std::string>{}, ParameterType::Static);
+  getParam(parallel_critics_, "parallel_critics", false, ParameterType::Static);
+  getParam(fuse_critics_, "fuse_critics", false, ParameterType::Static);
+  getParam(
+    expensive_critic_names_, "watchdog_expensive_critics",
+    std::vector<std::string>{"PathAlignCritic"}, ParameterType::Static);
+
+  std::vector<std::string> critic_order;
+  getParam(critic_order, "critic_order", std::vector<std::string>{}, ParameterType::Static);
+
+  // Critics in critic_order go first, such as collision checks, so that the following
+  // critics can skip the trajectories found in collision. The others keep their order
+  std::vector<std::string> ordered_names;
+  for (const auto & name : critic_order) {
+    if (std::find(critic_names_.begin(), critic_names_.end(), name) == critic_names_.end()) {
+      RCLCPP_WARN(logger_, "Ordered critic %s is not in the critics list", name.c_str());
+      continue;
+    }
+    if (std::find(ordered_names.begin(), ordered_names.end(), name) == ordered_names.end()) {
+      ordered_names.push_back(name);
+    }
+  }
+  for (const auto & name : critic_names_) {
+    if (std::find(ordered_names.begin(), ordered_names.end(), name) == ordered_names.end()) {
+      ordered_names.push_back(name);
+    }
+  }
+  critic_names_ = ordered_names;
 }
 
 void CriticManager::loadCritics()
 {
-  if (!loader_) {
-    loader_ = std::make_unique<pluginlib::ClassLoader<critics::CriticFunction>>(
-      "mppic", "mppi::critics::CriticFunction");
-  }
-
   critics_.clear();
+  critic_latency_ids_.clear();
   for (auto name : critic_names_) {
     std::string fullname = getFullName(name);
-    auto instance = std::unique_ptr<critics::CriticFunction>(
-      loader_->createUnmanagedInstance(fullname));
+
+    // Only critics of other libraries need pluginlib to parse their descriptions and load
+    auto instance = critics::createBuiltinCritic(name);
+    if (!instance) {
+      if (!loader_) {
+        loader_ = std::make_unique<pluginlib::ClassLoader<critics::CriticFunction>>(
+          "mppic", "mppi::critics::CriticFunction");
+      }
+      instance.reset(loader_->createUnmanagedInstance(fullname));
+    }
     critics_.push_back(std::move(instance));
     critics_.back()->on_configure(
-      parent_, name_, name_ + "." + name, costmap_ros_,
+      parent_, name_, name_ + "." + name, costmap_source_,
       parameters_handler_);
+    if (latency_profiler_) {
+      critic_latency_ids_.push_back(latency_profiler_->addEntry(name));
+    }
     RCLCPP_INFO(logger_, "Critic loaded : %s", fullname.c_str());
   }
+
+  if (latency_profiler_ && fuse_critics_) {
+    fused_latency_id_ = latency_profiler_->addEntry("FusedCritics");
+  }
 }
 
 std::string CriticManager::getFullName(const std::string & name)
@@ -65,14 +123,161 @@ std::string CriticManager::getFullName(const std::string & name)
 }
 
 void CriticManager::evalTrajectoriesScores(
-  CriticData & data) const
+  CriticData & data, critics::CriticStage stage)
 {
-  for (size_t q = 0; q < critics_.size(); q++) {
+  updateActiveCritics();
+  if (parallel_critics_ && data.thread_pool && data.thread_pool->size() > 1 &&
+    scoringCritics(data).size() > 1)
+  {
+    evalTrajectoriesScoresConcurrently(data, stage);
+    return;
+  }
+
+  // Fusable critics only add their terms, scored together after the other critics
+  fused_scorer_.clear();
+  for (const size_t q : scoringCritics(data)) {
     if (data.fail_flag) {
       break;
     }
-    critics_[q]->score(data);
+    if (!critics_[q]->scoresIn(stage)) {
+      continue;
+    }
+    ScopedLatencyTimer timer(
+      latency_profiler_, latency_profiler_ ? critic_latency_ids_[q] : 0);
+    if (!fuse_critics_ || !critics_[q]->addFusedTerm(data, fused_scorer_)) {
+      critics_[q]->score(data);
+    }
   }
+
+  if (fused_scorer_.size() > 0 && !data.fail_flag) {
+    ScopedLatencyTimer timer(latency_profiler_, fused_latency_id_);
+    fused_scorer_.score(data);
+  }
+}
+
+void CriticManager::evalTrajectoriesScoresConcurrently(
+  CriticData & data, critics::CriticStage stage)
+{
+  if (data.fail_flag) {
+    return;
+  }
+
+  // Lazily computed shared fields are set up front, so critics only read them. Path
+  // costs are read from the cycle's snapshot if there is one
+  if (data.path.x.shape(0) > 0) {
+    utils::setPathFurthestPointIfNotSet(data);
+    utils::setPathCostsIfNotSet(data, *costmap_source_);
+  }
+
+  prepareCriticData(data);
+  const auto & scoring_critics = scoringCritics(data);
+  data.thread_pool->parallelFor(
+    scoring_critics.size(), [&](size_t begin, size_t end) {
+      for (size_t k = begin; k < end; k++) {
+        const size_t q = scoring_critics[k];
+        if (!critics_[q]->scoresIn(stage)) {
+          continue;
+        }
+        ScopedLatencyTimer timer(
+          latency_profiler_, latency_profiler_ ? critic_latency_ids_[q] : 0);
+        critics_[q]->score(*critic_data_[q]);
+      }
+    });
+
+  // Reduced in critic order, so the result does not depend on scheduling
+  for (const size_t q : scoring_critics) {
+    if (!critics_[q]->scoresIn(stage)) {
+      continue;
+    }
+    xt::noalias(data.costs) += critic_costs_[q];
+    data.fail_flag = data.fail_flag || critic_data_[q]->fail_flag;
+
+    const auto & dead = critic_data_[q]->dead_trajectories;
+    if (dead.size() == data.dead_trajectories.size()) {
+      for (size_t i = 0; i != dead.size(); i++) {
+        data.dead_trajectories[i] |= dead[i];
+      }
+    }
+  }
+}
+
+void CriticManager::updateActiveCritics()
+{
+  if (!active_critics_changed_) {
+    return;
+  }
+  active_critics_changed_ = false;
+
+  // Disabled critics are skipped altogether, rather than called to return early
+  active_critics_.clear();
+  degraded_critics_.clear();
+  for (size_t q = 0; q < critics_.size(); q++) {
+    if (!critics_[q]->isEnabled()) {
+      continue;
+    }
+    active_critics_.push_back(q);
+    const bool expensive = q < critic_names_.size() &&
+      std::find(
+      expensive_critic_names_.begin(), expensive_critic_names_.end(), critic_names_[q]) !=
+      expensive_critic_names_.end();
+    if (!expensive) {
+      degraded_critics_.push_back(q);
+    }
+  }
+}
+
+void CriticManager::prepareCriticData(const CriticData & data)
+{
+  if (critic_data_.size() != critics_.size()) {
+    critic_data_.clear();
+    critic_data_.resize(critics_.size());
+    critic_costs_.resize(critics_.size());
+  }
+
+  for (const size_t q : scoringCritics(data)) {
+    auto & costs = critic_costs_[q];
+    if (costs.shape() != data.costs.shape()) {
+      // Reserved for the whole batch storage, so an adaptive batch does not reallocate
+      costs.storage().reserve(data.costs.storage().capacity());
+      costs.resize(data.costs.shape());
+    }
+    costs.fill(0.0f);
+
+    auto & critic_data = critic_data_[q];
+    if (!critic_data || &critic_data->state != &data.state ||
+      &critic_data->trajectories != &data.trajectories || &critic_data->path != &data.path ||
+      &critic_data->model_dt != &data.model_dt)
+    {
+      critic_data.emplace(
+        CriticData{data.state, data.trajectories, data.path, costs, data.model_dt, false,
+          nullptr, nullptr, std::nullopt, std::nullopt});
+    }
+
+    // Every field but the references, in declaration order. Copy assignment reuses the
+    // storage of the previous cycle's path validity
+    critic_data->fail_flag = false;
+    critic_data->goal_checker = data.goal_checker;
+    critic_data->motion_model = data.motion_model;
+    critic_data->path_pts_valid = data.path_pts_valid;
+    critic_data->furthest_reached_path_point = data.furthest_reached_path_point;
+    // Critics already run concurrently, so each scores its batch inline
+    critic_data->thread_pool = nullptr;
+    critic_data->workspace = data.workspace;
+    critic_data->path_index = data.path_index;
+    critic_data->dead_trajectories = data.dead_trajectories;
+    critic_data->fast_math = data.fast_math;
+    critic_data->costmap_snapshot = data.costmap_snapshot;
+    critic_data->model_dts = data.model_dts;
+    critic_data->screening = data.screening;
+    critic_data->degraded = data.degraded;
+    critic_data->cycle_context = data.cycle_context;
+    critic_data->kernel_set = data.kernel_set;
+  }
+}
+
+void CriticManager::setLatencyProfiler(LatencyProfiler * profiler)
+{
+  latency_profiler_ = profiler;
 }
 
 }  // namespace mppi
@@ -41,37 +41,67 @@ void ConstraintCritic::initialize()
 
 void ConstraintCritic::score(CriticData & data)
 {
-  using xt::evaluation_strategy::immediate;
-
   if (!enabled_) {
     return;
   }
 
-  auto sgn = xt::where(data.state.vx > 0.0, 1.0, -1.0);
-  auto vel_total = sgn * xt::sqrt(data.state.vx * data.state.vx + data.state.vy * data.state.vy);
-  auto out_of_max_bounds_motion = xt::maximum(vel_total - max_vel_, 0);
-  auto out_of_min_bounds_motion = xt::maximum(min_vel_ - vel_total, 0);
+  ScratchBuffer sums_buffer(data.workspace, data.costs.shape(0));
+  auto & sums = *sums_buffer;
 
-  auto acker = dynamic_cast<AckermannMotionModel *>(data.motion_model.get());
-  if (acker != nullptr) {
-    auto & vx = data.state.vx;
-    auto & wz = data.state.wz;
-    auto out_of_turning_rad_motion = xt::maximum(
-      acker->getMinTurningRadius() - (xt::fabs(vx) / xt::fabs(wz)), 0.0);
-
-    data.costs += xt::pow(
-      xt::sum(
-        (std::move(out_of_max_bounds_motion) +
-        std::move(out_of_min_bounds_motion) +
-        std::move(out_of_turning_rad_motion)) *
-        data.model_dt, {1}, immediate) * weight_, power_);
+  auto scoreVelocities = [&](auto && vel_total) {
+      auto out_of_max_bounds_motion = xt::maximum(vel_total - max_vel_, 0);
+      auto out_of_min_bounds_motion = xt::maximum(min_vel_ - vel_total, 0);
+
+      auto acker = dynamic_cast<AckermannMotionModel *>(data.motion_model.get());
+      if (acker != nullptr) {
+        auto & vx = data.state.vx;
+        auto & wz = data.state.wz;
+        // Turning tighter than the minimum radius if |vx| < r * |wz|, so wz = 0 never divides
+        const float min_turning_r = acker->getMinTurningRadius();
+        auto out_of_turning_rad_motion = xt::where(
+          xt::fabs(vx) < min_turning_r * xt::fabs(wz),
+          min_turning_r - xt::fabs(vx) / xt::fabs(wz), 0.0f);
+
+        utils::sumOverTime(
+          std::move(out_of_max_bounds_motion) +
+          std::move(out_of_min_bounds_motion) +
+          std::move(out_of_turning_rad_motion), data, sums);
+        xt::noalias(data.costs) += xt::pow(sums * weight_, power_);
+      }
+
+      utils::sumOverTime(
+        std::move(out_of_max_bounds_motion) +
+        std::move(out_of_min_bounds_motion), data, sums);
+      xt::noalias(data.costs) += xt::pow(sums * weight_, power_);
+    };
+
+  // Without lateral motion, the signed total velocity is the longitudinal one
+  if (data.motion_model->isHolonomic()) {
+    auto sgn = xt::where(data.state.vx > 0.0, 1.0, -1.0);
+    scoreVelocities(
+      sgn * xt::sqrt(data.state.vx * data.state.vx + data.state.vy * data.state.vy));
+  } else {
+    scoreVelocities(data.state.vx);
+  }
+}
+
+bool ConstraintCritic::addFusedTerm(CriticData & data, FusedScorer & scorer)
+{
+  if (!enabled_) {
+    return true;
   }
 
-  data.costs += xt::pow(
-    xt::sum(
-      (std::move(out_of_max_bounds_motion) +
-      std::move(out_of_min_bounds_motion)) *
-      data.model_dt, {1}, immediate) * weight_, power_);
+  FusedTerm term;
+  term.type = FusedTerm::Type::Constraint;
+  term.weight = weight_;
+  term.power = power_;
+  term.max_vel = max_vel_;
+  term.min_vel = min_vel_;
+  term.holonomic = data.motion_model->isHolonomic();
+  auto acker = dynamic_cast<AckermannMotionModel *>(data.motion_model.get());
+  term.min_turning_r = acker != nullptr ? acker->getMinTurningRadius() : 0.0f;
+  scorer.add(term);
+  return true;
 }
 
 }  // namespace mppi::critics
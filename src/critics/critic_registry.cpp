@@ -0,0 +1,81 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "mppic/critics/critic_registry.hpp"
+
+#include <utility>
+
+#include "mppic/critics/constraint_critic.hpp"
+#include "mppic/critics/goal_angle_critic.hpp"
+#include "mppic/critics/goal_critic.hpp"
+#include "mppic/critics/obstacles_critic.hpp"
+#include "mppic/critics/path_align_critic.hpp"
+#include "mppic/critics/path_angle_critic.hpp"
+#include "mppic/critics/path_follow_critic.hpp"
+#include "mppic/critics/prefer_forward_critic.hpp"
+#include "mppic/critics/twirling_critic.hpp"
+
+namespace mppi::critics
+{
+
+namespace
+{
+
+using CriticFactory = std::unique_ptr<CriticFunction>(*)();
+
+template<typename CriticT>
+std::unique_ptr<CriticFunction> create()
+{
+  return std::make_unique<CriticT>();
+}
+
+// Every plugin of critics.xml, by class name
+const std::vector<std::pair<std::string, CriticFactory>> & registry()
+{
+  static const std::vector<std::pair<std::string, CriticFactory>> critics = {
+    {"ConstraintCritic", &create<ConstraintCritic>},
+    {"GoalAngleCritic", &create<GoalAngleCritic>},
+    {"GoalCritic", &create<GoalCritic>},
+    {"ObstaclesCritic", &create<ObstaclesCritic>},
+    {"PathAlignCritic", &create<PathAlignCritic>},
+    {"PathAngleCritic", &create<PathAngleCritic>},
+    {"PathFollowCritic", &create<PathFollowCritic>},
+    {"PreferForwardCritic", &create<PreferForwardCritic>},
+    {"TwirlingCritic", &create<TwirlingCritic>}};
+  return critics;
+}
+
+}  // namespace
+
+std::unique_ptr<CriticFunction> createBuiltinCritic(const std::string & name)
+{
+  for (const auto & [critic_name, factory] : registry()) {
+    if (critic_name == name) {
+      return factory();
+    }
+  }
+  return nullptr;
+}
+
+std::vector<std::string> builtinCriticNames()
+{
+  std::vector<std::string> names;
+  for (const auto & critic : registry()) {
+    names.push_back(critic.first);
+  }
+  return names;
+}
+
+}  // namespace mppi::critics
@@ -14,6 +14,10 @@
 
 #include "mppic/critics/goal_angle_critic.hpp"
 
+#include <cmath>
+
+#include "mppic/tools/fast_math.hpp"
+
 namespace mppi::critics
 {
 
@@ -39,20 +43,53 @@ void GoalAngleCritic::score(CriticData & data)
     return;
   }
 
-  if (!utils::withinPositionGoalTolerance(
-      threshold_to_consider_, data.state.pose.pose, data.path))
-  {
+  if (!utils::withinPositionGoalTolerance(threshold_to_consider_, data)) {
     return;
   }
 
   const auto goal_idx = data.path.x.shape(0) - 1;
   const float goal_yaw = data.path.yaws(goal_idx);
 
-  data.costs += xt::pow(
+  if (data.fast_math) {
+    const auto & yaws = data.trajectories.yaws;
+    const size_t time_steps = yaws.shape(1);
+    ScratchBuffer means_buffer(data.workspace, data.costs.shape(0));
+    auto & means = *means_buffer;
+    utils::meanOverTime(
+      data, means, [&](size_t i, size_t begin, size_t size, float * out) {
+        const float * row = yaws.data() + i * time_steps + begin;
+        for (size_t t = 0; t != size; t++) {
+          out[t] = goal_yaw - row[t];
+        }
+        fast_math::wrapAngles(out, out, size);
+        for (size_t t = 0; t != size; t++) {
+          out[t] = std::fabs(out[t]);
+        }
+      });
+    xt::noalias(data.costs) += xt::pow(means * weight_, power_);
+    return;
+  }
+
+  xt::noalias(data.costs) += xt::pow(
     xt::mean(xt::abs(utils::shortest_angular_distance(data.trajectories.yaws, goal_yaw)), {1}) *
     weight_, power_);
 }
 
+bool GoalAngleCritic::addFusedTerm(CriticData & data, FusedScorer & scorer)
+{
+  if (!enabled_ || !utils::withinPositionGoalTolerance(threshold_to_consider_, data)) {
+    return true;
+  }
+
+  FusedTerm term;
+  term.type = FusedTerm::Type::GoalAngle;
+  term.weight = weight_;
+  term.power = power_;
+  term.yaw = data.path.yaws(data.path.x.shape(0) - 1);
+  scorer.add(term);
+  return true;
+}
+
 }  // namespace mppi::critics
 
 #include <pluginlib/class_list_macros.hpp>
@@ -36,9 +36,7 @@ void GoalCritic::score(CriticData & data)
     return;
   }
 
-  if (!utils::withinPositionGoalTolerance(
-      threshold_to_consider_, data.state.pose.pose, data.path))
-  {
+  if (!utils::withinPositionGoalTolerance(threshold_to_consider_, data)) {
     return;
   }
 
@@ -54,7 +52,24 @@ void GoalCritic::score(CriticData & data)
     xt::pow(last_x - goal_x, 2) +
     xt::pow(last_y - goal_y, 2));
 
-  data.costs += xt::pow(std::move(dists) * weight_, power_);
+  xt::noalias(data.costs) += xt::pow(std::move(dists) * weight_, power_);
+}
+
+bool GoalCritic::addFusedTerm(CriticData & data, FusedScorer & scorer)
+{
+  if (!enabled_ || !utils::withinPositionGoalTolerance(threshold_to_consider_, data)) {
+    return true;
+  }
+
+  const auto goal_idx = data.path.x.shape(0) - 1;
+  FusedTerm term;
+  term.type = FusedTerm::Type::GoalDistance;
+  term.weight = weight_;
+  term.power = power_;
+  term.x = data.path.x(goal_idx);
+  term.y = data.path.y(goal_idx);
+  scorer.add(term);
+  return true;
 }
 
 }  // namespace mppi::critics
@@ -12,7 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <limits>
 #include "mppic/critics/obstacles_critic.hpp"
 
 namespace mppi::critics
@@ -28,9 +32,14 @@ void ObstaclesCritic::initialize()
   getParam(collision_cost_, "collision_cost", 10000.0);
   getParam(collision_margin_distance_, "collision_margin_distance", 0.10);
   getParam(near_goal_distance_, "near_goal_distance", 0.5);
+  getParam(use_distance_field_, "use_distance_field", false);
+  getParam(use_footprint_stencils_, "footprint_stencils", false);
+  getParam(clearance_skipping_, "clearance_skipping", false);
+  getParam(use_tiled_costmap_, "tiled_costmap", false);
+  check_footprint_ = consider_footprint_;
 
   collision_checker_.setCostmap(costmap_);
-  possibly_inscribed_cost_ = findCircumscribedCost(costmap_ros_);
+  possibly_inscribed_cost_ = findCircumscribedCost(*costmap_source_);
   RCLCPP_INFO(
     logger_,
     "ObstaclesCritic instantiated with %d power and %f / %f weights. "
@@ -39,27 +48,18 @@ void ObstaclesCritic::initialize()
     "footprint" : "circular");
 }
 
-double ObstaclesCritic::findCircumscribedCost(
-  std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap)
+double ObstaclesCritic::findCircumscribedCost(const CostmapSource & costmap)
 {
   double result = -1.0;
-  bool inflation_layer_found = false;
-  // check if the costmap has an inflation layer
-  for (auto layer = costmap->getLayeredCostmap()->getPlugins()->begin();
-    layer != costmap->getLayeredCostmap()->getPlugins()->end();
-    ++layer)
-  {
-    auto inflation_layer = std::dynamic_pointer_cast<nav2_costmap_2d::InflationLayer>(*layer);
-    if (!inflation_layer) {
-      continue;
-    }
-
-    inflation_layer_found = true;
-    const double circum_radius = costmap->getLayeredCostmap()->getCircumscribedRadius();
-    const double resolution = costmap->getCostmap()->getResolution();
-    result = inflation_layer->computeCost(circum_radius / resolution);
-    inflation_scale_factor_ = static_cast<float>(inflation_layer->getCostScalingFactor());
-    inflation_radius_ = static_cast<float>(inflation_layer->getInflationRadius());
+  double scale_factor = 0.0, radius = 0.0;
+  // check if the costmap is inflated, by an inflation layer or as given if headless
+  const bool inflation_layer_found = costmap.getInflation(scale_factor, radius);
+  if (inflation_layer_found) {
+    const double circum_radius = costmap.getCircumscribedRadius();
+    const double resolution = costmap.getCostmap()->getResolution();
+    result = costmap.computeInflatedCost(circum_radius / resolution);
+    inflation_scale_factor_ = static_cast<float>(scale_factor);
+    inflation_radius_ = static_cast<float>(radius);
   }
 
   if (!inflation_layer_found) {
@@ -78,7 +78,7 @@ double ObstaclesCritic::findCircumscribedCost(
 float ObstaclesCritic::distanceToObstacle(const CollisionCost & cost)
 {
   const float scale_factor = inflation_scale_factor_;
-  const float min_radius = costmap_ros_->getLayeredCostmap()->getInscribedRadius();
+  const float min_radius = costmap_source_->getInscribedRadius();
   float dist_to_obj = (scale_factor * min_radius - log(cost.cost) + log(253.0f)) / scale_factor;
 
   // If not footprint collision checking, the cost is using the center point cost and
@@ -90,6 +90,69 @@ float ObstaclesCritic::distanceToObstacle(const CollisionCost & cost)
   return dist_to_obj;
 }
 
+float ObstaclesCritic::distanceFieldClearance(float x, float y, float theta) const
+{
+  const float center_distance = fieldDistance(x, y);
+  if (!check_footprint_ || center_distance > circumscribed_radius_) {
+    return centerClearance(center_distance);
+  }
+  return footprintClearance(x, y, center_distance, cos(theta), sin(theta));
+}
+
+float ObstaclesCritic::distanceFieldClearance(
+  float x, float y, float cos_theta, float sin_theta) const
+{
+  const float center_distance = fieldDistance(x, y);
+  if (!check_footprint_ || center_distance > circumscribed_radius_) {
+    return centerClearance(center_distance);
+  }
+  return footprintClearance(x, y, center_distance, cos_theta, sin_theta);
+}
+
+float ObstaclesCritic::centerClearance(float center_distance) const
+{
+  const bool in_free_space = center_distance >= inflation_radius_;
+  const float dist_to_obj = center_distance - inscribed_radius_;
+  return in_free_space && dist_to_obj > 0.0f ? std::numeric_limits<float>::max() : dist_to_obj;
+}
+
+float ObstaclesCritic::footprintClearance(
+  float x, float y, float center_distance, float cos_theta, float sin_theta) const
+{
+  // The outline may touch an obstacle, but is bounded by the center distance
+  const bool in_free_space = center_distance >= inflation_radius_;
+  float clearance = center_distance + circumscribed_radius_;
+  for (const auto & sample : footprint_samples_) {
+    const float sample_x = x + sample.first * cos_theta - sample.second * sin_theta;
+    const float sample_y = y + sample.first * sin_theta + sample.second * cos_theta;
+    clearance = std::min(clearance, fieldDistance(sample_x, sample_y));
+    if (clearance <= 0.0f) {
+      return clearance;
+    }
+  }
+
+  return in_free_space ? std::numeric_limits<float>::max() : clearance;
+}
+
+void ObstaclesCritic::updateFootprintSamples()
+{
+  const auto footprint = costmap_source_->getRobotFootprint();
+  const float step = distance_field_.getResolution() / 2.0f;
+
+  footprint_samples_.clear();
+  for (size_t i = 0; i != footprint.size(); i++) {
+    const auto & start = footprint[i];
+    const auto & end = footprint[(i + 1) % footprint.size()];
+    const float dx = end.x - start.x;
+    const float dy = end.y - start.y;
+    const size_t steps = std::max<size_t>(1, std::ceil(std::hypot(dx, dy) / step));
+    for (size_t j = 0; j != steps; j++) {
+      const float ratio = static_cast<float>(j) / steps;
+      footprint_samples_.emplace_back(start.x + ratio * dx, start.y + ratio * dy);
+    }
+  }
+}
+
 void ObstaclesCritic::score(CriticData & data)
 {
   using xt::evaluation_strategy::immediate;
@@ -99,58 +162,199 @@ void ObstaclesCritic::score(CriticData & data)
 
   // If near the goal, don't apply the preferential term since the goal is near obstacles
   bool near_goal = false;
-  if (utils::withinPositionGoalTolerance(near_goal_distance_, data.state.pose.pose, data.path)) {
+  if (utils::withinPositionGoalTolerance(near_goal_distance_, data)) {
     near_goal = true;
   }
 
-  auto && raw_cost = xt::xtensor<float, 1>::from_shape({data.costs.shape(0)});
-  raw_cost.fill(0.0);
-  auto && repulsive_cost = xt::xtensor<float, 1>::from_shape({data.costs.shape(0)});
-  repulsive_cost.fill(0.0);
+  // Screening and degraded rollouts are only checked by their center point costs
+  check_footprint_ = consider_footprint_ && !data.screening && !data.degraded;
 
-  const size_t traj_len = data.trajectories.x.shape(1);
-  bool all_trajectories_collide = true;
-  for (size_t i = 0; i < data.trajectories.x.shape(0); ++i) {
-    bool trajectory_collide = false;
-    float traj_cost = 0.0;
-    const auto & traj = data.trajectories;
-    CollisionCost pose_cost;
-
-    for (size_t j = 0; j < traj_len; j++) {
-      pose_cost = costAtPose(traj.x(i, j), traj.y(i, j), traj.yaws(i, j));
-      if (pose_cost.cost < 1) {continue;}  // In free space
-
-      if (inCollision(pose_cost.cost)) {
-        trajectory_collide = true;
-        break;
-      }
+  // All lookups of this cycle go to its snapshot when there is one, else to the live map
+  costmap_ = data.costmap_snapshot ?
+    data.costmap_snapshot->getCostmap() : costmap_source_->getCostmap();
+  collision_checker_.setCostmap(costmap_);
+  if (!use_distance_field_) {
+    updateCostLookup();
+  }
 
-      // Cannot process repulsion if inflation layer does not exist
-      if (inflation_radius_ == 0 || inflation_scale_factor_ == 0) {
-        continue;
-      }
+  ScratchBuffer raw_cost_buffer(data.workspace, data.costs.shape(0));
+  ScratchBuffer repulsive_cost_buffer(data.workspace, data.costs.shape(0));
+  auto & raw_cost = *raw_cost_buffer;
+  auto & repulsive_cost = *repulsive_cost_buffer;
 
-      const float dist_to_obj = distanceToObstacle(pose_cost);
+  const size_t traj_len = data.trajectories.x.shape(1);
+  const bool yaw_trig = data.trajectories.hasYawTrig();
+  const bool track_dead = data.dead_trajectories.size() == data.costs.shape(0);
+  std::atomic<bool> all_trajectories_collide{true};
 
-      // Let near-collision trajectory points be punished severely
-      if (dist_to_obj < collision_margin_distance_) {
-        traj_cost += (collision_margin_distance_ - dist_to_obj);
-      } else if (!near_goal) {  // Generally prefer trajectories further from obstacles
-        repulsive_cost[i] += (inflation_radius_ - dist_to_obj);
-      }
+  // Rebuilt only when the footprint or the costmap geometry changed
+  if (check_footprint_ && use_footprint_stencils_ && !use_distance_field_) {
+    footprint_stencils_.update(costmap_source_->getRobotFootprint(), *costmap_);
+  }
+
+  // Rebuilt only when the costmap contents changed since the last cycle
+  bool field_rebuilt = false;
+  if (use_distance_field_) {
+    const bool track_unknown = costmap_source_->isTrackingUnknown();
+    field_rebuilt = data.costmap_snapshot ?
+      distance_field_.update(*data.costmap_snapshot) :
+      distance_field_.update(*costmap_, track_unknown);
+    if (field_rebuilt || footprint_samples_.empty()) {
+      inscribed_radius_ = costmap_source_->getInscribedRadius();
+      circumscribed_radius_ = costmap_source_->getCircumscribedRadius();
+      updateFootprintSamples();
     }
+  }
+  if (use_tiled_costmap_) {
+    updateTiledCostmap(data, field_rebuilt);
+  }
 
-    if (!trajectory_collide) {all_trajectories_collide = false;}
-    raw_cost[i] = static_cast<float>(trajectory_collide ? collision_cost_ : traj_cost);
+  // Points are at most a step of the fastest sample apart, so those within the clear
+  // radius of a point in free space are in free space too and need no lookup
+  const bool skip_clear_points = use_distance_field_ && clearance_skipping_;
+  float max_step = 0.0f, free_distance = 0.0f;
+  if (skip_clear_points) {
+    max_step = maxStep(data);
+    free_distance = std::max(
+      inflation_radius_, check_footprint_ ? circumscribed_radius_ : inscribed_radius_);
   }
 
-  data.costs += xt::pow(
+  auto scoreTrajectories = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        // Already found in collision by an earlier critic
+        if (track_dead && data.dead_trajectories[i]) {
+          raw_cost[i] = static_cast<float>(collision_cost_);
+          continue;
+        }
+
+        bool trajectory_collide = false;
+        float traj_cost = 0.0;
+        const auto & traj = data.trajectories;
+        CollisionCost pose_cost;
+        std::array<float, point_costs_block_> point_costs;
+
+        for (size_t j = 0; j < traj_len; j++) {
+          // Center costs are looked up a block of points at a time
+          const size_t block_idx = j % point_costs_block_;
+          if (!use_distance_field_ && block_idx == 0) {
+            const size_t block_size = std::min(point_costs_block_, traj_len - j);
+            if (use_tiled_costmap_) {
+              for (size_t k = 0; k != block_size; k++) {
+                point_costs[k] = tiled_costmap_.cost(
+                  traj.x(i, j + k), traj.y(i, j + k), nav2_costmap_2d::NO_INFORMATION);
+              }
+            } else {
+              utils::gatherCosts(
+                *costmap_, &traj.x(i, j), &traj.y(i, j), point_costs.data(), block_size,
+                nav2_costmap_2d::NO_INFORMATION, data.kernel_set);
+            }
+          }
+
+          float dist_to_obj;
+          if (use_distance_field_) {
+            dist_to_obj = yaw_trig ?
+              distanceFieldClearance(
+              traj.x(i, j), traj.y(i, j), traj.yaw_cos(i, j), traj.yaw_sin(i, j)) :
+              distanceFieldClearance(traj.x(i, j), traj.y(i, j), traj.yaws(i, j));
+            if (dist_to_obj <= 0.0f) {
+              trajectory_collide = true;
+              break;
+            }
+
+            // In free space, beyond the inflation of any obstacle
+            if (dist_to_obj == std::numeric_limits<float>::max()) {
+              if (skip_clear_points) {
+                j += clearPoints(traj.x(i, j), traj.y(i, j), free_distance, max_step);
+              }
+              continue;
+            }
+          } else {
+            pose_cost = costAtPose(
+              traj.x(i, j), traj.y(i, j), traj.yaws(i, j), point_costs[block_idx]);
+            if (pose_cost.cost < 1) {continue;}  // In free space
+
+            const auto & lookup = cost_lookup_[static_cast<unsigned char>(pose_cost.cost)];
+            if (lookup.collision) {
+              trajectory_collide = true;
+              break;
+            }
+
+            // Cannot process repulsion if inflation layer does not exist
+            if (inflation_radius_ == 0 || inflation_scale_factor_ == 0) {
+              continue;
+            }
+
+            dist_to_obj = pose_cost.using_footprint ?
+              lookup.footprint_distance : lookup.center_distance;
+          }
+
+          // Let near-collision trajectory points be punished severely
+          if (dist_to_obj < collision_margin_distance_) {
+            traj_cost += (collision_margin_distance_ - dist_to_obj);
+          } else if (!near_goal) {  // Generally prefer trajectories further from obstacles
+            repulsive_cost[i] += (inflation_radius_ - dist_to_obj);
+          }
+        }
+
+        if (!trajectory_collide) {all_trajectories_collide = false;}
+        if (trajectory_collide && track_dead) {data.dead_trajectories[i] = 1;}
+        raw_cost[i] = static_cast<float>(trajectory_collide ? collision_cost_ : traj_cost);
+      }
+    };
+
+  // Trajectories are scored independently, so the batch can be split across the workers
+  utils::parallelFor(data, data.trajectories.x.shape(0), scoreTrajectories);
+
+  xt::noalias(data.costs) += xt::pow(
     (critical_weight_ * raw_cost) +
     (repulsion_weight_ * repulsive_cost / traj_len),
     power_);
   data.fail_flag = all_trajectories_collide;
 }
 
+void ObstaclesCritic::updateTiledCostmap(const CriticData & data, bool field_rebuilt)
+{
+  // Only the distances are looked up along with the distance field, and they change with it
+  if (use_distance_field_ && !field_rebuilt && tiled_costmap_.hasDistances()) {
+    return;
+  }
+
+  // The snapshot records the tiles it changed, the live costmap is copied whole
+  if (data.costmap_snapshot) {
+    tiled_costmap_.update(*data.costmap_snapshot);
+  } else {
+    tiled_costmap_.update(*costmap_);
+  }
+  if (use_distance_field_) {
+    tiled_costmap_.updateDistances(distance_field_);
+  }
+}
+
+float ObstaclesCritic::maxStep(const CriticData & data)
+{
+  const auto & vx = data.state.vx;
+  const auto & vy = data.state.vy;
+  const float max_speed_sq = vy.shape() == vx.shape() ?
+    xt::amax(vx * vx + vy * vy)() : xt::amax(vx * vx)();
+  const float max_dt = data.model_dts ? xt::amax(*data.model_dts)() : data.model_dt;
+  // Slack for the rounding of the integration, and of fast_math's trigonometry
+  return 1.001f * std::sqrt(max_speed_sq) * max_dt;
+}
+
+size_t ObstaclesCritic::clearPoints(float x, float y, float free_distance, float max_step) const
+{
+  const float radius = distance_field_.clearRadius(x, y, free_distance);
+  if (radius <= 0.0f) {
+    return 0;
+  }
+  if (max_step <= 0.0f) {
+    return std::numeric_limits<size_t>::max() / 2;
+  }
+  // Strictly within the radius, as a point at the free distance may not be in free space
+  const float steps = std::min(radius / max_step, 1e6f);
+  return static_cast<size_t>(std::ceil(steps)) - 1;
+}
+
 /**
   * @brief Checks if cost represents a collision
   * @param cost Costmap cost
@@ -159,14 +363,14 @@ void ObstaclesCritic::score(CriticData & data)
 bool ObstaclesCritic::inCollision(float cost) const
 {
   bool is_tracking_unknown =
-    costmap_ros_->getLayeredCostmap()->isTrackingUnknown();
+    costmap_source_->isTrackingUnknown();
 
   switch (static_cast<unsigned char>(cost)) {
     using namespace nav2_costmap_2d; // NOLINT
     case (LETHAL_OBSTACLE):
       return true;
     case (INSCRIBED_INFLATED_OBSTACLE):
-      return consider_footprint_ ? false : true;
+      return check_footprint_ ? false : true;
     case (NO_INFORMATION):
       return is_tracking_unknown ? false : true;
   }
@@ -175,26 +379,52 @@ bool ObstaclesCritic::inCollision(float cost) const
 }
 
 CollisionCost ObstaclesCritic::costAtPose(float x, float y, float theta)
+{
+  float point_cost;
+  utils::gatherCosts(*costmap_, &x, &y, &point_cost, 1);
+  return costAtPose(x, y, theta, point_cost);
+}
+
+CollisionCost ObstaclesCritic::costAtPose(float x, float y, float theta, float point_cost)
 {
   CollisionCost collision_cost;
   float & cost = collision_cost.cost;
   collision_cost.using_footprint = false;
-  unsigned int x_i, y_i;
-  collision_checker_.worldToMap(x, y, x_i, y_i);
-  cost = collision_checker_.pointCost(x_i, y_i);
+  cost = point_cost;
 
-  if (consider_footprint_ && cost >= possibly_inscribed_cost_) {
-    cost = static_cast<float>(collision_checker_.footprintCostAtPose(
-        x, y, theta, costmap_ros_->getRobotFootprint()));
+  if (check_footprint_ && cost >= possibly_inscribed_cost_) {
     collision_cost.using_footprint = true;
+    // Poses whose outline may leave the map are checked exactly
+    if (use_footprint_stencils_ &&
+      footprint_stencils_.footprintCost(*costmap_, x, y, theta, cost))
+    {
+      return collision_cost;
+    }
+    cost = static_cast<float>(collision_checker_.footprintCostAtPose(
+        x, y, theta, costmap_source_->getRobotFootprint()));
   }
 
   return collision_cost;
 }
 
+void ObstaclesCritic::updateCostLookup()
+{
+  // Costs are whole, whether of a center point or of a footprint
+  const bool inflated = inflation_radius_ != 0 && inflation_scale_factor_ != 0;
+  for (size_t cost = 0; cost != cost_lookup_.size(); cost++) {
+    auto & lookup = cost_lookup_[cost];
+    lookup.collision = inCollision(static_cast<float>(cost));
+    if (!inflated || cost == 0) {
+      continue;
+    }
+    lookup.center_distance = distanceToObstacle({static_cast<float>(cost), false});
+    lookup.footprint_distance = distanceToObstacle({static_cast<float>(cost), true});
+  }
+}
+
 unsigned char ObstaclesCritic::maxCost()
 {
-  return consider_footprint_ ? nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE :
+  return check_footprint_ ? nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE :
          nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 1;
 }
 
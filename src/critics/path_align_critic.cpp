@@ -14,7 +14,6 @@
 
 #include "mppic/critics/path_align_critic.hpp"
 
-#include <xtensor/xfixed.hpp>
 #include <xtensor/xmath.hpp>
 
 namespace mppi::critics
@@ -45,9 +44,7 @@ void PathAlignCritic::initialize()
 void PathAlignCritic::score(CriticData & data)
 {
   // Don't apply close to goal, let the goal critics take over
-  if (!enabled_ ||
-    utils::withinPositionGoalTolerance(threshold_to_consider_, data.state.pose.pose, data.path))
-  {
+  if (!enabled_ || utils::withinPositionGoalTolerance(threshold_to_consider_, data)) {
     return;
   }
 
@@ -58,7 +55,7 @@ void PathAlignCritic::score(CriticData & data)
   }
 
   // Don't apply when dynamic obstacles are blocking significant proportions of the local path
-  utils::setPathCostsIfNotSet(data, costmap_ros_);
+  utils::setPathCostsIfNotSet(data, *costmap_source_);
   const size_t closest_initial_path_point = utils::findPathTrajectoryInitialPoint(data);
   unsigned int invalid_ctr = 0;
   const float range = *data.furthest_reached_path_point - closest_initial_path_point;
@@ -79,41 +76,60 @@ void PathAlignCritic::score(CriticData & data)
   const size_t time_steps = T_x.shape(1);
   const size_t traj_pts_eval = floor(time_steps / trajectory_point_step_);
   const size_t path_segments_count = data.path.x.shape(0) - 1;
-  auto && cost = xt::xtensor<float, 1>::from_shape({data.costs.shape(0)});
 
   if (path_segments_count < 1) {
     return;
   }
 
-  for (size_t t = 0; t < batch_size; ++t) {
-    float summed_dist = 0;
-    for (size_t p = trajectory_point_step_; p < time_steps; p += trajectory_point_step_) {
-      double min_dist_sq = std::numeric_limits<float>::max();
-      size_t min_s = 0;
-
-      // Find closest path segment to the trajectory point
-      for (size_t s = 0; s < path_segments_count - 1; s++) {
-        xt::xtensor_fixed<float, xt::xshape<2>> P;
-        float dx = P_x(s) - T_x(t, p);
-        float dy = P_y(s) - T_y(t, p);
-        float dist_sq = dx * dx + dy * dy;
-        if (dist_sq < min_dist_sq) {
-          min_dist_sq = dist_sq;
-          min_s = s;
+  ScratchBuffer cost_buffer(data.workspace, data.costs.shape(0));
+  auto & cost = *cost_buffer;
+
+  const bool track_dead = data.dead_trajectories.size() == batch_size;
+  auto scoreTrajectories = [&](size_t begin, size_t end) {
+      for (size_t t = begin; t < end; ++t) {
+        // Trajectories in collision get no weight, their alignment is irrelevant
+        if (track_dead && data.dead_trajectories[t]) {
+          cost[t] = 0.0f;
+          continue;
+        }
+
+        float summed_dist = 0;
+        for (size_t p = trajectory_point_step_; p < time_steps; p += trajectory_point_step_) {
+          double min_dist_sq = std::numeric_limits<float>::max();
+          size_t min_s = 0;
+
+          // Find closest path segment to the trajectory point
+          if (data.path_index) {
+            const auto nearest =
+              data.path_index->nearest(T_x(t, p), T_y(t, p), path_segments_count - 1);
+            min_dist_sq = nearest.dist_sq;
+            min_s = nearest.idx;
+          } else {
+            for (size_t s = 0; s < path_segments_count - 1; s++) {
+              float dx = P_x(s) - T_x(t, p);
+              float dy = P_y(s) - T_y(t, p);
+              float dist_sq = dx * dx + dy * dy;
+              if (dist_sq < min_dist_sq) {
+                min_dist_sq = dist_sq;
+                min_s = s;
+              }
+            }
+          }
+
+          // The nearest path point to align to needs to be not in collision, else
+          // let the obstacle critic take over in this region due to dynamic obstacles
+          if (min_s != 0 && (*data.path_pts_valid)[min_s]) {
+            summed_dist += std::sqrt(min_dist_sq);
+          }
         }
-      }
 
-      // The nearest path point to align to needs to be not in collision, else
-      // let the obstacle critic take over in this region due to dynamic obstacles
-      if (min_s != 0 && (*data.path_pts_valid)[min_s]) {
-        summed_dist += std::sqrt(min_dist_sq);
+        cost[t] = summed_dist / traj_pts_eval;
       }
-    }
+    };
 
-    cost[t] = summed_dist / traj_pts_eval;
-  }
+  utils::parallelFor(data, batch_size, scoreTrajectories);
 
-  data.costs += xt::pow(std::move(cost) * weight_, power_);
+  xt::noalias(data.costs) += xt::pow(cost * weight_, power_);
 }
 
 }  // namespace mppi::critics
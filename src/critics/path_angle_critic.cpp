@@ -16,6 +16,8 @@
 
 #include <math.h>
 
+#include "mppic/tools/fast_math.hpp"
+
 namespace mppi::critics
 {
 
@@ -41,12 +43,11 @@ void PathAngleCritic::initialize()
 
 void PathAngleCritic::score(CriticData & data)
 {
-  using xt::evaluation_strategy::immediate;
   if (!enabled_) {
     return;
   }
 
-  if (utils::withinPositionGoalTolerance(threshold_to_consider_, data.state.pose.pose, data.path)) {
+  if (utils::withinPositionGoalTolerance(threshold_to_consider_, data)) {
     return;
   }
 
@@ -62,13 +63,97 @@ void PathAngleCritic::score(CriticData & data)
     return;
   }
 
+  // Angle from the heading to the point, from the stored trig without wrapping:
+  // the heading-frame direction to the point is (cos * dx + sin * dy, cos * dy - sin * dx)
+  const auto & traj = data.trajectories;
+  const size_t time_steps = traj.x.shape(1);
+  if (traj.hasYawTrig() || data.fast_math) {
+    ScratchBuffer means_buffer(data.workspace, data.costs.shape(0));
+    auto & means = *means_buffer;
+    const bool yaw_trig = traj.hasYawTrig();
+    utils::meanOverTime(
+      data, means, [&](size_t i, size_t begin, size_t size, float * out) {
+        const size_t offset = i * time_steps + begin;
+        const float * x = traj.x.data() + offset;
+        const float * y = traj.y.data() + offset;
+        float dx[utils::time_block];
+        if (yaw_trig) {
+          const float * c = traj.yaw_cos.data() + offset;
+          const float * s = traj.yaw_sin.data() + offset;
+          for (size_t t = 0; t != size; t++) {
+            const float px = goal_x - x[t];
+            const float py = goal_y - y[t];
+            out[t] = c[t] * py - s[t] * px;
+            dx[t] = c[t] * px + s[t] * py;
+          }
+        } else {
+          for (size_t t = 0; t != size; t++) {
+            out[t] = goal_y - y[t];
+            dx[t] = goal_x - x[t];
+          }
+        }
+
+        if (data.fast_math) {
+          fast_math::atan2(out, dx, out, size);
+        } else {
+          for (size_t t = 0; t != size; t++) {
+            out[t] = std::atan2(out[t], dx[t]);
+          }
+        }
+
+        // Without the trig, the bearing of the point is taken relative to the yaws
+        if (!yaw_trig) {
+          const float * yaws = traj.yaws.data() + offset;
+          for (size_t t = 0; t != size; t++) {
+            out[t] -= yaws[t];
+          }
+          fast_math::wrapAngles(out, out, size);
+        }
+
+        for (size_t t = 0; t != size; t++) {
+          out[t] = std::fabs(out[t]);
+        }
+      });
+    xt::noalias(data.costs) += xt::pow(means * weight_, power_);
+    return;
+  }
+
   const auto yaws_between_points = xt::atan2(
     goal_y - data.trajectories.y,
     goal_x - data.trajectories.x);
   const auto yaws =
     xt::abs(utils::shortest_angular_distance(data.trajectories.yaws, yaws_between_points));
 
-  data.costs += xt::pow(xt::mean(yaws, {1}, immediate) * weight_, power_);
+  // Reduced lazily as the costs are accumulated, so no temporary is allocated
+  xt::noalias(data.costs) += xt::pow(xt::mean(yaws, {1}) * weight_, power_);
+}
+
+bool PathAngleCritic::addFusedTerm(CriticData & data, FusedScorer & scorer)
+{
+  if (!enabled_ || utils::withinPositionGoalTolerance(threshold_to_consider_, data)) {
+    return true;
+  }
+
+  utils::setPathFurthestPointIfNotSet(data);
+
+  auto offseted_idx = std::min(
+    *data.furthest_reached_path_point + offset_from_furthest_, data.path.x.shape(0) - 1);
+
+  const float goal_x = data.path.x(offseted_idx);
+  const float goal_y = data.path.y(offseted_idx);
+
+  if (utils::posePointAngle(data.state.pose.pose, goal_x, goal_y) < max_angle_to_furthest_) {
+    return true;
+  }
+
+  FusedTerm term;
+  term.type = FusedTerm::Type::PathAngle;
+  term.weight = weight_;
+  term.power = power_;
+  term.x = goal_x;
+  term.y = goal_y;
+  scorer.add(term);
+  return true;
 }
 
 }  // namespace mppi::critics
@@ -34,14 +34,12 @@ void PathFollowCritic::initialize()
 
 void PathFollowCritic::score(CriticData & data)
 {
-  if (!enabled_ ||
-    utils::withinPositionGoalTolerance(threshold_to_consider_, data.state.pose.pose, data.path))
-  {
+  if (!enabled_ || utils::withinPositionGoalTolerance(threshold_to_consider_, data)) {
     return;
   }
 
   utils::setPathFurthestPointIfNotSet(data);
-  utils::setPathCostsIfNotSet(data, costmap_ros_);
+  utils::setPathCostsIfNotSet(data, *costmap_source_);
   const size_t path_size = data.path.x.shape(0) - 1;
 
   auto offseted_idx = std::min(
@@ -67,7 +65,7 @@ void PathFollowCritic::score(CriticData & data)
     xt::pow(last_x - path_x, 2) +
     xt::pow(last_y - path_y, 2));
 
-  data.costs += xt::pow(weight_ * std::move(dists), power_);
+  xt::noalias(data.costs) += xt::pow(weight_ * std::move(dists), power_);
 }
 
 }  // namespace mppi::critics
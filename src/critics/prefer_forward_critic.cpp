@@ -32,21 +32,32 @@ void PreferForwardCritic::initialize()
 
 void PreferForwardCritic::score(CriticData & data)
 {
-  using xt::evaluation_strategy::immediate;
-
   if (!enabled_) {
     return;
   }
 
-  if (utils::withinPositionGoalTolerance(threshold_to_consider_, data.state.pose.pose, data.path)) {
+  if (utils::withinPositionGoalTolerance(threshold_to_consider_, data)) {
     return;
   }
 
-  auto backward_motion = xt::maximum(-data.state.vx, 0);
-  data.costs += xt::pow(
-    xt::sum(
-      std::move(
-        backward_motion) * data.model_dt, {1}, immediate) * weight_, power_);
+  ScratchBuffer sums_buffer(data.workspace, data.costs.shape(0));
+  auto & sums = *sums_buffer;
+  utils::sumOverTime(xt::maximum(-data.state.vx, 0), data, sums);
+  xt::noalias(data.costs) += xt::pow(sums * weight_, power_);
+}
+
+bool PreferForwardCritic::addFusedTerm(CriticData & data, FusedScorer & scorer)
+{
+  if (!enabled_ || utils::withinPositionGoalTolerance(threshold_to_consider_, data)) {
+    return true;
+  }
+
+  FusedTerm term;
+  term.type = FusedTerm::Type::PreferForward;
+  term.weight = weight_;
+  term.power = power_;
+  scorer.add(term);
+  return true;
 }
 
 }  // namespace mppi::critics
@@ -30,17 +30,31 @@ void TwirlingCritic::initialize()
 
 void TwirlingCritic::score(CriticData & data)
 {
-  using xt::evaluation_strategy::immediate;
   if (!enabled_) {
     return;
   }
 
-  if (utils::withinPositionGoalTolerance(data.goal_checker, data.state.pose.pose, data.path)) {
+  if (utils::withinPositionGoalTolerance(data)) {
     return;
   }
 
+  // Reduced lazily as the costs are accumulated, so no temporary is allocated
   const auto wz = xt::abs(data.state.wz);
-  data.costs += xt::pow(xt::mean(wz, {1}, immediate) * weight_, power_);
+  xt::noalias(data.costs) += xt::pow(xt::mean(wz, {1}) * weight_, power_);
+}
+
+bool TwirlingCritic::addFusedTerm(CriticData & data, FusedScorer & scorer)
+{
+  if (!enabled_ || utils::withinPositionGoalTolerance(data)) {
+    return true;
+  }
+
+  FusedTerm term;
+  term.type = FusedTerm::Type::Twirling;
+  term.weight = weight_;
+  term.power = power_;
+  scorer.add(term);
+  return true;
 }
 
 }  // namespace mppi::critics
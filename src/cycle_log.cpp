@@ -0,0 +1,319 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/cycle_log.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+namespace mppi
+{
+
+namespace
+{
+
+// Fields are stored in native byte order, as logs are replayed on similar machines
+constexpr char magic[8] = {'M', 'P', 'P', 'I', 'L', 'O', 'G', '\0'};
+constexpr uint32_t version = 1;
+
+enum CycleFlags : uint8_t
+{
+  HasGoalChecker = 1,
+  FullCostmap = 2,
+  Failed = 4
+};
+
+template<typename T>
+void put(std::ofstream & file, const T & value)
+{
+  file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+void putArray(std::ofstream & file, const T * values, size_t size)
+{
+  put(file, static_cast<uint32_t>(size));
+  file.write(reinterpret_cast<const char *>(values), size * sizeof(T));
+}
+
+template<typename T>
+void get(std::ifstream & file, T & value)
+{
+  file.read(reinterpret_cast<char *>(&value), sizeof(T));
+  if (!file) {
+    throw std::runtime_error("Cycle log is truncated!");
+  }
+}
+
+size_t getSize(std::ifstream & file)
+{
+  uint32_t size;
+  get(file, size);
+  return size;
+}
+
+template<typename T>
+void getArray(std::ifstream & file, T * values, size_t size)
+{
+  file.read(reinterpret_cast<char *>(values), size * sizeof(T));
+  if (!file) {
+    throw std::runtime_error("Cycle log is truncated!");
+  }
+}
+
+void putTwist(std::ofstream & file, const geometry_msgs::msg::Twist & twist)
+{
+  put(file, twist.linear.x);
+  put(file, twist.linear.y);
+  put(file, twist.angular.z);
+}
+
+void getTwist(std::ifstream & file, geometry_msgs::msg::Twist & twist)
+{
+  get(file, twist.linear.x);
+  get(file, twist.linear.y);
+  get(file, twist.angular.z);
+}
+
+}  // namespace
+
+void CycleRecorder::open(const std::string & file_path, int64_t noise_seed)
+{
+  close();
+  file_.open(file_path, std::ios::binary | std::ios::trunc);
+  if (!file_) {
+    throw std::runtime_error("Cannot write cycle log " + file_path + "!");
+  }
+  file_.write(magic, sizeof(magic));
+  put(file_, version);
+  put(file_, noise_seed);
+  recorded_costs_.clear();
+}
+
+void CycleRecorder::close()
+{
+  if (file_.is_open()) {
+    file_.close();
+  }
+}
+
+void CycleRecorder::capture(
+  const geometry_msgs::msg::PoseStamped & robot_pose,
+  const geometry_msgs::msg::Twist & robot_speed, const models::Path & plan,
+  nav2_core::GoalChecker * goal_checker, nav2_costmap_2d::Costmap2D & costmap,
+  const std::vector<geometry_msgs::msg::Point> & footprint)
+{
+  auto & c = cycle_;
+  c.robot_pose = robot_pose;
+  c.robot_speed = robot_speed;
+  c.plan = plan;
+  c.has_goal_checker = goal_checker != nullptr;
+  if (goal_checker) {
+    goal_checker->getTolerances(c.pose_tolerance, c.vel_tolerance);
+  }
+  c.footprint = footprint;
+
+  std::unique_lock<nav2_costmap_2d::Costmap2D::mutex_t> lock(*costmap.getMutex());
+  const unsigned char * src = costmap.getCharMap();
+  const size_t size = static_cast<size_t>(costmap.getSizeInCellsX()) * costmap.getSizeInCellsY();
+  c.full_costmap = recorded_costs_.size() != size ||
+    costmap.getSizeInCellsX() != c.size_x || costmap.getResolution() != c.resolution ||
+    costmap.getOriginX() != c.origin_x || costmap.getOriginY() != c.origin_y;
+  c.changed_cells.clear();
+
+  if (c.full_costmap) {
+    c.size_x = costmap.getSizeInCellsX();
+    c.size_y = costmap.getSizeInCellsY();
+    c.resolution = costmap.getResolution();
+    c.origin_x = costmap.getOriginX();
+    c.origin_y = costmap.getOriginY();
+    recorded_costs_.assign(src, src + size);
+    return;
+  }
+
+  for (size_t i = 0; i != size; i++) {
+    if (src[i] != recorded_costs_[i]) {
+      c.changed_cells.emplace_back(static_cast<uint32_t>(i), src[i]);
+      recorded_costs_[i] = src[i];
+    }
+  }
+}
+
+void CycleRecorder::write(const geometry_msgs::msg::Twist & cmd, bool failed, int64_t latency_ns)
+{
+  if (!file_.is_open()) {
+    return;
+  }
+
+  const auto & c = cycle_;
+  const uint8_t flags = (c.has_goal_checker ? HasGoalChecker : 0) |
+    (c.full_costmap ? FullCostmap : 0) | (failed ? Failed : 0);
+  put(file_, flags);
+  put(file_, latency_ns);
+
+  const auto & pose = c.robot_pose;
+  putArray(file_, pose.header.frame_id.data(), pose.header.frame_id.size());
+  put(file_, pose.header.stamp.sec);
+  put(file_, pose.header.stamp.nanosec);
+  put(file_, pose.pose.position.x);
+  put(file_, pose.pose.position.y);
+  put(file_, pose.pose.position.z);
+  put(file_, pose.pose.orientation.x);
+  put(file_, pose.pose.orientation.y);
+  put(file_, pose.pose.orientation.z);
+  put(file_, pose.pose.orientation.w);
+  putTwist(file_, c.robot_speed);
+
+  putArray(file_, c.plan.x.data(), c.plan.x.size());
+  file_.write(reinterpret_cast<const char *>(c.plan.y.data()), c.plan.y.size() * sizeof(float));
+  file_.write(
+    reinterpret_cast<const char *>(c.plan.yaws.data()), c.plan.yaws.size() * sizeof(float));
+
+  if (c.has_goal_checker) {
+    put(file_, c.pose_tolerance.position.x);
+    put(file_, c.pose_tolerance.position.y);
+    putTwist(file_, c.vel_tolerance);
+  }
+
+  put(file_, static_cast<uint32_t>(c.footprint.size()));
+  for (const auto & point : c.footprint) {
+    put(file_, point.x);
+    put(file_, point.y);
+  }
+
+  if (c.full_costmap) {
+    put(file_, c.size_x);
+    put(file_, c.size_y);
+    put(file_, c.resolution);
+    put(file_, c.origin_x);
+    put(file_, c.origin_y);
+    file_.write(reinterpret_cast<const char *>(recorded_costs_.data()), recorded_costs_.size());
+  } else {
+    put(file_, static_cast<uint32_t>(c.changed_cells.size()));
+    for (const auto & [index, cost] : c.changed_cells) {
+      put(file_, index);
+      put(file_, cost);
+    }
+  }
+
+  if (!failed) {
+    putTwist(file_, cmd);
+  }
+  file_.flush();
+}
+
+CycleLogReader::CycleLogReader(const std::string & file_path)
+: file_(file_path, std::ios::binary)
+{
+  char file_magic[sizeof(magic)];
+  uint32_t file_version = 0;
+  file_.read(file_magic, sizeof(file_magic));
+  file_.read(reinterpret_cast<char *>(&file_version), sizeof(file_version));
+  if (!file_ || std::memcmp(file_magic, magic, sizeof(magic)) != 0 || file_version != version) {
+    throw std::runtime_error("Cannot read cycle log " + file_path + "!");
+  }
+  get(file_, noise_seed_);
+}
+
+bool CycleLogReader::next(RecordedCycle & c)
+{
+  uint8_t flags;
+  if (!file_.read(reinterpret_cast<char *>(&flags), sizeof(flags))) {
+    return false;
+  }
+  c.has_goal_checker = flags & HasGoalChecker;
+  c.full_costmap = flags & FullCostmap;
+  c.failed = flags & Failed;
+  get(file_, c.latency_ns);
+
+  auto & pose = c.robot_pose;
+  pose.header.frame_id.resize(getSize(file_));
+  getArray(file_, pose.header.frame_id.data(), pose.header.frame_id.size());
+  get(file_, pose.header.stamp.sec);
+  get(file_, pose.header.stamp.nanosec);
+  get(file_, pose.pose.position.x);
+  get(file_, pose.pose.position.y);
+  get(file_, pose.pose.position.z);
+  get(file_, pose.pose.orientation.x);
+  get(file_, pose.pose.orientation.y);
+  get(file_, pose.pose.orientation.z);
+  get(file_, pose.pose.orientation.w);
+  getTwist(file_, c.robot_speed);
+
+  const size_t plan_size = getSize(file_);
+  c.plan.reset(plan_size);
+  getArray(file_, c.plan.x.data(), plan_size);
+  getArray(file_, c.plan.y.data(), plan_size);
+  getArray(file_, c.plan.yaws.data(), plan_size);
+
+  if (c.has_goal_checker) {
+    get(file_, c.pose_tolerance.position.x);
+    get(file_, c.pose_tolerance.position.y);
+    getTwist(file_, c.vel_tolerance);
+  }
+
+  c.footprint.resize(getSize(file_));
+  for (auto & point : c.footprint) {
+    get(file_, point.x);
+    get(file_, point.y);
+  }
+
+  c.changed_cells.clear();
+  if (c.full_costmap) {
+    get(file_, c.size_x);
+    get(file_, c.size_y);
+    get(file_, c.resolution);
+    get(file_, c.origin_x);
+    get(file_, c.origin_y);
+    c.costs.resize(static_cast<size_t>(c.size_x) * c.size_y);
+    getArray(file_, c.costs.data(), c.costs.size());
+  } else {
+    c.changed_cells.resize(getSize(file_));
+    for (auto & [index, cost] : c.changed_cells) {
+      get(file_, index);
+      get(file_, cost);
+    }
+  }
+
+  c.cmd = geometry_msgs::msg::Twist();
+  if (!c.failed) {
+    getTwist(file_, c.cmd);
+  }
+  return true;
+}
+
+void CycleLogReader::applyCostmap(
+  const RecordedCycle & cycle, nav2_costmap_2d::Costmap2D & costmap)
+{
+  std::unique_lock<nav2_costmap_2d::Costmap2D::mutex_t> lock(*costmap.getMutex());
+  unsigned char * dst = costmap.getCharMap();
+  if (cycle.full_costmap) {
+    costmap.resizeMap(
+      cycle.size_x, cycle.size_y, cycle.resolution, cycle.origin_x, cycle.origin_y);
+    dst = costmap.getCharMap();
+    std::memcpy(dst, cycle.costs.data(), cycle.costs.size());
+    return;
+  }
+
+  const size_t size = static_cast<size_t>(costmap.getSizeInCellsX()) * costmap.getSizeInCellsY();
+  for (const auto & [index, cost] : cycle.changed_cells) {
+    if (index >= size) {
+      throw std::runtime_error("Cycle log costmap change is out of the map!");
+    }
+    dst[index] = cost;
+  }
+}
+
+}  // namespace mppi
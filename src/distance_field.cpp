@@ -0,0 +1,172 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/distance_field.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#include "nav2_costmap_2d/cost_values.hpp"
+
+namespace mppi
+{
+
+namespace
+{
+
+constexpr float far_away = 1e20f;
+
+uint64_t mix(uint64_t hash, uint64_t value)
+{
+  return (hash ^ value) * 0x100000001b3ULL;
+}
+
+}  // namespace
+
+uint64_t DistanceField::fingerprint(
+  const nav2_costmap_2d::Costmap2D & costmap, bool track_unknown)
+{
+  const unsigned char * data = costmap.getCharMap();
+  const size_t size = static_cast<size_t>(costmap.getSizeInCellsX()) * costmap.getSizeInCellsY();
+
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  hash = mix(hash, costmap.getSizeInCellsX());
+  hash = mix(hash, costmap.getSizeInCellsY());
+  hash = mix(hash, std::hash<double>{}(costmap.getOriginX()));
+  hash = mix(hash, std::hash<double>{}(costmap.getOriginY()));
+  hash = mix(hash, std::hash<double>{}(costmap.getResolution()));
+  hash = mix(hash, track_unknown);
+
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash = mix(hash, word);
+  }
+  for (; i < size; i++) {
+    hash = mix(hash, data[i]);
+  }
+
+  return hash;
+}
+
+bool DistanceField::update(const nav2_costmap_2d::Costmap2D & costmap, bool track_unknown)
+{
+  const uint64_t print = fingerprint(costmap, track_unknown);
+  if (update_count_ > 0 && snapshot_version_ == 0 && print == fingerprint_) {
+    return false;
+  }
+
+  fingerprint_ = print;
+  snapshot_version_ = 0;
+  build(costmap, track_unknown);
+  return true;
+}
+
+bool DistanceField::update(const CostmapSnapshot & snapshot)
+{
+  if (update_count_ > 0 && snapshot_version_ == snapshot.version()) {
+    return false;
+  }
+
+  snapshot_version_ = snapshot.version();
+  build(snapshot.costmap(), snapshot.isTrackingUnknown());
+  return true;
+}
+
+void DistanceField::build(const nav2_costmap_2d::Costmap2D & costmap, bool track_unknown)
+{
+  update_count_++;
+
+  size_x_ = costmap.getSizeInCellsX();
+  size_y_ = costmap.getSizeInCellsY();
+  origin_x_ = static_cast<float>(costmap.getOriginX());
+  origin_y_ = static_cast<float>(costmap.getOriginY());
+  resolution_ = static_cast<float>(costmap.getResolution());
+  inv_resolution_ = 1.0f / resolution_;
+  outside_distance_ = track_unknown ? std::numeric_limits<float>::max() : 0.0f;
+
+  const size_t size = static_cast<size_t>(size_x_) * size_y_;
+  const size_t longest = std::max(size_x_, size_y_);
+  distances_.resize(size);
+  line_.resize(longest);
+  envelope_.resize(longest + 1);
+  vertices_.resize(longest);
+
+  const unsigned char * data = costmap.getCharMap();
+  for (size_t i = 0; i != size; i++) {
+    const bool obstacle = data[i] == nav2_costmap_2d::LETHAL_OBSTACLE ||
+      (!track_unknown && data[i] == nav2_costmap_2d::NO_INFORMATION);
+    distances_[i] = obstacle ? 0.0f : far_away;
+  }
+
+  // Separable squared transform over columns, then rows
+  for (unsigned int x = 0; x != size_x_; x++) {
+    transform1D(distances_.data() + x, size_y_, size_x_);
+  }
+  for (unsigned int y = 0; y != size_y_; y++) {
+    transform1D(distances_.data() + static_cast<size_t>(y) * size_x_, size_x_, 1);
+  }
+
+  for (auto & distance : distances_) {
+    distance = std::sqrt(distance) * resolution_;
+  }
+}
+
+void DistanceField::transform1D(float * f, size_t size, size_t stride)
+{
+  if (size == 0) {
+    return;
+  }
+
+  for (size_t q = 0; q != size; q++) {
+    line_[q] = f[q * stride];
+  }
+
+  // Lower envelope of the parabolas rooted at each sample
+  int k = 0;
+  vertices_[0] = 0;
+  envelope_[0] = -far_away;
+  envelope_[1] = far_away;
+  for (int q = 1; q < static_cast<int>(size); q++) {
+    auto intersection = [&](int v) {
+        return ((line_[q] + q * q) - (line_[v] + v * v)) / static_cast<float>(2 * q - 2 * v);
+      };
+
+    // Terminates at k == 0 since envelope_[0] is below any intersection
+    float s = intersection(vertices_[k]);
+    while (s <= envelope_[k]) {
+      k--;
+      s = intersection(vertices_[k]);
+    }
+
+    k++;
+    vertices_[k] = q;
+    envelope_[k] = s;
+    envelope_[k + 1] = far_away;
+  }
+
+  k = 0;
+  for (int q = 0; q < static_cast<int>(size); q++) {
+    while (envelope_[k + 1] < q) {
+      k++;
+    }
+    const int v = vertices_[k];
+    f[q * stride] = static_cast<float>((q - v) * (q - v)) + line_[v];
+  }
+}
+
+}  // namespace mppi
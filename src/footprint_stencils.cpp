@@ -0,0 +1,126 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/footprint_stencils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "nav2_util/line_iterator.hpp"
+
+namespace mppi
+{
+
+bool FootprintStencils::update(
+  const std::vector<geometry_msgs::msg::Point> & footprint,
+  const nav2_costmap_2d::Costmap2D & costmap)
+{
+  const bool same_footprint = footprint.size() == footprint_.size() &&
+    std::equal(
+    footprint.begin(), footprint.end(), footprint_.begin(),
+    [](const auto & a, const auto & b) {return a.x == b.x && a.y == b.y;});
+  if (same_footprint && !bin_starts_.empty() && costmap.getResolution() == resolution_ &&
+    costmap.getSizeInCellsX() == size_x_ && costmap.getSizeInCellsY() == size_y_)
+  {
+    return false;
+  }
+
+  footprint_ = footprint;
+  resolution_ = costmap.getResolution();
+  size_x_ = costmap.getSizeInCellsX();
+  size_y_ = costmap.getSizeInCellsY();
+
+  double radius = 0.0;
+  for (const auto & point : footprint_) {
+    radius = std::max(radius, std::hypot(point.x, point.y));
+  }
+  const size_t bins = std::max<size_t>(8, std::ceil(2.0 * M_PI * radius / resolution_));
+
+  bin_starts_.assign(1, 0);
+  offsets_.clear();
+  extent_ = 0;
+  std::vector<std::pair<int, int>> cells;
+  for (size_t b = 0; b != bins; b++) {
+    // As the collision checker maps the outline of a pose at the center of its cell
+    const double yaw = 2.0 * M_PI * static_cast<double>(b) / static_cast<double>(bins);
+    const double cos_yaw = std::cos(yaw);
+    const double sin_yaw = std::sin(yaw);
+    auto toCell = [&](const geometry_msgs::msg::Point & point) {
+        const double rx = point.x * cos_yaw - point.y * sin_yaw;
+        const double ry = point.x * sin_yaw + point.y * cos_yaw;
+        return std::make_pair(
+          static_cast<int>(std::floor(0.5 + rx / resolution_)),
+          static_cast<int>(std::floor(0.5 + ry / resolution_)));
+      };
+
+    cells.clear();
+    for (size_t i = 0; i != footprint_.size(); i++) {
+      const auto start = toCell(footprint_[i]);
+      const auto end = toCell(footprint_[(i + 1) % footprint_.size()]);
+      for (nav2_util::LineIterator line(start.first, start.second, end.first, end.second);
+        line.isValid(); line.advance())
+      {
+        cells.emplace_back(line.getX(), line.getY());
+      }
+    }
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+    for (const auto & [dx, dy] : cells) {
+      offsets_.push_back(dy * static_cast<int>(size_x_) + dx);
+      extent_ = std::max({extent_, std::abs(dx), std::abs(dy)});
+    }
+    bin_starts_.push_back(offsets_.size());
+  }
+  return true;
+}
+
+bool FootprintStencils::footprintCost(
+  const nav2_costmap_2d::Costmap2D & costmap, float x, float y, float theta,
+  float & cost) const
+{
+  unsigned int mx, my;
+  if (bin_starts_.empty() || !costmap.worldToMap(x, y, mx, my)) {
+    return false;
+  }
+  const int cx = static_cast<int>(mx);
+  const int cy = static_cast<int>(my);
+  if (cx < extent_ || cy < extent_ || cx + extent_ >= static_cast<int>(size_x_) ||
+    cy + extent_ >= static_cast<int>(size_y_))
+  {
+    return false;
+  }
+
+  const size_t bins = getBinCount();
+  float turns = theta / static_cast<float>(2.0 * M_PI);
+  turns -= std::floor(turns);
+  const size_t bin = static_cast<size_t>(turns * bins + 0.5f) % bins;
+
+  // Branch-free over the outline, which is inside the map
+  const unsigned char * center = costmap.getCharMap() + my * size_x_ + mx;
+  unsigned char max_cost = 0;
+  bool lethal = false;
+  for (size_t k = bin_starts_[bin]; k != bin_starts_[bin + 1]; k++) {
+    const unsigned char cell_cost = center[offsets_[k]];
+    max_cost = std::max(max_cost, cell_cost);
+    lethal |= cell_cost == nav2_costmap_2d::LETHAL_OBSTACLE;
+  }
+  cost = lethal ? nav2_costmap_2d::LETHAL_OBSTACLE : max_cost;
+  return true;
+}
+
+}  // namespace mppi
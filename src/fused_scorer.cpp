@@ -0,0 +1,170 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/fused_scorer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "mppic/tools/fast_math.hpp"
+#include "mppic/tools/utils.hpp"
+
+namespace mppi
+{
+
+namespace
+{
+
+// Same wrapping as utils::normalize_angles
+inline float normalizeAngle(float angle)
+{
+  const float theta = std::fmod(angle + static_cast<float>(M_PI), static_cast<float>(2.0 * M_PI));
+  return theta <= 0.0f ? theta + static_cast<float>(M_PI) : theta - static_cast<float>(M_PI);
+}
+
+inline float power(float value, unsigned int exponent)
+{
+  float result = 1.0f;
+  for (unsigned int e = 0; e != exponent; e++) {
+    result *= value;
+  }
+  return result;
+}
+
+}  // namespace
+
+void FusedScorer::score(CriticData & data) const
+{
+  if (terms_.empty()) {
+    return;
+  }
+
+  const bool track_dead = data.dead_trajectories.size() == data.costs.shape(0);
+  utils::parallelFor(
+    data, data.costs.shape(0), [&](size_t begin, size_t end) {
+      for (size_t i = begin; i != end; i++) {
+        if (track_dead && data.dead_trajectories[i]) {
+          continue;
+        }
+        float cost = 0.0f;
+        for (const auto & term : terms_) {
+          cost += scoreTrajectory(term, data, i);
+        }
+        data.costs(i) += cost;
+      }
+    });
+}
+
+float FusedScorer::scoreTrajectory(
+  const FusedTerm & term, const CriticData & data, size_t i) const
+{
+  const size_t time_steps = data.trajectories.x.shape(1);
+  const size_t row = i * time_steps;
+  const float * x = data.trajectories.x.data() + row;
+  const float * y = data.trajectories.y.data() + row;
+  const float * yaws = data.trajectories.yaws.data() + row;
+  const bool yaw_trig = data.trajectories.hasYawTrig();
+  const float * yaw_cos = yaw_trig ? data.trajectories.yaw_cos.data() + row : nullptr;
+  const float * yaw_sin = yaw_trig ? data.trajectories.yaw_sin.data() + row : nullptr;
+  const float * vx = data.state.vx.data() + row;
+  // Lateral velocities are only stored for holonomic models
+  const float * vy = data.state.vy.size() != 0 ? data.state.vy.data() + row : nullptr;
+  const float * wz = data.state.wz.data() + row;
+  // Time integrals weight each point by its own time step if they are not uniform
+  const float * dts = data.model_dts ? data.model_dts->data() : nullptr;
+  const float dt = dts ? 1.0f : data.model_dt;
+
+  float sum = 0.0f;
+  switch (term.type) {
+    case FusedTerm::Type::GoalDistance:
+      {
+        const float dx = x[time_steps - 1] - term.x;
+        const float dy = y[time_steps - 1] - term.y;
+        return power(std::sqrt(dx * dx + dy * dy) * term.weight, term.power);
+      }
+
+    case FusedTerm::Type::GoalAngle:
+      for (size_t t = 0; t != time_steps; t++) {
+        sum += std::fabs(
+          data.fast_math ? fast_math::wrapAngle(term.yaw - yaws[t]) :
+          normalizeAngle(term.yaw - yaws[t]));
+      }
+      return power(sum / time_steps * term.weight, term.power);
+
+    case FusedTerm::Type::PathAngle:
+      for (size_t t = 0; t != time_steps; t++) {
+        if (yaw_trig) {
+          // As PathAngleCritic, the angle to the point in the heading frame
+          const float dx = term.x - x[t];
+          const float dy = term.y - y[t];
+          const float lateral = yaw_cos[t] * dy - yaw_sin[t] * dx;
+          const float forward = yaw_cos[t] * dx + yaw_sin[t] * dy;
+          sum += std::fabs(
+            data.fast_math ? fast_math::atan2(lateral, forward) : std::atan2(lateral, forward));
+          continue;
+        }
+        if (data.fast_math) {
+          const float yaw_to_point = fast_math::atan2(term.y - y[t], term.x - x[t]);
+          sum += std::fabs(fast_math::wrapAngle(yaw_to_point - yaws[t]));
+          continue;
+        }
+        const float yaw_to_point = std::atan2(term.y - y[t], term.x - x[t]);
+        sum += std::fabs(normalizeAngle(yaw_to_point - yaws[t]));
+      }
+      return power(sum / time_steps * term.weight, term.power);
+
+    case FusedTerm::Type::Twirling:
+      for (size_t t = 0; t != time_steps; t++) {
+        sum += std::fabs(wz[t]);
+      }
+      return power(sum / time_steps * term.weight, term.power);
+
+    case FusedTerm::Type::PreferForward:
+      for (size_t t = 0; t != time_steps; t++) {
+        sum += std::max(-vx[t], 0.0f) * (dts ? dts[t] : 1.0f);
+      }
+      return power(sum * dt * term.weight, term.power);
+
+    case FusedTerm::Type::Constraint:
+      {
+        float turning_sum = 0.0f;
+        for (size_t t = 0; t != time_steps; t++) {
+          float vel_total = vx[t];
+          if (term.holonomic) {
+            const float sgn = vx[t] > 0.0f ? 1.0f : -1.0f;
+            vel_total = sgn * std::sqrt(vx[t] * vx[t] + vy[t] * vy[t]);
+          }
+          const float step = dts ? dts[t] : 1.0f;
+          sum += (std::max(vel_total - term.max_vel, 0.0f) +
+            std::max(term.min_vel - vel_total, 0.0f)) * step;
+          const float abs_vx = std::fabs(vx[t]);
+          const float abs_wz = std::fabs(wz[t]);
+          if (term.min_turning_r > 0.0f && abs_vx < term.min_turning_r * abs_wz) {
+            turning_sum += (term.min_turning_r - abs_vx / abs_wz) * step;
+          }
+        }
+
+        // As ConstraintCritic, which adds the ackermann cost on top of the bounds cost
+        float cost = power(sum * dt * term.weight, term.power);
+        if (term.min_turning_r > 0.0f) {
+          cost += power((sum + turning_sum) * dt * term.weight, term.power);
+        }
+        return cost;
+      }
+  }
+
+  return 0.0f;
+}
+
+}  // namespace mppi
@@ -0,0 +1,94 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/gaussian_sampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mppi
+{
+
+namespace
+{
+
+uint64_t splitMix64(uint64_t & state)
+{
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+}  // namespace
+
+void GaussianSampler::seed(uint64_t seed)
+{
+  // Decorrelated lane states from a single seed, as recommended for xoshiro
+  uint64_t state = seed;
+  for (size_t l = 0; l != lanes_; l++) {
+    const uint64_t a = splitMix64(state);
+    const uint64_t b = splitMix64(state);
+    s0_[l] = static_cast<uint32_t>(a);
+    s1_[l] = static_cast<uint32_t>(a >> 32);
+    s2_[l] = static_cast<uint32_t>(b);
+    s3_[l] = static_cast<uint32_t>(b >> 32) | 1u;  // Never all zero
+  }
+}
+
+void GaussianSampler::nextUniforms(std::array<float, lanes_> & uniforms)
+{
+  // Plain loops over the lanes so the compiler vectorizes the integer streams
+  for (size_t l = 0; l != lanes_; l++) {
+    const uint32_t result = s0_[l] + s3_[l];
+    const uint32_t t = s1_[l] << 9;
+    s2_[l] ^= s0_[l];
+    s3_[l] ^= s1_[l];
+    s1_[l] ^= s2_[l];
+    s0_[l] ^= s3_[l];
+    s2_[l] ^= t;
+    s3_[l] = (s3_[l] << 11) | (s3_[l] >> 21);
+
+    // Top 24 bits to a float in (0, 1], so the log below is finite
+    uniforms[l] = static_cast<float>((result >> 8) + 1) * (1.0f / 16777216.0f);
+  }
+}
+
+void GaussianSampler::nextNormals(float * out, float std_dev)
+{
+  std::array<float, lanes_> u1, u2;
+  nextUniforms(u1);
+  nextUniforms(u2);
+
+  kernels::boxMuller(
+    kernels_ ? *kernels_ : kernels::baselineKernels(), u1.data(), u2.data(), out,
+    out + lanes_, lanes_, std_dev);
+}
+
+void GaussianSampler::fill(float * data, size_t size, float std_dev)
+{
+  constexpr size_t block = 2 * lanes_;
+  size_t i = 0;
+  for (; i + block <= size; i += block) {
+    nextNormals(data + i, std_dev);
+  }
+
+  if (i < size) {
+    std::array<float, block> tail;
+    nextNormals(tail.data(), std_dev);
+    std::copy(tail.begin(), tail.begin() + (size - i), data + i);
+  }
+}
+
+}  // namespace mppi
@@ -0,0 +1,218 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "mppic/tools/kernels_impl.hpp"
+
+namespace mppi::kernels
+{
+
+// Wider kernel sets, each defined in its own translation unit built with its flags
+#ifdef MPPIC_KERNELS_AVX512
+const KernelSet & avx512Kernels();
+#endif
+#ifdef MPPIC_KERNELS_AVX2
+const KernelSet & avx2Kernels();
+#endif
+#ifdef MPPIC_KERNELS_SSE4_2
+const KernelSet & sse4_2Kernels();
+#endif
+
+namespace
+{
+
+std::vector<const KernelSet *> availableKernelSets()
+{
+  std::vector<const KernelSet *> kernel_sets;
+  [[maybe_unused]] const auto cpu = xsimd::available_architectures();
+#ifdef MPPIC_KERNELS_AVX512
+  if (cpu.avx512bw) {
+    kernel_sets.push_back(&avx512Kernels());
+  }
+#endif
+#ifdef MPPIC_KERNELS_AVX2
+  if (cpu.fma3_avx2) {
+    kernel_sets.push_back(&avx2Kernels());
+  }
+#endif
+#ifdef MPPIC_KERNELS_SSE4_2
+  if (cpu.sse4_2) {
+    kernel_sets.push_back(&sse4_2Kernels());
+  }
+#endif
+  kernel_sets.push_back(&baselineKernels());
+  return kernel_sets;
+}
+
+template<bool Holonomic, bool FastMath>
+void integrateRemainingRows(const RolloutView & view, size_t begin, size_t end)
+{
+  size_t row = begin;
+  auto load_row = [&](const float * tensor, size_t t) {
+      return tensor[row * view.time_steps + t];
+    };
+
+  auto store_row = [&](float * tensor, size_t t, float value) {
+      tensor[row * view.time_steps + t] = value;
+    };
+
+  for (; row < end; row++) {
+    detail::integrateLanes<float, Holonomic, FastMath>(view, load_row, store_row);
+  }
+}
+
+template<bool Holonomic>
+void accelerateRemainingRows(const DynamicsView & view, size_t begin, size_t end)
+{
+  size_t row = begin;
+  auto load_row = [&](const float * tensor, size_t t) {
+      return tensor[row * view.time_steps + t];
+    };
+
+  auto store_row = [&](float * tensor, size_t t, float value) {
+      tensor[row * view.time_steps + t] = value;
+    };
+
+  for (; row < end; row++) {
+    detail::accelerateLanes<float, Holonomic>(view, load_row, store_row);
+  }
+}
+
+}  // namespace
+
+const KernelSet & baselineKernels()
+{
+  static const KernelSet kernel_set = detail::makeKernelSet<xsimd::default_arch>("baseline");
+  return kernel_set;
+}
+
+std::vector<std::string> availableKernels()
+{
+  std::vector<std::string> names;
+  for (const auto * kernel_set : availableKernelSets()) {
+    names.emplace_back(kernel_set->name);
+  }
+  return names;
+}
+
+const KernelSet & selectKernels(const std::string & name)
+{
+  const auto kernel_sets = availableKernelSets();
+  if (name == "auto") {
+    return *kernel_sets.front();
+  }
+
+  std::string available;
+  for (const auto * kernel_set : kernel_sets) {
+    if (name == kernel_set->name) {
+      return *kernel_set;
+    }
+    available += std::string(available.empty() ? "" : ", ") + kernel_set->name;
+  }
+
+  throw std::runtime_error(
+          "SIMD kernels " + name + " are not available on this CPU! Valid options are auto, " +
+          available);
+}
+
+void integrate(
+  const KernelSet & kernel_set, const RolloutView & view, size_t begin, size_t end,
+  bool is_holonomic, bool fast_math)
+{
+  const size_t first = begin + kernel_set.integrate(view, begin, end, is_holonomic, fast_math);
+  if (is_holonomic && fast_math) {
+    integrateRemainingRows<true, true>(view, first, end);
+  } else if (is_holonomic) {
+    integrateRemainingRows<true, false>(view, first, end);
+  } else if (fast_math) {
+    integrateRemainingRows<false, true>(view, first, end);
+  } else {
+    integrateRemainingRows<false, false>(view, first, end);
+  }
+}
+
+void limitAcceleration(
+  const KernelSet & kernel_set, const DynamicsView & view, size_t begin, size_t end,
+  bool is_holonomic)
+{
+  const size_t first = begin + kernel_set.limit_acceleration(view, begin, end, is_holonomic);
+  if (is_holonomic) {
+    accelerateRemainingRows<true>(view, first, end);
+  } else {
+    accelerateRemainingRows<false>(view, first, end);
+  }
+}
+
+void gatherCosts(
+  const KernelSet & kernel_set, const CostmapView & costmap, const float * x, const float * y,
+  float * costs, size_t size)
+{
+  const float max_x = static_cast<float>(costmap.size_x);
+  const float max_y = static_cast<float>(costmap.size_y);
+  for (size_t i = kernel_set.gather_costs(costmap, x, y, costs, size); i < size; i++) {
+    const float fx = (x[i] - costmap.origin_x) / costmap.resolution;
+    const float fy = (y[i] - costmap.origin_y) / costmap.resolution;
+    if (!(fx >= 0.0f && fy >= 0.0f && fx < max_x && fy < max_y)) {
+      costs[i] = costmap.out_of_bounds_cost;
+      continue;
+    }
+    costs[i] =
+      costmap.char_map[static_cast<size_t>(fy) * costmap.size_x + static_cast<size_t>(fx)];
+  }
+}
+
+void boxMuller(
+  const KernelSet & kernel_set, const float * u1, const float * u2, float * cos_out,
+  float * sin_out, size_t size, float std_dev)
+{
+  for (size_t i = kernel_set.box_muller(u1, u2, cos_out, sin_out, size, std_dev); i < size; i++) {
+    const float radius = std::sqrt(-2.0f * std::log(u1[i])) * std_dev;
+    const float angle = static_cast<float>(2.0 * M_PI) * u2[i];
+    cos_out[i] = radius * std::cos(angle);
+    sin_out[i] = radius * std::sin(angle);
+  }
+}
+
+void weightedSum(
+  const KernelSet & kernel_set, float weight, const float * values, float * sum, float * sq_sum,
+  size_t size)
+{
+  for (size_t i = kernel_set.weighted_sum(weight, values, sum, sq_sum, size); i < size; i++) {
+    const float weighted = weight * values[i];
+    sum[i] += weighted;
+    if (sq_sum) {
+      sq_sum[i] += weighted * values[i];
+    }
+  }
+}
+
+void limitTurningRate(
+  const KernelSet & kernel_set, const float * vx, float * wz, size_t size, float min_turning_r)
+{
+  if (min_turning_r <= 0.0f) {
+    return;
+  }
+  const float inv_radius = 1.0f / min_turning_r;
+  for (size_t i = kernel_set.limit_turning_rate(vx, wz, size, inv_radius); i < size; i++) {
+    const float max_wz = std::fabs(vx[i]) * inv_radius;
+    wz[i] = std::min(std::max(wz[i], -max_wz), max_wz);
+  }
+}
+
+}  // namespace mppi::kernels
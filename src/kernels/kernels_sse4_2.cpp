@@ -0,0 +1,28 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compiled with SSE4.2 flags, only called once the CPU supports them
+#define MPPIC_KERNELS_TARGET target_sse4_2
+#include "mppic/tools/kernels_impl.hpp"
+
+namespace mppi::kernels
+{
+
+const KernelSet & sse4_2Kernels()
+{
+  static const KernelSet kernel_set = detail::makeKernelSet<xsimd::sse4_2>("sse4_2");
+  return kernel_set;
+}
+
+}  // namespace mppi::kernels
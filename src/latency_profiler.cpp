@@ -0,0 +1,103 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/latency_profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mppi
+{
+
+size_t LatencyProfiler::addEntry(const std::string & name)
+{
+  for (size_t i = 0; i != entries_.size(); i++) {
+    if (entries_[i].name == name) {
+      return i;
+    }
+  }
+
+  entries_.emplace_back();
+  entries_.back().name = name;
+  if (trace_recorder_) {
+    trace_names_.push_back(trace_recorder_->addName(name));
+  }
+  return entries_.size() - 1;
+}
+
+void LatencyProfiler::setTraceRecorder(TraceRecorder * recorder)
+{
+  trace_recorder_ = recorder;
+  trace_names_.clear();
+  if (trace_recorder_) {
+    for (const auto & entry : entries_) {
+      trace_names_.push_back(trace_recorder_->addName(entry.name));
+    }
+  }
+}
+
+void LatencyProfiler::reset()
+{
+  for (auto & entry : entries_) {
+    entry.count = 0;
+  }
+}
+
+std::vector<LatencyStats> LatencyProfiler::getStats() const
+{
+  std::vector<LatencyStats> stats;
+  stats.reserve(entries_.size());
+  for (const auto & entry : entries_) {
+    stats.push_back(computeStats(entry));
+  }
+  return stats;
+}
+
+std::optional<LatencyStats> LatencyProfiler::getStats(const std::string & name) const
+{
+  for (const auto & entry : entries_) {
+    if (entry.name == name) {
+      return computeStats(entry);
+    }
+  }
+  return std::nullopt;
+}
+
+LatencyStats LatencyProfiler::computeStats(const Entry & entry)
+{
+  LatencyStats stats;
+  stats.name = entry.name;
+  stats.count = entry.count;
+
+  const size_t size = std::min(entry.count, window_size);
+  if (size == 0) {
+    return stats;
+  }
+
+  std::array<float, window_size> sorted;
+  std::copy(entry.samples.begin(), entry.samples.begin() + size, sorted.begin());
+  std::sort(sorted.begin(), sorted.begin() + size);
+
+  // Nearest rank percentiles
+  auto percentile = [&](float p) {
+      const size_t rank = static_cast<size_t>(std::ceil(p * size));
+      return sorted[std::clamp<size_t>(rank, 1, size) - 1];
+    };
+  stats.p50 = percentile(0.50f);
+  stats.p99 = percentile(0.99f);
+  stats.max = sorted[size - 1];
+  return stats;
+}
+
+}  // namespace mppi
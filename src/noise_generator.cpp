@@ -14,27 +14,57 @@
 
 #include "mppic/tools/noise_generator.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <mutex>
+#include <utility>
 #include <xtensor/xmath.hpp>
 #include <xtensor/xrandom.hpp>
 #include <xtensor/xnoalias.hpp>
 
+#include "mppic/tools/half.hpp"
+#include "mppic/tools/utils.hpp"
+
 namespace mppi
 {
 
-void NoiseGenerator::initialize(mppi::models::OptimizerSettings & settings, bool is_holonomic)
+void NoiseGenerator::initialize(
+  mppi::models::OptimizerSettings & settings, bool is_holonomic,
+  ThreadPool * thread_pool, const kernels::KernelSet * kernel_set)
 {
   settings_ = settings;
   is_holonomic_ = is_holonomic;
+  thread_pool_ = thread_pool;
+
+  // Random seeds are kept within the noise_seed parameter's range, for replays to reuse
+  seed_ = settings_.noise_seed < 0 ?
+    std::random_device{}() & 0x7fffffffu : static_cast<unsigned int>(settings_.noise_seed);
+  engine_.seed(seed_);
+  sampler_.seed(seed_);
+  sampler_.setKernels(kernel_set);
+  kernel_set_ = kernel_set;
+
   active_ = true;
-  noise_thread_ = std::thread(std::bind(&NoiseGenerator::noiseThread, this));
+  ready_ = false;
+  placement_report_ = models::ThreadPlacementReport{};
+  placement_report_.description = describeThreadPlacement();
+  if (settings_.noise_thread) {
+    placed_ = false;
+    noise_thread_ = std::thread(
+      &NoiseGenerator::noiseThread, this, settings_.noise_thread_placement);
+    std::unique_lock<std::mutex> guard(noise_lock_);
+    noise_cond_.wait(guard, [this]() {return placed_;});
+  }
 }
 
 void NoiseGenerator::shutdown()
 {
-  active_ = false;
-  ready_ = true;
+  {
+    std::unique_lock<std::mutex> guard(noise_lock_);
+    active_ = false;
+    ready_ = true;
+  }
   noise_cond_.notify_all();
   if (noise_thread_.joinable()) {
     noise_thread_.join();
@@ -43,6 +73,12 @@ void NoiseGenerator::shutdown()
 
 void NoiseGenerator::generateNextNoises()
 {
+  // Without a noise thread, the caller generates them now, on its own thread
+  if (!settings_.noise_thread) {
+    generateNoisedControls();
+    return;
+  }
+
   // Trigger the thread to run in parallel to this iteration
   // to generate the next iteration's noises.
   {
@@ -56,54 +92,455 @@ void NoiseGenerator::setNoisedControls(
   models::State & state,
   const models::ControlSequence & control_sequence)
 {
-  std::unique_lock<std::mutex> guard(noise_lock_);
+  // Wait for the requested noises rather than reuse the previous, so that seeded runs repeat
+  if (settings_.deterministic_noises) {
+    std::unique_lock<std::mutex> guard(noise_lock_);
+    noise_cond_.wait(guard, [this]() {return !active_ || (!ready_ && !generating_);});
+  }
 
-  xt::noalias(state.cvx) = control_sequence.vx + noises_vx_;
-  xt::noalias(state.cvy) = control_sequence.vy + noises_vy_;
-  xt::noalias(state.cwz) = control_sequence.wz + noises_wz_;
+  // The buffers were zeroed by a reset, so the first noises after it are waited for
+  if (awaiting_noises_) {
+    std::unique_lock<std::mutex> guard(noise_lock_);
+    noise_cond_.wait(guard, [this]() {return !active_ || (latest_ & fresh_flag_);});
+    awaiting_noises_ = false;
+  }
+
+  // Swap in the latest completed buffer, or keep the current one if none was completed
+  if (latest_ & fresh_flag_) {
+    front_ = latest_.exchange(front_) & index_mask_;
+  } else {
+    wait_count_++;
+  }
+
+  const auto & noises = noises_[front_];
+  const auto & scales = sampling_scales_;
+  const bool half = settings_.noise_precision == models::StoragePrecision::Float16;
+  const size_t time_steps = settings_.time_steps;
+  auto applyNoises = [&](size_t begin, size_t end) {
+      const auto rows = xt::range(begin, end);
+      auto apply = [&](models::BatchTensor<2> & controls, const xt::xtensor<float, 1> & mean,
+          const xt::xtensor<float, 2> & noise, const xt::xtensor<float, 1> & scale) {
+          if (settings_.adaptive_sampling) {
+            xt::noalias(xt::view(controls, rows, xt::all())) =
+              mean + xt::view(noise, rows, xt::all()) * scale;
+          } else {
+            xt::noalias(xt::view(controls, rows, xt::all())) =
+              mean + xt::view(noise, rows, xt::all());
+          }
+        };
+
+      auto applyHalf = [&](models::BatchTensor<2> & controls, const xt::xtensor<float, 1> & mean,
+          const xt::xtensor<uint16_t, 2> & noise, const xt::xtensor<float, 1> & scale) {
+          for (size_t i = begin; i != end; i++) {
+            float * dst = controls.data() + i * time_steps;
+            const uint16_t * src = noise.data() + i * time_steps;
+            for (size_t t = 0; t != time_steps; t++) {
+              const float sample = halfToFloat(src[t]);
+              dst[t] = mean(t) + (settings_.adaptive_sampling ? sample * scale(t) : sample);
+            }
+          }
+        };
+
+      if (half) {
+        applyHalf(state.cvx, control_sequence.vx, noises.vx_half, scales.vx);
+        applyHalf(state.cwz, control_sequence.wz, noises.wz_half, scales.wz);
+      } else {
+        apply(state.cvx, control_sequence.vx, noises.vx, scales.vx);
+        apply(state.cwz, control_sequence.wz, noises.wz, scales.wz);
+      }
+      // Lateral controls are neither sampled nor used by non-holonomic models
+      if (is_holonomic_ && half) {
+        applyHalf(state.cvy, control_sequence.vy, noises.vy_half, scales.vy);
+      } else if (is_holonomic_) {
+        apply(state.cvy, control_sequence.vy, noises.vy, scales.vy);
+      }
+    };
+
+  // Noises may be sampled for a larger batch than the state's, which uses their leading rows
+  const size_t noise_rows = half ? noises.vx_half.shape(0) : noises.vx.shape(0);
+  const size_t batch_size = std::min(state.cvx.shape(0), noise_rows);
+  if (thread_pool_) {
+    thread_pool_->parallelFor(batch_size, applyNoises);
+  } else {
+    applyNoises(0, batch_size);
+  }
 }
 
 void NoiseGenerator::reset(mppi::models::OptimizerSettings & settings, bool is_holonomic)
 {
-  settings_ = settings;
-  is_holonomic_ = is_holonomic;
-
   // Recompute the noises on reset, initialization, and fallback
   {
     std::unique_lock<std::mutex> guard(noise_lock_);
-    xt::noalias(noises_vx_) = xt::zeros<float>({settings_.batch_size, settings_.time_steps});
-    xt::noalias(noises_vy_) = xt::zeros<float>({settings_.batch_size, settings_.time_steps});
-    xt::noalias(noises_wz_) = xt::zeros<float>({settings_.batch_size, settings_.time_steps});
-    ready_ = true;
+    noise_cond_.wait(guard, [this]() {return !generating_;});
+
+    // Storage staged for these settings is swapped in rather than allocated
+    std::unique_ptr<Staging> staged;
+    {
+      std::lock_guard<std::mutex> staging_guard(staging_lock_);
+      staged.swap(staging_);
+    }
+    if (staged &&
+      (!isSameNoiseBank(staged->settings, staged->is_holonomic, settings, is_holonomic) ||
+      staged->settings.noise_precision != settings.noise_precision))
+    {
+      staged.reset();
+    }
+
+    if (staged && staged->bank && !isNoiseBankCurrent(settings, is_holonomic)) {
+      std::swap(bank_, *staged->bank);
+      bank_size_ = staged->bank_size;
+      bank_settings_ = settings;
+      bank_holonomic_ = is_holonomic;
+    }
+    settings_ = settings;
+    is_holonomic_ = is_holonomic;
+    updateNoiseBank();
+
+    sampling_scales_.vx = xt::ones<float>({settings_.time_steps});
+    sampling_scales_.vy = xt::ones<float>({settings_.time_steps});
+    sampling_scales_.wz = xt::ones<float>({settings_.time_steps});
+
+    // noise_correlation holds per model_dt, longer steps decorrelate as much more
+    const float a = std::min(settings_.noise_correlation, 0.99f);
+    correlation_gains_.assign(settings_.time_steps, a);
+    innovation_gains_.assign(settings_.time_steps, std::sqrt(1.0f - a * a));
+    const auto model_dts = utils::getModelDts(settings_);
+    const size_t growing_steps = settings_.model_dt_max > 0.0f ? correlation_gains_.size() : 0;
+    for (size_t t = 1; t < growing_steps; t++) {
+      correlation_gains_[t] = std::pow(a, model_dts(t - 1) / model_dts(0));
+      innovation_gains_[t] = std::sqrt(1.0f - correlation_gains_[t] * correlation_gains_[t]);
+    }
+
+    if (staged) {
+      std::swap(noises_, staged->noises);
+      std::swap(half_chunk_, staged->half_chunk);
+    } else {
+      allocateNoises(settings_, is_holonomic_, noises_, half_chunk_);
+    }
+
+    // No buffer holds noises yet, until the first is generated into the back one
+    front_ = 0;
+    back_ = 1;
+    latest_ = 2;
+    ready_ = settings_.noise_thread;
+    awaiting_noises_ = settings_.noise_thread;
   }
   noise_cond_.notify_all();
+
+  if (!settings_.noise_thread) {
+    generateNoisedControls();
+  }
+}
+
+void NoiseGenerator::stage(
+  const mppi::models::OptimizerSettings & settings, bool is_holonomic, bool sample_bank)
+{
+  auto staging = std::make_unique<Staging>();
+  staging->settings = settings;
+  staging->is_holonomic = is_holonomic;
+  allocateNoises(settings, is_holonomic, staging->noises, staging->half_chunk);
+  if (sample_bank) {
+    // Generators of its own, as the noise thread draws from the others meanwhile
+    const unsigned int seed = seed_ + ++stage_count_;
+    std::mt19937 engine(seed);
+    GaussianSampler sampler(seed);
+    sampler.setKernels(kernel_set_);
+    staging->bank.emplace();
+    staging->bank_size =
+      sampleNoiseBank(settings, is_holonomic, engine, sampler, *staging->bank);
+  }
+
+  std::lock_guard<std::mutex> guard(staging_lock_);
+  staging_.swap(staging);
+}
+
+bool NoiseGenerator::isNoiseBankCurrent(
+  const mppi::models::OptimizerSettings & settings, bool is_holonomic) const
+{
+  return bank_settings_ &&
+         isSameNoiseBank(*bank_settings_, bank_holonomic_, settings, is_holonomic);
 }
 
-void NoiseGenerator::noiseThread()
+bool NoiseGenerator::isSameNoiseBank(
+  const mppi::models::OptimizerSettings & a, bool a_holonomic,
+  const mppi::models::OptimizerSettings & b, bool b_holonomic)
 {
-  do {
+  return a.noise_bank_memory_mb == b.noise_bank_memory_mb &&
+         a.batch_size == b.batch_size && a.time_steps == b.time_steps &&
+         a.sampling_std.vx == b.sampling_std.vx && a.sampling_std.vy == b.sampling_std.vy &&
+         a.sampling_std.wz == b.sampling_std.wz && a_holonomic == b_holonomic;
+}
+
+void NoiseGenerator::allocateNoises(
+  const mppi::models::OptimizerSettings & settings, bool is_holonomic,
+  std::array<Noises, num_buffers_> & noises, xt::xtensor<float, 2> & half_chunk)
+{
+  const bool half = settings.noise_precision == models::StoragePrecision::Float16;
+  const size_t time_steps = settings.time_steps;
+  const size_t full_rows = half ? 0 : settings.batch_size;
+  const size_t half_rows = half ? settings.batch_size : 0;
+  const size_t lateral = is_holonomic ? 1 : 0;
+  for (auto & buffer : noises) {
+    buffer.vx = xt::zeros<float>({full_rows, time_steps});
+    buffer.vy = xt::zeros<float>({full_rows * lateral, time_steps});
+    buffer.wz = xt::zeros<float>({full_rows, time_steps});
+    buffer.vx_half = xt::zeros<uint16_t>({half_rows, time_steps});
+    buffer.vy_half = xt::zeros<uint16_t>({half_rows * lateral, time_steps});
+    buffer.wz_half = xt::zeros<uint16_t>({half_rows, time_steps});
+  }
+  half_chunk = xt::zeros<float>({half ? half_chunk_rows_ : 0, time_steps});
+}
+
+void NoiseGenerator::setTraceRecorder(TraceRecorder * recorder)
+{
+  std::unique_lock<std::mutex> guard(noise_lock_);
+  trace_recorder_ = recorder;
+  if (trace_recorder_) {
+    trace_name_ = trace_recorder_->addName("generateNoises");
+  }
+}
+
+void NoiseGenerator::noiseThread(const models::ThreadPlacement & placement)
+{
+  models::ThreadPlacementReport report;
+  report.applied = applyThreadPlacement(placement, report.description);
+  {
     std::unique_lock<std::mutex> guard(noise_lock_);
-    noise_cond_.wait(guard, [this]() {return ready_;});
-    ready_ = false;
-    generateNoisedControls();
-  } while (active_);
+    placement_report_ = std::move(report);
+    placed_ = true;
+  }
+  noise_cond_.notify_all();
+
+  while (true) {
+    TraceRecorder * trace_recorder;
+    uint32_t trace_name;
+    {
+      std::unique_lock<std::mutex> guard(noise_lock_);
+      noise_cond_.wait(guard, [this]() {return ready_;});
+      if (!active_) {
+        return;
+      }
+      ready_ = false;
+      generating_ = true;
+      trace_recorder = trace_recorder_;
+      trace_name = trace_name_;
+    }
+
+    // Not holding the lock, so the consumer is never blocked by generation
+    if (trace_recorder) {
+      trace_recorder->nameThread("noise");
+    }
+    {
+      ScopedTrace trace(trace_recorder, trace_name);
+      generateNoisedControls();
+    }
+
+    {
+      std::unique_lock<std::mutex> guard(noise_lock_);
+      generating_ = false;
+    }
+    noise_cond_.notify_all();
+  }
 }
 
 void NoiseGenerator::generateNoisedControls()
 {
   auto & s = settings_;
+  auto & noises = noises_[back_];
+
+  if (s.noise_precision == models::StoragePrecision::Float16) {
+    generateHalfNoises(noises);
+    back_ = latest_.exchange(back_ | fresh_flag_) & index_mask_;
+    return;
+  }
+
+  if (bank_size_ > 0) {
+    pickBankNoises(noises);
+  } else {
+    sampleNoises(noises.vx, s.batch_size, s.sampling_std.vx);
+    sampleNoises(noises.wz, s.batch_size, s.sampling_std.wz);
+    if (is_holonomic_) {
+      sampleNoises(noises.vy, s.batch_size, s.sampling_std.vy);
+    }
+  }
+
+  if (s.noise_correlation > 0.0f) {
+    correlateNoises(noises.vx);
+    correlateNoises(noises.wz);
+    if (is_holonomic_) {
+      correlateNoises(noises.vy);
+    }
+  }
+
+  // Publish the completed buffer, taking back the one not in use by the consumer
+  back_ = latest_.exchange(back_ | fresh_flag_) & index_mask_;
+}
+
+void NoiseGenerator::sampleNoises(xt::xtensor<float, 2> & noises, size_t rows, float std_dev)
+{
+  sampleNoises(noises, rows, std_dev, settings_, engine_, sampler_);
+}
+
+void NoiseGenerator::sampleNoises(
+  xt::xtensor<float, 2> & noises, size_t rows, float std_dev,
+  const mppi::models::OptimizerSettings & settings, std::mt19937 & engine,
+  GaussianSampler & sampler)
+{
+  const std::array<size_t, 2> shape = {rows, settings.time_steps};
+  if (settings.noise_sampler == models::NoiseSampler::Xoshiro) {
+    noises.resize(shape);
+    sampler.fill(noises, std_dev);
+  } else {
+    xt::noalias(noises) = xt::random::randn<float>(shape, 0.0f, std_dev, engine);
+  }
+}
+
+void NoiseGenerator::pickBankNoises(Noises & noises)
+{
+  const size_t time_steps = settings_.time_steps;
+  for (size_t i = 0; i != settings_.batch_size; i++) {
+    pickBankSequence(bank_.vx, noises.vx.data() + i * time_steps);
+    pickBankSequence(bank_.wz, noises.wz.data() + i * time_steps);
+    if (is_holonomic_) {
+      pickBankSequence(bank_.vy, noises.vy.data() + i * time_steps);
+    }
+  }
+}
+
+void NoiseGenerator::pickBankSequence(const xt::xtensor<float, 2> & bank, float * dst)
+{
+  const size_t time_steps = settings_.time_steps;
+  std::uniform_int_distribution<size_t> pick_row(0, bank_size_ - 1);
+  std::uniform_int_distribution<size_t> pick_offset(0, time_steps - 1);
+
+  // Samples are i.i.d., so any circular shift of a bank sequence is a valid sequence too
+  const float * src = bank.data() + pick_row(engine_) * time_steps;
+  const size_t offset = pick_offset(engine_);
+  std::copy(src + offset, src + time_steps, dst);
+  std::copy(src, src + offset, dst + (time_steps - offset));
+}
+
+void NoiseGenerator::generateHalfNoises(Noises & noises)
+{
+  const auto & s = settings_;
+  const size_t time_steps = s.time_steps;
+
+  auto generate = [&](xt::xtensor<uint16_t, 2> & dst, const xt::xtensor<float, 2> & bank,
+      float std_dev) {
+      for (size_t begin = 0; begin < s.batch_size; begin += half_chunk_rows_) {
+        // Always a full chunk, so the scratch keeps its shape, of which the used rows are stored
+        const size_t rows = std::min(half_chunk_rows_, s.batch_size - begin);
+        if (bank_size_ > 0) {
+          for (size_t i = 0; i != rows; i++) {
+            pickBankSequence(bank, half_chunk_.data() + i * time_steps);
+          }
+        } else {
+          sampleNoises(half_chunk_, half_chunk_rows_, std_dev);
+        }
+
+        if (s.noise_correlation > 0.0f) {
+          correlateNoises(half_chunk_);
+        }
+
+        uint16_t * out = dst.data() + begin * time_steps;
+        for (size_t k = 0; k != rows * time_steps; k++) {
+          out[k] = floatToHalf(half_chunk_.data()[k]);
+        }
+      }
+    };
 
-  xt::noalias(noises_vx_) = xt::random::randn<float>(
-    {s.batch_size, s.time_steps}, 0.0,
-    s.sampling_std.vx);
-  xt::noalias(noises_wz_) = xt::random::randn<float>(
-    {s.batch_size, s.time_steps}, 0.0,
-    s.sampling_std.wz);
+  generate(noises.vx_half, bank_.vx, s.sampling_std.vx);
+  generate(noises.wz_half, bank_.wz, s.sampling_std.wz);
   if (is_holonomic_) {
-    xt::noalias(noises_vy_) = xt::random::randn<float>(
-      {s.batch_size, s.time_steps}, 0.0,
-      s.sampling_std.vy);
+    generate(noises.vy_half, bank_.vy, s.sampling_std.vy);
+  }
+}
+
+size_t NoiseGenerator::getMemoryUsage() const
+{
+  size_t bytes = half_chunk_.size() * sizeof(float);
+  for (const auto & noises : noises_) {
+    bytes += (noises.vx.size() + noises.vy.size() + noises.wz.size()) * sizeof(float);
+    bytes += (noises.vx_half.size() + noises.vy_half.size() + noises.wz_half.size()) *
+      sizeof(uint16_t);
+  }
+  return bytes;
+}
+
+size_t NoiseGenerator::getNoiseBankMemoryUsage() const
+{
+  return (bank_.vx.size() + bank_.vy.size() + bank_.wz.size()) * sizeof(float);
+}
+
+void NoiseGenerator::correlateNoises(xt::xtensor<float, 2> & noises) const
+{
+  // First order autoregressive filter, scaled so that the stationary variance is unchanged
+  const size_t time_steps = settings_.time_steps;
+  for (size_t i = 0; i != noises.shape(0); i++) {
+    float * row = noises.data() + i * time_steps;
+    for (size_t t = 1; t < time_steps; t++) {
+      row[t] = correlation_gains_[t] * row[t - 1] + innovation_gains_[t] * row[t];
+    }
+  }
+}
+
+void NoiseGenerator::adaptSamplingStd(const models::ControlSequence & variances)
+{
+  if (!settings_.adaptive_sampling) {
+    return;
+  }
+
+  const float rate = settings_.adaptive_sampling_rate;
+  const float min_ratio = settings_.min_sampling_std_ratio;
+  auto adapt = [&](xt::xtensor<float, 1> & scales, const xt::xtensor<float, 1> & variance,
+      float std_dev) {
+      for (size_t t = 0; t != scales.shape(0); t++) {
+        const float ratio = std::sqrt(std::max(variance(t), 0.0f)) / std_dev;
+        scales(t) += rate * (std::clamp(ratio, min_ratio, 1.0f) - scales(t));
+      }
+    };
+
+  adapt(sampling_scales_.vx, variances.vx, settings_.sampling_std.vx);
+  adapt(sampling_scales_.wz, variances.wz, settings_.sampling_std.wz);
+  if (is_holonomic_) {
+    adapt(sampling_scales_.vy, variances.vy, settings_.sampling_std.vy);
+  }
+}
+
+void NoiseGenerator::updateNoiseBank()
+{
+  if (isNoiseBankCurrent(settings_, is_holonomic_)) {
+    return;
+  }
+
+  bank_settings_ = settings_;
+  bank_holonomic_ = is_holonomic_;
+  bank_size_ = sampleNoiseBank(settings_, is_holonomic_, engine_, sampler_, bank_);
+}
+
+size_t NoiseGenerator::sampleNoiseBank(
+  const mppi::models::OptimizerSettings & settings, bool is_holonomic,
+  std::mt19937 & engine, GaussianSampler & sampler, Noises & bank)
+{
+  const auto & s = settings;
+  const size_t channels = is_holonomic ? 3 : 2;
+  const double sequence_bytes = static_cast<double>(channels * s.time_steps * sizeof(float));
+  const size_t bank_size = s.noise_bank_memory_mb > 0.0f && s.time_steps > 0 ?
+    static_cast<size_t>(s.noise_bank_memory_mb * 1024.0 * 1024.0 / sequence_bytes) : 0;
+
+  if (bank_size == 0) {
+    bank = Noises();
+    return 0;
+  }
+
+  sampleNoises(bank.vx, bank_size, s.sampling_std.vx, s, engine, sampler);
+  sampleNoises(bank.wz, bank_size, s.sampling_std.wz, s, engine, sampler);
+  if (is_holonomic) {
+    sampleNoises(bank.vy, bank_size, s.sampling_std.vy, s, engine, sampler);
+  } else {
+    bank.vy = xt::xtensor<float, 2>();
   }
+  return bank_size;
 }
 
 }  // namespace mppi
@@ -14,10 +14,18 @@
 
 #include "mppic/optimizer.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
 #include <limits>
 #include <memory>
+#include <numeric>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 #include <xtensor/xmath.hpp>
 #include <xtensor/xrandom.hpp>
@@ -25,6 +33,7 @@
 
 #include "nav2_core/controller_exceptions.hpp"
 #include "nav2_costmap_2d/costmap_filters/filter_values.hpp"
+#include "mppic/tools/rollout.hpp"
 
 namespace mppi
 {
@@ -32,44 +41,118 @@ namespace mppi
 using namespace xt::placeholders;  // NOLINT
 using xt::evaluation_strategy::immediate;
 
+namespace
+{
+
+bool isHolonomicModel(const std::string & model)
+{
+  return model == "Omni" || model == "AccelLimitedOmni";
+}
+
+}  // namespace
+
 void Optimizer::initialize(
   rclcpp_lifecycle::LifecycleNode::WeakPtr parent, const std::string & name,
   std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros,
   ParametersHandler * param_handler)
+{
+  configure(parent, name, std::make_shared<CostmapSource>(costmap_ros), param_handler);
+}
+
+void Optimizer::initialize(
+  const std::string & name, const HeadlessCostmap & costmap,
+  ParametersHandler * param_handler)
+{
+  configure({}, name, std::make_shared<CostmapSource>(costmap), param_handler);
+}
+
+void Optimizer::configure(
+  rclcpp_lifecycle::LifecycleNode::WeakPtr parent, const std::string & name,
+  std::shared_ptr<CostmapSource> costmap_source, ParametersHandler * param_handler)
 {
   parent_ = parent;
   name_ = name;
-  costmap_ros_ = costmap_ros;
-  costmap_ = costmap_ros_->getCostmap();
+  costmap_source_ = costmap_source;
+  costmap_ros_ = costmap_source_->getCostmapROS();
+  costmap_ = costmap_source_->getCostmap();
   parameters_handler_ = param_handler;
 
-  auto node = parent_.lock();
-  logger_ = node->get_logger();
+  if (auto node = parent_.lock()) {
+    logger_ = node->get_logger();
+  }
 
   getParams();
 
-  critic_manager_.on_configure(parent_, name_, costmap_ros_, parameters_handler_);
-  noise_generator_.initialize(settings_, isHolonomic());
+  auto & p = latency_profiler_;
+  latency_stages_ = {p.addEntry("evalControl"), p.addEntry("prepare"), p.addEntry("noise"),
+    p.addEntry("rollout"), p.addEntry("critics"), p.addEntry("update"), p.addEntry("smoothing"),
+    p.addEntry("screening"), p.addEntry("preroll")};
+  critic_manager_.setLatencyProfiler(&latency_profiler_);
+
+  thread_pool_.initialize(settings_.worker_threads, settings_.worker_placement);
+  critic_manager_.on_configure(parent_, name_, costmap_source_, parameters_handler_);
+  auto noise_settings = getNoiseSettings();
+  noise_generator_.initialize(noise_settings, isHolonomic(), &thread_pool_, kernels_);
+
+  const auto & workers = thread_pool_.getPlacementReports();
+  for (size_t i = 0; i != workers.size(); i++) {
+    logPlacement("Worker thread " + std::to_string(i + 1), workers[i]);
+  }
+  if (settings_.noise_thread) {
+    logPlacement("Noise thread", noise_generator_.getPlacementReport());
+  }
 
   reset();
+
+  for (const auto & usage : getMemoryUsage()) {
+    RCLCPP_INFO(
+      logger_, "Memory usage of %s: %.1f KiB", usage.component.c_str(),
+      static_cast<double>(usage.bytes) / 1024.0);
+  }
 }
 
 void Optimizer::shutdown()
 {
+  {
+    std::lock_guard<std::mutex> guard(preroll_lock_);
+    preroll_stop_ = true;
+  }
+  preroll_cond_.notify_all();
+  if (preroll_thread_.joinable()) {
+    preroll_thread_.join();
+  }
   noise_generator_.shutdown();
+  thread_pool_.shutdown();
 }
 
 void Optimizer::getParams()
 {
   std::string motion_model_name;
+  std::string noise_sampler_name;
+  std::string noise_precision_name;
+  std::string simd_kernels_name;
+  std::vector<std::string> watchdog_steps;
+  std::vector<int64_t> worker_cpus, noise_thread_cpus;
+  std::string worker_scheduling, noise_thread_scheduling;
+  int worker_priority, noise_thread_priority;
 
   auto & s = settings_;
   auto getParam = parameters_handler_->getParamGetter(name_);
   auto getParentParam = parameters_handler_->getParamGetter("");
   getParam(s.model_dt, "model_dt", 0.05f);
+  getParam(s.model_dt_max, "model_dt_max", 0.0f);
   getParam(s.time_steps, "time_steps", 56);
   getParam(s.batch_size, "batch_size", 1000);
+  getParam(s.adaptive_batch_size, "adaptive_batch_size", false);
+  getParam(s.min_batch_size, "min_batch_size", 200);
+  getParam(s.max_batch_size, "max_batch_size", static_cast<int>(s.batch_size));
+  getParam(s.batch_size_step, "batch_size_step", 100);
+  getParam(s.screening_batch_size, "screening_batch_size", 0);
+  getParam(s.screening_time_stride, "screening_time_stride", 2);
   getParam(s.iteration_count, "iteration_count", 1);
+  getParam(s.max_compute_time_ms, "max_compute_time_ms", 0.0f);
+  getParam(s.min_cost_improvement, "min_cost_improvement", 0.0f);
+  getParam(s.warm_start_samples, "warm_start_samples", 0);
   getParam(s.temperature, "temperature", 0.3f);
   getParam(s.gamma, "gamma", 0.015f);
   getParam(s.base_constraints.vx_max, "vx_max", 0.5);
@@ -80,12 +163,105 @@ void Optimizer::getParams()
   getParam(s.sampling_std.vy, "vy_std", 0.2);
   getParam(s.sampling_std.wz, "wz_std", 0.4);
   getParam(s.retry_attempt_limit, "retry_attempt_limit", 1);
+  getParam(s.fallback_recovery, "fallback_recovery", false);
+  getParam(s.fallback_std_scale, "fallback_std_scale", 2.0f);
+  getParam(s.pipelined_rollouts, "pipelined_rollouts", false);
+  getParam(s.watchdog_budget_ms, "watchdog_budget_ms", 0.0f);
+  getParam(
+    watchdog_steps, "watchdog_degradation_order",
+    std::vector<std::string>{"skip_visualization", "drop_iterations",
+      "disable_expensive_critics", "reuse_previous_sequence"}, ParameterType::Static);
+  getParam(s.smoothing_window, "smoothing_window", 5);
+  getParam(s.constrain_samples, "constrain_samples", false);
+  getParam(s.fast_math, "fast_math", false);
+  getParam(s.store_yaw_trig, "store_yaw_trig", false);
+  getParam(s.costmap_snapshot, "costmap_snapshot", false);
+  getParam(s.worker_threads, "worker_threads", 1, ParameterType::Static);
+  getParam(worker_cpus, "worker_threads_cpus", std::vector<int64_t>{}, ParameterType::Static);
+  getParam(
+    worker_scheduling, "worker_threads_scheduling", std::string("other"),
+    ParameterType::Static);
+  getParam(worker_priority, "worker_threads_priority", 0, ParameterType::Static);
+  getParam(simd_kernels_name, "simd_kernels", std::string("auto"), ParameterType::Static);
+  getParam(noise_sampler_name, "noise_sampler", std::string("Default"), ParameterType::Static);
+  getParam(s.noise_seed, "noise_seed", -1, ParameterType::Static);
+  getParam(s.deterministic_noises, "deterministic_noises", false);
+  getParam(s.noise_thread, "noise_thread", true, ParameterType::Static);
+  getParam(
+    noise_thread_cpus, "noise_thread_cpus", std::vector<int64_t>{}, ParameterType::Static);
+  getParam(
+    noise_thread_scheduling, "noise_thread_scheduling", std::string("other"),
+    ParameterType::Static);
+  getParam(noise_thread_priority, "noise_thread_priority", 0, ParameterType::Static);
+  getParam(s.noise_bank_memory_mb, "noise_bank_memory_mb", 0.0f);
+  getParam(
+    noise_precision_name, "noise_precision", std::string("float32"), ParameterType::Static);
+  getParam(s.noise_correlation, "noise_correlation", 0.0f);
+  getParam(s.adaptive_sampling, "adaptive_sampling", false);
+  getParam(s.adaptive_sampling_rate, "adaptive_sampling_rate", 0.3f);
+  getParam(s.min_sampling_std_ratio, "min_sampling_std_ratio", 0.2f);
+
+  getParam(motion_model_name, "motion_model", std::string("DiffDrive"), ParameterType::Static);
+
+  if (s.adaptive_batch_size &&
+    (s.min_batch_size == 0 || s.min_batch_size > s.max_batch_size || s.batch_size_step == 0))
+  {
+    throw std::runtime_error(
+            "Adaptive batch size needs 0 < min_batch_size <= max_batch_size "
+            "and batch_size_step > 0");
+  }
+
+  const unsigned int largest_batch = s.adaptive_batch_size ? s.max_batch_size : s.batch_size;
+  if (s.screening_batch_size != 0 &&
+    (s.screening_batch_size <= largest_batch || s.screening_time_stride == 0))
+  {
+    throw std::runtime_error(
+            "Two-stage sampling needs screening_batch_size larger than the batch size "
+            "and screening_time_stride > 0");
+  }
+
+  if (s.model_dt_max > 0.0f && s.model_dt_max < s.model_dt) {
+    throw std::runtime_error("model_dt_max needs to be 0 or at least model_dt");
+  }
 
-  getParam(motion_model_name, "motion_model", std::string("DiffDrive"));
+  if (s.smoothing_window != 5 && s.smoothing_window != 7 && s.smoothing_window != 9) {
+    throw std::runtime_error("Smoothing window needs to be 5, 7 or 9");
+  }
+
+  if (s.adaptive_sampling &&
+    (s.min_sampling_std_ratio <= 0.0f || s.min_sampling_std_ratio > 1.0f))
+  {
+    throw std::runtime_error("Adaptive sampling needs 0 < min_sampling_std_ratio <= 1");
+  }
 
   s.constraints = s.base_constraints;
   setMotionModel(motion_model_name);
-  parameters_handler_->addPostCallback([this]() {reset();});
+  setNoiseSampler(noise_sampler_name);
+  setNoisePrecision(noise_precision_name);
+  setSimdKernels(simd_kernels_name);
+  setWatchdogSteps(watchdog_steps);
+  s.worker_placement = makeThreadPlacement(worker_cpus, worker_scheduling, worker_priority);
+  s.noise_thread_placement =
+    makeThreadPlacement(noise_thread_cpus, noise_thread_scheduling, noise_thread_priority);
+  // The adapted deviations divide the control costs, so they cannot shrink to 0
+  parameters_handler_->addParamVerifier(
+    name_ + ".min_sampling_std_ratio", [this](const rclcpp::Parameter & param) {
+      const double ratio = param.as_double();
+      return ratio <= 0.0 || ratio > 1.0 ?
+      name_ + ".min_sampling_std_ratio needs to be in (0, 1]" : std::string();
+    });
+  parameters_handler_->addDynamicParamCallback(
+    name_ + ".motion_model", [this](const rclcpp::Parameter & param) {
+      setMotionModel(param.as_string());
+    });
+  // The pre-roll reads the settings outside the parameters lock, so changes wait for it
+  parameters_handler_->addPreCallback([this]() {finishPreroll();});
+  parameters_handler_->addPostCallback([this]() {applyParameterChanges();});
+  // Deferred changes are built off the control thread, then only swapped in
+  parameters_handler_->addStageCallback(
+    [this](const std::vector<rclcpp::Parameter> & parameters) {
+      return stageParameterChanges(parameters);
+    });
 
   double controller_frequency;
   getParentParam(controller_frequency, "controller_frequency", 0.0, ParameterType::Static);
@@ -96,6 +272,7 @@ void Optimizer::setOffset(double controller_frequency)
 {
   const double controller_period = 1.0 / controller_frequency;
   constexpr double eps = 1e-6;
+  controller_period_ = controller_period;
 
   if ((controller_period + eps) < settings_.model_dt) {
     RCLCPP_WARN(
@@ -115,16 +292,331 @@ void Optimizer::setOffset(double controller_frequency)
 
 void Optimizer::reset()
 {
-  state_.reset(settings_.batch_size, settings_.time_steps);
+  finishPreroll();
+  preroll_ready_ = false;
+  if (settings_.adaptive_batch_size) {
+    settings_.batch_size =
+      std::clamp(settings_.batch_size, settings_.min_batch_size, settings_.max_batch_size);
+  }
+  headroom_cycles_ = 0;
+  pending_batch_size_ = 0;
+  warm_start_.count = 0;
+
+  // Built aside by a deferred parameter change, or now
+  auto buffers = takeStagedBuffers();
+  if (!buffers) {
+    buffers = std::make_unique<BatchBuffers>();
+    buffers->settings = settings_;
+    buffers->holonomic = isHolonomic();
+    buffers->workspace_buffers = workspace_.numBatchBuffers();
+    buildBuffers(*buffers);
+  }
+  swapBuffers(*buffers);
   control_sequence_.reset(settings_.time_steps);
-  control_history_[0] = {0.0, 0.0, 0.0};
-  control_history_[1] = {0.0, 0.0, 0.0};
+  best_control_sequence_.reset(settings_.time_steps);
+  control_history_.fill({0.0, 0.0, 0.0});
+  updateModelDts();
+  resetScreening();
+
+  // Weighted sums of the controls, then of their squares in adaptive sampling mode
+  const size_t partial_sums = settings_.adaptive_sampling ? 6 : 3;
+  partial_controls_ =
+    xt::zeros<float>({partial_sums, thread_pool_.size(), size_t{settings_.time_steps}});
+  softmax_partials_.resize(thread_pool_.size());
+  sampling_variances_.reset(settings_.time_steps);
+  sampling_gains_.reset(settings_.time_steps);
+
+  auto noise_settings = getNoiseSettings();
+  noise_generator_.reset(noise_settings, isHolonomic());
+  applied_settings_ = settings_;
+  applied_holonomic_ = isHolonomic();
+  RCLCPP_INFO(logger_, "Optimizer reset");
+}
 
-  costs_ = xt::zeros<float>({settings_.batch_size});
-  generated_trajectories_.reset(settings_.batch_size, settings_.time_steps);
+void Optimizer::applyParameterChanges()
+{
+  // Rolled out with the previous parameters, the pre-callback having waited for it
+  preroll_ready_ = false;
+  if (isStructuralChange(settings_, isHolonomic())) {
+    resize();
+    return;
+  }
 
-  noise_generator_.reset(settings_, isHolonomic());
-  RCLCPP_INFO(logger_, "Optimizer reset");
+  if (isNoiseChange(settings_)) {
+    auto noise_settings = getNoiseSettings();
+    noise_generator_.reset(noise_settings, isHolonomic());
+  }
+
+  // Anything else, such as the temperature or critic weights, applies from the next cycle
+  applied_settings_ = settings_;
+}
+
+bool Optimizer::isStructuralChange(
+  const models::OptimizerSettings & settings, bool holonomic) const
+{
+  // Changes of the buffer shapes or of the time discretization reallocate
+  const auto & s = settings;
+  const auto & a = applied_settings_;
+  return s.batch_size != a.batch_size ||
+         s.adaptive_batch_size != a.adaptive_batch_size || s.min_batch_size != a.min_batch_size ||
+         s.max_batch_size != a.max_batch_size ||
+         s.screening_batch_size != a.screening_batch_size ||
+         s.screening_time_stride != a.screening_time_stride || s.time_steps != a.time_steps ||
+         s.model_dt != a.model_dt || s.model_dt_max != a.model_dt_max ||
+         s.store_yaw_trig != a.store_yaw_trig || s.adaptive_sampling != a.adaptive_sampling ||
+         holonomic != applied_holonomic_;
+}
+
+bool Optimizer::isNoiseChange(const models::OptimizerSettings & settings) const
+{
+  // Changes of the sampling distribution only regenerate the noises
+  const auto & s = settings;
+  const auto & a = applied_settings_;
+  return s.sampling_std.vx != a.sampling_std.vx ||
+         s.sampling_std.vy != a.sampling_std.vy || s.sampling_std.wz != a.sampling_std.wz ||
+         s.noise_correlation != a.noise_correlation ||
+         s.noise_bank_memory_mb != a.noise_bank_memory_mb ||
+         s.deterministic_noises != a.deterministic_noises ||
+         s.adaptive_sampling_rate != a.adaptive_sampling_rate ||
+         s.min_sampling_std_ratio != a.min_sampling_std_ratio;
+}
+
+std::function<void()> Optimizer::stageParameterChanges(
+  const std::vector<rclcpp::Parameter> & parameters)
+{
+  auto settings = parameters_handler_->stageSettings(settings_, parameters);
+  bool holonomic = isHolonomic();
+  for (const auto & param : parameters) {
+    if (param.get_name() == name_ + ".motion_model") {
+      holonomic = isHolonomicModel(param.as_string());
+    }
+  }
+  if (settings.adaptive_batch_size) {
+    settings.batch_size =
+      std::clamp(settings.batch_size, settings.min_batch_size, settings.max_batch_size);
+  }
+
+  const bool structural = isStructuralChange(settings, holonomic);
+  if (!structural && !isNoiseChange(settings)) {
+    return {};
+  }
+
+  // Read under the lock, which the noise resets and the cycles leasing buffers hold
+  const auto noise_settings = getNoiseSettings(settings);
+  const bool sample_bank = !noise_generator_.isNoiseBankCurrent(noise_settings, holonomic);
+  const size_t workspace_buffers = workspace_.numBatchBuffers();
+
+  // Built off the lock, touching only the staged buffers and noise storage
+  auto build = [this, settings, holonomic, structural, noise_settings, sample_bank,
+      workspace_buffers]() {
+      if (structural) {
+        auto buffers = std::make_unique<BatchBuffers>();
+        buffers->settings = settings;
+        buffers->holonomic = holonomic;
+        buffers->workspace_buffers = workspace_buffers;
+        buildBuffers(*buffers);
+        std::lock_guard<std::mutex> guard(staging_lock_);
+        staged_buffers_.swap(buffers);
+      }
+      noise_generator_.stage(noise_settings, holonomic, sample_bank);
+    };
+  return build;
+}
+
+void Optimizer::buildBuffers(BatchBuffers & buffers) const
+{
+  // Reserved once for the largest batch, so that adapting the batch size never reallocates
+  const auto & s = buffers.settings;
+  const unsigned int max_batch_size = getMaxBatchSize(s);
+  buffers.state.reset(s.batch_size, s.time_steps, buffers.holonomic);
+  buffers.state.reserve(max_batch_size);
+  buffers.costs = xt::zeros<float>({s.batch_size});
+  models::reserveBatch(buffers.costs, max_batch_size);
+  buffers.generated_trajectories.reset(s.batch_size, s.time_steps, s.store_yaw_trig);
+  buffers.generated_trajectories.reserve(max_batch_size);
+  buffers.workspace.reset(s.batch_size, max_batch_size, buffers.workspace_buffers);
+
+  // Only the sampled controls are kept at full resolution, to refine the survivors
+  const size_t rows = s.screening_batch_size;
+  const size_t time_steps = s.time_steps;
+  const size_t stride = std::max(s.screening_time_stride, 1u);
+  const size_t coarse_steps = rows != 0 ? (time_steps + stride - 1) / stride : 0;
+  const size_t lateral_rows = buffers.holonomic ? rows : 0;
+  buffers.screening_samples.cvx = xt::zeros<float>({rows, time_steps});
+  buffers.screening_samples.cvy = xt::zeros<float>({lateral_rows, time_steps});
+  buffers.screening_samples.cwz = xt::zeros<float>({rows, time_steps});
+  buffers.screening_state.reset(rows, coarse_steps, buffers.holonomic);
+  buffers.screening_trajectories.reset(rows, coarse_steps, s.store_yaw_trig);
+  buffers.screening_costs = xt::zeros<float>({rows});
+}
+
+void Optimizer::swapBuffers(BatchBuffers & buffers)
+{
+  // Tensors only, the states keep their pose, speed and time steps
+  auto swapState = [](models::State & a, models::State & b) {
+      std::swap(a.vx, b.vx);
+      std::swap(a.vy, b.vy);
+      std::swap(a.wz, b.wz);
+      std::swap(a.cvx, b.cvx);
+      std::swap(a.cvy, b.cvy);
+      std::swap(a.cwz, b.cwz);
+    };
+  swapState(state_, buffers.state);
+  std::swap(generated_trajectories_, buffers.generated_trajectories);
+  std::swap(costs_, buffers.costs);
+  workspace_.swap(buffers.workspace);
+  swapState(screening_samples_, buffers.screening_samples);
+  swapState(screening_state_, buffers.screening_state);
+  std::swap(screening_trajectories_, buffers.screening_trajectories);
+  std::swap(screening_costs_, buffers.screening_costs);
+
+  // An adapted batch size may have changed since, resized within the reserved storage
+  if (state_.vx.shape(0) != settings_.batch_size) {
+    state_.resize(settings_.batch_size);
+    models::resizeBatch(costs_, settings_.batch_size);
+    generated_trajectories_.resize(settings_.batch_size);
+  }
+}
+
+std::unique_ptr<Optimizer::BatchBuffers> Optimizer::takeStagedBuffers()
+{
+  std::unique_ptr<BatchBuffers> buffers;
+  {
+    std::lock_guard<std::mutex> guard(staging_lock_);
+    buffers.swap(staged_buffers_);
+  }
+  if (!buffers) {
+    return buffers;
+  }
+
+  const auto & s = settings_;
+  const auto & b = buffers->settings;
+  const bool fits = buffers->holonomic == isHolonomic() && b.time_steps == s.time_steps &&
+    getMaxBatchSize(b) == getMaxBatchSize(s) &&
+    (b.batch_size == s.batch_size || s.adaptive_batch_size) &&
+    b.store_yaw_trig == s.store_yaw_trig && b.screening_batch_size == s.screening_batch_size &&
+    b.screening_time_stride == s.screening_time_stride;
+  if (!fits) {
+    buffers.reset();
+  }
+  return buffers;
+}
+
+void Optimizer::resize()
+{
+  // The warm control sequence and command history survive, resampled to the new steps
+  const models::ControlSequence previous = control_sequence_;
+  const xt::xtensor<float, 1> previous_dts = model_dts_;
+  const auto history = control_history_;
+  reset();
+  control_history_ = history;
+
+  const size_t previous_steps = previous.vx.shape(0);
+  const size_t time_steps = settings_.time_steps;
+  if (previous_steps == 0 || previous_dts.shape(0) != previous_steps) {
+    return;
+  }
+
+  std::vector<float> previous_starts(previous_steps, 0.0f);
+  for (size_t t = 1; t < previous_steps; t++) {
+    previous_starts[t] = previous_starts[t - 1] + previous_dts(t - 1);
+  }
+
+  float start = 0.0f;
+  for (size_t t = 0; t != time_steps; t++) {
+    const size_t id = std::upper_bound(
+      previous_starts.begin(), previous_starts.end(), start) - previous_starts.begin() - 1;
+    const float w = id + 1 < previous_steps ?
+      std::clamp((start - previous_starts[id]) / previous_dts(id), 0.0f, 1.0f) : 0.0f;
+    const size_t next = std::min(id + 1, previous_steps - 1);
+    control_sequence_.vx(t) = previous.vx(id) + w * (previous.vx(next) - previous.vx(id));
+    control_sequence_.wz(t) = previous.wz(id) + w * (previous.wz(next) - previous.wz(id));
+    control_sequence_.vy(t) = isHolonomic() ?
+      previous.vy(id) + w * (previous.vy(next) - previous.vy(id)) : 0.0f;
+    start += model_dts_(t);
+  }
+  best_control_sequence_ = control_sequence_;
+}
+
+models::OptimizerSettings Optimizer::getNoiseSettings() const
+{
+  return getNoiseSettings(settings_);
+}
+
+models::OptimizerSettings Optimizer::getNoiseSettings(
+  const models::OptimizerSettings & optimizer_settings)
+{
+  models::OptimizerSettings settings = optimizer_settings;
+  if (settings.adaptive_batch_size) {
+    settings.batch_size = settings.max_batch_size;
+  }
+  settings.batch_size = std::max(settings.batch_size, settings.screening_batch_size);
+  return settings;
+}
+
+unsigned int Optimizer::getMaxBatchSize() const
+{
+  return getMaxBatchSize(settings_);
+}
+
+unsigned int Optimizer::getMaxBatchSize(const models::OptimizerSettings & settings)
+{
+  return settings.adaptive_batch_size ? settings.max_batch_size : settings.batch_size;
+}
+
+void Optimizer::setBatchSize(unsigned int batch_size)
+{
+  // Leading rows are kept and new ones sampled, so only the shapes change
+  settings_.batch_size = batch_size;
+  state_.resize(batch_size);
+  models::resizeBatch(costs_, batch_size);
+  generated_trajectories_.resize(batch_size);
+  applied_settings_.batch_size = batch_size;
+  // Pre-rolled trajectories were sampled for the previous size
+  preroll_ready_ = false;
+  RCLCPP_DEBUG(logger_, "Adaptive batch size set to %u", batch_size);
+}
+
+void Optimizer::applyPendingBatchSize()
+{
+  if (pending_batch_size_ != 0) {
+    setBatchSize(pending_batch_size_);
+    pending_batch_size_ = 0;
+  }
+}
+
+void Optimizer::adaptBatchSize(double cycle_time)
+{
+  auto & s = settings_;
+  if (!s.adaptive_batch_size || controller_period_ <= 0.0 || cycle_time <= 0.0) {
+    return;
+  }
+
+  // Shrink as soon as a cycle overruns its budget, grow back only after sustained headroom
+  constexpr double shrink_ratio = 0.9;
+  constexpr double grow_ratio = 0.6;
+  constexpr unsigned int grow_cycles = 10;
+
+  unsigned int batch_size = s.batch_size;
+  if (cycle_time > shrink_ratio * controller_period_) {
+    headroom_cycles_ = 0;
+    // Cycle time is about linear in the batch size, so jump to the size fitting the budget
+    const double fitting = s.batch_size * shrink_ratio * controller_period_ / cycle_time;
+    const unsigned int steps = static_cast<unsigned int>(fitting) / s.batch_size_step;
+    const unsigned int one_step_less =
+      s.batch_size > s.batch_size_step ? s.batch_size - s.batch_size_step : 0;
+    batch_size = std::min(steps * s.batch_size_step, one_step_less);
+  } else if (cycle_time < grow_ratio * controller_period_) {
+    if (++headroom_cycles_ >= grow_cycles) {
+      headroom_cycles_ = 0;
+      batch_size = s.batch_size + s.batch_size_step;
+    }
+  } else {
+    headroom_cycles_ = 0;
+  }
+
+  batch_size = std::clamp(batch_size, s.min_batch_size, s.max_batch_size);
+  pending_batch_size_ = batch_size != s.batch_size ? batch_size : 0;
 }
 
 geometry_msgs::msg::TwistStamped Optimizer::evalControl(
@@ -132,108 +624,742 @@ geometry_msgs::msg::TwistStamped Optimizer::evalControl(
   const geometry_msgs::msg::Twist & robot_speed,
   const nav_msgs::msg::Path & plan, nav2_core::GoalChecker * goal_checker)
 {
-  prepare(robot_pose, robot_speed, plan, goal_checker);
+  models::Path path = utils::toTensor(plan);
+  return evalControl(robot_pose, robot_speed, path, plan.header.stamp, goal_checker);
+}
+
+geometry_msgs::msg::TwistStamped Optimizer::evalControl(
+  const geometry_msgs::msg::PoseStamped & robot_pose,
+  const geometry_msgs::msg::Twist & robot_speed, models::Path & path,
+  const builtin_interfaces::msg::Time & stamp, nav2_core::GoalChecker * goal_checker)
+{
+  finishPreroll();
+  applyPendingBatchSize();
+  const auto start = std::chrono::steady_clock::now();
+  ScopedLatencyTimer eval_control_timer(&latency_profiler_, latency_stages_.eval_control);
+  {
+    ScopedLatencyTimer timer(&latency_profiler_, latency_stages_.prepare);
+    prepare(robot_pose, robot_speed, path, goal_checker);
+    seedNominalSequence();
+  }
+  startWatchdog(start);
 
   do {
     optimize();
   } while (fallback(critics_data_.fail_flag));
 
-  utils::savitskyGolayFilter(control_sequence_, control_history_, settings_);
-  auto control = getControlFromSequenceAsTwist(plan.header.stamp);
+  {
+    ScopedLatencyTimer timer(&latency_profiler_, latency_stages_.smoothing);
+    utils::savitskyGolayFilter(control_sequence_, control_history_, settings_);
+  }
+  auto control = getControlFromSequenceAsTwist(stamp);
 
   if (settings_.shift_control_sequence) {
     shiftControlSequence();
   }
 
+  const std::chrono::duration<double> cycle_time = std::chrono::steady_clock::now() - start;
+  if (settings_.watchdog_budget_ms > 0.0f) {
+    watchdog_stats_.cycles++;
+    watchdog_stats_.overruns += cycle_time.count() * 1e3 > settings_.watchdog_budget_ms ? 1 : 0;
+  }
+
+  // Resized on the next cycle, once this one's trajectories are no longer needed
+  adaptBatchSize(cycle_time.count());
   return control;
 }
 
 void Optimizer::optimize()
 {
+  if (settings_.max_compute_time_ms > 0.0f) {
+    optimizeWithinBudget();
+    return;
+  }
+
   for (size_t i = 0; i < settings_.iteration_count; ++i) {
+    if (!watchdogAllowsIteration(i)) {
+      break;
+    }
+    iterate();
+  }
+}
+
+void Optimizer::startWatchdog(std::chrono::steady_clock::time_point start)
+{
+  auto & w = watchdog_;
+  w.start = start;
+  w.last_check = std::chrono::steady_clock::now();
+  w.skip_visualization = false;
+  w.drop_iterations = false;
+  w.reused_sequence = false;
+  critics_data_.degraded = false;
+  if (settings_.watchdog_budget_ms > 0.0f) {
+    w.previous_sequence = control_sequence_;
+  }
+}
+
+bool Optimizer::watchdogAllowsIteration(size_t iterations)
+{
+  if (settings_.watchdog_budget_ms <= 0.0f) {
+    return true;
+  }
+
+  auto & w = watchdog_;
+  const auto now = std::chrono::steady_clock::now();
+  if (iterations > 0) {
+    w.iteration_time = now - w.last_check;
+  }
+  w.last_check = now;
+
+  // Another iteration like the last one is expected to fit, or the last cycle's first one
+  const std::chrono::duration<double, std::milli> predicted = now - w.start + w.iteration_time;
+  if (predicted.count() <= settings_.watchdog_budget_ms) {
+    return true;
+  }
+
+  // The first degradation not applied yet which applies now, in the configured order
+  using models::WatchdogStep;
+  for (const auto step : settings_.watchdog_steps) {
+    switch (step) {
+      case WatchdogStep::SkipVisualization:
+        // Saves time after the optimization only, so the next degradation applies too
+        if (!w.skip_visualization) {
+          w.skip_visualization = true;
+          watchdog_stats_.skipped_visualizations++;
+        }
+        break;
+      case WatchdogStep::DropIterations:
+        // Needs an iteration of this optimization to use
+        if (iterations > 0) {
+          watchdog_stats_.dropped_iterations += w.drop_iterations ? 0 : 1;
+          w.drop_iterations = true;
+          return false;
+        }
+        break;
+      case WatchdogStep::DisableExpensiveCritics:
+        if (!critics_data_.degraded) {
+          critics_data_.degraded = true;
+          watchdog_stats_.disabled_expensive_critics++;
+          return true;
+        }
+        break;
+      case WatchdogStep::ReusePreviousSequence:
+        // Not when retrying, as the previous sequence may lead into the collision found
+        if (fallback_attempts_ == 0) {
+          control_sequence_ = w.previous_sequence;
+          critics_data_.fail_flag = false;
+          w.reused_sequence = true;
+          watchdog_stats_.reused_sequences++;
+          return false;
+        }
+        break;
+    }
+  }
+
+  // Every degradation applies already, so the optimization iterates until it can drop
+  return true;
+}
+
+void Optimizer::iterate()
+{
+  if (!usePrerolledTrajectories()) {
     generateNoisedTrajectories();
+  }
+  // Depends on this iteration's trajectories, unlike the cycle's path validity
+  critics_data_.furthest_reached_path_point.reset();
+  critics_data_.dead_trajectories.assign(settings_.batch_size, 0);
+  {
+    ScopedLatencyTimer timer(&latency_profiler_, latency_stages_.critics);
     critic_manager_.evalTrajectoriesScores(critics_data_);
-    updateControlSequence();
   }
+  ScopedLatencyTimer timer(&latency_profiler_, latency_stages_.update);
+  updateControlSequence();
+  saveWarmStartSamples();
 }
 
-bool Optimizer::fallback(bool fail)
+void Optimizer::optimizeWithinBudget()
 {
-  static size_t counter = 0;
+  using clock = std::chrono::steady_clock;
+  const auto start = clock::now();
+  const std::chrono::duration<double, std::milli> budget(settings_.max_compute_time_ms);
+
+  float best_cost = std::numeric_limits<float>::max();
+  bool last_is_best = true;
+  for (size_t iterations = 1; ; iterations++) {
+    if (!watchdogAllowsIteration(iterations - 1)) {
+      break;
+    }
+    iterate();
+
+    // An update's expected cost is the weighted cost of the samples it averages
+    const float improvement = best_cost - weighted_cost_;
+    last_is_best = weighted_cost_ < best_cost;
+    if (last_is_best) {
+      best_cost = weighted_cost_;
+      best_control_sequence_ = control_sequence_;
+    }
+
+    if (improvement <= settings_.min_cost_improvement) {
+      break;
+    }
+
+    // Stop unless another iteration like the previous ones still fits in the budget
+    const std::chrono::duration<double, std::milli> elapsed = clock::now() - start;
+    if (elapsed + elapsed / static_cast<double>(iterations) > budget) {
+      break;
+    }
+  }
 
+  // A reused previous sequence replaces this cycle's
+  if (!last_is_best && !watchdog_.reused_sequence) {
+    control_sequence_ = best_control_sequence_;
+    weighted_cost_ = best_cost;
+  }
+}
+
+bool Optimizer::fallback(bool fail)
+{
+  // Per instance, as optimizers may run concurrently
   if (!fail) {
-    counter = 0;
+    fallback_attempts_ = 0;
     return false;
   }
 
-  reset();
-
-  if (++counter > settings_.retry_attempt_limit) {
-    counter = 0;
+  if (++fallback_attempts_ > settings_.retry_attempt_limit) {
+    fallback_attempts_ = 0;
+    reset();
     throw std::runtime_error("Optimizer fail to compute path");
   }
 
+  // Recovery retries keep the buffers and control sequence, sampling wider instead
+  if (!settings_.fallback_recovery) {
+    reset();
+  }
+
   return true;
 }
 
+void Optimizer::applyRecoverySamples()
+{
+  if (!settings_.fallback_recovery || fallback_attempts_ == 0) {
+    return;
+  }
+
+  // Widen the sampled deviations from the control sequence, more on every attempt
+  const auto & s = settings_;
+  const float scale = std::pow(s.fallback_std_scale, static_cast<float>(fallback_attempts_));
+  const size_t time_steps = s.time_steps;
+  auto widen = [&](models::BatchTensor<2> & sampled, const xt::xtensor<float, 1> & mean,
+      size_t begin, size_t end) {
+      for (size_t i = begin; i != end; i++) {
+        float * row = sampled.data() + i * time_steps;
+        for (size_t t = 0; t != time_steps; t++) {
+          row[t] = mean(t) + scale * (row[t] - mean(t));
+        }
+      }
+    };
+  thread_pool_.parallelFor(
+    s.batch_size, [&](size_t begin, size_t end) {
+      widen(state_.cvx, control_sequence_.vx, begin, end);
+      widen(state_.cwz, control_sequence_.wz, begin, end);
+      if (isHolonomic()) {
+        widen(state_.cvy, control_sequence_.vy, begin, end);
+      }
+    });
+
+  // The first rows try stopping, reversing and rotating in place either way
+  const std::array<models::Control, 4> primitives = {
+    models::Control{0.0f, 0.0f, 0.0f}, models::Control{s.constraints.vx_min, 0.0f, 0.0f},
+    models::Control{0.0f, 0.0f, s.constraints.wz}, models::Control{0.0f, 0.0f, -s.constraints.wz}};
+  const size_t count = std::min<size_t>(primitives.size(), s.batch_size / 2);
+  for (size_t k = 0; k != count; k++) {
+    auto fill = [&](models::BatchTensor<2> & sampled, float value) {
+        std::fill_n(sampled.data() + k * time_steps, time_steps, value);
+      };
+    fill(state_.cvx, primitives[k].vx);
+    fill(state_.cwz, primitives[k].wz);
+    if (isHolonomic()) {
+      fill(state_.cvy, primitives[k].vy);
+    }
+  }
+}
+
 void Optimizer::prepare(
   const geometry_msgs::msg::PoseStamped & robot_pose,
   const geometry_msgs::msg::Twist & robot_speed,
   const nav_msgs::msg::Path & plan, nav2_core::GoalChecker * goal_checker)
+{
+  models::Path path = utils::toTensor(plan);
+  prepare(robot_pose, robot_speed, path, goal_checker);
+}
+
+void Optimizer::prepare(
+  const geometry_msgs::msg::PoseStamped & robot_pose,
+  const geometry_msgs::msg::Twist & robot_speed,
+  models::Path & path, nav2_core::GoalChecker * goal_checker)
 {
   state_.pose = robot_pose;
   state_.speed = robot_speed;
-  path_ = utils::toTensor(plan);
+  std::swap(path_, path);
+  path_index_.build(path_);
   costs_.fill(0);
 
   critics_data_.fail_flag = false;
   critics_data_.goal_checker = goal_checker;
   critics_data_.motion_model = motion_model_;
+  critics_data_.fast_math = settings_.fast_math;
+  critics_data_.costmap_snapshot = nullptr;
+  if (settings_.costmap_snapshot) {
+    costmap_snapshot_.update(
+      *costmap_, costmap_source_->isTrackingUnknown());
+    critics_data_.costmap_snapshot = &costmap_snapshot_;
+  }
   critics_data_.furthest_reached_path_point.reset();
-  critics_data_.path_pts_valid.reset();
+  workspace_.releasePathValidity(critics_data_.path_pts_valid);
+  cycle_context_.reset();
+  critics_data_.cycle_context = &cycle_context_;
+  critics_data_.kernel_set = kernels_;
+
+  if (settings_.screening_batch_size != 0) {
+    auto & screening = screening_data_;
+    screening.goal_checker = goal_checker;
+    screening.motion_model = motion_model_;
+    screening.fast_math = settings_.fast_math;
+    screening.costmap_snapshot = critics_data_.costmap_snapshot;
+    screening.furthest_reached_path_point.reset();
+    workspace_.releasePathValidity(screening.path_pts_valid);
+    // Kept apart, as the coarser first step moves the trajectory initial point
+    screening_cycle_context_.reset();
+    screening.cycle_context = &screening_cycle_context_;
+    screening.kernel_set = kernels_;
+  }
+}
+
+void Optimizer::resetScreening()
+{
+  const auto & s = settings_;
+  const size_t rows = s.screening_batch_size;
+  const size_t time_steps = s.time_steps;
+  const size_t stride = std::max(s.screening_time_stride, 1u);
+  const size_t coarse_steps = rows != 0 ? (time_steps + stride - 1) / stride : 0;
+
+  // A coarse step lasts as long as the time steps it groups, the last maybe fewer
+  screening_dts_ = xt::zeros<float>({coarse_steps});
+  for (size_t t = 0; coarse_steps != 0 && t != time_steps; t++) {
+    screening_dts_(t / stride) += model_dts_(t);
+  }
+  screening_model_dt_ = s.model_dt * stride;
+  screening_data_.model_dts = &screening_dts_;
+  screening_state_.model_dts = &screening_dts_;
+  screening_data_.screening = true;
+}
+
+void Optimizer::screenSamples()
+{
+  const auto & s = settings_;
+  const size_t rows = s.screening_batch_size;
+  const size_t time_steps = s.time_steps;
+  const size_t stride = s.screening_time_stride;
+  const size_t coarse_steps = screening_state_.cvx.shape(1);
+  const bool holonomic = isHolonomic();
+
+  noise_generator_.setNoisedControls(screening_samples_, control_sequence_);
+  screening_state_.pose = state_.pose;
+  screening_state_.speed = state_.speed;
+
+  // Coarse rollouts hold each control over the time steps of its group
+  thread_pool_.parallelFor(
+    rows, [&](size_t begin, size_t end) {
+      auto subsample = [&](
+        const models::BatchTensor<2> & controls, models::BatchTensor<2> & coarse) {
+          for (size_t i = begin; i != end; i++) {
+            const float * src = controls.data() + i * time_steps;
+            float * dst = coarse.data() + i * coarse_steps;
+            for (size_t k = 0; k != coarse_steps; k++) {
+              dst[k] = src[k * stride];
+            }
+          }
+        };
+
+      subsample(screening_samples_.cvx, screening_state_.cvx);
+      subsample(screening_samples_.cwz, screening_state_.cwz);
+      if (holonomic) {
+        subsample(screening_samples_.cvy, screening_state_.cvy);
+      }
+      if (s.constrain_samples) {
+        motion_model_->applyConstraints(screening_state_, begin, end);
+      }
+      updateStateVelocities(screening_state_, begin, end);
+      rollout::integrate(
+        screening_trajectories_, screening_state_, begin, end, screening_model_dt_, holonomic,
+        s.fast_math, screening_dts_.data(), kernels_);
+    });
+
+  screening_costs_.fill(0.0f);
+  screening_data_.fail_flag = false;
+  screening_data_.furthest_reached_path_point.reset();
+  screening_data_.dead_trajectories.assign(rows, 0);
+  critic_manager_.evalTrajectoriesScores(screening_data_, critics::CriticStage::Screening);
+
+  // The lowest cost samples survive, refined at full resolution by the whole batch
+  const size_t survivors = std::min<size_t>(s.batch_size, rows);
+  screening_ids_.resize(rows);
+  std::iota(screening_ids_.begin(), screening_ids_.end(), 0);
+  std::nth_element(
+    screening_ids_.begin(), screening_ids_.begin() + survivors, screening_ids_.end(),
+    [this](size_t a, size_t b) {return screening_costs_(a) < screening_costs_(b);});
+
+  thread_pool_.parallelFor(
+    survivors, [&](size_t begin, size_t end) {
+      auto copy = [&](const models::BatchTensor<2> & samples, models::BatchTensor<2> & controls) {
+          for (size_t k = begin; k != end; k++) {
+            const float * row = samples.data() + screening_ids_[k] * time_steps;
+            std::copy(row, row + time_steps, controls.data() + k * time_steps);
+          }
+        };
+
+      copy(screening_samples_.cvx, state_.cvx);
+      copy(screening_samples_.cwz, state_.cwz);
+      if (holonomic) {
+        copy(screening_samples_.cvy, state_.cvy);
+      }
+    });
+}
+
+void Optimizer::updateModelDts()
+{
+  const size_t time_steps = settings_.time_steps;
+  model_dts_ = utils::getModelDts(settings_);
+  state_.model_dts = &model_dts_;
+  const bool growing = settings_.model_dt_max > 0.0f;
+  critics_data_.model_dts = growing ? &model_dts_ : nullptr;
+
+  shift_ids_.clear();
+  shift_weights_.clear();
+  if (!growing) {
+    return;
+  }
+
+  // Start time of each point, the shifted sequence is sampled one model_dt later
+  std::vector<float> starts(time_steps, 0.0f);
+  for (size_t t = 1; t < time_steps; t++) {
+    starts[t] = starts[t - 1] + model_dts_(t - 1);
+  }
+
+  shift_ids_.resize(time_steps);
+  shift_weights_.resize(time_steps);
+  for (size_t t = 0; t != time_steps; t++) {
+    const float time = starts[t] + model_dts_(0);
+    const size_t id = std::upper_bound(starts.begin(), starts.end(), time) - starts.begin() - 1;
+    shift_ids_[t] = id;
+    shift_weights_[t] = id + 1 < time_steps ?
+      std::min((time - starts[id]) / model_dts_(id), 1.0f) : 0.0f;
+  }
 }
 
 void Optimizer::shiftControlSequence()
 {
-  using namespace xt::placeholders;  // NOLINT
-  control_sequence_.vx = xt::roll(control_sequence_.vx, -1);
-  control_sequence_.wz = xt::roll(control_sequence_.wz, -1);
+  // Shift in place, never reading a point already written
+  auto shift = [this](float * controls, size_t size) {
+      if (shift_ids_.size() != size) {
+        // By one time step, repeating the last control
+        std::copy(controls + 1, controls + size, controls);
+        return;
+      }
+      for (size_t t = 0; t != size; t++) {
+        const size_t id = shift_ids_[t];
+        const float next = controls[std::min(id + 1, size - 1)];
+        controls[t] = controls[id] + shift_weights_[t] * (next - controls[id]);
+      }
+    };
+
+  shift(control_sequence_.vx.data(), control_sequence_.vx.size());
+  shift(control_sequence_.wz.data(), control_sequence_.wz.size());
+
+  if (isHolonomic()) {
+    shift(control_sequence_.vy.data(), control_sequence_.vy.size());
+  }
+
+  // Warm start samples follow the control sequence they were sampled around
+  const size_t time_steps = settings_.time_steps;
+  auto shiftRows = [&](xt::xtensor<float, 2> & samples) {
+      for (size_t k = 0; k != warm_start_.count; k++) {
+        shift(samples.data() + k * time_steps, time_steps);
+      }
+    };
+
+  shiftRows(warm_start_.vx);
+  shiftRows(warm_start_.wz);
+
+  if (isHolonomic()) {
+    shiftRows(warm_start_.vy);
+  }
+}
+
+void Optimizer::saveWarmStartSamples()
+{
+  auto & w = warm_start_;
+  const size_t batch_size = settings_.batch_size;
+  const size_t time_steps = settings_.time_steps;
+  const size_t count = std::min<size_t>(settings_.warm_start_samples, batch_size / 2);
+  w.count = 0;
+  if (count == 0) {
+    return;
+  }
 
+  // Trajectories in collision are not worth reusing, unless none is left
+  const auto & dead = critics_data_.dead_trajectories;
+  const bool prune = dead.size() == batch_size &&
+    std::find(dead.begin(), dead.end(), 0) != dead.end();
+  w.ids.clear();
+  for (size_t i = 0; i != batch_size; i++) {
+    if (!prune || dead[i] == 0) {
+      w.ids.push_back(i);
+    }
+  }
+
+  const size_t kept = std::min(count, w.ids.size());
+  if (kept < w.ids.size()) {
+    std::nth_element(
+      w.ids.begin(), w.ids.begin() + kept, w.ids.end(),
+      [this](size_t a, size_t b) {return costs_(a) < costs_(b);});
+  }
 
-  xt::view(control_sequence_.vx, -1) =
-    xt::view(control_sequence_.vx, -2);
+  if (w.vx.shape(0) != count || w.vx.shape(1) != time_steps) {
+    w.vx = xt::zeros<float>({count, time_steps});
+    w.vy = xt::zeros<float>({count, time_steps});
+    w.wz = xt::zeros<float>({count, time_steps});
+  }
 
-  xt::view(control_sequence_.wz, -1) =
-    xt::view(control_sequence_.wz, -2);
+  auto save = [&](const models::BatchTensor<2> & sampled, xt::xtensor<float, 2> & samples) {
+      for (size_t k = 0; k != kept; k++) {
+        const float * row = sampled.data() + w.ids[k] * time_steps;
+        std::copy(row, row + time_steps, samples.data() + k * time_steps);
+      }
+    };
 
+  save(state_.cvx, w.vx);
+  save(state_.cwz, w.wz);
+  if (isHolonomic()) {
+    save(state_.cvy, w.vy);
+  }
+  w.count = kept;
+}
 
+void Optimizer::applyWarmStartSamples()
+{
+  const auto & w = warm_start_;
+  const size_t batch_size = settings_.batch_size;
+  const size_t time_steps = settings_.time_steps;
+  const size_t count = std::min(w.count, batch_size / 2);
+
+  // Seed the last rows of the batch, in place of some of the fresh samples
+  auto apply = [&](const xt::xtensor<float, 2> & samples, models::BatchTensor<2> & sampled) {
+      for (size_t k = 0; k != count; k++) {
+        const float * row = samples.data() + k * time_steps;
+        std::copy(row, row + time_steps, sampled.data() + (batch_size - count + k) * time_steps);
+      }
+    };
+
+  apply(w.vx, state_.cvx);
+  apply(w.wz, state_.cwz);
   if (isHolonomic()) {
-    control_sequence_.vy = xt::roll(control_sequence_.vy, -1);
-    xt::view(control_sequence_.vy, -1) =
-      xt::view(control_sequence_.vy, -2);
+    apply(w.vy, state_.cvy);
   }
 }
 
 void Optimizer::generateNoisedTrajectories()
 {
+  {
+    ScopedLatencyTimer timer(&latency_profiler_, latency_stages_.noise);
+    if (settings_.screening_batch_size != 0) {
+      ScopedLatencyTimer screening_timer(&latency_profiler_, latency_stages_.screening);
+      screenSamples();
+    } else {
+      noise_generator_.setNoisedControls(state_, control_sequence_);
+    }
+    noise_generator_.generateNextNoises();
+    applyWarmStartSamples();
+    applyRecoverySamples();
+  }
+
+  ScopedLatencyTimer timer(&latency_profiler_, latency_stages_.rollout);
+  // Trajectories are independent of each other, so the batch is rolled out in chunks,
+  // their sampled controls made feasible first if set to rather than left to the critics
+  thread_pool_.parallelFor(
+    settings_.batch_size, [this](size_t begin, size_t end) {
+      if (settings_.constrain_samples) {
+        motion_model_->applyConstraints(state_, begin, end);
+      }
+      updateStateVelocities(state_, begin, end);
+      integrateStateVelocities(generated_trajectories_, state_, begin, end);
+    });
+}
+
+void Optimizer::startPreroll()
+{
+  finishPreroll();
+  preroll_ready_ = false;
+  // This cycle's trajectories are published by now, so the next batch size applies
+  applyPendingBatchSize();
+  if (!settings_.pipelined_rollouts || !canPreroll()) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> guard(preroll_lock_);
+  if (!preroll_thread_.joinable()) {
+    preroll_stop_ = false;
+    preroll_placed_ = false;
+    preroll_thread_ = std::thread(&Optimizer::prerollThread, this);
+  }
+  preroll_requested_ = true;
+  guard.unlock();
+  preroll_cond_.notify_all();
+}
+
+void Optimizer::finishPreroll()
+{
+  std::unique_lock<std::mutex> guard(preroll_lock_);
+  preroll_cond_.wait(guard, [this]() {return !preroll_requested_;});
+}
+
+void Optimizer::prerollThread()
+{
+  std::unique_lock<std::mutex> guard(preroll_lock_);
+  while (true) {
+    preroll_cond_.wait(guard, [this]() {return preroll_requested_ || preroll_stop_;});
+    if (preroll_stop_) {
+      preroll_requested_ = false;
+      preroll_cond_.notify_all();
+      return;
+    }
+
+    guard.unlock();
+    if (!preroll_placed_) {
+      // The pre-roll thread runs the rollouts the workers would, so it is placed alike
+      models::ThreadPlacementReport report;
+      report.applied = applyThreadPlacement(settings_.worker_placement, report.description);
+      logPlacement("Pre-roll thread", report);
+      preroll_placed_ = true;
+    }
+    if (trace_recorder_) {
+      trace_recorder_->nameThread("preroll");
+    }
+    bool ready = false;
+    try {
+      prerollNextCycle();
+      ready = true;
+    } catch (const std::exception & e) {
+      RCLCPP_WARN(logger_, "Pre-rolling the next cycle failed: %s", e.what());
+    }
+    guard.lock();
+    preroll_ready_ = ready;
+    preroll_requested_ = false;
+    preroll_cond_.notify_all();
+  }
+}
+
+bool Optimizer::canPreroll() const
+{
+  // Screening, nominal sequences and speed dependent velocities need the next inputs
+  return settings_.screening_batch_size == 0 &&
+         settings_.nominal_sequence == models::NominalSequence::Previous &&
+         !motion_model_->dependsOnInitialVelocities() && fallback_attempts_ == 0;
+}
+
+void Optimizer::prerollNextCycle()
+{
+  ScopedLatencyTimer timer(&latency_profiler_, latency_stages_.preroll);
   noise_generator_.setNoisedControls(state_, control_sequence_);
   noise_generator_.generateNextNoises();
-  updateStateVelocities(state_);
-  integrateStateVelocities(generated_trajectories_, state_);
+  applyWarmStartSamples();
+
+  // Without speed, a rollout's first step stays at the origin, so that the next cycle's
+  // rollouts are these moved onto where its measured speed takes the robot in one step
+  const auto pose = state_.pose;
+  const auto speed = state_.speed;
+  state_.pose = geometry_msgs::msg::PoseStamped();
+  state_.speed = geometry_msgs::msg::Twist();
+  thread_pool_.parallelFor(
+    settings_.batch_size, [this](size_t begin, size_t end) {
+      if (settings_.constrain_samples) {
+        motion_model_->applyConstraints(state_, begin, end);
+      }
+      updateStateVelocities(state_, begin, end);
+      integrateStateVelocities(generated_trajectories_, state_, begin, end);
+    });
+  state_.pose = pose;
+  state_.speed = speed;
 }
 
-bool Optimizer::isHolonomic() const {return motion_model_->isHolonomic();}
+bool Optimizer::usePrerolledTrajectories()
+{
+  if (!preroll_ready_) {
+    return false;
+  }
+  preroll_ready_ = false;
+
+  // The velocities only differ by the first ones, the measured speed
+  ScopedLatencyTimer timer(&latency_profiler_, latency_stages_.rollout);
+  updateInitialStateVelocities(state_);
+
+  // Pose after the first step, as integrated, which every rollout starts from
+  const auto & speed = state_.speed;
+  const auto & position = state_.pose.pose.position;
+  const double yaw = tf2::getYaw(state_.pose.pose.orientation);
+  const double dt = critics_data_.model_dts ? model_dts_(0) : settings_.model_dt;
+  const double vy = isHolonomic() ? speed.linear.y : 0.0;
+  const float x0 = static_cast<float>(
+    position.x + (speed.linear.x * std::cos(yaw) - vy * std::sin(yaw)) * dt);
+  const float y0 = static_cast<float>(
+    position.y + (speed.linear.x * std::sin(yaw) + vy * std::cos(yaw)) * dt);
+  const double yaw0 = yaw + speed.angular.z * dt;
+  const float yaw0_f = static_cast<float>(yaw0);
+  const float cos0 = static_cast<float>(std::cos(yaw0));
+  const float sin0 = static_cast<float>(std::sin(yaw0));
+
+  auto & t = generated_trajectories_;
+  const bool yaw_trig = t.hasYawTrig();
+  const size_t time_steps = t.x.shape(1);
+  thread_pool_.parallelFor(
+    settings_.batch_size, [&](size_t begin, size_t end) {
+      constexpr float pi = static_cast<float>(M_PI);
+      for (size_t i = begin; i != end; i++) {
+        for (size_t j = 0; j != time_steps; j++) {
+          const float px = t.x(i, j);
+          const float py = t.y(i, j);
+          t.x(i, j) = x0 + cos0 * px - sin0 * py;
+          t.y(i, j) = y0 + sin0 * px + cos0 * py;
+          // Wrapped as normalize_angles does
+          const float theta = std::fmod(t.yaws(i, j) + yaw0_f + pi, 2.0f * pi);
+          t.yaws(i, j) = theta <= 0.0f ? theta + pi : theta - pi;
+          if (yaw_trig) {
+            const float c = t.yaw_cos(i, j);
+            const float s = t.yaw_sin(i, j);
+            t.yaw_cos(i, j) = cos0 * c - sin0 * s;
+            t.yaw_sin(i, j) = sin0 * c + cos0 * s;
+          }
+        }
+      }
+    });
+  return true;
+}
+
+bool Optimizer::isHolonomic() const {return is_holonomic_;}
 
 void Optimizer::applyControlSequenceConstraints()
 {
   auto & s = settings_;
 
   if (isHolonomic()) {
-    control_sequence_.vy = xt::clip(control_sequence_.vy, -s.constraints.vy, s.constraints.vy);
+    xt::noalias(control_sequence_.vy) =
+      xt::clip(control_sequence_.vy, -s.constraints.vy, s.constraints.vy);
   }
 
-  control_sequence_.vx = xt::clip(control_sequence_.vx, s.constraints.vx_min, s.constraints.vx_max);
-  control_sequence_.wz = xt::clip(control_sequence_.wz, -s.constraints.wz, s.constraints.wz);
+  xt::noalias(control_sequence_.vx) =
+    xt::clip(control_sequence_.vx, s.constraints.vx_min, s.constraints.vx_max);
+  xt::noalias(control_sequence_.wz) =
+    xt::clip(control_sequence_.wz, -s.constraints.wz, s.constraints.wz);
 
   motion_model_->applyConstraints(control_sequence_);
 }
@@ -241,25 +1367,44 @@ void Optimizer::applyControlSequenceConstraints()
 void Optimizer::updateStateVelocities(
   models::State & state) const
 {
-  updateInitialStateVelocities(state);
-  propagateStateVelocitiesFromInitials(state);
+  updateStateVelocities(state, 0, state.vx.shape(0));
+}
+
+void Optimizer::updateStateVelocities(
+  models::State & state, size_t begin, size_t end) const
+{
+  updateInitialStateVelocities(state, begin, end);
+  propagateStateVelocitiesFromInitials(state, begin, end);
 }
 
 void Optimizer::updateInitialStateVelocities(
   models::State & state) const
 {
-  xt::noalias(xt::view(state.vx, xt::all(), 0)) = state.speed.linear.x;
-  xt::noalias(xt::view(state.wz, xt::all(), 0)) = state.speed.angular.z;
+  updateInitialStateVelocities(state, 0, state.vx.shape(0));
+}
+
+void Optimizer::updateInitialStateVelocities(
+  models::State & state, size_t begin, size_t end) const
+{
+  const auto rows = xt::range(begin, end);
+  xt::noalias(xt::view(state.vx, rows, 0)) = state.speed.linear.x;
+  xt::noalias(xt::view(state.wz, rows, 0)) = state.speed.angular.z;
 
   if (isHolonomic()) {
-    xt::noalias(xt::view(state.vy, xt::all(), 0)) = state.speed.linear.y;
+    xt::noalias(xt::view(state.vy, rows, 0)) = state.speed.linear.y;
   }
 }
 
 void Optimizer::propagateStateVelocitiesFromInitials(
   models::State & state) const
 {
-  motion_model_->predict(state);
+  propagateStateVelocitiesFromInitials(state, 0, state.vx.shape(0));
+}
+
+void Optimizer::propagateStateVelocitiesFromInitials(
+  models::State & state, size_t begin, size_t end) const
+{
+  motion_model_->predict(state, begin, end);
 }
 
 void Optimizer::integrateStateVelocities(
@@ -277,7 +1422,7 @@ void Optimizer::integrateStateVelocities(
   auto traj_yaws = xt::view(trajectory, xt::all(), 2);
 
   xt::noalias(traj_yaws) =
-    utils::normalize_angles(xt::cumsum(wz * settings_.model_dt, 0) + initial_yaw);
+    utils::normalize_angles(xt::cumsum(wz * model_dts_, 0) + initial_yaw);
 
   auto && yaw_cos = xt::xtensor<float, 1>::from_shape(traj_yaws.shape());
   auto && yaw_sin = xt::xtensor<float, 1>::from_shape(traj_yaws.shape());
@@ -297,40 +1442,30 @@ void Optimizer::integrateStateVelocities(
     dy = dy + vy * yaw_cos;
   }
 
-  xt::noalias(traj_x) = state_.pose.pose.position.x + xt::cumsum(dx * settings_.model_dt, 0);
-  xt::noalias(traj_y) = state_.pose.pose.position.y + xt::cumsum(dy * settings_.model_dt, 0);
+  xt::noalias(traj_x) = state_.pose.pose.position.x + xt::cumsum(dx * model_dts_, 0);
+  xt::noalias(traj_y) = state_.pose.pose.position.y + xt::cumsum(dy * model_dts_, 0);
 }
 
 void Optimizer::integrateStateVelocities(
   models::Trajectories & trajectories,
   const models::State & state) const
 {
-  const double initial_yaw = tf2::getYaw(state.pose.pose.orientation);
-
-  xt::noalias(trajectories.yaws) =
-    utils::normalize_angles(xt::cumsum(state.wz * settings_.model_dt, 1) + initial_yaw);
-
-  const auto yaws_cutted = xt::view(trajectories.yaws, xt::all(), xt::range(0, -1));
-
-  auto && yaw_cos = xt::xtensor<float, 2>::from_shape(trajectories.yaws.shape());
-  auto && yaw_sin = xt::xtensor<float, 2>::from_shape(trajectories.yaws.shape());
-  xt::noalias(xt::view(yaw_cos, xt::all(), 0)) = std::cos(initial_yaw);
-  xt::noalias(xt::view(yaw_sin, xt::all(), 0)) = std::sin(initial_yaw);
-  xt::noalias(xt::view(yaw_cos, xt::all(), xt::range(1, _))) = xt::cos(yaws_cutted);
-  xt::noalias(xt::view(yaw_sin, xt::all(), xt::range(1, _))) = xt::sin(yaws_cutted);
-
-  auto && dx = xt::eval(state.vx * yaw_cos);
-  auto && dy = xt::eval(state.vx * yaw_sin);
-
-  if (isHolonomic()) {
-    dx = dx - state.vy * yaw_sin;
-    dy = dy + state.vy * yaw_cos;
+  const auto & shape = state.vx.shape();
+  if (trajectories.x.shape() != shape || trajectories.hasYawTrig() != settings_.store_yaw_trig) {
+    trajectories.reset(shape[0], shape[1], settings_.store_yaw_trig);
   }
 
-  xt::noalias(trajectories.x) = state.pose.pose.position.x +
-    xt::cumsum(dx * settings_.model_dt, 1);
-  xt::noalias(trajectories.y) = state.pose.pose.position.y +
-    xt::cumsum(dy * settings_.model_dt, 1);
+  integrateStateVelocities(trajectories, state, 0, shape[0]);
+}
+
+void Optimizer::integrateStateVelocities(
+  models::Trajectories & trajectories,
+  const models::State & state, size_t begin, size_t end) const
+{
+  const float * model_dts = critics_data_.model_dts ? model_dts_.data() : nullptr;
+  rollout::integrate(
+    trajectories, state, begin, end, settings_.model_dt, isHolonomic(), settings_.fast_math,
+    model_dts, kernels_);
 }
 
 xt::xtensor<float, 2> Optimizer::getOptimizedTrajectory()
@@ -352,32 +1487,189 @@ xt::xtensor<float, 2> Optimizer::getOptimizedTrajectory()
 
 void Optimizer::updateControlSequence()
 {
-  auto & s = settings_;
-  auto bounded_noises_vx = state_.cvx - control_sequence_.vx;
-  auto bounded_noises_wz = state_.cwz - control_sequence_.wz;
-  xt::noalias(costs_) +=
-    s.gamma / std::pow(s.sampling_std.vx, 2) * xt::sum(
-    xt::view(control_sequence_.vx, xt::newaxis(), xt::all()) * bounded_noises_vx, 1, immediate);
-  xt::noalias(costs_) +=
-    s.gamma / std::pow(s.sampling_std.wz, 2) * xt::sum(
-    xt::view(control_sequence_.wz, xt::newaxis(), xt::all()) * bounded_noises_wz, 1, immediate);
-
   if (isHolonomic()) {
-    auto bounded_noises_vy = state_.cvy - control_sequence_.vy;
-    xt::noalias(costs_) +=
-      s.gamma / std::pow(s.sampling_std.vy, 2) * xt::sum(
-      xt::view(control_sequence_.vy, xt::newaxis(), xt::all()) * bounded_noises_vy,
-      1, immediate);
+    updateControlSequence<true>();
+  } else {
+    updateControlSequence<false>();
   }
+}
 
-  auto && costs_normalized = costs_ - xt::amin(costs_, immediate);
-  auto && exponents = xt::eval(xt::exp(-1 / settings_.temperature * costs_normalized));
-  auto && softmaxes = xt::eval(exponents / xt::sum(exponents, immediate));
-  auto && softmaxes_extened = xt::eval(xt::view(softmaxes, xt::all(), xt::newaxis()));
+template<bool Holonomic>
+void Optimizer::updateControlSequence()
+{
+  auto & s = settings_;
+  const bool adaptive_sampling = s.adaptive_sampling;
+  const size_t time_steps = s.time_steps;
+  const float inv_temperature = 1.0f / s.temperature;
+
+  // Sum over time of gain * control * (sampled control - control), i.e. control * noise,
+  // the gain varying along time with the adapted deviations
+  auto controlCost = [time_steps](
+    const xt::xtensor<float, 1> & control, const float * sampled, float gain,
+    const xt::xtensor<float, 1> & step_gains, bool adapted) {
+      const float * u = control.data();
+      float cost = 0.0f;
+      if (adapted) {
+        const float * g = step_gains.data();
+        for (size_t t = 0; t != time_steps; t++) {
+          cost += g[t] * u[t] * (sampled[t] - u[t]);
+        }
+        return cost;
+      }
+      for (size_t t = 0; t != time_steps; t++) {
+        cost += u[t] * (sampled[t] - u[t]);
+      }
+      return gain * cost;
+    };
+
+  // Trajectories in collision get no weight, unless none is left to weight
+  const auto & dead = critics_data_.dead_trajectories;
+  const bool prune = dead.size() == s.batch_size &&
+    std::find(dead.begin(), dead.end(), 0) != dead.end();
+  auto isPruned = [&](size_t i) {return prune && dead[i] != 0;};
+
+  const float vx_gain = s.gamma / std::pow(s.sampling_std.vx, 2);
+  const float vy_gain = s.gamma / std::pow(s.sampling_std.vy, 2);
+  const float wz_gain = s.gamma / std::pow(s.sampling_std.wz, 2);
+  if (adaptive_sampling) {
+    // The samples were drawn with the scales as they are until adapted after this update
+    const auto & scales = noise_generator_.getSamplingScales();
+    auto & g = sampling_gains_;
+    for (size_t t = 0; t != time_steps; t++) {
+      g.vx(t) = vx_gain / (scales.vx(t) * scales.vx(t));
+      g.vy(t) = vy_gain / (scales.vy(t) * scales.vy(t));
+      g.wz(t) = wz_gain / (scales.wz(t) * scales.wz(t));
+    }
+  }
+  const auto & kernel_set = kernels_ ? *kernels_ : kernels::baselineKernels();
+
+  // Single pass streaming softmax: each chunk adds the control costs, then weights its
+  // trajectories relative to its running min cost, rescaling its sums when the min drops.
+  // Chunks are merged in chunk order so that the result only depends on the pool size,
+  // not on thread scheduling
+  const size_t sums = adaptive_sampling ? 6 : 3;
+  const size_t num_chunks = std::min<size_t>(partial_controls_.shape(1), s.batch_size);
+  thread_pool_.parallelFor(
+    num_chunks, [&](size_t first, size_t last) {
+      for (size_t c = first; c != last; c++) {
+        std::array<float *, 6> partial_sums{};
+        for (size_t k = 0; k != sums; k++) {
+          partial_sums[k] = &partial_controls_(k, c, 0);
+          std::fill_n(partial_sums[k], time_steps, 0.0f);
+        }
+        float * sum_vx = partial_sums[0];
+        float * sum_vy = partial_sums[1];
+        float * sum_wz = partial_sums[2];
+        float * sq_sum_vx = partial_sums[3];
+        float * sq_sum_vy = partial_sums[4];
+        float * sq_sum_wz = partial_sums[5];
+
+        SoftmaxPartial partial{std::numeric_limits<float>::max(), 0.0f, 0.0f, 0.0f};
+        const size_t rows_end = (c + 1) * s.batch_size / num_chunks;
+        for (size_t i = c * s.batch_size / num_chunks; i != rows_end; i++) {
+          if (isPruned(i)) {
+            continue;
+          }
+          const size_t row = i * time_steps;
+          const float * cvx = state_.cvx.data() + row;
+          const float * cwz = state_.cwz.data() + row;
+          const auto & g = sampling_gains_;
+          float cost = costs_(i) +
+            controlCost(control_sequence_.vx, cvx, vx_gain, g.vx, adaptive_sampling) +
+            controlCost(control_sequence_.wz, cwz, wz_gain, g.wz, adaptive_sampling);
+          if constexpr (Holonomic) {
+            cost += controlCost(
+              control_sequence_.vy, state_.cvy.data() + row, vy_gain, g.vy, adaptive_sampling);
+          }
+          costs_(i) = cost;
+
+          if (cost < partial.min_cost) {
+            if (partial.normalizer > 0.0f) {
+              const float rescale = std::exp((cost - partial.min_cost) * inv_temperature);
+              partial.normalizer *= rescale;
+              partial.weighted_cost *= rescale;
+              for (size_t k = 0; k != sums; k++) {
+                for (size_t t = 0; t != time_steps; t++) {
+                  partial_sums[k][t] *= rescale;
+                }
+              }
+            }
+            partial.min_cost = cost;
+          }
+
+          const float weight = std::exp((partial.min_cost - cost) * inv_temperature);
+          partial.normalizer += weight;
+          partial.weighted_cost += weight * cost;
+          kernels::weightedSum(
+            kernel_set, weight, cvx, sum_vx, adaptive_sampling ? sq_sum_vx : nullptr, time_steps);
+          kernels::weightedSum(
+            kernel_set, weight, cwz, sum_wz, adaptive_sampling ? sq_sum_wz : nullptr, time_steps);
+          if constexpr (Holonomic) {
+            kernels::weightedSum(
+              kernel_set, weight, state_.cvy.data() + row, sum_vy,
+              adaptive_sampling ? sq_sum_vy : nullptr, time_steps);
+          }
+        }
+        softmax_partials_[c] = partial;
+      }
+    });
+
+  // Chunk weights relative to the batch min cost, normalized over the batch
+  float min_cost = std::numeric_limits<float>::max();
+  for (size_t c = 0; c != num_chunks; c++) {
+    min_cost = std::min(min_cost, softmax_partials_[c].min_cost);
+  }
+  float normalizer = 0.0f;
+  float weighted_cost = 0.0f;
+  for (size_t c = 0; c != num_chunks; c++) {
+    auto & partial = softmax_partials_[c];
+    partial.scale = partial.normalizer > 0.0f ?
+      std::exp((min_cost - partial.min_cost) * inv_temperature) : 0.0f;
+    normalizer += partial.scale * partial.normalizer;
+    weighted_cost += partial.scale * partial.weighted_cost;
+  }
+  for (size_t c = 0; c != num_chunks; c++) {
+    softmax_partials_[c].scale /= normalizer;
+  }
+  weighted_cost_ = weighted_cost / normalizer;
+
+  control_sequence_.vx.fill(0.0f);
+  control_sequence_.vy.fill(0.0f);
+  control_sequence_.wz.fill(0.0f);
+  for (size_t c = 0; c != num_chunks; c++) {
+    const float scale = softmax_partials_[c].scale;
+    for (size_t t = 0; t != time_steps; t++) {
+      control_sequence_.vx(t) += scale * partial_controls_(0, c, t);
+      control_sequence_.wz(t) += scale * partial_controls_(2, c, t);
+      if constexpr (Holonomic) {
+        control_sequence_.vy(t) += scale * partial_controls_(1, c, t);
+      }
+    }
+  }
 
-  xt::noalias(control_sequence_.vx) = xt::sum(state_.cvx * softmaxes_extened, 0, immediate);
-  xt::noalias(control_sequence_.vy) = xt::sum(state_.cvy * softmaxes_extened, 0, immediate);
-  xt::noalias(control_sequence_.wz) = xt::sum(state_.cwz * softmaxes_extened, 0, immediate);
+  // Weighted variances around the updated, not yet constrained, control sequence
+  if (adaptive_sampling) {
+    auto & v = sampling_variances_;
+    v.vx.fill(0.0f);
+    v.vy.fill(0.0f);
+    v.wz.fill(0.0f);
+    for (size_t c = 0; c != num_chunks; c++) {
+      const float scale = softmax_partials_[c].scale;
+      for (size_t t = 0; t != time_steps; t++) {
+        v.vx(t) += scale * partial_controls_(3, c, t);
+        v.wz(t) += scale * partial_controls_(5, c, t);
+        if constexpr (Holonomic) {
+          v.vy(t) += scale * partial_controls_(4, c, t);
+        }
+      }
+    }
+    xt::noalias(v.vx) -= control_sequence_.vx * control_sequence_.vx;
+    xt::noalias(v.wz) -= control_sequence_.wz * control_sequence_.wz;
+    if constexpr (Holonomic) {
+      xt::noalias(v.vy) -= control_sequence_.vy * control_sequence_.vy;
+    }
+    noise_generator_.adaptSamplingStd(v);
+  }
 
   applyControlSequenceConstraints();
 }
@@ -392,10 +1684,10 @@ geometry_msgs::msg::TwistStamped Optimizer::getControlFromSequenceAsTwist(
 
   if (isHolonomic()) {
     auto vy = control_sequence_.vy(offset);
-    return utils::toTwistStamped(vx, vy, wz, stamp, costmap_ros_->getBaseFrameID());
+    return utils::toTwistStamped(vx, vy, wz, stamp, costmap_source_->getBaseFrameID());
   }
 
-  return utils::toTwistStamped(vx, wz, stamp, costmap_ros_->getBaseFrameID());
+  return utils::toTwistStamped(vx, wz, stamp, costmap_source_->getBaseFrameID());
 }
 
 void Optimizer::setMotionModel(const std::string & model)
@@ -406,16 +1698,104 @@ void Optimizer::setMotionModel(const std::string & model)
     motion_model_ = std::make_shared<OmniMotionModel>();
   } else if (model == "Ackermann") {
     motion_model_ = std::make_shared<AckermannMotionModel>(parameters_handler_);
+  } else if (model == "AccelLimitedDiffDrive") {
+    motion_model_ = std::make_shared<AccelLimitedDiffDriveMotionModel>(parameters_handler_);
+  } else if (model == "AccelLimitedOmni") {
+    motion_model_ = std::make_shared<AccelLimitedOmniMotionModel>(parameters_handler_);
   } else {
     throw std::runtime_error(
             std::string(
               "Model " + model + " is not valid! Valid options are DiffDrive, Omni, "
-              "or Ackermann"));
+              "Ackermann, AccelLimitedDiffDrive or AccelLimitedOmni"));
+  }
+  is_holonomic_ = motion_model_->isHolonomic();
+  motion_model_->setKernels(kernels_ ? *kernels_ : kernels::baselineKernels());
+  // Lateral velocities are only stored for holonomic models, so a change of holonomy is
+  // structural and resizes the buffers once the parameter change is applied
+}
+
+void Optimizer::setNoiseSampler(const std::string & sampler)
+{
+  if (sampler == "Default") {
+    settings_.noise_sampler = models::NoiseSampler::Default;
+  } else if (sampler == "Xoshiro") {
+    settings_.noise_sampler = models::NoiseSampler::Xoshiro;
+  } else {
+    throw std::runtime_error(
+            std::string(
+              "Noise sampler " + sampler + " is not valid! Valid options are Default "
+              "or Xoshiro"));
+  }
+}
+
+void Optimizer::setWatchdogSteps(const std::vector<std::string> & steps)
+{
+  settings_.watchdog_steps.clear();
+  for (const auto & step : steps) {
+    if (step == "skip_visualization") {
+      settings_.watchdog_steps.push_back(models::WatchdogStep::SkipVisualization);
+    } else if (step == "drop_iterations") {
+      settings_.watchdog_steps.push_back(models::WatchdogStep::DropIterations);
+    } else if (step == "disable_expensive_critics") {
+      settings_.watchdog_steps.push_back(models::WatchdogStep::DisableExpensiveCritics);
+    } else if (step == "reuse_previous_sequence") {
+      settings_.watchdog_steps.push_back(models::WatchdogStep::ReusePreviousSequence);
+    } else {
+      throw std::runtime_error(
+              std::string(
+                "Watchdog degradation " + step + " is not valid! Valid options are "
+                "skip_visualization, drop_iterations, disable_expensive_critics or "
+                "reuse_previous_sequence"));
+    }
+  }
+}
+
+void Optimizer::logPlacement(
+  const std::string & thread, const models::ThreadPlacementReport & report) const
+{
+  if (report.applied) {
+    RCLCPP_INFO(logger_, "%s placement: %s", thread.c_str(), report.description.c_str());
+  } else {
+    RCLCPP_WARN(
+      logger_, "%s placement could not be fully applied: %s", thread.c_str(),
+      report.description.c_str());
+  }
+}
+
+void Optimizer::setNoisePrecision(const std::string & precision)
+{
+  if (precision == "float32") {
+    settings_.noise_precision = models::StoragePrecision::Float32;
+  } else if (precision == "float16") {
+    settings_.noise_precision = models::StoragePrecision::Float16;
+  } else {
+    throw std::runtime_error(
+            std::string(
+              "Noise precision " + precision + " is not valid! Valid options are float32 "
+              "or float16"));
+  }
+}
+
+void Optimizer::setSimdKernels(const std::string & name)
+{
+  kernels_ = &kernels::selectKernels(name);
+  if (motion_model_) {
+    motion_model_->setKernels(*kernels_);
+  }
+
+  std::string available;
+  for (const auto & kernel_set : kernels::availableKernels()) {
+    available += (available.empty() ? "" : ", ") + kernel_set;
   }
+  RCLCPP_INFO(
+    logger_, "Using %s SIMD kernels (%s), available on this CPU: %s", kernels_->name,
+    kernels_->arch, available.c_str());
 }
 
 void Optimizer::setSpeedLimit(double speed_limit, bool percentage)
 {
+  finishPreroll();
+  preroll_ready_ = false;
   auto & s = settings_;
   if (speed_limit == nav2_costmap_2d::NO_SPEED_LIMIT) {
     s.constraints.vx_max = s.base_constraints.vx_max;
@@ -446,4 +1826,189 @@ models::Trajectories & Optimizer::getGeneratedTrajectories()
   return generated_trajectories_;
 }
 
+void Optimizer::setNominalSequence(models::NominalSequence nominal)
+{
+  finishPreroll();
+  preroll_ready_ = false;
+  settings_.nominal_sequence = nominal;
+}
+
+float Optimizer::getExpectedCost() const
+{
+  return weighted_cost_;
+}
+
+unsigned int Optimizer::getNoiseSeed() const
+{
+  return noise_generator_.getSeed();
+}
+
+const models::ControlSequence & Optimizer::getControlSequence() const
+{
+  return control_sequence_;
+}
+
+void Optimizer::setControlSequence(const models::ControlSequence & control_sequence)
+{
+  if (control_sequence.vx.shape(0) != settings_.time_steps) {
+    throw std::runtime_error("Control sequence does not match the optimizer's time steps");
+  }
+  finishPreroll();
+  preroll_ready_ = false;
+  control_sequence_ = control_sequence;
+}
+
+const xt::xtensor<float, 1> & Optimizer::getModelDts() const
+{
+  return model_dts_;
+}
+
+void Optimizer::seedNominalSequence()
+{
+  auto & s = settings_;
+  auto & u = control_sequence_;
+  switch (s.nominal_sequence) {
+    case models::NominalSequence::Previous:
+      return;
+    case models::NominalSequence::Stop:
+      u.reset(s.time_steps);
+      break;
+    case models::NominalSequence::Reverse:
+      u.reset(s.time_steps);
+      u.vx.fill(s.constraints.vx_min);
+      break;
+    case models::NominalSequence::PathFeedforward:
+      {
+        // Pure pursuit at the maximum speed, of the path point two steps ahead by arc length
+        u.reset(s.time_steps);
+        const size_t path_size = path_.x.shape(0);
+        if (path_size == 0) {
+          break;
+        }
+        const float wz_max = s.constraints.wz;
+        float x = state_.pose.pose.position.x;
+        float y = state_.pose.pose.position.y;
+        float yaw = tf2::getYaw(state_.pose.pose.orientation);
+        size_t target = 0;
+        float arc = 0.0f;
+        float travelled = 0.0f;
+        for (size_t t = 0; t != s.time_steps; t++) {
+          const float dt = model_dts_(t);
+          const float step = s.constraints.vx_max * dt;
+          const float lookahead = travelled + 2.0f * s.constraints.vx_max * s.model_dt;
+          while (target + 1 < path_size && arc < lookahead) {
+            arc += std::hypot(
+              path_.x(target + 1) - path_.x(target), path_.y(target + 1) - path_.y(target));
+            target++;
+          }
+          const float heading = std::atan2(path_.y(target) - y, path_.x(target) - x);
+          const float turn = angles::shortest_angular_distance(yaw, heading) / dt;
+          u.vx(t) = s.constraints.vx_max;
+          u.wz(t) = std::clamp(turn, -wz_max, wz_max);
+          yaw += u.wz(t) * dt;
+          x += step * std::cos(yaw);
+          y += step * std::sin(yaw);
+          travelled += step;
+        }
+        break;
+      }
+  }
+  applyControlSequenceConstraints();
+}
+
+void Optimizer::getTopTrajectories(
+  size_t count, models::Trajectories & trajectories, xt::xtensor<float, 1> & costs)
+{
+  const auto & generated = generated_trajectories_;
+  const size_t batch_size = std::min(costs_.shape(0), generated.x.shape(0));
+  const size_t time_steps = generated.x.shape(1);
+  count = std::min(count, batch_size);
+
+  top_ids_.resize(batch_size);
+  std::iota(top_ids_.begin(), top_ids_.end(), 0);
+  auto lower_cost = [this](size_t a, size_t b) {return costs_(a) < costs_(b);};
+  if (count < batch_size) {
+    std::nth_element(top_ids_.begin(), top_ids_.begin() + count, top_ids_.end(), lower_cost);
+  }
+  std::sort(top_ids_.begin(), top_ids_.begin() + count, lower_cost);
+
+  if (trajectories.x.shape(0) != count || trajectories.x.shape(1) != time_steps) {
+    trajectories.reset(count, time_steps);
+  }
+  if (costs.shape(0) != count) {
+    costs = xt::xtensor<float, 1>::from_shape({count});
+  }
+
+  auto copy = [&](const models::BatchTensor<2> & src, models::BatchTensor<2> & dst) {
+      for (size_t k = 0; k != count; k++) {
+        const float * row = src.data() + top_ids_[k] * time_steps;
+        std::copy(row, row + time_steps, dst.data() + k * time_steps);
+      }
+    };
+
+  copy(generated.x, trajectories.x);
+  copy(generated.y, trajectories.y);
+  copy(generated.yaws, trajectories.yaws);
+  for (size_t k = 0; k != count; k++) {
+    costs(k) = costs_(top_ids_[k]);
+  }
+}
+
+const models::Path & Optimizer::getPath() const
+{
+  return path_;
+}
+
+const LatencyProfiler & Optimizer::getLatencyProfiler() const
+{
+  return latency_profiler_;
+}
+
+void Optimizer::setTraceRecorder(TraceRecorder * recorder)
+{
+  // Not while the pre-roll thread may be recording
+  finishPreroll();
+  trace_recorder_ = recorder;
+  latency_profiler_.setTraceRecorder(recorder);
+  noise_generator_.setTraceRecorder(recorder);
+}
+
+std::vector<MemoryUsage> Optimizer::getMemoryUsage() const
+{
+  auto bytes = [](std::initializer_list<const xt::xtensor<float, 2> *> tensors) {
+      size_t sum = 0;
+      for (const auto * tensor : tensors) {
+        sum += tensor->size() * sizeof(float);
+      }
+      return sum;
+    };
+  // Batch tensors hold the storage reserved for the largest adaptive batch size
+  auto batchBytes = [](std::initializer_list<const models::BatchTensor<2> *> tensors) {
+      size_t sum = 0;
+      for (const auto * tensor : tensors) {
+        sum += models::reservedBytes(*tensor);
+      }
+      return sum;
+    };
+
+  const auto & s = state_;
+  const auto & t = generated_trajectories_;
+  const auto & w = warm_start_;
+  return {
+    {"state", batchBytes({&s.vx, &s.vy, &s.wz, &s.cvx, &s.cvy, &s.cwz})},
+    {"trajectories", batchBytes({&t.x, &t.y, &t.yaws, &t.yaw_cos, &t.yaw_sin})},
+    {"noises", noise_generator_.getMemoryUsage()},
+    {"noise_bank", noise_generator_.getNoiseBankMemoryUsage()},
+    {"workspace", workspace_.getMemoryUsage()},
+    {"warm_start", bytes({&w.vx, &w.vy, &w.wz})},
+    {"costs", models::reservedBytes(costs_) + partial_controls_.size() * sizeof(float)},
+    {"costmap_snapshot", costmap_snapshot_.getMemoryUsage()},
+    {"screening", batchBytes({&screening_samples_.cvx, &screening_samples_.cvy,
+        &screening_samples_.cwz, &screening_state_.vx, &screening_state_.vy,
+        &screening_state_.wz, &screening_state_.cvx, &screening_state_.cvy,
+        &screening_state_.cwz, &screening_trajectories_.x, &screening_trajectories_.y,
+        &screening_trajectories_.yaws, &screening_trajectories_.yaw_cos,
+        &screening_trajectories_.yaw_sin})}};
+}
+
 }  // namespace mppi
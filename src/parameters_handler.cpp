@@ -14,6 +14,10 @@
 
 #include "mppic/tools/parameters_handler.hpp"
 
+#include <chrono>
+#include <iterator>
+#include <utility>
+
 namespace mppi
 {
 
@@ -26,25 +30,84 @@ ParametersHandler::ParametersHandler(
   logger_ = node->get_logger();
 }
 
-void ParametersHandler::start()
+ParametersHandler::ParametersHandler(
+  const std::vector<rclcpp::Parameter> & parameters, const std::string & node_name)
+{
+  headless_ = true;
+  node_name_ = node_name;
+  for (const auto & parameter : parameters) {
+    headless_parameters_.insert_or_assign(parameter.get_name(), parameter);
+  }
+}
+
+void ParametersHandler::start(bool defer_changes)
 {
+  auto get_param = getParamGetter(node_name_);
+  if (headless_) {
+    get_param(verbose_, "verbose", false);
+    return;
+  }
+
   auto node = node_.lock();
   on_set_param_handler_ = node->add_on_set_parameters_callback(
     std::bind(
+      defer_changes ? &ParametersHandler::deferParamsCallback :
       &ParametersHandler::dynamicParamsCallback, this,
       std::placeholders::_1));
 
-  auto get_param = getParamGetter(node_name_);
+  if (defer_changes) {
+    // Only runs while changes are queued or staged behind a control cycle
+    retry_timer_ = node->create_wall_timer(
+      std::chrono::milliseconds(10), [this]() {processPendingChanges();});
+    retry_timer_->cancel();
+  }
+
   get_param(verbose_, "verbose", false);
 }
 
+rcl_interfaces::msg::SetParametersResult
+ParametersHandler::verifyParameters(const std::vector<rclcpp::Parameter> & parameters) const
+{
+  rcl_interfaces::msg::SetParametersResult result;
+  result.successful = true;
+  for (const auto & param : parameters) {
+    auto verifiers = verify_param_callbacks_.find(param.get_name());
+    if (verifiers == verify_param_callbacks_.end()) {
+      continue;
+    }
+
+    for (const auto & verifier : verifiers->second) {
+      const std::string reason = verifier(param);
+      if (!reason.empty()) {
+        result.successful = false;
+        result.reason += (result.reason.empty() ? "" : "; ") + reason;
+        break;
+      }
+    }
+  }
+
+  if (!result.successful) {
+    RCLCPP_WARN(logger_, "Rejected parameter changes: %s", result.reason.c_str());
+  }
+  return result;
+}
+
 rcl_interfaces::msg::SetParametersResult
 ParametersHandler::dynamicParamsCallback(
   std::vector<rclcpp::Parameter> parameters)
 {
-  rcl_interfaces::msg::SetParametersResult result;
+  auto result = verifyParameters(parameters);
+  if (!result.successful) {
+    return result;
+  }
+
   std::lock_guard<std::mutex> lock(parameters_change_mutex_);
+  applyChanges(parameters);
+  return result;
+}
 
+void ParametersHandler::applyChanges(const std::vector<rclcpp::Parameter> & parameters)
+{
   for (auto & pre_cb : pre_callbacks_) {
     pre_cb();
   }
@@ -52,10 +115,12 @@ ParametersHandler::dynamicParamsCallback(
   for (auto & param : parameters) {
     const std::string & param_name = param.get_name();
 
-    if (auto callback = get_param_callbacks_.find(param_name);
-      callback != get_param_callbacks_.end())
+    if (auto callbacks = get_param_callbacks_.find(param_name);
+      callbacks != get_param_callbacks_.end())
     {
-      callback->second(param);
+      for (auto & callback : callbacks->second) {
+        callback(param);
+      }
     } else {
       RCLCPP_WARN(logger_, "Parameter %s not found", param_name.c_str());
     }
@@ -64,9 +129,148 @@ ParametersHandler::dynamicParamsCallback(
   for (auto & post_cb : post_callbacks_) {
     post_cb();
   }
+}
 
-  result.successful = true;
+rcl_interfaces::msg::SetParametersResult
+ParametersHandler::deferParamsCallback(
+  std::vector<rclcpp::Parameter> parameters)
+{
+  auto result = verifyParameters(parameters);
+  if (!result.successful) {
+    return result;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending_parameters_.insert(
+      pending_parameters_.end(), std::make_move_iterator(parameters.begin()),
+      std::make_move_iterator(parameters.end()));
+  }
+  has_pending_.store(true, std::memory_order_release);
+
+  // Applied right away unless a control cycle runs, which then picks them up
+  processPendingChanges();
   return result;
 }
 
+std::vector<rclcpp::Parameter> ParametersHandler::takeStagedChanges()
+{
+  std::vector<rclcpp::Parameter> parameters;
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  parameters.swap(staged_parameters_);
+  has_pending_.store(
+    !pending_parameters_.empty() || !building_parameters_.empty(), std::memory_order_relaxed);
+  return parameters;
+}
+
+void ParametersHandler::snapshotPendingChanges()
+{
+  std::vector<rclcpp::Parameter> parameters;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    if (!building_parameters_.empty() || !staged_parameters_.empty()) {
+      return;
+    }
+    parameters.swap(pending_parameters_);
+  }
+  if (parameters.empty()) {
+    return;
+  }
+
+  std::vector<std::function<void()>> builds;
+  for (auto & stage_cb : stage_callbacks_) {
+    if (auto build = stage_cb(parameters)) {
+      builds.push_back(std::move(build));
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  if (builds.empty()) {
+    staged_parameters_ = std::move(parameters);
+  } else {
+    building_parameters_ = std::move(parameters);
+    stage_builds_ = std::move(builds);
+  }
+}
+
+void ParametersHandler::buildPendingChanges()
+{
+  std::vector<std::function<void()>> builds;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    builds.swap(stage_builds_);
+  }
+  if (builds.empty()) {
+    return;
+  }
+
+  for (auto & build : builds) {
+    build();
+  }
+
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  staged_parameters_ = std::move(building_parameters_);
+  building_parameters_.clear();
+}
+
+bool ParametersHandler::applyPendingChanges()
+{
+  if (!has_pending_.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  // The node already holds the new values, only the settings are to be updated
+  std::lock_guard<std::mutex> lock(parameters_change_mutex_);
+  snapshotPendingChanges();
+  if (!retry_timer_) {
+    // Without an executor to build them, a headless handler does so right away
+    buildPendingChanges();
+  }
+  const auto parameters = takeStagedChanges();
+  if (has_pending_.load(std::memory_order_relaxed) && retry_timer_) {
+    retry_timer_->reset();
+  }
+  if (parameters.empty()) {
+    return false;
+  }
+  applyChanges(parameters);
+  return true;
+}
+
+void ParametersHandler::processPendingChanges()
+{
+  // Canceled first, so changes queued meanwhile reset it again
+  if (retry_timer_) {
+    retry_timer_->cancel();
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(parameters_change_mutex_, std::try_to_lock);
+    if (lock.owns_lock()) {
+      const auto parameters = takeStagedChanges();
+      if (!parameters.empty()) {
+        applyChanges(parameters);
+      }
+      snapshotPendingChanges();
+    }
+  }
+
+  // Built off the lock, a cycle starting meanwhile runs with the previous settings
+  buildPendingChanges();
+
+  {
+    std::unique_lock<std::mutex> lock(parameters_change_mutex_, std::try_to_lock);
+    if (lock.owns_lock()) {
+      const auto parameters = takeStagedChanges();
+      if (!parameters.empty()) {
+        applyChanges(parameters);
+      }
+    }
+  }
+
+  if (has_pending_.load(std::memory_order_acquire) && retry_timer_) {
+    retry_timer_->reset();
+  }
+}
+
 }  // namespace mppi
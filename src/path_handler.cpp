@@ -13,12 +13,32 @@
 // limitations under the License.
 
 #include "mppic/tools/path_handler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
 #include "mppic/tools/utils.hpp"
 #include "nav2_costmap_2d/costmap_2d_ros.hpp"
 
 namespace mppi
 {
 
+namespace
+{
+
+inline void applyTransform(
+  const tf2::Transform & transform, const geometry_msgs::msg::Pose & in_pose,
+  geometry_msgs::msg::Pose & out_pose)
+{
+  tf2::Transform pose;
+  tf2::fromMsg(in_pose, pose);
+  tf2::toMsg(transform * pose, out_pose);
+}
+
+}  // namespace
+
 void PathHandler::initialize(
   rclcpp_lifecycle::LifecycleNode::WeakPtr parent, const std::string & name,
   std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap,
@@ -35,18 +55,19 @@ void PathHandler::initialize(
   getParam(max_robot_pose_search_dist_, "max_robot_pose_search_dist", getMaxCostmapDist());
   getParam(prune_distance_, "prune_distance", 1.5);
   getParam(transform_tolerance_, "transform_tolerance", 0.1);
+  getParam(incremental_, "incremental_path_handling", false);
 }
 
 PathRange PathHandler::getGlobalPlanConsideringBounds(
   const geometry_msgs::msg::PoseStamped & global_pose)
 {
   using nav2_util::geometry_utils::euclidean_distance;
-  auto begin = global_plan_.poses.begin();
+  auto begin = global_plan_.poses.begin() + plan_start_;
   auto end = global_plan_.poses.end();
 
   auto closest_pose_upper_bound =
     nav2_util::geometry_utils::first_after_integrated_distance(
-    global_plan_.poses.begin(), global_plan_.poses.end(), max_robot_pose_search_dist_);
+    begin, end, max_robot_pose_search_dist_);
 
   // Find closest point to the robot
   auto closest_point = nav2_util::geometry_utils::min_by(
@@ -73,7 +94,7 @@ PathRange PathHandler::getGlobalPlanConsideringBounds(
 geometry_msgs::msg::PoseStamped PathHandler::transformToGlobalPlanFrame(
   const geometry_msgs::msg::PoseStamped & pose)
 {
-  if (global_plan_.poses.empty()) {
+  if (plan_start_ == global_plan_.poses.size()) {
     throw std::runtime_error("Received plan with zero length");
   }
 
@@ -96,7 +117,8 @@ nav_msgs::msg::Path PathHandler::transformPath(
 
   // Transform these bounds into the local costmap frame and prune older points
   const auto & stamp = global_pose.header.stamp;
-  nav_msgs::msg::Path transformed_plan =
+  nav_msgs::msg::Path transformed_plan = incremental_ ?
+    transformPlanPosesIncrementally(lower_bound, upper_bound, stamp) :
     transformPlanPosesToCostmapFrame(lower_bound, upper_bound, stamp);
 
   pruneGlobalPlan(lower_bound);
@@ -108,6 +130,68 @@ nav_msgs::msg::Path PathHandler::transformPath(
   return transformed_plan;
 }
 
+void PathHandler::transformPath(
+  const geometry_msgs::msg::PoseStamped & robot_pose, models::Path & path)
+{
+  ScopedTrace trace(trace_recorder_, trace_name_);
+  geometry_msgs::msg::PoseStamped global_pose =
+    transformToGlobalPlanFrame(robot_pose);
+  auto [lower_bound, upper_bound] = getGlobalPlanConsideringBounds(global_pose);
+
+  // Planar rigid transform of the plan to the costmap frame, looked up once
+  geometry_msgs::msg::TransformStamped transform;
+  if (!lookupPlanTransform(global_pose.header.stamp, transform)) {
+    throw std::runtime_error("Unable to transform plan into costmap's frame");
+  }
+  const double tx = transform.transform.translation.x;
+  const double ty = transform.transform.translation.y;
+  const double yaw = tf2::getYaw(transform.transform.rotation);
+  const double cos_yaw = std::cos(yaw);
+  const double sin_yaw = std::sin(yaw);
+
+  auto toPlanarPose = [&](const geometry_msgs::msg::Pose & pose) {
+      return PlanarPose{
+        static_cast<float>(cos_yaw * pose.position.x - sin_yaw * pose.position.y + tx),
+        static_cast<float>(sin_yaw * pose.position.x + cos_yaw * pose.position.y + ty),
+        static_cast<float>(angles::normalize_angle(tf2::getYaw(pose.orientation) + yaw))};
+    };
+
+  const size_t size = upper_bound - lower_bound;
+  if (path.x.shape(0) != size) {
+    path.reset(size);
+  }
+  if (incremental_) {
+    // Poses left behind or beyond the window are dropped, those newly entered transformed
+    const size_t first = lower_bound - global_plan_.poses.begin();
+    const size_t kept = cached_planar_poses_.advance(transform, first, first + size);
+    transform_cache_stats_.reused_poses += kept;
+    transform_cache_stats_.transformed_poses += size - kept;
+    for (size_t i = kept; i < size; i++) {
+      cached_planar_poses_.poses.push_back(toPlanarPose(lower_bound[i].pose));
+    }
+    const PlanarPose * poses = cached_planar_poses_.data();
+    for (size_t i = 0; i != size; i++) {
+      path.x(i) = poses[i].x;
+      path.y(i) = poses[i].y;
+      path.yaws(i) = poses[i].yaw;
+    }
+  } else {
+    transform_cache_stats_.transformed_poses += size;
+    for (size_t i = 0; i != size; i++) {
+      const PlanarPose pose = toPlanarPose(lower_bound[i].pose);
+      path.x(i) = pose.x;
+      path.y(i) = pose.y;
+      path.yaws(i) = pose.yaw;
+    }
+  }
+
+  pruneGlobalPlan(lower_bound);
+
+  if (size == 0) {
+    throw std::runtime_error("Resulting plan has 0 poses in it.");
+  }
+}
+
 bool PathHandler::transformPose(
   const std::string & frame, const geometry_msgs::msg::PoseStamped & in_pose,
   geometry_msgs::msg::PoseStamped & out_pose) const
@@ -156,21 +240,179 @@ nav_msgs::msg::Path PathHandler::transformPlanPosesToCostmapFrame(
   plan.header.frame_id = frame;
   plan.header.stamp = stamp;
 
-  std::transform(begin, end, std::back_inserter(plan.poses), transformToFrame);
+  // Without the transform, fall back to transforming pose by pose as TF allows
+  transform_cache_stats_.transformed_poses += end - begin;
+  geometry_msgs::msg::TransformStamped transform_msg;
+  if (!lookupPlanTransform(stamp, transform_msg)) {
+    std::transform(begin, end, std::back_inserter(plan.poses), transformToFrame);
+    return plan;
+  }
+
+  tf2::Transform transform;
+  tf2::fromMsg(transform_msg.transform, transform);
+  plan.poses.resize(end - begin);
+  for (size_t i = 0; i != plan.poses.size(); i++) {
+    plan.poses[i].header = plan.header;
+    applyTransform(transform, begin[i].pose, plan.poses[i].pose);
+  }
+
+  return plan;
+}
+
+bool PathHandler::lookupPlanTransform(
+  const builtin_interfaces::msg::Time & stamp, geometry_msgs::msg::TransformStamped & transform)
+{
+  const std::string & frame = costmap_->getGlobalFrameID();
+  const std::string & plan_frame = global_plan_.header.frame_id;
+  if (plan_frame == frame) {
+    transform = geometry_msgs::msg::TransformStamped();
+    transform.header.frame_id = frame;
+    transform.child_frame_id = frame;
+    transform.transform.rotation.w = 1.0;
+    return true;
+  }
+
+  // A zero stamp asks for the latest transform, which may have changed since
+  const bool latest = stamp.sec == 0 && stamp.nanosec == 0;
+  if (plan_transform_ && !latest && plan_transform_stamp_ == stamp &&
+    plan_transform_->header.frame_id == frame && plan_transform_->child_frame_id == plan_frame)
+  {
+    transform_cache_stats_.hits++;
+    transform = *plan_transform_;
+    return true;
+  }
+
+  transform_cache_stats_.misses++;
+  try {
+    transform = tf_buffer_->lookupTransform(
+      frame, plan_frame, tf2_ros::fromMsg(stamp), tf2::durationFromSec(transform_tolerance_));
+  } catch (tf2::TransformException & ex) {
+    transform_cache_stats_.failures++;
+    RCLCPP_ERROR(logger_, "Exception in lookupPlanTransform: %s", ex.what());
+    return false;
+  }
+
+  plan_transform_ = transform;
+  plan_transform_stamp_ = stamp;
+  return true;
+}
+
+const TransformCacheStats & PathHandler::getTransformCacheStats() const
+{
+  return transform_cache_stats_;
+}
+
+void PathHandler::setTraceRecorder(TraceRecorder * recorder)
+{
+  trace_recorder_ = recorder;
+  if (trace_recorder_) {
+    trace_name_ = trace_recorder_->addName("transformPath");
+  }
+}
+
+nav_msgs::msg::Path PathHandler::transformPlanPosesIncrementally(
+  PathIterator begin, PathIterator end, const builtin_interfaces::msg::Time & stamp)
+{
+  std::string frame = costmap_->getGlobalFrameID();
+  geometry_msgs::msg::TransformStamped transform;
+  if (!lookupPlanTransform(stamp, transform)) {
+    resetTransformCache();
+    return transformPlanPosesToCostmapFrame(begin, end, stamp);
+  }
+
+  // Poses left behind or beyond the window are dropped, those newly entered transformed
+  const size_t first = begin - global_plan_.poses.begin();
+  const size_t last = end - global_plan_.poses.begin();
+  const size_t kept = cached_poses_.advance(transform, first, last);
+  transform_cache_stats_.reused_poses += kept;
+  transform_cache_stats_.transformed_poses += last - first - kept;
+  tf2::Transform plan_to_costmap;
+  tf2::fromMsg(transform.transform, plan_to_costmap);
+  for (size_t i = first + kept; i < last; i++) {
+    geometry_msgs::msg::PoseStamped to_pose;
+    applyTransform(plan_to_costmap, global_plan_.poses[i].pose, to_pose.pose);
+    to_pose.header.frame_id = frame;
+    cached_poses_.poses.push_back(to_pose);
+  }
+
+  nav_msgs::msg::Path plan;
+  plan.header.frame_id = frame;
+  plan.header.stamp = stamp;
+  plan.poses.assign(cached_poses_.data(), cached_poses_.data() + cached_poses_.size());
+  for (auto & pose : plan.poses) {
+    pose.header.stamp = stamp;
+  }
 
   return plan;
 }
 
+bool PathHandler::isSameTransform(
+  const geometry_msgs::msg::TransformStamped & a,
+  const geometry_msgs::msg::TransformStamped & b)
+{
+  const auto & t = a.transform;
+  const auto & o = b.transform;
+  return a.header.frame_id == b.header.frame_id && a.child_frame_id == b.child_frame_id &&
+         t.translation.x == o.translation.x && t.translation.y == o.translation.y &&
+         t.translation.z == o.translation.z && t.rotation.x == o.rotation.x &&
+         t.rotation.y == o.rotation.y && t.rotation.z == o.rotation.z &&
+         t.rotation.w == o.rotation.w;
+}
+
+void PathHandler::resetTransformCache()
+{
+  cached_poses_.clear();
+  cached_planar_poses_.clear();
+}
+
 void PathHandler::setPath(const nav_msgs::msg::Path & plan)
 {
   global_plan_ = plan;
+  plan_start_ = 0;
+  resetTransformCache();
 }
 
-nav_msgs::msg::Path & PathHandler::getPath() {return global_plan_;}
+void PathHandler::setPath(nav_msgs::msg::Path && plan)
+{
+  global_plan_ = std::move(plan);
+  plan_start_ = 0;
+  resetTransformCache();
+}
+
+nav_msgs::msg::Path & PathHandler::getPath()
+{
+  compactGlobalPlan();
+  return global_plan_;
+}
 
 void PathHandler::pruneGlobalPlan(const PathIterator end)
 {
-  global_plan_.poses.erase(global_plan_.poses.begin(), end);
+  // Pruning only advances the start of the plan, its storage is compacted once it is
+  // mostly pruned poses, so each pose is moved a bounded number of times
+  plan_start_ = end - global_plan_.poses.begin();
+  if (cached_poses_.begin < plan_start_) {
+    cached_poses_.clear();
+  }
+  if (cached_planar_poses_.begin < plan_start_) {
+    cached_planar_poses_.clear();
+  }
+  if (2 * plan_start_ > global_plan_.poses.size()) {
+    compactGlobalPlan();
+  }
+}
+
+void PathHandler::compactGlobalPlan()
+{
+  if (plan_start_ == 0) {
+    return;
+  }
+
+  global_plan_.poses.erase(global_plan_.poses.begin(), global_plan_.poses.begin() + plan_start_);
+
+  // Keep the cached poses aligned with the remaining plan
+  cached_poses_.dropPlanPoses(plan_start_);
+  cached_planar_poses_.dropPlanPoses(plan_start_);
+  plan_start_ = 0;
 }
 
 }  // namespace mppi
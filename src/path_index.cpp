@@ -0,0 +1,172 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/path_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mppi
+{
+
+namespace
+{
+
+// Cells span a few path steps, so a query near the path visits a handful of points
+constexpr float points_per_cell = 4.0f;
+constexpr float min_cell_size = 1e-3f;
+// Bounds the grid of sparse, spread out paths
+constexpr size_t max_cells_per_point = 4;
+// Keeps cell coordinates of far away queries within int range
+constexpr float max_cell_coordinate = 1e6f;
+
+}  // namespace
+
+void PathIndex::build(const models::Path & path)
+{
+  size_ = path.x.shape(0);
+  if (size_ == 0) {
+    cells_x_ = cells_y_ = 0;
+    return;
+  }
+
+  float max_x = path.x(0), max_y = path.y(0);
+  min_x_ = path.x(0);
+  min_y_ = path.y(0);
+  float length = 0.0f;
+  for (size_t i = 1; i != size_; i++) {
+    min_x_ = std::min(min_x_, path.x(i));
+    min_y_ = std::min(min_y_, path.y(i));
+    max_x = std::max(max_x, path.x(i));
+    max_y = std::max(max_y, path.y(i));
+    length += std::hypot(path.x(i) - path.x(i - 1), path.y(i) - path.y(i - 1));
+  }
+
+  const float spacing = size_ > 1 ? length / static_cast<float>(size_ - 1) : 0.0f;
+  cell_size_ = std::max(points_per_cell * spacing, min_cell_size);
+
+  const float extent_x = max_x - min_x_;
+  const float extent_y = max_y - min_y_;
+  const float max_cells = static_cast<float>(max_cells_per_point * size_);
+  const float cells = (extent_x / cell_size_ + 1.0f) * (extent_y / cell_size_ + 1.0f);
+  if (cells > max_cells) {
+    cell_size_ *= std::sqrt(cells / max_cells);
+  }
+
+  inv_cell_size_ = 1.0f / cell_size_;
+  cells_x_ = static_cast<int>(extent_x * inv_cell_size_) + 1;
+  cells_y_ = static_cast<int>(extent_y * inv_cell_size_) + 1;
+
+  // Counting sort of the points by cell, stable so indices ascend within a cell
+  cell_starts_.assign(static_cast<size_t>(cells_x_) * cells_y_ + 1, 0);
+  ids_.resize(size_);
+  xs_.resize(size_);
+  ys_.resize(size_);
+
+  auto cellOf = [&](size_t i) {
+      const int cx = static_cast<int>((path.x(i) - min_x_) * inv_cell_size_);
+      const int cy = static_cast<int>((path.y(i) - min_y_) * inv_cell_size_);
+      return static_cast<size_t>(std::min(cy, cells_y_ - 1)) * cells_x_ +
+             std::min(cx, cells_x_ - 1);
+    };
+
+  for (size_t i = 0; i != size_; i++) {
+    cell_starts_[cellOf(i) + 1]++;
+  }
+  for (size_t c = 1; c != cell_starts_.size(); c++) {
+    cell_starts_[c] += cell_starts_[c - 1];
+  }
+  for (size_t i = 0; i != size_; i++) {
+    const size_t slot = cell_starts_[cellOf(i)]++;
+    ids_[slot] = i;
+    xs_[slot] = path.x(i);
+    ys_[slot] = path.y(i);
+  }
+
+  // Filling advanced every start to the next cell's, shift them back
+  for (size_t c = cell_starts_.size() - 1; c != 0; c--) {
+    cell_starts_[c] = cell_starts_[c - 1];
+  }
+  cell_starts_[0] = 0;
+}
+
+void PathIndex::scanCell(int cx, int cy, float x, float y, size_t end, Nearest & best) const
+{
+  const size_t cell = static_cast<size_t>(cy) * cells_x_ + cx;
+  for (size_t k = cell_starts_[cell]; k != cell_starts_[cell + 1]; k++) {
+    if (ids_[k] >= end) {
+      continue;
+    }
+    const float dx = xs_[k] - x;
+    const float dy = ys_[k] - y;
+    const float dist_sq = dx * dx + dy * dy;
+    if (dist_sq < best.dist_sq || (dist_sq == best.dist_sq && ids_[k] < best.idx)) {
+      best.dist_sq = dist_sq;
+      best.idx = ids_[k];
+    }
+  }
+}
+
+PathIndex::Nearest PathIndex::nearest(float x, float y, size_t end) const
+{
+  Nearest best;
+  end = std::min(end, size_);
+  if (end == 0) {
+    return best;
+  }
+
+  auto toCell = [&](float value, float min) {
+      const float cell = std::floor((value - min) * inv_cell_size_);
+      return static_cast<int>(std::clamp(cell, -max_cell_coordinate, max_cell_coordinate));
+    };
+  const int cx = toCell(x, min_x_);
+  const int cy = toCell(y, min_y_);
+
+  // Rings of cells around the query, starting at the first one overlapping the grid
+  const int first_ring = std::max({0, -cx, cx - (cells_x_ - 1), -cy, cy - (cells_y_ - 1)});
+  const int last_ring = std::max({cx, cells_x_ - 1 - cx, cy, cells_y_ - 1 - cy});
+  bool found = false;
+
+  for (int r = first_ring; r <= last_ring; r++) {
+    const int y_low = std::max(cy - r, 0);
+    const int y_high = std::min(cy + r, cells_y_ - 1);
+    for (int iy = y_low; iy <= y_high; iy++) {
+      if (iy == cy - r || iy == cy + r) {
+        const int x_low = std::max(cx - r, 0);
+        const int x_high = std::min(cx + r, cells_x_ - 1);
+        for (int ix = x_low; ix <= x_high; ix++) {
+          scanCell(ix, iy, x, y, end, best);
+        }
+        continue;
+      }
+      if (cx - r >= 0 && cx - r < cells_x_) {
+        scanCell(cx - r, iy, x, y, end, best);
+      }
+      if (cx + r >= 0 && cx + r < cells_x_) {
+        scanCell(cx + r, iy, x, y, end, best);
+      }
+    }
+
+    // Points beyond this ring are at least r cells away from the query's cell
+    found = found || best.dist_sq != std::numeric_limits<float>::max();
+    const float ring_distance = static_cast<float>(r) * cell_size_;
+    if (found && best.dist_sq < ring_distance * ring_distance) {
+      break;
+    }
+  }
+
+  return best;
+}
+
+}  // namespace mppi
@@ -0,0 +1,183 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/thread_placement.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace mppi
+{
+
+namespace
+{
+
+id_t threadId()
+{
+  return static_cast<id_t>(::syscall(SYS_gettid));
+}
+
+// Ranges of consecutive values, as in "0-3,6"
+std::string formatList(std::vector<int> values)
+{
+  std::sort(values.begin(), values.end());
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+  std::string text;
+  for (size_t i = 0; i < values.size(); ) {
+    size_t j = i;
+    while (j + 1 < values.size() && values[j + 1] == values[j] + 1) {
+      j++;
+    }
+    text += (text.empty() ? "" : ",") + std::to_string(values[i]);
+    if (j != i) {
+      text += "-" + std::to_string(values[j]);
+    }
+    i = j + 1;
+  }
+  return text;
+}
+
+// NUMA node of a CPU, from the node link in its sysfs directory
+int numaNode(int cpu)
+{
+  std::error_code error;
+  const std::filesystem::path path("/sys/devices/system/cpu/cpu" + std::to_string(cpu));
+  for (const auto & entry : std::filesystem::directory_iterator(path, error)) {
+    const std::string name = entry.path().filename().string();
+    if (name.rfind("node", 0) == 0 && name.size() > 4 &&
+      std::all_of(name.begin() + 4, name.end(), ::isdigit))
+    {
+      return std::stoi(name.substr(4));
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+
+models::ThreadPlacement makeThreadPlacement(
+  const std::vector<int64_t> & cpus, const std::string & scheduling, int priority)
+{
+  models::ThreadPlacement placement;
+  for (const auto cpu : cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      throw std::runtime_error("CPU " + std::to_string(cpu) + " is not valid!");
+    }
+    placement.cpus.push_back(static_cast<int>(cpu));
+  }
+
+  if (scheduling == "other") {
+    placement.scheduling = models::ThreadScheduling::Other;
+    if (priority < -20 || priority > 19) {
+      throw std::runtime_error("Nice value needs to be between -20 and 19");
+    }
+  } else if (scheduling == "fifo") {
+    placement.scheduling = models::ThreadScheduling::Fifo;
+    if (priority < 1 || priority > 99) {
+      throw std::runtime_error("Real-time priority needs to be between 1 and 99");
+    }
+  } else {
+    throw std::runtime_error(
+            "Thread scheduling " + scheduling + " is not valid! Valid options are other "
+            "or fifo");
+  }
+  placement.priority = priority;
+  return placement;
+}
+
+bool applyThreadPlacement(const models::ThreadPlacement & placement, std::string & report)
+{
+  std::string errors;
+  auto addError = [&errors](const std::string & what, int error) {
+      errors += (errors.empty() ? "" : ", ") + what + ": " + std::strerror(error);
+    };
+
+  if (!placement.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : placement.cpus) {
+      CPU_SET(cpu, &set);
+    }
+    const int error = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    if (error != 0) {
+      addError("cannot pin to CPUs " + formatList(placement.cpus), error);
+    }
+  }
+
+  if (placement.scheduling == models::ThreadScheduling::Fifo) {
+    sched_param param{};
+    param.sched_priority = placement.priority;
+    const int error = ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param);
+    if (error != 0) {
+      addError("cannot set SCHED_FIFO priority " + std::to_string(placement.priority), error);
+    }
+  } else if (placement.priority != 0) {
+    // Nice values are per thread on Linux, set through the thread id
+    if (::setpriority(PRIO_PROCESS, threadId(), placement.priority) != 0) {
+      addError("cannot set nice value " + std::to_string(placement.priority), errno);
+    }
+  }
+
+  report = describeThreadPlacement();
+  if (!errors.empty()) {
+    report += " (" + errors + ")";
+  }
+  return errors.empty();
+}
+
+std::string describeThreadPlacement()
+{
+  std::vector<int> cpus, nodes;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (::pthread_getaffinity_np(::pthread_self(), sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu != CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+        const int node = numaNode(cpu);
+        if (node >= 0) {
+          nodes.push_back(node);
+        }
+      }
+    }
+  }
+
+  std::string text = "CPUs " + (cpus.empty() ? std::string("unknown") : formatList(cpus)) +
+    ", NUMA nodes " + (nodes.empty() ? std::string("unknown") : formatList(nodes));
+
+  int policy = SCHED_OTHER;
+  sched_param param{};
+  ::pthread_getschedparam(::pthread_self(), &policy, &param);
+  if (policy == SCHED_FIFO || policy == SCHED_RR) {
+    text += std::string(policy == SCHED_FIFO ? ", SCHED_FIFO" : ", SCHED_RR") +
+      " priority " + std::to_string(param.sched_priority);
+  } else {
+    errno = 0;
+    const int nice = ::getpriority(PRIO_PROCESS, threadId());
+    text += ", SCHED_OTHER nice " + (errno == 0 ? std::to_string(nice) : std::string("unknown"));
+  }
+  return text;
+}
+
+}  // namespace mppi
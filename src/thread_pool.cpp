@@ -0,0 +1,135 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/thread_pool.hpp"
+
+#include <utility>
+
+#include "mppic/tools/thread_placement.hpp"
+
+namespace mppi
+{
+
+void ThreadPool::initialize(unsigned int num_threads, const models::ThreadPlacement & placement)
+{
+  shutdown();
+
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  active_ = true;
+  started_workers_ = 0;
+  placement_reports_.assign(num_threads - 1, models::ThreadPlacementReport{});
+  for (unsigned int i = 1; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::workerThread, this, i - 1, generation_, placement);
+  }
+
+  // Placements are applied from within the workers, as nice values are per thread
+  std::unique_lock<std::mutex> guard(lock_);
+  done_cond_.wait(guard, [this]() {return started_workers_ == workers_.size();});
+}
+
+void ThreadPool::shutdown()
+{
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+    active_ = false;
+  }
+  start_cond_.notify_all();
+
+  for (auto & worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  workers_.clear();
+}
+
+void ThreadPool::run(size_t num_chunks, job_t job, void * context)
+{
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+    job_ = job;
+    job_context_ = context;
+    num_chunks_ = num_chunks;
+    next_chunk_ = 0;
+    job_error_ = nullptr;
+    pending_workers_ = workers_.size();
+    generation_++;
+  }
+  start_cond_.notify_all();
+
+  processChunks();
+
+  std::unique_lock<std::mutex> guard(lock_);
+  done_cond_.wait(guard, [this]() {return pending_workers_ == 0;});
+  job_ = nullptr;
+  job_context_ = nullptr;
+
+  // Rethrown on the calling thread, where it would have been thrown without workers
+  if (job_error_) {
+    std::rethrow_exception(std::exchange(job_error_, nullptr));
+  }
+}
+
+void ThreadPool::processChunks()
+{
+  for (size_t chunk = next_chunk_++; chunk < num_chunks_; chunk = next_chunk_++) {
+    try {
+      job_(job_context_, chunk);
+    } catch (...) {
+      std::unique_lock<std::mutex> guard(lock_);
+      if (!job_error_) {
+        job_error_ = std::current_exception();
+      }
+      // The job failed, so the chunks nobody claimed yet are not worth processing
+      next_chunk_ = num_chunks_;
+    }
+  }
+}
+
+void ThreadPool::workerThread(
+  size_t index, size_t seen_generation, const models::ThreadPlacement & placement)
+{
+  models::ThreadPlacementReport report;
+  report.applied = applyThreadPlacement(placement, report.description);
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+    placement_reports_[index] = std::move(report);
+    started_workers_++;
+  }
+  done_cond_.notify_all();
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard(lock_);
+      start_cond_.wait(
+        guard, [&]() {return !active_ || generation_ != seen_generation;});
+      if (!active_) {
+        return;
+      }
+      seen_generation = generation_;
+    }
+
+    processChunks();
+
+    std::unique_lock<std::mutex> guard(lock_);
+    if (--pending_workers_ == 0) {
+      done_cond_.notify_all();
+    }
+  }
+}
+
+}  // namespace mppi
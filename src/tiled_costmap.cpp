@@ -0,0 +1,168 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/tiled_costmap.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+#include "nav2_costmap_2d/cost_values.hpp"
+
+namespace mppi
+{
+
+namespace
+{
+
+constexpr size_t tile_cells = static_cast<size_t>(TiledCostmap::tile_size) *
+  TiledCostmap::tile_size;
+
+uint32_t spreadBits(uint32_t value)
+{
+  value = (value | (value << 8)) & 0x00ff00ffu;
+  value = (value | (value << 4)) & 0x0f0f0f0fu;
+  value = (value | (value << 2)) & 0x33333333u;
+  value = (value | (value << 1)) & 0x55555555u;
+  return value;
+}
+
+}  // namespace
+
+uint32_t TiledCostmap::mortonCode(uint16_t tx, uint16_t ty)
+{
+  return spreadBits(tx) | (spreadBits(ty) << 1);
+}
+
+bool TiledCostmap::resize(const nav2_costmap_2d::Costmap2D & costmap)
+{
+  const unsigned int size_x = costmap.getSizeInCellsX();
+  const unsigned int size_y = costmap.getSizeInCellsY();
+  const float origin_x = static_cast<float>(costmap.getOriginX());
+  const float origin_y = static_cast<float>(costmap.getOriginY());
+  const float resolution = static_cast<float>(costmap.getResolution());
+  if (!costs_.empty() && size_x == size_x_ && size_y == size_y_ && origin_x == origin_x_ &&
+    origin_y == origin_y_ && resolution == resolution_)
+  {
+    return false;
+  }
+
+  size_x_ = size_x;
+  size_y_ = size_y;
+  origin_x_ = origin_x;
+  origin_y_ = origin_y;
+  resolution_ = resolution;
+  inv_resolution_ = 1.0f / resolution_;
+  tiles_x_ = (size_x_ + tile_size - 1) / tile_size;
+  tiles_y_ = (size_y_ + tile_size - 1) / tile_size;
+  if (tiles_x_ > 0xffffu || tiles_y_ > 0xffffu) {
+    throw std::runtime_error("Costmap is too large to be tiled!");
+  }
+
+  // Tiles are ranked by Morton code, which skips the codes of tiles out of the map
+  const size_t tiles = static_cast<size_t>(tiles_x_) * tiles_y_;
+  std::vector<size_t> order(tiles);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(
+    order.begin(), order.end(), [&](size_t a, size_t b) {
+      return mortonCode(a % tiles_x_, a / tiles_x_) < mortonCode(b % tiles_x_, b / tiles_x_);
+    });
+  tile_offsets_.resize(tiles);
+  for (size_t rank = 0; rank != tiles; rank++) {
+    tile_offsets_[order[rank]] = rank * tile_cells;
+  }
+
+  costs_.assign(tiles * tile_cells, nav2_costmap_2d::NO_INFORMATION);
+  // Distances are only held once copied
+  distances_.clear();
+  has_distances_ = false;
+  return true;
+}
+
+void TiledCostmap::copyTile(
+  const nav2_costmap_2d::Costmap2D & costmap, unsigned int tx, unsigned int ty)
+{
+  const unsigned int x_begin = tx * tile_size;
+  const unsigned int y_begin = ty * tile_size;
+  const size_t width = std::min(size_x_, x_begin + tile_size) - x_begin;
+  const unsigned int y_end = std::min(size_y_, y_begin + tile_size);
+  const unsigned char * src = costmap.getCharMap();
+  unsigned char * dst = costs_.data() + tile_offsets_[static_cast<size_t>(ty) * tiles_x_ + tx];
+  for (unsigned int y = y_begin; y != y_end; y++) {
+    std::memcpy(
+      dst + static_cast<size_t>(y - y_begin) * tile_size,
+      src + static_cast<size_t>(y) * size_x_ + x_begin, width);
+  }
+  copied_cells_ += width * (y_end - y_begin);
+}
+
+bool TiledCostmap::update(const CostmapSnapshot & snapshot)
+{
+  copied_cells_ = 0;
+  const auto & costmap = snapshot.costmap();
+  const bool resized = resize(costmap);
+  if (!resized && snapshot_version_ == snapshot.version()) {
+    return false;
+  }
+
+  // Tiles changed since the version mirrored, which may be several updates ago
+  for (unsigned int ty = 0; ty != tiles_y_; ty++) {
+    for (unsigned int tx = 0; tx != tiles_x_; tx++) {
+      if (resized || snapshot_version_ == 0 ||
+        snapshot.changedSince(tx * tile_size, ty * tile_size, snapshot_version_))
+      {
+        copyTile(costmap, tx, ty);
+      }
+    }
+  }
+  snapshot_version_ = snapshot.version();
+  return copied_cells_ != 0;
+}
+
+void TiledCostmap::update(const nav2_costmap_2d::Costmap2D & costmap)
+{
+  copied_cells_ = 0;
+  resize(costmap);
+  for (unsigned int ty = 0; ty != tiles_y_; ty++) {
+    for (unsigned int tx = 0; tx != tiles_x_; tx++) {
+      copyTile(costmap, tx, ty);
+    }
+  }
+  snapshot_version_ = 0;
+}
+
+void TiledCostmap::updateDistances(const DistanceField & field)
+{
+  if (field.getSizeInCellsX() != size_x_ || field.getSizeInCellsY() != size_y_) {
+    throw std::runtime_error("Distance field does not match the tiled costmap!");
+  }
+
+  outside_distance_ = field.getOutsideDistance();
+  distances_.resize(costs_.size());
+  for (unsigned int my = 0; my != size_y_; my++) {
+    for (unsigned int mx = 0; mx != size_x_; mx++) {
+      distances_[index(mx, my)] = floatToHalf(field.distanceAtCell(mx, my));
+    }
+  }
+  has_distances_ = true;
+}
+
+size_t TiledCostmap::getMemoryUsage() const
+{
+  return costs_.size() * sizeof(unsigned char) + distances_.size() * sizeof(uint16_t) +
+         tile_offsets_.size() * sizeof(size_t);
+}
+
+}  // namespace mppi
@@ -0,0 +1,53 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/tiled_tensor.hpp"
+
+namespace mppi
+{
+
+void TiledTensor::reset(size_t batch_size, size_t time_steps)
+{
+  batch_size_ = batch_size;
+  time_steps_ = time_steps;
+  data_.assign(tiles() * time_steps_ * tile_size, 0.0f);
+}
+
+void TiledTensor::pack(const float * data, size_t batch_size, size_t time_steps)
+{
+  if (batch_size_ != batch_size || time_steps_ != time_steps) {
+    reset(batch_size, time_steps);
+  }
+
+  for (size_t i = 0; i != batch_size_; i++) {
+    const float * row = data + i * time_steps_;
+    float * dst = data_.data() + (i / tile_size) * time_steps_ * tile_size + i % tile_size;
+    for (size_t t = 0; t != time_steps_; t++) {
+      dst[t * tile_size] = row[t];
+    }
+  }
+}
+
+void TiledTensor::unpack(float * data) const
+{
+  for (size_t i = 0; i != batch_size_; i++) {
+    float * row = data + i * time_steps_;
+    const float * src = data_.data() + (i / tile_size) * time_steps_ * tile_size + i % tile_size;
+    for (size_t t = 0; t != time_steps_; t++) {
+      row[t] = src[t * tile_size];
+    }
+  }
+}
+
+}  // namespace mppi
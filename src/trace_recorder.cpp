@@ -0,0 +1,210 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/trace_recorder.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace mppi
+{
+
+namespace
+{
+
+std::atomic<uint64_t> next_recorder_id{1};
+
+/**
+ * @struct ThreadCache
+ * @brief Ring of the calling thread in the recorder it last recorded into
+ */
+struct ThreadCache
+{
+  uint64_t recorder{0};
+  void * buffer{nullptr};
+};
+
+thread_local ThreadCache thread_cache;
+
+void writeString(std::ostream & stream, const std::string & value)
+{
+  stream << '"';
+  for (const char c : value) {
+    if (c == '"' || c == '\\') {
+      stream << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      stream << escaped;
+    } else {
+      stream << c;
+    }
+  }
+  stream << '"';
+}
+
+}  // namespace
+
+TraceRecorder::TraceRecorder()
+: id_(next_recorder_id++), epoch_(std::chrono::steady_clock::now())
+{
+}
+
+void TraceRecorder::setBufferSize(size_t size)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  buffer_size_ = std::max<size_t>(size, 1);
+}
+
+uint32_t TraceRecorder::addName(const std::string & name)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto it = std::find(names_.begin(), names_.end(), name);
+  if (it != names_.end()) {
+    return static_cast<uint32_t>(it - names_.begin());
+  }
+  names_.push_back(name);
+  return static_cast<uint32_t>(names_.size() - 1);
+}
+
+std::string TraceRecorder::getName(uint32_t name) const
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  return name < names_.size() ? names_[name] : std::string();
+}
+
+void TraceRecorder::nameThread(const std::string & name)
+{
+  if (!isEnabled()) {
+    return;
+  }
+  ThreadBuffer & buffer = threadBuffer();
+  std::lock_guard<std::mutex> guard(lock_);
+  buffer.name = name;
+}
+
+TraceRecorder::ThreadBuffer & TraceRecorder::threadBuffer()
+{
+  // Threads recording into more than one recorder in turn look their ring up every time
+  if (thread_cache.recorder == id_) {
+    return *static_cast<ThreadBuffer *>(thread_cache.buffer);
+  }
+  ThreadBuffer & buffer = registerThread();
+  thread_cache.recorder = id_;
+  thread_cache.buffer = &buffer;
+  return buffer;
+}
+
+TraceRecorder::ThreadBuffer & TraceRecorder::registerThread()
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  const auto id = std::this_thread::get_id();
+  for (auto & buffer : buffers_) {
+    if (buffer->id == id) {
+      return *buffer;
+    }
+  }
+
+  auto buffer = std::make_unique<ThreadBuffer>();
+  buffer->id = id;
+  buffer->thread = static_cast<uint32_t>(buffers_.size() + 1);
+  buffer->name = "thread " + std::to_string(buffer->thread);
+  buffer->events.resize(buffer_size_);
+  buffers_.push_back(std::move(buffer));
+  return *buffers_.back();
+}
+
+std::vector<TraceEvent> TraceRecorder::collect() const
+{
+  std::vector<TraceEvent> events;
+  std::lock_guard<std::mutex> guard(lock_);
+  for (const auto & buffer : buffers_) {
+    const uint64_t capacity = buffer->events.size();
+    const uint64_t head = buffer->head.load(std::memory_order_acquire);
+    const uint64_t begin = head > capacity ? head - capacity : 0;
+    const size_t first = events.size();
+    for (uint64_t i = begin; i != head; i++) {
+      events.push_back(buffer->events[i % capacity]);
+    }
+
+    // Events the thread wrapped around to while they were copied may be torn
+    const uint64_t written = buffer->head.load(std::memory_order_acquire);
+    const uint64_t overwritten = written > capacity ? written - capacity : 0;
+    if (overwritten > begin) {
+      const size_t torn = static_cast<size_t>(std::min(overwritten, head) - begin);
+      events.erase(events.begin() + first, events.begin() + first + torn);
+    }
+  }
+  return events;
+}
+
+size_t TraceRecorder::writeJson(std::ostream & stream) const
+{
+  const auto events = collect();
+  std::vector<std::pair<uint32_t, std::string>> threads;
+  std::vector<std::string> names;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (const auto & buffer : buffers_) {
+      threads.emplace_back(buffer->thread, buffer->name);
+    }
+    names = names_;
+  }
+
+  const int pid = static_cast<int>(::getpid());
+  stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto & [thread, name] : threads) {
+    stream << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" <<
+      pid << ",\"tid\":" << thread << ",\"args\":{\"name\":";
+    writeString(stream, name);
+    stream << "}}";
+    first = false;
+  }
+
+  // Complete events, in microseconds since the recorder was created
+  char times[64];
+  for (const auto & event : events) {
+    stream << (first ? "" : ",") << "\n{\"name\":";
+    writeString(stream, event.name < names.size() ? names[event.name] : std::string());
+    std::snprintf(
+      times, sizeof(times), "%.3f,\"dur\":%.3f", event.begin_ns * 1e-3,
+      event.duration_ns * 1e-3);
+    stream << ",\"cat\":\"mppi\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << event.thread <<
+      ",\"ts\":" << times << "}";
+    first = false;
+  }
+  stream << "\n]}\n";
+  return events.size();
+}
+
+size_t TraceRecorder::dump(const std::string & file_path) const
+{
+  std::ofstream file(file_path, std::ios::trunc);
+  if (!file) {
+    throw std::runtime_error("Cannot write trace " + file_path + "!");
+  }
+  const size_t events = writeJson(file);
+  if (!file) {
+    throw std::runtime_error("Cannot write trace " + file_path + "!");
+  }
+  return events;
+}
+
+}  // namespace mppi
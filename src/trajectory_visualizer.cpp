@@ -14,6 +14,7 @@
 
 #include <memory>
 #include "mppic/tools/trajectory_visualizer.hpp"
+#include "nav2_util/geometry_utils.hpp"
 
 namespace mppi
 {
@@ -22,8 +23,11 @@ void TrajectoryVisualizer::on_configure(
   rclcpp_lifecycle::LifecycleNode::WeakPtr parent, const std::string & name,
   const std::string & frame_id, ParametersHandler * parameters_handler)
 {
+  stopPublisherThread();
+
   auto node = parent.lock();
   logger_ = node->get_logger();
+  clock_ = node->get_clock();
   frame_id_ = frame_id;
   trajectories_publisher_ =
     node->create_publisher<visualization_msgs::msg::MarkerArray>("/trajectories", 1);
@@ -34,12 +38,27 @@ void TrajectoryVisualizer::on_configure(
 
   getParam(trajectory_step_, "trajectory_step", 5);
   getParam(time_step_, "time_step", 3);
+  getParam(top_trajectories_, "top_trajectories", 0);
+  getParam(line_strips_, "line_strips", false);
+  getParam(publish_rate_, "publish_rate", 0.0);
+  getParam(async_, "async", false, ParameterType::Static);
 
+  last_publish_time_.reset();
   reset();
+
+  if (async_) {
+    {
+      std::unique_lock<std::mutex> guard(publisher_lock_);
+      active_ = true;
+      ready_ = false;
+    }
+    publisher_thread_ = std::thread(&TrajectoryVisualizer::publisherThread, this);
+  }
 }
 
 void TrajectoryVisualizer::on_cleanup()
 {
+  stopPublisherThread();
   trajectories_publisher_.reset();
   transformed_path_pub_.reset();
 }
@@ -59,69 +78,267 @@ void TrajectoryVisualizer::on_deactivate()
 void TrajectoryVisualizer::add(const xt::xtensor<float, 2> & trajectory)
 {
   auto & size = trajectory.shape()[0];
-  if (!size) {
+  if (!size || !shouldVisualizeTrajectories()) {
     return;
   }
 
-  auto add_marker = [&](auto i) {
-      float component = static_cast<float>(i) / static_cast<float>(size);
-
-      auto pose = utils::createPose(trajectory(i, 0), trajectory(i, 1), 0.06);
-      auto scale =
-        i != size - 1 ?
-        utils::createScale(0.03, 0.03, 0.07) :
-        utils::createScale(0.07, 0.07, 0.09);
-      auto color = utils::createColor(0, component, component, 1);
-      auto marker = utils::createMarker(marker_id_++, pose, scale, color, frame_id_);
-      points_->markers.push_back(marker);
-    };
-
+  auto & strips = frames_[back_].optimal;
   for (size_t i = 0; i < size; i++) {
-    add_marker(i);
+    strips.x.push_back(trajectory(i, 0));
+    strips.y.push_back(trajectory(i, 1));
+    strips.shade.push_back(static_cast<float>(i) / static_cast<float>(size));
   }
+  strips.ends.push_back(strips.x.size());
 }
 
 void TrajectoryVisualizer::add(
   const models::Trajectories & trajectories)
 {
+  add(trajectories, trajectory_step_);
+}
+
+void TrajectoryVisualizer::add(
+  const models::Trajectories & trajectories, size_t trajectory_step)
+{
+  if (!shouldVisualizeTrajectories()) {
+    return;
+  }
+
+  ScopedTrace trace(trace_recorder_, add_trace_);
   auto & shape = trajectories.x.shape();
   const float shape_1 = static_cast<float>(shape[1]);
-  points_->markers.reserve(floor(shape[0] / trajectory_step_) * floor(shape[1] * time_step_));
-
-  for (size_t i = 0; i < shape[0]; i += trajectory_step_) {
+  auto & strips = frames_[back_].candidates;
+  for (size_t i = 0; i < shape[0]; i += trajectory_step) {
     for (size_t j = 0; j < shape[1]; j += time_step_) {
-      const float j_flt = static_cast<float>(j);
-      float blue_component = 1.0f - j_flt / shape_1;
-      float green_component = j_flt / shape_1;
-
-      auto pose = utils::createPose(trajectories.x(i, j), trajectories.y(i, j), 0.03);
-      auto scale = utils::createScale(0.03, 0.03, 0.03);
-      auto color = utils::createColor(0, green_component, blue_component, 1);
-      auto marker = utils::createMarker(marker_id_++, pose, scale, color, frame_id_);
-
-      points_->markers.push_back(marker);
+      strips.x.push_back(trajectories.x(i, j));
+      strips.y.push_back(trajectories.y(i, j));
+      strips.shade.push_back(static_cast<float>(j) / shape_1);
     }
+    strips.ends.push_back(strips.x.size());
+  }
+}
+
+bool TrajectoryVisualizer::shouldVisualizeTrajectories()
+{
+  if (!publish_due_) {
+    const bool period_elapsed = publish_rate_ <= 0.0 || !last_publish_time_ ||
+      (clock_->now() - *last_publish_time_).seconds() >= 1.0 / publish_rate_;
+    publish_due_ = period_elapsed && trajectories_publisher_->get_subscription_count() > 0;
   }
+  return *publish_due_;
 }
 
 void TrajectoryVisualizer::reset()
 {
-  marker_id_ = 0;
-  points_ = std::make_unique<visualization_msgs::msg::MarkerArray>();
+  publish_due_.reset();
+
+  auto & frame = frames_[back_];
+  frame.trajectories = false;
+  frame.candidates.clear();
+  frame.optimal.clear();
+  frame.path = false;
 }
 
 void TrajectoryVisualizer::visualize(const nav_msgs::msg::Path & plan)
 {
-  if (trajectories_publisher_->get_subscription_count() > 0) {
-    trajectories_publisher_->publish(std::move(points_));
+  // Already a message, so published as is on this thread
+  if (transformed_path_pub_->get_subscription_count() > 0) {
+    auto plan_ptr = std::make_unique<nav_msgs::msg::Path>(plan);
+    transformed_path_pub_->publish(std::move(plan_ptr));
   }
 
+  commitFrame();
   reset();
+}
 
+void TrajectoryVisualizer::visualize(
+  const models::Path & plan, const builtin_interfaces::msg::Time & stamp)
+{
   if (transformed_path_pub_->get_subscription_count() > 0) {
-    auto plan_ptr = std::make_unique<nav_msgs::msg::Path>(plan);
+    auto & frame = frames_[back_];
+    frame.path = true;
+    frame.stamp = stamp;
+    frame.path_x.assign(plan.x.begin(), plan.x.end());
+    frame.path_y.assign(plan.y.begin(), plan.y.end());
+    frame.path_yaws.assign(plan.yaws.begin(), plan.yaws.end());
+  }
+
+  commitFrame();
+  reset();
+}
+
+void TrajectoryVisualizer::setTraceRecorder(TraceRecorder * recorder)
+{
+  trace_recorder_ = recorder;
+  if (trace_recorder_) {
+    add_trace_ = trace_recorder_->addName("addTrajectories");
+    commit_trace_ = trace_recorder_->addName("commitFrame");
+    publish_trace_ = trace_recorder_->addName("publishFrame");
+  }
+}
+
+void TrajectoryVisualizer::commitFrame()
+{
+  ScopedTrace trace(trace_recorder_, commit_trace_);
+  auto & frame = frames_[back_];
+  frame.trajectories = shouldVisualizeTrajectories();
+  if (frame.trajectories) {
+    last_publish_time_ = clock_->now();
+  }
+
+  if (!frame.trajectories && !frame.path) {
+    return;
+  }
+
+  if (!async_) {
+    publishFrame(frame);
+    return;
+  }
+
+  // Hand off the frame, taking back the one not in use by the publisher thread
+  const unsigned int previous = latest_.exchange(back_ | fresh_flag_);
+  if (previous & fresh_flag_) {
+    dropped_frames_++;
+  }
+  back_ = previous & index_mask_;
+
+  {
+    std::unique_lock<std::mutex> guard(publisher_lock_);
+    ready_ = true;
+  }
+  publisher_cond_.notify_all();
+}
+
+void TrajectoryVisualizer::publisherThread()
+{
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard(publisher_lock_);
+      publisher_cond_.wait(guard, [this]() {return ready_;});
+      if (!active_) {
+        return;
+      }
+      ready_ = false;
+    }
+
+    if (trace_recorder_) {
+      trace_recorder_->nameThread("visualizer");
+    }
+    if (latest_ & fresh_flag_) {
+      front_ = latest_.exchange(front_) & index_mask_;
+      publishFrame(frames_[front_]);
+    }
+  }
+}
+
+void TrajectoryVisualizer::stopPublisherThread()
+{
+  {
+    std::unique_lock<std::mutex> guard(publisher_lock_);
+    active_ = false;
+    ready_ = true;
+  }
+  publisher_cond_.notify_all();
+  if (publisher_thread_.joinable()) {
+    publisher_thread_.join();
+  }
+}
+
+void TrajectoryVisualizer::publishFrame(const Frame & frame)
+{
+  ScopedTrace trace(trace_recorder_, publish_trace_);
+  using visualization_msgs::msg::Marker;
+  if (frame.trajectories) {
+    marker_id_ = 0;
+    used_markers_ = 0;
+
+    // Candidates shade from blue to green, the optimal trajectory from black to cyan
+    auto addStrips = [&](const Strips & strips, bool optimal) {
+        const double z = optimal ? 0.06 : 0.03;
+        auto color = [&](size_t k) {
+            const float shade = strips.shade[k];
+            return utils::createColor(0, shade, optimal ? shade : 1.0f - shade, 1);
+          };
+
+        size_t begin = 0;
+        for (const size_t end : strips.ends) {
+          if (end == begin) {
+            continue;
+          }
+
+          if (line_strips_) {
+            auto & marker = nextMarker(Marker::LINE_STRIP);
+            marker.scale = utils::createScale(optimal ? 0.05 : 0.01, 0.0, 0.0);
+            marker.color = color(begin);
+            marker.points.resize(end - begin);
+            marker.colors.resize(end - begin);
+            for (size_t k = begin; k != end; k++) {
+              marker.points[k - begin].x = strips.x[k];
+              marker.points[k - begin].y = strips.y[k];
+              marker.points[k - begin].z = z;
+              marker.colors[k - begin] = color(k);
+            }
+          } else {
+            for (size_t k = begin; k != end; k++) {
+              auto & marker = nextMarker(Marker::SPHERE);
+              marker.pose = utils::createPose(strips.x[k], strips.y[k], z);
+              if (!optimal) {
+                marker.scale = utils::createScale(0.03, 0.03, 0.03);
+              } else if (k != end - 1) {
+                marker.scale = utils::createScale(0.03, 0.03, 0.07);
+              } else {
+                marker.scale = utils::createScale(0.07, 0.07, 0.09);
+              }
+              marker.color = color(k);
+            }
+          }
+          begin = end;
+        }
+      };
+
+    addStrips(frame.candidates, false);
+    addStrips(frame.optimal, true);
+
+    // Only shrinks when fewer markers were added than in a previous frame
+    markers_.markers.resize(used_markers_);
+    trajectories_publisher_->publish(markers_);
+  }
+
+  if (frame.path) {
+    auto plan_ptr = std::make_unique<nav_msgs::msg::Path>();
+    plan_ptr->header.frame_id = frame_id_;
+    plan_ptr->header.stamp = frame.stamp;
+    plan_ptr->poses.resize(frame.path_x.size());
+    for (size_t i = 0; i != plan_ptr->poses.size(); i++) {
+      auto & pose = plan_ptr->poses[i];
+      pose.header = plan_ptr->header;
+      pose.pose.position.x = frame.path_x[i];
+      pose.pose.position.y = frame.path_y[i];
+      pose.pose.orientation = nav2_util::geometry_utils::orientationAroundZAxis(frame.path_yaws[i]);
+    }
     transformed_path_pub_->publish(std::move(plan_ptr));
   }
 }
 
+visualization_msgs::msg::Marker & TrajectoryVisualizer::nextMarker(int32_t type)
+{
+  using visualization_msgs::msg::Marker;
+  if (used_markers_ == markers_.markers.size()) {
+    markers_.markers.emplace_back();
+  }
+
+  // Assigned in place, so the strings and point vectors keep their capacity
+  Marker & marker = markers_.markers[used_markers_++];
+  marker.header.frame_id = frame_id_;
+  marker.header.stamp = rclcpp::Time(0, 0);
+  marker.ns = "MarkerNS";
+  marker.id = marker_id_++;
+  marker.type = type;
+  marker.action = Marker::ADD;
+  marker.pose = geometry_msgs::msg::Pose();
+  marker.points.clear();
+  marker.colors.clear();
+  return marker;
+}
+
 }  // namespace mppi
@@ -0,0 +1,156 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mppic/tools/workspace.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace mppi
+{
+
+ScratchBuffer::ScratchBuffer(Workspace * workspace, size_t size)
+: workspace_(workspace)
+{
+  if (workspace_) {
+    slot_ = workspace_->acquire(size);
+    buffer_ = &workspace_->buffers_[slot_];
+  } else {
+    local_ = models::BatchTensor<1>::from_shape({size});
+    buffer_ = &local_;
+  }
+
+  buffer_->fill(0.0f);
+}
+
+ScratchBuffer::~ScratchBuffer()
+{
+  if (workspace_) {
+    workspace_->release(slot_);
+  }
+}
+
+void Workspace::reset(size_t batch_size, size_t max_batch_size, size_t num_buffers)
+{
+  std::unique_lock<std::mutex> guard(lock_);
+  const size_t count = std::max(num_buffers, initial_batch_buffers_);
+  if (buffers_.size() < count) {
+    buffers_.resize(count);
+    leased_.resize(count, false);
+  }
+
+  reserved_size_ = std::max(batch_size, max_batch_size);
+  for (auto & buffer : buffers_) {
+    sizeBuffer(buffer, batch_size);
+  }
+}
+
+void Workspace::swap(Workspace & other)
+{
+  std::scoped_lock guard(lock_, other.lock_);
+  std::swap(reserved_size_, other.reserved_size_);
+  buffers_.swap(other.buffers_);
+  leased_.swap(other.leased_);
+}
+
+void Workspace::sizeBuffer(models::BatchTensor<1> & buffer, size_t size) const
+{
+  models::reserveBatch(buffer, std::max(size, reserved_size_));
+  if (buffer.size() != size) {
+    models::resizeBatch(buffer, size);
+  }
+}
+
+size_t Workspace::acquire(size_t size)
+{
+  std::unique_lock<std::mutex> guard(lock_);
+  size_t slot = 0;
+  while (slot < leased_.size() && leased_[slot]) {
+    slot++;
+  }
+
+  // Only grows when more buffers are leased at once than ever before
+  if (slot == buffers_.size()) {
+    buffers_.emplace_back();
+    leased_.push_back(false);
+  }
+
+  sizeBuffer(buffers_[slot], size);
+
+  leased_[slot] = true;
+  return slot;
+}
+
+size_t Workspace::getMemoryUsage() const
+{
+  std::unique_lock<std::mutex> guard(lock_);
+  size_t bytes = path_validity_.capacity() / 8 + path_lengths_.capacity() * sizeof(float);
+  for (const auto & buffer : buffers_) {
+    bytes += models::reservedBytes(buffer);
+  }
+  return bytes;
+}
+
+void Workspace::release(size_t slot)
+{
+  std::unique_lock<std::mutex> guard(lock_);
+  leased_[slot] = false;
+}
+
+void Workspace::acquirePathValidity(
+  std::optional<std::vector<bool>> & path_pts_valid, size_t size)
+{
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+    path_pts_valid = std::move(path_validity_);
+    path_validity_ = std::vector<bool>();
+  }
+
+  // Within the previous capacity, this does not reallocate
+  path_pts_valid->assign(size, false);
+}
+
+void Workspace::releasePathValidity(std::optional<std::vector<bool>> & path_pts_valid)
+{
+  if (path_pts_valid) {
+    std::unique_lock<std::mutex> guard(lock_);
+    if (path_pts_valid->capacity() > path_validity_.capacity()) {
+      path_validity_ = std::move(*path_pts_valid);
+    }
+  }
+
+  path_pts_valid.reset();
+}
+
+void Workspace::acquirePathLengths(std::vector<float> & path_lengths, size_t size)
+{
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+    path_lengths = std::move(path_lengths_);
+    path_lengths_ = std::vector<float>();
+  }
+
+  // Within the previous capacity, this does not reallocate
+  path_lengths.assign(size, 0.0f);
+}
+
+void Workspace::releasePathLengths(std::vector<float> & path_lengths)
+{
+  std::unique_lock<std::mutex> guard(lock_);
+  if (path_lengths.capacity() > path_lengths_.capacity()) {
+    path_lengths_ = std::move(path_lengths);
+  }
+}
+
+}  // namespace mppi
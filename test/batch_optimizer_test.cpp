@@ -0,0 +1,101 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "mppic/batch_optimizer.hpp"
+
+// Tests stepping many robots' optimizers together
+
+using namespace mppi;  // NOLINT
+
+namespace
+{
+
+models::Path makePath(float heading)
+{
+  models::Path path;
+  path.reset(20);
+  for (size_t i = 0; i != 20; i++) {
+    path.x(i) = 0.1f * static_cast<float>(i) * std::cos(heading);
+    path.y(i) = 0.1f * static_cast<float>(i) * std::sin(heading);
+    path.yaws(i) = heading;
+  }
+  return path;
+}
+
+}  // namespace
+
+TEST(BatchOptimizerTest, MatchesSeparateOptimizers)
+{
+  nav2_costmap_2d::Costmap2D costmap(100, 100, 0.05, -2.5, -2.5, nav2_costmap_2d::FREE_SPACE);
+  for (unsigned int i = 60; i != 70; i++) {
+    costmap.setCost(i, 40, nav2_costmap_2d::LETHAL_OBSTACLE);
+  }
+  HeadlessCostmap headless;
+  headless.costmap = &costmap;
+  headless.base_frame_id = "robot_base";
+
+  const std::vector<rclcpp::Parameter> parameters{
+    rclcpp::Parameter("controller_frequency", 30.0),
+    rclcpp::Parameter("mppic.batch_size", 200),
+    rclcpp::Parameter("mppic.time_steps", 15),
+    rclcpp::Parameter("mppic.noise_seed", 42),
+    rclcpp::Parameter(
+      "mppic.critics", std::vector<std::string>{"ObstaclesCritic", "PathFollowCritic"})};
+
+  const size_t robots = 4;
+  BatchOptimizer batch;
+  batch.initialize("mppic", headless, robots, parameters, 2);
+  EXPECT_EQ(batch.size(), robots);
+
+  std::vector<RobotProblem> problems(robots);
+  for (size_t i = 0; i != robots; i++) {
+    problems[i].robot_pose.pose.orientation.w = 1.0;
+    problems[i].path = makePath(0.3f * static_cast<float>(i));
+  }
+  std::vector<RobotCommand> commands;
+  batch.evalControls(problems, commands);
+  ASSERT_EQ(commands.size(), robots);
+
+  // Each robot gives the command of an optimizer of its own, seeded alike
+  auto robot_parameters = parameters;
+  robot_parameters.emplace_back("mppic.worker_threads", 1);
+  robot_parameters.emplace_back("mppic.noise_thread", false);
+  for (size_t i = 0; i != robots; i++) {
+    EXPECT_FALSE(commands[i].failed) << commands[i].error;
+    EXPECT_EQ(commands[i].cmd.header.frame_id, "robot_base");
+
+    ParametersHandler param_handler(robot_parameters);
+    Optimizer optimizer;
+    optimizer.initialize("mppic", headless, &param_handler);
+    param_handler.start();
+    auto path = makePath(0.3f * static_cast<float>(i));
+    const auto cmd = optimizer.evalControl(
+      problems[i].robot_pose, problems[i].robot_speed, path, problems[i].stamp, nullptr);
+    EXPECT_EQ(cmd.twist.linear.x, commands[i].cmd.twist.linear.x);
+    EXPECT_EQ(cmd.twist.angular.z, commands[i].cmd.twist.angular.z);
+    optimizer.shutdown();
+  }
+
+  // One problem per robot
+  problems.pop_back();
+  EXPECT_THROW(batch.evalControls(problems, commands), std::runtime_error);
+  batch.shutdown();
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "mppic/tools/costmap_snapshot.hpp"
+#include "mppic/tools/distance_field.hpp"
+
+// Tests the per cycle costmap snapshot and its change tracking
+
+using namespace mppi;  // NOLINT
+
+TEST(CostmapSnapshotTest, TracksChangedTiles)
+{
+  nav2_costmap_2d::Costmap2D costmap(100, 70, 0.05, 1.0, 2.0, nav2_costmap_2d::FREE_SPACE);
+  CostmapSnapshot snapshot;
+  EXPECT_EQ(snapshot.version(), 0u);
+
+  // The first update copies everything
+  EXPECT_TRUE(snapshot.update(costmap, false));
+  EXPECT_EQ(snapshot.version(), 1u);
+  EXPECT_EQ(snapshot.dirtyTiles(), 4u * 3u);
+  EXPECT_EQ(snapshot.costmap().getSizeInCellsX(), 100u);
+  EXPECT_DOUBLE_EQ(snapshot.costmap().getOriginY(), 2.0);
+
+  // Unchanged map, nothing to do
+  EXPECT_FALSE(snapshot.update(costmap, false));
+  EXPECT_FALSE(snapshot.changed());
+  EXPECT_EQ(snapshot.version(), 1u);
+  unsigned int min_x, min_y, max_x, max_y;
+  EXPECT_FALSE(snapshot.getDirtyBounds(min_x, min_y, max_x, max_y));
+
+  // A single changed cell dirties its tile only
+  costmap.setCost(40, 10, nav2_costmap_2d::LETHAL_OBSTACLE);
+  EXPECT_EQ(snapshot.costmap().getCost(40, 10), nav2_costmap_2d::FREE_SPACE);
+  EXPECT_TRUE(snapshot.update(costmap, false));
+  EXPECT_EQ(snapshot.version(), 2u);
+  EXPECT_EQ(snapshot.dirtyTiles(), 1u);
+  EXPECT_EQ(snapshot.costmap().getCost(40, 10), nav2_costmap_2d::LETHAL_OBSTACLE);
+  ASSERT_TRUE(snapshot.getDirtyBounds(min_x, min_y, max_x, max_y));
+  EXPECT_EQ(min_x, 32u);
+  EXPECT_EQ(min_y, 0u);
+  EXPECT_EQ(max_x, 64u);
+  EXPECT_EQ(max_y, 32u);
+
+  EXPECT_TRUE(snapshot.changedSince(40, 10, 1));
+  EXPECT_FALSE(snapshot.changedSince(40, 10, 2));
+  EXPECT_FALSE(snapshot.changedSince(0, 0, 1));
+  EXPECT_FALSE(snapshot.changedSince(99, 69, 1));
+
+  // The partial last tiles are tracked as well
+  costmap.setCost(99, 69, nav2_costmap_2d::NO_INFORMATION);
+  costmap.setCost(0, 0, nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE);
+  EXPECT_TRUE(snapshot.update(costmap, false));
+  EXPECT_EQ(snapshot.dirtyTiles(), 2u);
+  ASSERT_TRUE(snapshot.getDirtyBounds(min_x, min_y, max_x, max_y));
+  EXPECT_EQ(min_x, 0u);
+  EXPECT_EQ(min_y, 0u);
+  EXPECT_EQ(max_x, 100u);
+  EXPECT_EQ(max_y, 70u);
+  EXPECT_TRUE(snapshot.changedSince(99, 69, 2));
+  EXPECT_FALSE(snapshot.changedSince(40, 10, 2));
+
+  // Unknown space tracking or geometry changes invalidate everything
+  EXPECT_TRUE(snapshot.update(costmap, true));
+  EXPECT_TRUE(snapshot.isTrackingUnknown());
+  EXPECT_EQ(snapshot.dirtyTiles(), 12u);
+  costmap.updateOrigin(1.5, 2.0);
+  EXPECT_TRUE(snapshot.update(costmap, true));
+  EXPECT_DOUBLE_EQ(snapshot.costmap().getOriginX(), costmap.getOriginX());
+  EXPECT_EQ(snapshot.version(), 5u);
+}
+
+TEST(CostmapSnapshotTest, DistanceFieldFollowsVersion)
+{
+  nav2_costmap_2d::Costmap2D costmap(60, 40, 0.05, 0.0, 0.0, nav2_costmap_2d::FREE_SPACE);
+  costmap.setCost(10, 10, nav2_costmap_2d::LETHAL_OBSTACLE);
+
+  CostmapSnapshot snapshot;
+  DistanceField field;
+  snapshot.update(costmap, true);
+  EXPECT_TRUE(field.update(snapshot));
+  EXPECT_EQ(field.distanceAtCell(10, 10), 0.0f);
+
+  // Unchanged snapshot, no rebuild
+  snapshot.update(costmap, true);
+  EXPECT_FALSE(field.update(snapshot));
+  EXPECT_EQ(field.getUpdateCount(), 1u);
+
+  // The field reads the snapshot, not the live map, until the snapshot is updated
+  costmap.setCost(30, 30, nav2_costmap_2d::LETHAL_OBSTACLE);
+  EXPECT_FALSE(field.update(snapshot));
+  EXPECT_GT(field.distanceAtCell(30, 30), 0.0f);
+  snapshot.update(costmap, true);
+  EXPECT_TRUE(field.update(snapshot));
+  EXPECT_EQ(field.distanceAtCell(30, 30), 0.0f);
+
+  // Switching back to the live map rebuilds, whatever its fingerprint
+  EXPECT_TRUE(field.update(costmap, true));
+  EXPECT_FALSE(field.update(costmap, true));
+  EXPECT_EQ(field.getUpdateCount(), 3u);
+}
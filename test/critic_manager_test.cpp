@@ -13,11 +13,19 @@
 // limitations under the License.
 
 #include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <vector>
+
+#include <xtensor/xnoalias.hpp>
+#include <xtensor/xrandom.hpp>
 
 #include "gtest/gtest.h"
 #include "rclcpp/rclcpp.hpp"
 #include "mppic/critic_manager.hpp"
+#include "mppic/critics/critic_registry.hpp"
 
 // Tests critic manager
 
@@ -72,6 +80,101 @@ public:
   }
 };
 
+class WeightCritic : public CriticFunction
+{
+public:
+  explicit WeightCritic(float weight)
+  : weight_(weight) {}
+
+  virtual void initialize() {}
+  virtual void score(CriticData & data)
+  {
+    // Reads the shared lazily computed fields, which must already be set
+    if (data.path.x.shape(0) > 0 && !data.furthest_reached_path_point) {
+      throw std::runtime_error("Furthest path point not set");
+    }
+    xt::noalias(data.costs) += weight_ * xt::view(data.trajectories.x, xt::all(), -1);
+    data.fail_flag = weight_ < 0.0f;
+  }
+
+  float weight_;
+};
+
+class CriticManagerWeightsWrapper : public CriticManager
+{
+public:
+  explicit CriticManagerWeightsWrapper(std::vector<float> weights)
+  : CriticManager(), weights_(weights) {}
+
+  virtual void loadCritics()
+  {
+    critics_.clear();
+    for (float weight : weights_) {
+      critics_.push_back(std::make_unique<WeightCritic>(weight));
+      critics_.back()->on_configure(
+        parent_, name_, name_ + "." + "WeightCritic", costmap_ros_,
+        parameters_handler_);
+    }
+  }
+
+  std::vector<float> weights_;
+};
+
+class RecordingCritic : public CriticFunction
+{
+public:
+  virtual void initialize() {}
+  virtual void score(CriticData & data)
+  {
+    costmap_snapshot_ = data.costmap_snapshot;
+    fast_math_ = data.fast_math;
+  }
+
+  CostmapSnapshot * costmap_snapshot_{nullptr};
+  bool fast_math_{false};
+};
+
+class CriticManagerRecordingWrapper : public CriticManager
+{
+public:
+  virtual void loadCritics()
+  {
+    critics_.clear();
+    for (size_t i = 0; i != 2; i++) {
+      critics_.push_back(std::make_unique<RecordingCritic>());
+      critics_.back()->on_configure(
+        parent_, name_, name_ + ".RecordingCritic" + std::to_string(i), costmap_ros_,
+        parameters_handler_);
+    }
+  }
+
+  RecordingCritic & getCritic(size_t i)
+  {
+    return *dynamic_cast<RecordingCritic *>(critics_[i].get());
+  }
+};
+
+class CriticManagerStagesWrapper : public CriticManager
+{
+public:
+  explicit CriticManagerStagesWrapper(std::vector<float> weights)
+  : CriticManager(), weights_(weights) {}
+
+  virtual void loadCritics()
+  {
+    // Each critic has its own namespace, for its own stage
+    critics_.clear();
+    for (size_t i = 0; i != weights_.size(); i++) {
+      critics_.push_back(std::make_unique<WeightCritic>(weights_[i]));
+      critics_.back()->on_configure(
+        parent_, name_, name_ + ".WeightCritic" + std::to_string(i), costmap_ros_,
+        parameters_handler_);
+    }
+  }
+
+  std::vector<float> weights_;
+};
+
 class CriticManagerWrapperEnum : public CriticManager
 {
 public:
@@ -82,6 +185,11 @@ public:
   {
     return critics_.size();
   }
+
+  std::string getCriticName(size_t i)
+  {
+    return critics_[i]->getName();
+  }
 };
 
 TEST(CriticManagerTests, BasicCriticOperations)
@@ -103,7 +211,7 @@ TEST(CriticManagerTests, BasicCriticOperations)
   models::ControlSequence control_sequence;
   models::Trajectories generated_trajectories;
   models::Path path;
-  xt::xtensor<float, 1> costs;
+  models::BatchTensor<1> costs;
   float model_dt = 0.1;
   CriticData data =
   {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr,
@@ -135,4 +243,222 @@ TEST(CriticManagerTests, CriticLoadingTest)
   CriticManagerWrapperEnum critic_manager;
   critic_manager.on_configure(node, "critic_manager", costmap_ros, &param_handler);
   EXPECT_EQ(critic_manager.getCriticNum(), 2u);
+  EXPECT_EQ(critic_manager.getCriticName(0), "critic_manager.ConstraintCritic");
+
+  // Built-in critics are created without pluginlib, others are left to it
+  for (const auto & name : critics::builtinCriticNames()) {
+    EXPECT_NE(critics::createBuiltinCritic(name), nullptr) << name;
+  }
+  EXPECT_EQ(critics::builtinCriticNames().size(), 9u);
+  EXPECT_EQ(critics::createBuiltinCritic("UnknownCritic"), nullptr);
+}
+
+TEST(CriticManagerTests, CriticOrderTest)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  node->declare_parameter(
+    "critic_manager.critics",
+    rclcpp::ParameterValue(
+      std::vector<std::string>{"ConstraintCritic", "PreferForwardCritic", "GoalCritic"}));
+  node->declare_parameter(
+    "critic_manager.critic_order",
+    rclcpp::ParameterValue(std::vector<std::string>{"GoalCritic", "UnknownCritic"}));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State state;
+  costmap_ros->on_configure(state);
+
+  // Ordered critics go first, unknown ones are ignored and the rest keep their order
+  CriticManagerWrapperEnum critic_manager;
+  critic_manager.on_configure(node, "critic_manager", costmap_ros, &param_handler);
+  ASSERT_EQ(critic_manager.getCriticNum(), 3u);
+  EXPECT_EQ(critic_manager.getCriticName(0), "critic_manager.GoalCritic");
+  EXPECT_EQ(critic_manager.getCriticName(1), "critic_manager.ConstraintCritic");
+  EXPECT_EQ(critic_manager.getCriticName(2), "critic_manager.PreferForwardCritic");
+}
+
+TEST(CriticManagerTests, ParallelCriticsTest)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  node->declare_parameter("critic_manager.parallel_critics", rclcpp::ParameterValue(true));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+
+  CriticManagerWeightsWrapper critic_manager({1.0f, 2.0f, 3.0f, 4.0f});
+  critic_manager.on_configure(node, "critic_manager", costmap_ros, &param_handler);
+
+  models::State state;
+  models::Trajectories generated_trajectories;
+  generated_trajectories.reset(100, 10);
+  generated_trajectories.x = xt::random::rand<float>({100, 10}, 0.0, 2.0);
+  models::Path path;
+  path.reset(20);
+  models::BatchTensor<1> costs = xt::zeros<float>({100});
+  models::BatchTensor<1> sequential_costs = xt::zeros<float>({100});
+  float model_dt = 0.1;
+
+  // Without a pool critics run sequentially, with one they run concurrently
+  ThreadPool thread_pool;
+  thread_pool.initialize(3);
+  CriticData sequential_data =
+  {state, generated_trajectories, path, sequential_costs, model_dt, false, nullptr, nullptr,
+    std::nullopt, std::nullopt};
+  CriticData data =
+  {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr,
+    std::nullopt, std::nullopt, &thread_pool};
+
+  sequential_data.furthest_reached_path_point = 0;
+  critic_manager.evalTrajectoriesScores(sequential_data);
+  for (unsigned int i = 0; i != 2; i++) {
+    costs.fill(0.0f);
+    data.furthest_reached_path_point.reset();
+    data.path_pts_valid.reset();
+    EXPECT_NO_THROW(critic_manager.evalTrajectoriesScores(data));
+    EXPECT_TRUE(data.furthest_reached_path_point.has_value());
+    EXPECT_TRUE(data.path_pts_valid.has_value());
+    EXPECT_FALSE(data.fail_flag);
+    EXPECT_TRUE(xt::allclose(costs, sequential_costs));
+  }
+
+  // Any critic failing fails the whole evaluation
+  CriticManagerWeightsWrapper failing_manager({1.0f, -1.0f});
+  failing_manager.on_configure(node, "critic_manager", costmap_ros, &param_handler);
+  failing_manager.evalTrajectoriesScores(data);
+  EXPECT_TRUE(data.fail_flag);
+  thread_pool.shutdown();
+}
+
+TEST(CriticManagerTests, ParallelCriticsDataTest)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  node->declare_parameter("critic_manager.parallel_critics", rclcpp::ParameterValue(true));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+
+  CriticManagerRecordingWrapper critic_manager;
+  critic_manager.on_configure(node, "critic_manager", costmap_ros, &param_handler);
+
+  models::State state;
+  models::Trajectories generated_trajectories;
+  generated_trajectories.reset(10, 5);
+  models::Path path;
+  path.reset(5);
+  models::BatchTensor<1> costs = xt::zeros<float>({10});
+  float model_dt = 0.1;
+  ThreadPool thread_pool;
+  thread_pool.initialize(2);
+  CriticData data =
+  {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr,
+    std::nullopt, std::nullopt, &thread_pool};
+
+  // Critics scored concurrently read the cycle's settings and snapshot, the path
+  // validity being computed from the snapshot too
+  data.fast_math = true;
+  nav2_costmap_2d::Costmap2D costmap(
+    20, 20, 0.1, -1.0, -1.0, nav2_costmap_2d::LETHAL_OBSTACLE);
+  CostmapSnapshot snapshot;
+  snapshot.update(costmap, false);
+  data.costmap_snapshot = &snapshot;
+  critic_manager.evalTrajectoriesScores(data);
+  ASSERT_TRUE(data.path_pts_valid.has_value());
+  EXPECT_FALSE((*data.path_pts_valid)[0]);
+  for (size_t i = 0; i != 2; i++) {
+    EXPECT_EQ(critic_manager.getCritic(i).costmap_snapshot_, &snapshot);
+    EXPECT_TRUE(critic_manager.getCritic(i).fast_math_);
+  }
+  thread_pool.shutdown();
+}
+
+TEST(CriticManagerTests, CriticStagesTest)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  node->declare_parameter(
+    "critic_manager.WeightCritic0.stage", rclcpp::ParameterValue(std::string("screen")));
+  node->declare_parameter(
+    "critic_manager.WeightCritic2.stage", rclcpp::ParameterValue(std::string("both")));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+
+  CriticManagerStagesWrapper critic_manager({1.0f, 10.0f, 100.0f});
+  critic_manager.on_configure(node, "critic_manager", costmap_ros, &param_handler);
+
+  models::State state;
+  models::Trajectories generated_trajectories;
+  generated_trajectories.reset(10, 5);
+  generated_trajectories.x = xt::ones<float>({10, 5});
+  models::Path path;
+  models::BatchTensor<1> costs = xt::zeros<float>({10});
+  float model_dt = 0.1;
+  CriticData data =
+  {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr,
+    std::nullopt, std::nullopt};
+
+  // Critics refine by default, and all of them score outside of two-stage sampling
+  critic_manager.evalTrajectoriesScores(data, CriticStage::Screening);
+  EXPECT_NEAR(costs(0), 101.0f, 1e-4);
+  costs.fill(0.0f);
+  critic_manager.evalTrajectoriesScores(data, CriticStage::Refinement);
+  EXPECT_NEAR(costs(0), 110.0f, 1e-4);
+  costs.fill(0.0f);
+  critic_manager.evalTrajectoriesScores(data);
+  EXPECT_NEAR(costs(0), 111.0f, 1e-4);
+
+  node->declare_parameter(
+    "critic_manager.WeightCritic1.stage", rclcpp::ParameterValue(std::string("always")));
+  CriticManagerStagesWrapper invalid_manager({1.0f, 10.0f});
+  EXPECT_THROW(
+    invalid_manager.on_configure(node, "critic_manager", costmap_ros, &param_handler),
+    std::runtime_error);
+}
+
+TEST(CriticManagerTests, EnabledCriticsTest)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  node->declare_parameter("critic_manager.WeightCritic1.enabled", rclcpp::ParameterValue(false));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+
+  CriticManagerStagesWrapper critic_manager({1.0f, 10.0f, 100.0f});
+  critic_manager.on_configure(node, "critic_manager", costmap_ros, &param_handler);
+  // Bound to the same parameters, as the critics of concurrent optimizers are
+  CriticManagerStagesWrapper other_manager({1.0f, 10.0f, 100.0f});
+  other_manager.on_configure(node, "critic_manager", costmap_ros, &param_handler);
+
+  models::State state;
+  models::Trajectories generated_trajectories;
+  generated_trajectories.reset(10, 5);
+  generated_trajectories.x = xt::ones<float>({10, 5});
+  models::Path path;
+  models::BatchTensor<1> costs = xt::zeros<float>({10});
+  float model_dt = 0.1;
+  CriticData data =
+  {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr,
+    std::nullopt, std::nullopt};
+
+  // Disabled critics do not score, until enabled again
+  critic_manager.evalTrajectoriesScores(data);
+  EXPECT_NEAR(costs(0), 101.0f, 1e-4);
+
+  param_handler.dynamicParamsCallback(
+    {rclcpp::Parameter("critic_manager.WeightCritic1.enabled", true),
+      rclcpp::Parameter("critic_manager.WeightCritic2.enabled", false)});
+  costs.fill(0.0f);
+  critic_manager.evalTrajectoriesScores(data);
+  EXPECT_NEAR(costs(0), 11.0f, 1e-4);
+  costs.fill(0.0f);
+  other_manager.evalTrajectoriesScores(data);
+  EXPECT_NEAR(costs(0), 11.0f, 1e-4);
 }
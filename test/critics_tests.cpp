@@ -12,8 +12,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <chrono>
+#include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "rclcpp/rclcpp.hpp"
@@ -53,7 +57,7 @@ TEST(CriticTests, ConstraintsCritic)
   models::ControlSequence control_sequence;
   models::Trajectories generated_trajectories;
   models::Path path;
-  xt::xtensor<float, 1> costs = xt::zeros<float>({1000});
+  models::BatchTensor<1> costs = xt::zeros<float>({1000});
   float model_dt = 0.1;
   CriticData data =
   {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr, std::nullopt,
@@ -126,7 +130,7 @@ TEST(CriticTests, GoalAngleCritic)
   models::Trajectories generated_trajectories;
   generated_trajectories.reset(1000, 30);
   models::Path path;
-  xt::xtensor<float, 1> costs = xt::zeros<float>({1000});
+  models::BatchTensor<1> costs = xt::zeros<float>({1000});
   float model_dt = 0.1;
   CriticData data =
   {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr, std::nullopt,
@@ -178,7 +182,7 @@ TEST(CriticTests, GoalCritic)
   models::Trajectories generated_trajectories;
   generated_trajectories.reset(1000, 30);
   models::Path path;
-  xt::xtensor<float, 1> costs = xt::zeros<float>({1000});
+  models::BatchTensor<1> costs = xt::zeros<float>({1000});
   float model_dt = 0.1;
   CriticData data =
   {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr, std::nullopt,
@@ -228,7 +232,7 @@ TEST(CriticTests, PathAngleCritic)
   models::Trajectories generated_trajectories;
   generated_trajectories.reset(1000, 30);
   models::Path path;
-  xt::xtensor<float, 1> costs = xt::zeros<float>({1000});
+  models::BatchTensor<1> costs = xt::zeros<float>({1000});
   float model_dt = 0.1;
   CriticData data =
   {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr, std::nullopt,
@@ -267,6 +271,17 @@ TEST(CriticTests, PathAngleCritic)
   critic.score(data);
   EXPECT_GT(xt::sum(costs, immediate)(), 0.0);
   EXPECT_NEAR(costs(0), 3.6315, 1e-2);  // atan2(4,-1) [1.81] * 2.0 weight
+
+  // Same angles from the stored trigonometry of the yaws, with either math
+  generated_trajectories.yaw_cos = xt::cos(generated_trajectories.yaws);
+  generated_trajectories.yaw_sin = xt::sin(generated_trajectories.yaws);
+  ASSERT_TRUE(generated_trajectories.hasYawTrig());
+  for (bool fast_math : {false, true}) {
+    data.fast_math = fast_math;
+    costs = xt::zeros<float>({1000});
+    critic.score(data);
+    EXPECT_NEAR(costs(0), 3.6315, 1e-2);
+  }
 }
 
 TEST(CriticTests, PreferForwardCritic)
@@ -285,7 +300,7 @@ TEST(CriticTests, PreferForwardCritic)
   models::Trajectories generated_trajectories;
   generated_trajectories.reset(1000, 30);
   models::Path path;
-  xt::xtensor<float, 1> costs = xt::zeros<float>({1000});
+  models::BatchTensor<1> costs = xt::zeros<float>({1000});
   float model_dt = 0.1;
   CriticData data =
   {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr, std::nullopt,
@@ -338,7 +353,7 @@ TEST(CriticTests, TwirlingCritic)
   models::Trajectories generated_trajectories;
   generated_trajectories.reset(1000, 30);
   models::Path path;
-  xt::xtensor<float, 1> costs = xt::zeros<float>({1000});
+  models::BatchTensor<1> costs = xt::zeros<float>({1000});
   float model_dt = 0.1;
   CriticData data =
   {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr, std::nullopt,
@@ -398,7 +413,7 @@ TEST(CriticTests, PathFollowCritic)
   models::Trajectories generated_trajectories;
   generated_trajectories.reset(1000, 30);
   models::Path path;
-  xt::xtensor<float, 1> costs = xt::zeros<float>({1000});
+  models::BatchTensor<1> costs = xt::zeros<float>({1000});
   float model_dt = 0.1;
   CriticData data =
   {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr, std::nullopt,
@@ -446,7 +461,7 @@ TEST(CriticTests, PathAlignCritic)
   models::Trajectories generated_trajectories;
   generated_trajectories.reset(1000, 30);
   models::Path path;
-  xt::xtensor<float, 1> costs = xt::zeros<float>({1000});
+  models::BatchTensor<1> costs = xt::zeros<float>({1000});
   float model_dt = 0.1;
   CriticData data =
   {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr, std::nullopt,
@@ -516,6 +531,14 @@ TEST(CriticTests, PathAlignCritic)
   // 0.04 * 1000 * 10 weight * 4 num pts eval / 4 normalization term
   EXPECT_NEAR(xt::sum(costs, immediate)(), 400.0, 1e-2);
 
+  // Trajectories marked in collision by an earlier critic are skipped
+  costs = xt::zeros<float>({1000});
+  data.dead_trajectories.assign(1000, 0);
+  std::fill(data.dead_trajectories.begin(), data.dead_trajectories.begin() + 500, 1);
+  critic.score(data);
+  EXPECT_NEAR(xt::sum(costs, immediate)(), 200.0, 1e-2);
+  data.dead_trajectories.clear();
+
   // provide state pose and path far enough to enable, with data to pass condition
   // but path is blocked in collision
   auto * costmap = costmap_ros->getCostmap();
@@ -533,3 +556,149 @@ TEST(CriticTests, PathAlignCritic)
   critic.score(data);
   EXPECT_NEAR(xt::sum(costs, immediate)(), 0.0, 1e-6);
 }
+
+TEST(CriticTests, FusedCriticsMatchIndividualScoring)
+{
+  // Standard preamble
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  // Goal critics considered far enough from the goal for the path critics to be active too
+  node->declare_parameter("goal.threshold_to_consider", rclcpp::ParameterValue(5.0));
+  node->declare_parameter("goal_angle.threshold_to_consider", rclcpp::ParameterValue(5.0));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+
+  models::State state;
+  state.reset(100, 30);
+  state.vx = xt::random::rand<float>({100, 30}, -0.6, 0.6);
+  state.vy = xt::random::rand<float>({100, 30}, -0.3, 0.3);
+  state.wz = xt::random::rand<float>({100, 30}, 0.1, 2.5);
+  models::Trajectories generated_trajectories;
+  generated_trajectories.reset(100, 30);
+  generated_trajectories.x = xt::random::rand<float>({100, 30}, -1.0, 1.0);
+  generated_trajectories.y = xt::random::rand<float>({100, 30}, -1.0, 1.0);
+  generated_trajectories.yaws = xt::random::rand<float>({100, 30}, -3.14, 3.14);
+
+  // Path behind the robot, so its points are beyond the path angle critic's max angle
+  models::Path path;
+  path.reset(10);
+  for (size_t i = 0; i != 10; i++) {
+    path.x(i) = -0.3 * (i + 1);
+    path.yaws(i) = 3.0;
+  }
+  models::BatchTensor<1> costs = xt::zeros<float>({100});
+  float model_dt = 0.1;
+  CriticData data =
+  {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr, std::nullopt,
+    std::nullopt};
+  data.furthest_reached_path_point = 2;
+
+  std::vector<std::unique_ptr<CriticFunction>> critics;
+  critics.push_back(std::make_unique<GoalCritic>());
+  critics.push_back(std::make_unique<GoalAngleCritic>());
+  critics.push_back(std::make_unique<PathAngleCritic>());
+  critics.push_back(std::make_unique<TwirlingCritic>());
+  critics.push_back(std::make_unique<PreferForwardCritic>());
+  critics.push_back(std::make_unique<ConstraintCritic>());
+  const std::vector<std::string> names =
+  {"goal", "goal_angle", "path_angle", "twirling", "prefer_forward", "constraint"};
+  for (size_t q = 0; q != critics.size(); q++) {
+    critics[q]->on_configure(node, "mppi", names[q], costmap_ros, &param_handler);
+  }
+
+  // One fused sweep scores the same as each critic on its own, for both kinds of models
+  std::vector<std::shared_ptr<MotionModel>> models = {
+    std::make_shared<DiffDriveMotionModel>(),
+    std::make_shared<OmniMotionModel>(),
+    std::make_shared<AckermannMotionModel>(&param_handler)};
+  for (auto & model : models) {
+    data.motion_model = model;
+    costs = xt::zeros<float>({100});
+    for (auto & critic : critics) {
+      critic->score(data);
+    }
+    xt::xtensor<float, 1> individual_costs = costs;
+
+    costs = xt::zeros<float>({100});
+    FusedScorer scorer;
+    for (auto & critic : critics) {
+      EXPECT_TRUE(critic->addFusedTerm(data, scorer));
+    }
+    EXPECT_EQ(scorer.size(), 6u);
+    scorer.score(data);
+
+    EXPECT_GT(xt::sum(individual_costs, immediate)(), 0.0);
+    for (size_t i = 0; i != 100; i++) {
+      EXPECT_NEAR(costs(i), individual_costs(i), 1e-3 * std::max(1.0f, individual_costs(i)));
+    }
+  }
+}
+
+TEST(CriticTests, ObstaclesCriticClearanceSkipping)
+{
+  // Standard preamble
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  for (const std::string name : {"obstacles", "obstacles_skipping"}) {
+    node->declare_parameter(name + ".use_distance_field", rclcpp::ParameterValue(true));
+    node->declare_parameter(name + ".consider_footprint", rclcpp::ParameterValue(true));
+  }
+  node->declare_parameter("obstacles_skipping.clearance_skipping", rclcpp::ParameterValue(true));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+  auto costmap = costmap_ros->getCostmap();
+  costmap->resizeMap(100, 100, 0.05, -2.5, -2.5);
+  for (unsigned int x = 60; x != 64; x++) {
+    for (unsigned int y = 20; y != 80; y++) {
+      costmap->setCost(x, y, nav2_costmap_2d::LETHAL_OBSTACLE);
+    }
+  }
+
+  // Trajectories integrated from their velocities, which bound their steps
+  const size_t batch = 200, steps = 50;
+  const float dt = 0.1;
+  models::State state;
+  state.reset(batch, steps);
+  state.vx = xt::random::rand<float>({batch, steps}, -0.2, 0.6);
+  state.wz = xt::random::rand<float>({batch, steps}, -1.0, 1.0);
+  models::Trajectories generated_trajectories;
+  generated_trajectories.reset(batch, steps);
+  for (size_t i = 0; i != batch; i++) {
+    float x = 0.0f, y = 0.0f, yaw = (i % 16) * 0.4f;
+    for (size_t j = 0; j != steps; j++) {
+      yaw += state.wz(i, j) * dt;
+      x += state.vx(i, j) * std::cos(yaw) * dt;
+      y += state.vx(i, j) * std::sin(yaw) * dt;
+      generated_trajectories.x(i, j) = x;
+      generated_trajectories.y(i, j) = y;
+      generated_trajectories.yaws(i, j) = yaw;
+    }
+  }
+  models::Path path;
+  path.reset(1);
+  path.x(0) = 10.0;
+  models::BatchTensor<1> costs = xt::zeros<float>({batch});
+  float model_dt = dt;
+  CriticData data =
+  {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr, std::nullopt,
+    std::nullopt};
+  data.motion_model = std::make_shared<DiffDriveMotionModel>();
+
+  ObstaclesCritic critic, skipping_critic;
+  critic.on_configure(node, "mppi", "obstacles", costmap_ros, &param_handler);
+  skipping_critic.on_configure(node, "mppi", "obstacles_skipping", costmap_ros, &param_handler);
+
+  // Skipping the points which cannot leave free space leaves the scores unchanged
+  critic.score(data);
+  xt::xtensor<float, 1> expected_costs = costs;
+  costs = xt::zeros<float>({batch});
+  skipping_critic.score(data);
+  EXPECT_GT(xt::amax(expected_costs, immediate)(), 0.0f);
+  for (size_t i = 0; i != batch; i++) {
+    EXPECT_EQ(costs(i), expected_costs(i));
+  }
+}
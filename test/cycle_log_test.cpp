@@ -0,0 +1,114 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "mppic/tools/cycle_log.hpp"
+
+// Tests recording controller cycles and reading them back
+
+using namespace mppi;  // NOLINT
+
+TEST(CycleLogTest, RoundTrip)
+{
+  const std::string file_path = "cycle_log_test.bin";
+  nav2_costmap_2d::Costmap2D costmap(50, 40, 0.05, 1.0, 2.0, nav2_costmap_2d::FREE_SPACE);
+  costmap.setCost(3, 4, nav2_costmap_2d::LETHAL_OBSTACLE);
+
+  geometry_msgs::msg::PoseStamped pose;
+  pose.header.frame_id = "odom";
+  pose.header.stamp.sec = 12;
+  pose.pose.position.x = 1.5;
+  pose.pose.orientation.w = 1.0;
+  geometry_msgs::msg::Twist speed, cmd;
+  speed.linear.x = 0.3;
+  cmd.linear.x = 0.4;
+  cmd.angular.z = -0.2;
+  models::Path plan;
+  plan.reset(7);
+  plan.x(6) = 3.0f;
+  plan.yaws(2) = 0.5f;
+  geometry_msgs::msg::Point corner;
+  corner.x = 0.2;
+  corner.y = -0.1;
+
+  CycleRecorder recorder;
+  recorder.open(file_path, 1234);
+  EXPECT_TRUE(recorder.isOpen());
+  recorder.capture(pose, speed, plan, nullptr, costmap, {corner});
+  recorder.write(cmd, false, 1500);
+
+  // Only the changed cell is stored from then on
+  costmap.setCost(10, 20, 100);
+  pose.pose.position.x = 1.6;
+  recorder.capture(pose, speed, plan, nullptr, costmap, {corner});
+  recorder.write(cmd, true, 2500);
+  recorder.close();
+
+  CycleLogReader reader(file_path);
+  EXPECT_EQ(reader.getNoiseSeed(), 1234);
+
+  RecordedCycle cycle;
+  ASSERT_TRUE(reader.next(cycle));
+  EXPECT_TRUE(cycle.full_costmap);
+  EXPECT_FALSE(cycle.failed);
+  EXPECT_FALSE(cycle.has_goal_checker);
+  EXPECT_EQ(cycle.latency_ns, 1500);
+  EXPECT_EQ(cycle.robot_pose.header.frame_id, "odom");
+  EXPECT_EQ(cycle.robot_pose.header.stamp.sec, 12);
+  EXPECT_DOUBLE_EQ(cycle.robot_pose.pose.position.x, 1.5);
+  EXPECT_DOUBLE_EQ(cycle.robot_speed.linear.x, 0.3);
+  ASSERT_EQ(cycle.plan.x.size(), 7u);
+  EXPECT_FLOAT_EQ(cycle.plan.x(6), 3.0f);
+  EXPECT_FLOAT_EQ(cycle.plan.yaws(2), 0.5f);
+  ASSERT_EQ(cycle.footprint.size(), 1u);
+  EXPECT_DOUBLE_EQ(cycle.footprint[0].y, -0.1);
+  EXPECT_DOUBLE_EQ(cycle.cmd.angular.z, -0.2);
+
+  nav2_costmap_2d::Costmap2D replayed;
+  CycleLogReader::applyCostmap(cycle, replayed);
+  EXPECT_EQ(replayed.getSizeInCellsX(), 50u);
+  EXPECT_DOUBLE_EQ(replayed.getOriginY(), 2.0);
+  EXPECT_EQ(replayed.getCost(3, 4), nav2_costmap_2d::LETHAL_OBSTACLE);
+
+  ASSERT_TRUE(reader.next(cycle));
+  EXPECT_FALSE(cycle.full_costmap);
+  EXPECT_TRUE(cycle.failed);
+  EXPECT_EQ(cycle.changed_cells.size(), 1u);
+  EXPECT_DOUBLE_EQ(cycle.robot_pose.pose.position.x, 1.6);
+  EXPECT_DOUBLE_EQ(cycle.cmd.linear.x, 0.0);
+  CycleLogReader::applyCostmap(cycle, replayed);
+  EXPECT_EQ(replayed.getCost(10, 20), 100);
+  EXPECT_EQ(replayed.getCost(3, 4), nav2_costmap_2d::LETHAL_OBSTACLE);
+
+  EXPECT_FALSE(reader.next(cycle));
+  std::remove(file_path.c_str());
+}
+
+TEST(CycleLogTest, RejectsOtherFiles)
+{
+  const std::string file_path = "cycle_log_test_other.bin";
+  {
+    std::ofstream file(file_path);
+    file << "not a cycle log";
+  }
+  EXPECT_THROW(CycleLogReader{file_path}, std::runtime_error);
+  EXPECT_THROW(CycleLogReader{"missing_cycle_log.bin"}, std::runtime_error);
+  std::remove(file_path.c_str());
+}
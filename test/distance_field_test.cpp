@@ -0,0 +1,84 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "mppic/tools/distance_field.hpp"
+
+// Tests the obstacle distance field
+
+using namespace mppi;  // NOLINT
+
+TEST(DistanceFieldTest, MatchesBruteForce)
+{
+  nav2_costmap_2d::Costmap2D costmap(60, 40, 0.05, 1.0, 2.0, nav2_costmap_2d::FREE_SPACE);
+  std::vector<std::pair<unsigned int, unsigned int>> obstacles =
+  {{3, 4}, {30, 20}, {59, 39}, {10, 35}, {45, 2}};
+  for (auto & obstacle : obstacles) {
+    costmap.setCost(obstacle.first, obstacle.second, nav2_costmap_2d::LETHAL_OBSTACLE);
+  }
+  // Inflated cells are not obstacles
+  costmap.setCost(20, 20, nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE);
+
+  DistanceField field;
+  EXPECT_TRUE(field.update(costmap, true));
+
+  for (unsigned int y = 0; y != 40; y++) {
+    for (unsigned int x = 0; x != 60; x++) {
+      float expected = std::numeric_limits<float>::max();
+      for (auto & obstacle : obstacles) {
+        const float dx = static_cast<float>(obstacle.first) - x;
+        const float dy = static_cast<float>(obstacle.second) - y;
+        expected = std::min(expected, std::hypot(dx, dy) * 0.05f);
+      }
+      EXPECT_NEAR(field.distanceAtCell(x, y), expected, 1e-4);
+    }
+  }
+
+  // World queries land in the containing cell, outside is unknown space
+  EXPECT_EQ(field.distance(1.0 + 3 * 0.05 + 0.01, 2.0 + 4 * 0.05 + 0.01), 0.0f);
+  EXPECT_NEAR(field.distance(1.0 + 5 * 0.05 + 0.01, 2.0 + 4 * 0.05 + 0.01), 0.1f, 1e-4);
+  EXPECT_GT(field.distance(-5.0, 0.0), 1e6f);
+}
+
+TEST(DistanceFieldTest, UpdatesOnlyOnChange)
+{
+  nav2_costmap_2d::Costmap2D costmap(20, 20, 0.1, 0.0, 0.0, nav2_costmap_2d::FREE_SPACE);
+  costmap.setCost(5, 5, nav2_costmap_2d::LETHAL_OBSTACLE);
+
+  DistanceField field;
+  EXPECT_TRUE(field.update(costmap, true));
+  EXPECT_FALSE(field.update(costmap, true));
+  EXPECT_EQ(field.getUpdateCount(), 1u);
+  EXPECT_NEAR(field.distanceAtCell(5, 8), 0.3f, 1e-5);
+
+  // Unknown space is an obstacle when not tracked, as is space outside of the map
+  costmap.setCost(5, 9, nav2_costmap_2d::NO_INFORMATION);
+  EXPECT_TRUE(field.update(costmap, true));
+  EXPECT_NEAR(field.distanceAtCell(5, 8), 0.3f, 1e-5);
+  EXPECT_TRUE(field.update(costmap, false));
+  EXPECT_NEAR(field.distanceAtCell(5, 8), 0.1f, 1e-5);
+  EXPECT_EQ(field.distance(-1.0, 0.5), 0.0f);
+
+  // Moving the map origin, as a rolling costmap does, rebuilds the field
+  costmap.updateOrigin(0.5, 0.0);
+  EXPECT_TRUE(field.update(costmap, false));
+  EXPECT_EQ(field.getUpdateCount(), 4u);
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mppic/tools/fast_math.hpp"
+
+// Tests the float-only math kernels against the double precision std versions
+
+using namespace mppi;  // NOLINT
+
+namespace
+{
+
+constexpr float tolerance = 1e-6f;
+
+// Odd size so the array kernels run both their SIMD body and scalar tail
+std::vector<float> randomValues(float range, size_t size = 100003)
+{
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> distribution(-range, range);
+  std::vector<float> values(size);
+  for (auto & value : values) {
+    value = distribution(generator);
+  }
+  return values;
+}
+
+double angleError(double lhs, double rhs)
+{
+  return std::fabs(std::remainder(lhs - rhs, 2.0 * M_PI));
+}
+
+}  // namespace
+
+TEST(FastMathTest, WrapAngle)
+{
+  const auto angles = randomValues(1e3f);
+  std::vector<float> wrapped(angles.size());
+  fast_math::wrapAngles(angles.data(), wrapped.data(), angles.size());
+
+  for (size_t i = 0; i != angles.size(); i++) {
+    EXPECT_LE(std::fabs(wrapped[i]), static_cast<float>(M_PI) + tolerance);
+    EXPECT_LE(angleError(wrapped[i], angles[i]), tolerance);
+    EXPECT_NEAR(wrapped[i], fast_math::wrapAngle(angles[i]), tolerance);
+  }
+
+  EXPECT_NEAR(fast_math::wrapAngle(0.0f), 0.0f, tolerance);
+  EXPECT_NEAR(fast_math::wrapAngle(3.0f * static_cast<float>(M_PI_2)), -M_PI_2, tolerance);
+  EXPECT_NEAR(fast_math::shortestAngularDistance(3.0f, -3.0f), 2.0 * M_PI - 6.0, tolerance);
+}
+
+TEST(FastMathTest, SinCos)
+{
+  const auto angles = randomValues(1e3f);
+  std::vector<float> sin(angles.size()), cos(angles.size());
+  fast_math::sincos(angles.data(), sin.data(), cos.data(), angles.size());
+
+  for (size_t i = 0; i != angles.size(); i++) {
+    EXPECT_NEAR(sin[i], std::sin(static_cast<double>(angles[i])), tolerance);
+    EXPECT_NEAR(cos[i], std::cos(static_cast<double>(angles[i])), tolerance);
+    EXPECT_NEAR(sin[i], fast_math::sin(angles[i]), tolerance);
+    EXPECT_NEAR(cos[i], fast_math::cos(angles[i]), tolerance);
+  }
+
+  // Quadrant boundaries
+  for (int q = -8; q <= 8; q++) {
+    const float angle = q * static_cast<float>(M_PI_2);
+    EXPECT_NEAR(fast_math::sin(angle), std::sin(static_cast<double>(angle)), tolerance);
+    EXPECT_NEAR(fast_math::cos(angle), std::cos(static_cast<double>(angle)), tolerance);
+  }
+}
+
+TEST(FastMathTest, Atan2)
+{
+  auto y = randomValues(10.0f);
+  auto x = randomValues(10.0f);
+  // Near axis vectors, where the octant selection matters the most
+  for (size_t i = 0; i < y.size(); i += 7) {
+    y[i] *= 1e-4f;
+  }
+  for (size_t i = 3; i < x.size(); i += 7) {
+    x[i] *= 1e-4f;
+  }
+
+  std::vector<float> angles(y.size());
+  fast_math::atan2(y.data(), x.data(), angles.data(), y.size());
+  for (size_t i = 0; i != y.size(); i++) {
+    const double expected = std::atan2(static_cast<double>(y[i]), static_cast<double>(x[i]));
+    EXPECT_NEAR(angles[i], expected, tolerance);
+    EXPECT_NEAR(angles[i], fast_math::atan2(y[i], x[i]), tolerance);
+  }
+
+  EXPECT_EQ(fast_math::atan2(0.0f, 0.0f), 0.0f);
+  EXPECT_NEAR(fast_math::atan2(0.0f, -1.0f), M_PI, tolerance);
+  EXPECT_NEAR(fast_math::atan2(1.0f, 0.0f), M_PI_2, tolerance);
+  EXPECT_NEAR(fast_math::atan2(-1.0f, 0.0f), -M_PI_2, tolerance);
+  EXPECT_NEAR(fast_math::atan2(-1.0f, -1.0f), -3.0 * M_PI_4, tolerance);
+}
+
+TEST(FastMathTest, InPlace)
+{
+  auto angles = randomValues(50.0f, 37);
+  const auto expected = angles;
+  fast_math::wrapAngles(angles.data(), angles.data(), angles.size());
+  for (size_t i = 0; i != angles.size(); i++) {
+    EXPECT_NEAR(angles[i], fast_math::wrapAngle(expected[i]), tolerance);
+  }
+
+  auto x = randomValues(5.0f, 37);
+  auto y = angles;
+  fast_math::atan2(y.data(), x.data(), y.data(), y.size());
+  for (size_t i = 0; i != y.size(); i++) {
+    EXPECT_NEAR(y[i], fast_math::atan2(angles[i], x[i]), tolerance);
+  }
+}
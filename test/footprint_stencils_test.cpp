@@ -0,0 +1,114 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "nav2_costmap_2d/footprint_collision_checker.hpp"
+#include "mppic/tools/footprint_stencils.hpp"
+
+// Tests the rotated footprint stencils
+
+using namespace mppi;  // NOLINT
+
+namespace
+{
+
+std::vector<geometry_msgs::msg::Point> makeFootprint()
+{
+  std::vector<geometry_msgs::msg::Point> footprint(5);
+  const double vertices[5][2] = {{0.33, 0.27}, {-0.21, 0.31}, {-0.29, -0.02}, {-0.18, -0.26},
+    {0.37, -0.23}};
+  for (size_t i = 0; i != footprint.size(); i++) {
+    footprint[i].x = vertices[i][0];
+    footprint[i].y = vertices[i][1];
+  }
+  return footprint;
+}
+
+}  // namespace
+
+TEST(FootprintStencilsTest, MatchesCollisionChecker)
+{
+  nav2_costmap_2d::Costmap2D costmap(80, 70, 0.05, 1.0, 2.0, nav2_costmap_2d::FREE_SPACE);
+  std::mt19937 engine(7);
+  std::uniform_int_distribution<int> cost_dist(0, 252);
+  for (unsigned int y = 0; y != 70; y++) {
+    for (unsigned int x = 0; x != 80; x++) {
+      costmap.setCost(x, y, static_cast<unsigned char>(cost_dist(engine)));
+    }
+  }
+  for (unsigned int x = 30; x != 34; x++) {
+    costmap.setCost(x, 40, nav2_costmap_2d::LETHAL_OBSTACLE);
+  }
+
+  const auto footprint = makeFootprint();
+  FootprintStencils stencils;
+  EXPECT_TRUE(stencils.update(footprint, costmap));
+  EXPECT_FALSE(stencils.update(footprint, costmap));
+  const size_t bins = stencils.getBinCount();
+  EXPECT_GE(bins, 8u);
+
+  nav2_costmap_2d::FootprintCollisionChecker<nav2_costmap_2d::Costmap2D *> checker(&costmap);
+  std::uniform_int_distribution<unsigned int> x_dist(10, 69), y_dist(10, 59);
+  for (size_t i = 0; i != 500; i++) {
+    // Poses at cell centers and bin yaws, whose outlines are exactly the stencils'
+    const unsigned int mx = x_dist(engine);
+    const unsigned int my = y_dist(engine);
+    const size_t bin = i % bins;
+    const float x = 1.0 + (mx + 0.5) * 0.05;
+    const float y = 2.0 + (my + 0.5) * 0.05;
+    const float theta = 2.0 * M_PI * bin / bins - (i % 3 == 0 ? 2.0 * M_PI : 0.0);
+
+    float cost = -1.0f;
+    ASSERT_TRUE(stencils.footprintCost(costmap, x, y, theta, cost));
+    EXPECT_EQ(cost, checker.footprintCostAtPose(x, y, theta, footprint));
+  }
+}
+
+TEST(FootprintStencilsTest, FallsBackNearEdges)
+{
+  nav2_costmap_2d::Costmap2D costmap(40, 40, 0.05, 0.0, 0.0, nav2_costmap_2d::FREE_SPACE);
+  for (unsigned int y = 27; y != 30; y++) {
+    for (unsigned int x = 19; x != 22; x++) {
+      costmap.setCost(x, y, nav2_costmap_2d::LETHAL_OBSTACLE);
+    }
+  }
+  FootprintStencils stencils;
+  float cost = -1.0f;
+  EXPECT_FALSE(stencils.footprintCost(costmap, 1.0, 1.0, 0.0, cost));
+
+  EXPECT_TRUE(stencils.update(makeFootprint(), costmap));
+  // The obstacle is ahead of the robot's front edge, which a quarter turn brings onto it
+  EXPECT_TRUE(stencils.footprintCost(costmap, 1.025, 1.025, 0.0, cost));
+  EXPECT_EQ(cost, nav2_costmap_2d::FREE_SPACE);
+  EXPECT_TRUE(stencils.footprintCost(costmap, 1.025, 1.025, M_PI_2, cost));
+  EXPECT_EQ(cost, nav2_costmap_2d::LETHAL_OBSTACLE);
+
+  // Outlines which may leave the map are left to the exact check
+  EXPECT_FALSE(stencils.footprintCost(costmap, 0.1, 1.0, 0.0, cost));
+  EXPECT_FALSE(stencils.footprintCost(costmap, 1.0, 1.95, 0.0, cost));
+  EXPECT_FALSE(stencils.footprintCost(costmap, -1.0, 1.0, 0.0, cost));
+
+  // A new footprint or costmap geometry rebuilds the stencils
+  auto footprint = makeFootprint();
+  footprint[0].x = 0.5;
+  EXPECT_TRUE(stencils.update(footprint, costmap));
+  costmap.resizeMap(50, 40, 0.05, 0.0, 0.0);
+  EXPECT_TRUE(stencils.update(footprint, costmap));
+  EXPECT_FALSE(stencils.update(footprint, costmap));
+}
@@ -0,0 +1,220 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mppic/tools/kernels.hpp"
+
+// Tests every kernel set available on this CPU against the baseline one
+
+using namespace mppi;  // NOLINT
+
+namespace
+{
+
+// Odd sizes so the kernels leave a remainder to the baseline code
+std::vector<float> randomValues(float low, float high, size_t size)
+{
+  static std::mt19937 generator(42);
+  std::uniform_real_distribution<float> distribution(low, high);
+  std::vector<float> values(size);
+  for (auto & value : values) {
+    value = distribution(generator);
+  }
+  return values;
+}
+
+}  // namespace
+
+TEST(KernelsTest, Selection)
+{
+  const auto names = kernels::availableKernels();
+  ASSERT_FALSE(names.empty());
+  EXPECT_EQ(names.back(), "baseline");
+  EXPECT_EQ(std::string(kernels::selectKernels("auto").name), names.front());
+  for (const auto & name : names) {
+    EXPECT_EQ(std::string(kernels::selectKernels(name).name), name);
+  }
+  EXPECT_EQ(&kernels::selectKernels("baseline"), &kernels::baselineKernels());
+  EXPECT_THROW(kernels::selectKernels("sse1"), std::runtime_error);
+}
+
+TEST(KernelsTest, Integrate)
+{
+  const size_t batch_size = 37, time_steps = 23;
+  const auto vx = randomValues(-0.5f, 0.5f, batch_size * time_steps);
+  const auto vy = randomValues(-0.5f, 0.5f, batch_size * time_steps);
+  const auto wz = randomValues(-1.0f, 1.0f, batch_size * time_steps);
+
+  for (bool holonomic : {false, true}) {
+    for (bool fast_math : {false, true}) {
+      for (bool yaw_trig : {false, true}) {
+        auto rollout = [&](const kernels::KernelSet & kernel_set) {
+            std::vector<float> out(5 * batch_size * time_steps, 0.0f);
+            const size_t n = batch_size * time_steps;
+            kernels::RolloutView view{vx.data(), vy.data(), wz.data(), out.data(),
+              out.data() + n, out.data() + 2 * n, yaw_trig ? out.data() + 3 * n : nullptr,
+              yaw_trig ? out.data() + 4 * n : nullptr, time_steps, 1.0f, -2.0f, 0.5f,
+              std::cos(0.5f), std::sin(0.5f), 0.1f, nullptr};
+            kernels::integrate(kernel_set, view, 0, batch_size, holonomic, fast_math);
+            return out;
+          };
+
+        const auto reference = rollout(kernels::baselineKernels());
+        for (const auto & name : kernels::availableKernels()) {
+          const auto result = rollout(kernels::selectKernels(name));
+          for (size_t i = 0; i != result.size(); i++) {
+            EXPECT_NEAR(result[i], reference[i], 1e-4f) << name << " at " << i;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(KernelsTest, GatherCosts)
+{
+  const unsigned int size_x = 40, size_y = 30;
+  std::vector<unsigned char> char_map(size_x * size_y);
+  for (size_t i = 0; i != char_map.size(); i++) {
+    char_map[i] = static_cast<unsigned char>((i * 7) % 256);
+  }
+  const kernels::CostmapView costmap{
+    char_map.data(), size_x, size_y, -1.0f, 2.0f, 0.1f, 255.0f};
+
+  const size_t size = 1001;
+  auto x = randomValues(-2.0f, 4.0f, size);
+  auto y = randomValues(1.0f, 6.0f, size);
+  x[3] = std::numeric_limits<float>::quiet_NaN();
+
+  std::vector<float> reference(size);
+  for (size_t i = 0; i != size; i++) {
+    const float fx = (x[i] - costmap.origin_x) / costmap.resolution;
+    const float fy = (y[i] - costmap.origin_y) / costmap.resolution;
+    const bool in_bounds = fx >= 0.0f && fy >= 0.0f && fx < size_x && fy < size_y;
+    reference[i] = in_bounds ?
+      char_map[static_cast<size_t>(fy) * size_x + static_cast<size_t>(fx)] : 255.0f;
+  }
+
+  for (const auto & name : kernels::availableKernels()) {
+    std::vector<float> costs(size, -1.0f);
+    kernels::gatherCosts(
+      kernels::selectKernels(name), costmap, x.data(), y.data(), costs.data(), size);
+    EXPECT_EQ(costs, reference) << name;
+  }
+}
+
+TEST(KernelsTest, BoxMullerAndWeightedSum)
+{
+  const size_t size = 203;
+  const auto u1 = randomValues(1e-6f, 1.0f, size);
+  const auto u2 = randomValues(0.0f, 1.0f, size);
+  const auto values = randomValues(-1.0f, 1.0f, size);
+
+  for (const auto & name : kernels::availableKernels()) {
+    const auto & kernel_set = kernels::selectKernels(name);
+
+    std::vector<float> cos_out(size), sin_out(size);
+    kernels::boxMuller(
+      kernel_set, u1.data(), u2.data(), cos_out.data(), sin_out.data(), size, 0.5f);
+    for (size_t i = 0; i != size; i++) {
+      const float radius = std::sqrt(-2.0f * std::log(u1[i])) * 0.5f;
+      const float angle = static_cast<float>(2.0 * M_PI) * u2[i];
+      EXPECT_NEAR(cos_out[i], radius * std::cos(angle), 1e-4f) << name;
+      EXPECT_NEAR(sin_out[i], radius * std::sin(angle), 1e-4f) << name;
+    }
+
+    std::vector<float> sum(size, 1.0f), sq_sum(size, 2.0f), sum_only(size, 1.0f);
+    kernels::weightedSum(kernel_set, 0.25f, values.data(), sum.data(), sq_sum.data(), size);
+    kernels::weightedSum(kernel_set, 0.25f, values.data(), sum_only.data(), nullptr, size);
+    for (size_t i = 0; i != size; i++) {
+      EXPECT_NEAR(sum[i], 1.0f + 0.25f * values[i], 1e-6f) << name;
+      EXPECT_NEAR(sq_sum[i], 2.0f + 0.25f * values[i] * values[i], 1e-6f) << name;
+      EXPECT_NEAR(sum_only[i], sum[i], 1e-6f) << name;
+    }
+  }
+}
+
+TEST(KernelsTest, LimitTurningRate)
+{
+  const size_t size = 203;
+  auto vx = randomValues(-0.5f, 0.5f, size);
+  const auto wz = randomValues(-2.0f, 2.0f, size);
+  vx[0] = 0.0f;
+
+  for (const auto & name : kernels::availableKernels()) {
+    auto limited = wz;
+    kernels::limitTurningRate(kernels::selectKernels(name), vx.data(), limited.data(), size, 0.4f);
+    EXPECT_EQ(limited[0], 0.0f) << name;
+    for (size_t i = 0; i != size; i++) {
+      const float max_wz = std::fabs(vx[i]) / 0.4f;
+      EXPECT_NEAR(limited[i], std::min(std::max(wz[i], -max_wz), max_wz), 1e-6f) << name;
+    }
+
+    // Without a turning radius, nothing is constrained
+    limited = wz;
+    kernels::limitTurningRate(kernels::selectKernels(name), vx.data(), limited.data(), size, 0.0f);
+    EXPECT_EQ(limited, wz) << name;
+  }
+}
+
+TEST(KernelsTest, LimitAcceleration)
+{
+  const size_t batch_size = 37, time_steps = 23;
+  const size_t n = batch_size * time_steps;
+  const auto cvx = randomValues(-0.5f, 0.5f, n);
+  const auto cvy = randomValues(-0.5f, 0.5f, n);
+  const auto cwz = randomValues(-1.0f, 1.0f, n);
+  const auto initial = randomValues(-0.5f, 0.5f, 3 * n);
+  const auto model_dts = randomValues(0.05f, 0.1f, time_steps);
+
+  for (bool holonomic : {false, true}) {
+    auto predict = [&](const kernels::KernelSet & kernel_set) {
+        auto out = initial;
+        const kernels::DynamicsView view{cvx.data(), cvy.data(), cwz.data(), out.data(),
+          out.data() + n, out.data() + 2 * n, time_steps, model_dts.data(), 1.0f, 0.5f,
+          std::numeric_limits<float>::infinity()};
+        kernels::limitAcceleration(kernel_set, view, 0, batch_size, holonomic);
+        return out;
+      };
+
+    const auto reference = predict(kernels::baselineKernels());
+    for (size_t i = 0; i != batch_size; i++) {
+      for (size_t t = 1; t != time_steps; t++) {
+        const size_t k = i * time_steps + t;
+        const float max_dvx = 1.0f * model_dts[t - 1] + 1e-6f;
+        EXPECT_LE(std::fabs(reference[k] - reference[k - 1]), max_dvx);
+        // Unlimited angular velocities reach their controls at once
+        EXPECT_NEAR(reference[2 * n + k], cwz[k - 1], 1e-6f);
+        if (!holonomic) {
+          EXPECT_EQ(reference[n + k], initial[n + k]);
+        }
+      }
+    }
+
+    for (const auto & name : kernels::availableKernels()) {
+      const auto result = predict(kernels::selectKernels(name));
+      for (size_t i = 0; i != result.size(); i++) {
+        EXPECT_NEAR(result[i], reference[i], 1e-6f) << name << " at " << i;
+      }
+    }
+  }
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "mppic/tools/latency_profiler.hpp"
+
+// Tests the latency histograms of the profiler
+
+using namespace mppi;  // NOLINT
+
+TEST(LatencyProfilerTest, Percentiles)
+{
+  LatencyProfiler profiler;
+  const size_t first = profiler.addEntry("first");
+  const size_t second = profiler.addEntry("second");
+  EXPECT_NE(first, second);
+  EXPECT_EQ(profiler.addEntry("first"), first);
+
+  // No samples yet
+  auto stats = profiler.getStats("first");
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->count, 0u);
+  EXPECT_EQ(stats->max, 0.0f);
+
+  for (unsigned int i = 100; i != 0; i--) {
+    profiler.record(first, static_cast<float>(i));
+  }
+  stats = profiler.getStats("first");
+  EXPECT_EQ(stats->name, "first");
+  EXPECT_EQ(stats->count, 100u);
+  EXPECT_EQ(stats->p50, 50.0f);
+  EXPECT_EQ(stats->p99, 99.0f);
+  EXPECT_EQ(stats->max, 100.0f);
+
+  const auto all_stats = profiler.getStats();
+  ASSERT_EQ(all_stats.size(), 2u);
+  EXPECT_EQ(all_stats[0].name, "first");
+  EXPECT_EQ(all_stats[1].name, "second");
+  EXPECT_EQ(all_stats[1].count, 0u);
+  EXPECT_FALSE(profiler.getStats("third").has_value());
+}
+
+TEST(LatencyProfilerTest, RollingWindow)
+{
+  LatencyProfiler profiler;
+  const size_t id = profiler.addEntry("stage");
+
+  // A spike falls out of the window once enough newer samples are recorded
+  profiler.record(id, 1000.0f);
+  for (size_t i = 0; i != LatencyProfiler::window_size; i++) {
+    profiler.record(id, 10.0f);
+  }
+  auto stats = profiler.getStats("stage");
+  EXPECT_EQ(stats->count, LatencyProfiler::window_size + 1);
+  EXPECT_EQ(stats->max, 10.0f);
+  EXPECT_EQ(stats->p99, 10.0f);
+
+  profiler.reset();
+  EXPECT_EQ(profiler.getStats("stage")->count, 0u);
+}
+
+TEST(LatencyProfilerTest, ScopedTimer)
+{
+  LatencyProfiler profiler;
+  const size_t id = profiler.addEntry("sleep");
+  {
+    ScopedLatencyTimer timer(&profiler, id);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  const auto stats = profiler.getStats("sleep");
+  EXPECT_EQ(stats->count, 1u);
+  EXPECT_GE(stats->max, 2000.0f);
+
+  // Without a profiler the timer does nothing
+  EXPECT_NO_THROW(ScopedLatencyTimer(nullptr, 5));
+}
@@ -156,7 +156,7 @@ TEST(MotionModelTests, AckermannTest)
   // Check that application of constraints are non-empty for Ackermann Drive
   for (unsigned int i = 0; i != control_sequence.vx.shape(0); i++) {
     control_sequence.vx(i) = i * i * i;
-    control_sequence.wz(i) = i * i * i;
+    control_sequence.wz(i) = i * i * i * i;
   }
 
   models::ControlSequence initial_control_sequence = control_sequence;
@@ -168,12 +168,82 @@ TEST(MotionModelTests, AckermannTest)
   // Now, check the specifics of the minimum curvature constraint
   EXPECT_NEAR(model->getMinTurningRadius(), 0.2, 1e-6);
   for (unsigned int i = 1; i != control_sequence.vx.shape(0); i++) {
-    EXPECT_TRUE(fabs(control_sequence.vx(i)) / fabs(control_sequence.wz(i)) <= 0.2);
+    EXPECT_GE(fabs(control_sequence.vx(i)) / fabs(control_sequence.wz(i)), 0.2 - 1e-6);
   }
 
+  // Without linear velocity, no turning is feasible and it does not divide by zero
+  EXPECT_EQ(control_sequence.wz(0), 0.0f);
+
+  // The sampled controls of a range of trajectories are constrained alike
+  state.cvx = 0.1 * xt::ones<float>({batches, timesteps});
+  state.cwz = 1 * xt::ones<float>({batches, timesteps});
+  const auto initial_cvx = state.cvx;
+  model->applyConstraints(state, 10, 20);
+  EXPECT_NEAR(state.cwz(9, 0), 1.0, 1e-6);
+  EXPECT_NEAR(state.cwz(10, 0), 0.5, 1e-6);
+  EXPECT_NEAR(state.cwz(19, timesteps - 1), 0.5, 1e-6);
+  EXPECT_NEAR(state.cwz(20, 0), 1.0, 1e-6);
+  EXPECT_EQ(state.cvx, initial_cvx);
+
   // Check that Ackermann Drive is properly non-holonomic and parameterized
   EXPECT_EQ(model->isHolonomic(), false);
 
   // Check it cleanly destructs
   model.reset();
 }
+
+TEST(MotionModelTests, AccelLimitedTest)
+{
+  models::State state;
+  int batches = 37;
+  int timesteps = 20;
+  state.reset(batches, timesteps);  // populates with zeros
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  node->declare_parameter("AccelerationConstraints.ax_max", rclcpp::ParameterValue(2.0));
+  node->declare_parameter("AccelerationConstraints.ay_max", rclcpp::ParameterValue(1.0));
+  node->declare_parameter("AccelerationConstraints.az_max", rclcpp::ParameterValue(0.0));
+  ParametersHandler param_handler(node);
+  std::unique_ptr<AccelLimitedOmniMotionModel> model =
+    std::make_unique<AccelLimitedOmniMotionModel>(&param_handler);
+  EXPECT_EQ(model->isHolonomic(), true);
+  EXPECT_EQ(AccelLimitedDiffDriveMotionModel(&param_handler).isHolonomic(), false);
+
+  float ax_max, ay_max, az_max;
+  model->getAccelerationLimits(ax_max, ay_max, az_max);
+  EXPECT_NEAR(ax_max, 2.0, 1e-6);
+  EXPECT_NEAR(ay_max, 1.0, 1e-6);
+  EXPECT_NEAR(az_max, 0.0, 1e-6);
+
+  // Without time steps, the controls are reached at once
+  state.cvx = 1 * xt::ones<float>({batches, timesteps});
+  state.cvy = -1 * xt::ones<float>({batches, timesteps});
+  state.cwz = 5 * xt::ones<float>({batches, timesteps});
+  model->predict(state);
+  EXPECT_EQ(xt::view(state.vx, xt::all(), xt::range(1, timesteps)), xt::view(
+      state.cvx, xt::all(), xt::range(0, timesteps - 1)));
+
+  // With time steps of 0.1 s, vx ramps up by 0.2 and vy down by 0.1 per step, wz unlimited
+  const xt::xtensor<float, 1> model_dts = 0.1 * xt::ones<float>({timesteps});
+  state.model_dts = &model_dts;
+  state.vx.fill(0.0f);
+  state.vy.fill(0.0f);
+  state.wz.fill(0.0f);
+  model->predict(state);
+  for (int i = 0; i != batches; i++) {
+    EXPECT_NEAR(state.vx(i, 1), 0.2, 1e-6);
+    EXPECT_NEAR(state.vx(i, 4), 0.8, 1e-5);
+    EXPECT_NEAR(state.vx(i, 5), 1.0, 1e-5);
+    EXPECT_NEAR(state.vx(i, timesteps - 1), 1.0, 1e-5);
+    EXPECT_NEAR(state.vy(i, 3), -0.3, 1e-5);
+    EXPECT_NEAR(state.vy(i, timesteps - 1), -1.0, 1e-5);
+    EXPECT_NEAR(state.wz(i, 1), 5.0, 1e-6);
+  }
+
+  // The range outside of the trajectories predicted is left untouched
+  state.vx.fill(0.0f);
+  model->predict(state, 5, 9);
+  EXPECT_NEAR(state.vx(4, 1), 0.0, 1e-6);
+  EXPECT_NEAR(state.vx(5, 1), 0.2, 1e-6);
+  EXPECT_NEAR(state.vx(8, 1), 0.2, 1e-6);
+  EXPECT_NEAR(state.vx(9, 1), 0.0, 1e-6);
+}
@@ -14,9 +14,13 @@
 
 #include <chrono>
 #include <thread>
+#include <vector>
+
+#include <xtensor/xmath.hpp>
 
 #include "gtest/gtest.h"
 #include "rclcpp/rclcpp.hpp"
+#include "mppic/tools/gaussian_sampler.hpp"
 #include "mppic/tools/noise_generator.hpp"
 #include "mppic/models/optimizer_settings.hpp"
 #include "mppic/models/state.hpp"
@@ -69,16 +73,16 @@ TEST(NoiseGeneratorTest, NoiseGeneratorMain)
   mppi::models::State state;
   state.reset(settings.batch_size, settings.time_steps);
 
-  // Request an update with no noise yet generated, should result in identical outputs
+  // Request an update right after a reset, which waits for the first noises generated
   generator.initialize(settings, false);
   generator.reset(settings, false);  // sets initial sizing and zeros out noises
   generator.setNoisedControls(state, control_sequence);
-  EXPECT_EQ(state.cvx(0), 0);
-  EXPECT_EQ(state.cvy(0), 0);
-  EXPECT_EQ(state.cwz(0), 0);
-  EXPECT_EQ(state.cvx(9), 9);
-  EXPECT_EQ(state.cvy(9), 9);
-  EXPECT_EQ(state.cwz(9), 9);
+  EXPECT_NE(state.cvx(0), 0);
+  EXPECT_EQ(state.cvy(0), 0);  // Not populated in non-holonomic
+  EXPECT_NE(state.cwz(0), 0);
+  EXPECT_NE(state.cvx(9), 9);
+  EXPECT_EQ(state.cvy(9), 0);  // Not populated in non-holonomic
+  EXPECT_NE(state.cwz(9), 9);
 
   // Request an update with noise requested
   generator.generateNextNoises();
@@ -88,14 +92,12 @@ TEST(NoiseGeneratorTest, NoiseGeneratorMain)
   EXPECT_EQ(state.cvy(0), 0);  // Not populated in non-holonomic
   EXPECT_NE(state.cwz(0), 0);
   EXPECT_NE(state.cvx(9), 9);
-  EXPECT_EQ(state.cvy(9), 9);  // Not populated in non-holonomic
+  EXPECT_EQ(state.cvy(9), 0);  // Not populated in non-holonomic
   EXPECT_NE(state.cwz(9), 9);
 
   EXPECT_NEAR(state.cvx(0), 0, 0.3);
-  EXPECT_NEAR(state.cvy(0), 0, 0.3);
   EXPECT_NEAR(state.cwz(0), 0, 0.3);
   EXPECT_NEAR(state.cvx(9), 9, 0.3);
-  EXPECT_NEAR(state.cvy(9), 9, 0.3);
   EXPECT_NEAR(state.cwz(9), 9, 0.3);
 
   // Test holonomic setting
@@ -119,3 +121,313 @@ TEST(NoiseGeneratorTest, NoiseGeneratorMain)
 
   generator.shutdown();
 }
+
+TEST(NoiseGeneratorTest, NoiseGeneratorDoesNotBlock)
+{
+  NoiseGenerator generator;
+  mppi::models::OptimizerSettings settings;
+  settings.batch_size = 100;
+  settings.time_steps = 25;
+  settings.sampling_std.vx = 0.1;
+  settings.sampling_std.vy = 0.1;
+  settings.sampling_std.wz = 0.1;
+
+  mppi::models::ControlSequence control_sequence;
+  control_sequence.reset(25);
+  mppi::models::State state;
+  state.reset(settings.batch_size, settings.time_steps);
+
+  generator.initialize(settings, false);
+  generator.reset(settings, false);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // Noises completed after the reset are picked up without waiting
+  generator.setNoisedControls(state, control_sequence);
+  EXPECT_EQ(generator.getWaitCount(), 0u);
+  const float first_noise = state.cvx(3, 4);
+  EXPECT_NE(first_noise, 0.0f);
+
+  // Without new noises requested, the previous ones are reused and counted
+  generator.setNoisedControls(state, control_sequence);
+  EXPECT_EQ(generator.getWaitCount(), 1u);
+  EXPECT_EQ(state.cvx(3, 4), first_noise);
+
+  // Newly completed noises replace them
+  generator.generateNextNoises();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  generator.setNoisedControls(state, control_sequence);
+  EXPECT_EQ(generator.getWaitCount(), 1u);
+  EXPECT_NE(state.cvx(3, 4), first_noise);
+
+  generator.shutdown();
+}
+
+TEST(NoiseGeneratorTest, NoiseGeneratorResetWaitsForNoises)
+{
+  NoiseGenerator generator;
+  mppi::models::OptimizerSettings settings;
+  settings.batch_size = 2000;
+  settings.time_steps = 56;
+  settings.sampling_std.vx = 0.1;
+  settings.sampling_std.vy = 0.1;
+  settings.sampling_std.wz = 0.1;
+
+  mppi::models::ControlSequence control_sequence;
+  control_sequence.reset(settings.time_steps);
+  mppi::models::State state;
+  state.reset(settings.batch_size, settings.time_steps);
+
+  // Consumed as soon as reset, as after a parameter change, a fallback retry or an
+  // activation, no batch is left without noises, and none are counted as reused
+  generator.initialize(settings, false);
+  for (unsigned int i = 0; i != 20; i++) {
+    generator.reset(settings, i % 2 == 1);
+    generator.setNoisedControls(state, control_sequence);
+    EXPECT_GT(xt::amax(xt::abs(state.cvx))(), 0.0f) << "reset " << i;
+    EXPECT_GT(xt::amax(xt::abs(state.cwz))(), 0.0f) << "reset " << i;
+    if (i % 2 == 1) {
+      EXPECT_GT(xt::amax(xt::abs(state.cvy))(), 0.0f) << "reset " << i;
+    }
+  }
+  EXPECT_EQ(generator.getWaitCount(), 0u);
+
+  // Without a noise thread, the reset generates them itself
+  generator.shutdown();
+  settings.noise_thread = false;
+  generator.initialize(settings, false);
+  generator.reset(settings, false);
+  generator.setNoisedControls(state, control_sequence);
+  EXPECT_GT(xt::amax(xt::abs(state.cvx))(), 0.0f);
+  EXPECT_EQ(generator.getWaitCount(), 0u);
+  generator.shutdown();
+}
+
+TEST(NoiseGeneratorTest, GaussianSamplerStatistics)
+{
+  // Odd size to exercise the partial last block
+  GaussianSampler sampler(42);
+  xt::xtensor<float, 2> samples = xt::zeros<float>({2001, 57});
+  sampler.fill(samples, 0.5f);
+
+  EXPECT_NEAR(xt::mean(samples)(), 0.0, 0.01);
+  EXPECT_NEAR(xt::stddev(samples)(), 0.5, 0.01);
+  EXPECT_NE(samples(2000, 56), 0.0f);
+
+  // Same seed gives the same sequence, another seed a different one
+  GaussianSampler same(42), other(7);
+  xt::xtensor<float, 2> same_samples = xt::zeros<float>({2001, 57});
+  xt::xtensor<float, 2> other_samples = xt::zeros<float>({2001, 57});
+  same.fill(same_samples, 0.5f);
+  other.fill(other_samples, 0.5f);
+  EXPECT_EQ(samples, same_samples);
+  EXPECT_NE(samples, other_samples);
+}
+
+TEST(NoiseGeneratorTest, NoiseGeneratorSeeded)
+{
+  // Seeded generators should produce reproducible noises with either backend
+  for (auto sampler : {models::NoiseSampler::Default, models::NoiseSampler::Xoshiro}) {
+    mppi::models::OptimizerSettings settings;
+    settings.batch_size = 100;
+    settings.time_steps = 25;
+    settings.sampling_std.vx = 0.1;
+    settings.sampling_std.vy = 0.1;
+    settings.sampling_std.wz = 0.1;
+    settings.noise_sampler = sampler;
+    settings.noise_seed = 11;
+
+    mppi::models::ControlSequence control_sequence;
+    control_sequence.reset(25);
+
+    std::vector<mppi::models::State> states(2);
+    for (auto & state : states) {
+      NoiseGenerator generator;
+      state.reset(settings.batch_size, settings.time_steps);
+      generator.initialize(settings, true);
+      generator.reset(settings, true);
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      generator.setNoisedControls(state, control_sequence);
+      generator.shutdown();
+    }
+
+    EXPECT_NE(states[0].cvx(5, 5), 0.0f);
+    EXPECT_EQ(states[0].cvx, states[1].cvx);
+    EXPECT_EQ(states[0].cvy, states[1].cvy);
+    EXPECT_EQ(states[0].cwz, states[1].cwz);
+    EXPECT_NEAR(xt::stddev(states[0].cwz)(), 0.1, 0.01);
+  }
+}
+
+TEST(NoiseGeneratorTest, NoiseGeneratorBank)
+{
+  NoiseGenerator generator;
+  mppi::models::OptimizerSettings settings;
+  settings.batch_size = 100;
+  settings.time_steps = 25;
+  settings.sampling_std.vx = 0.1;
+  settings.sampling_std.vy = 0.1;
+  settings.sampling_std.wz = 0.1;
+  settings.noise_seed = 3;
+  // 2 channels * 25 steps * 4 bytes = 200 bytes per sequence
+  settings.noise_bank_memory_mb = 0.1f;
+
+  mppi::models::ControlSequence control_sequence;
+  control_sequence.reset(25);
+  mppi::models::State state;
+  state.reset(settings.batch_size, settings.time_steps);
+
+  generator.initialize(settings, false);
+  generator.reset(settings, false);
+  const size_t bank_size = 0.1 * 1024 * 1024 / 200;
+  EXPECT_EQ(generator.getNoiseBankSize(), bank_size);
+
+  // Noises are picked from the bank instead of sampled
+  generator.generateNextNoises();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  generator.setNoisedControls(state, control_sequence);
+  EXPECT_NE(state.cvx(0, 0), 0.0f);
+  EXPECT_EQ(state.cvy(0, 0), 0.0f);
+  EXPECT_NEAR(xt::stddev(state.cvx)(), 0.1, 0.01);
+  EXPECT_NEAR(xt::stddev(state.cwz)(), 0.1, 0.01);
+
+  // Changing the horizon or the model rebuilds the bank within the same memory bound
+  settings.time_steps = 50;
+  generator.reset(settings, true);
+  EXPECT_EQ(generator.getNoiseBankSize(), static_cast<size_t>(0.1 * 1024 * 1024 / 600));
+
+  // Disabled in the default settings
+  settings.noise_bank_memory_mb = 0.0f;
+  generator.reset(settings, true);
+  EXPECT_EQ(generator.getNoiseBankSize(), 0u);
+
+  generator.shutdown();
+}
+
+TEST(NoiseGeneratorTest, NoiseGeneratorAdaptiveSampling)
+{
+  NoiseGenerator generator;
+  mppi::models::OptimizerSettings settings;
+  settings.batch_size = 400;
+  settings.time_steps = 25;
+  settings.sampling_std.vx = 0.1;
+  settings.sampling_std.vy = 0.1;
+  settings.sampling_std.wz = 0.1;
+  settings.noise_seed = 5;
+  settings.adaptive_sampling = true;
+  settings.adaptive_sampling_rate = 1.0f;
+  settings.min_sampling_std_ratio = 0.2f;
+
+  mppi::models::ControlSequence control_sequence;
+  control_sequence.reset(25);
+  mppi::models::State state;
+  state.reset(settings.batch_size, settings.time_steps);
+
+  generator.initialize(settings, false);
+  generator.reset(settings, false);
+  EXPECT_EQ(generator.getSamplingScales().vx, xt::ones<float>({25}));
+
+  // Deviations follow the weighted samples', bounded by the configured ones
+  mppi::models::ControlSequence variances;
+  variances.reset(25);
+  variances.vx.fill(0.05f * 0.05f);
+  generator.adaptSamplingStd(variances);
+  EXPECT_NEAR(generator.getSamplingScales().vx(3), 0.5, 1e-5);
+  EXPECT_NEAR(generator.getSamplingScales().wz(3), 0.2, 1e-5);
+
+  generator.generateNextNoises();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  generator.setNoisedControls(state, control_sequence);
+  EXPECT_NEAR(xt::stddev(state.cvx)(), 0.05, 0.005);
+  EXPECT_NEAR(xt::stddev(state.cwz)(), 0.02, 0.002);
+
+  variances.vx.fill(1.0f);
+  generator.adaptSamplingStd(variances);
+  EXPECT_NEAR(generator.getSamplingScales().vx(3), 1.0, 1e-5);
+
+  // Ones again on reset, and kept as is with adaptive sampling disabled
+  settings.adaptive_sampling = false;
+  generator.reset(settings, false);
+  generator.adaptSamplingStd(variances);
+  EXPECT_EQ(generator.getSamplingScales().wz, xt::ones<float>({25}));
+
+  generator.shutdown();
+}
+
+TEST(NoiseGeneratorTest, NoiseGeneratorCorrelatedNoises)
+{
+  NoiseGenerator generator;
+  mppi::models::OptimizerSettings settings;
+  settings.batch_size = 400;
+  settings.time_steps = 25;
+  settings.sampling_std.vx = 0.1;
+  settings.sampling_std.vy = 0.1;
+  settings.sampling_std.wz = 0.1;
+  settings.noise_seed = 5;
+  settings.noise_correlation = 0.9f;
+
+  mppi::models::ControlSequence control_sequence;
+  control_sequence.reset(25);
+  mppi::models::State state;
+  state.reset(settings.batch_size, settings.time_steps);
+
+  generator.initialize(settings, false);
+  generator.reset(settings, false);
+  generator.generateNextNoises();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  generator.setNoisedControls(state, control_sequence);
+
+  // Same deviation, correlated between consecutive time steps
+  EXPECT_NEAR(xt::stddev(state.cvx)(), 0.1, 0.01);
+  double products = 0.0;
+  for (size_t i = 0; i != settings.batch_size; i++) {
+    for (size_t t = 1; t != settings.time_steps; t++) {
+      products += state.cvx(i, t) * state.cvx(i, t - 1);
+    }
+  }
+  const double correlation = products / (settings.batch_size * 24) / (0.1 * 0.1);
+  EXPECT_NEAR(correlation, 0.9, 0.05);
+
+  generator.shutdown();
+}
+
+TEST(NoiseGeneratorTest, NoiseGeneratorHalfPrecision)
+{
+  NoiseGenerator generator;
+  mppi::models::OptimizerSettings settings;
+  // Not a multiple of the generation chunk, so the last chunk is partial
+  settings.batch_size = 400;
+  settings.time_steps = 25;
+  settings.sampling_std.vx = 0.1;
+  settings.sampling_std.vy = 0.1;
+  settings.sampling_std.wz = 0.2;
+  settings.noise_seed = 7;
+
+  // Float noises of a non-holonomic model: 3 buffers * 2 channels * 400 * 25 floats
+  generator.initialize(settings, false);
+  generator.reset(settings, false);
+  EXPECT_EQ(generator.getMemoryUsage(), 3u * 2u * 400u * 25u * sizeof(float));
+
+  // Half noises with a float chunk of 64 rows to generate them
+  settings.noise_precision = models::StoragePrecision::Float16;
+  generator.reset(settings, false);
+  EXPECT_EQ(
+    generator.getMemoryUsage(),
+    3u * 2u * 400u * 25u * sizeof(uint16_t) + 64u * 25u * sizeof(float));
+
+  mppi::models::ControlSequence control_sequence;
+  control_sequence.reset(25);
+  control_sequence.vx.fill(0.5f);
+  mppi::models::State state;
+  state.reset(settings.batch_size, settings.time_steps, false);
+  EXPECT_EQ(state.cvy.size(), 0u);
+
+  generator.generateNextNoises();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  generator.setNoisedControls(state, control_sequence);
+  EXPECT_NE(state.cvx(399, 24), 0.5f);
+  EXPECT_NEAR(xt::mean(state.cvx)(), 0.5, 0.01);
+  EXPECT_NEAR(xt::stddev(state.cvx)(), 0.1, 0.01);
+  EXPECT_NEAR(xt::stddev(state.cwz)(), 0.2, 0.02);
+
+  generator.shutdown();
+}
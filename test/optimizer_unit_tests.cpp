@@ -12,8 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
 #include <thread>
+#include <tuple>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "rclcpp/rclcpp.hpp"
@@ -133,6 +141,7 @@ public:
     EXPECT_FALSE(critics_data_.motion_model->isHolonomic());  // object is valid + diff drive
     EXPECT_FALSE(critics_data_.furthest_reached_path_point.has_value());  // val is not set
     EXPECT_FALSE(critics_data_.path_pts_valid.has_value());  // val is not set
+    EXPECT_EQ(critics_data_.cycle_context, &cycle_context_);  // shared by the iterations
     EXPECT_EQ(state_.pose.pose.position.x, 999);
     EXPECT_EQ(state_.speed.linear.y, 4.0);
     EXPECT_EQ(path_.x.shape(0), 17u);
@@ -213,6 +222,154 @@ public:
   {
     return integrateStateVelocities(traj, state);
   }
+
+  models::ControlSequence updateControlSequenceFromPattern()
+  {
+    const size_t batch = settings_.batch_size;
+    const size_t steps = settings_.time_steps;
+    for (size_t i = 0; i != batch; i++) {
+      costs_(i) = static_cast<float>(i % 17);
+      for (size_t j = 0; j != steps; j++) {
+        state_.cvx(i, j) = 0.01f * ((i * 7 + j) % 13);
+        state_.cwz(i, j) = 0.02f * ((i * 3 + j) % 11);
+      }
+    }
+    control_sequence_.reset(steps);
+    updateControlSequence();
+    return control_sequence_;
+  }
+
+  models::ControlSequence updateControlSequenceFromPattern(const std::vector<uint8_t> & dead)
+  {
+    critics_data_.dead_trajectories = dead;
+    auto control_sequence = updateControlSequenceFromPattern();
+    critics_data_.dead_trajectories.clear();
+    return control_sequence;
+  }
+
+  void testAdaptedControlCosts()
+  {
+    // Deviations adapted to half and a quarter of the configured ones along the horizon
+    const size_t batch = settings_.batch_size;
+    const size_t steps = settings_.time_steps;
+    models::ControlSequence variances;
+    variances.reset(steps);
+    variances.vx = xt::ones<float>({steps}) * std::pow(0.5f * settings_.sampling_std.vx, 2);
+    variances.wz = xt::ones<float>({steps}) * std::pow(0.25f * settings_.sampling_std.wz, 2);
+    noise_generator_.adaptSamplingStd(variances);
+    const models::ControlSequence scales = noise_generator_.getSamplingScales();
+    EXPECT_NEAR(scales.vx(0), 0.5f, 1e-5);
+    EXPECT_NEAR(scales.wz(0), 0.25f, 1e-5);
+
+    control_sequence_.reset(steps);
+    control_sequence_.vx.fill(0.1f);
+    control_sequence_.wz.fill(0.2f);
+    const models::ControlSequence sequence = control_sequence_;
+    for (size_t i = 0; i != batch; i++) {
+      costs_(i) = 0.0f;
+      for (size_t j = 0; j != steps; j++) {
+        state_.cvx(i, j) = 0.1f + 0.01f * ((i + j) % 5);
+        state_.cwz(i, j) = 0.2f - 0.01f * ((i * 3 + j) % 7);
+      }
+    }
+    updateControlSequence();
+
+    // Control costs weigh the noises by the deviations they were drawn with
+    for (const size_t i : {size_t{0}, size_t{7}, batch - 1}) {
+      float expected = 0.0f;
+      for (size_t j = 0; j != steps; j++) {
+        expected += settings_.gamma /
+          std::pow(settings_.sampling_std.vx * scales.vx(j), 2) *
+          sequence.vx(j) * (state_.cvx(i, j) - sequence.vx(j));
+        expected += settings_.gamma /
+          std::pow(settings_.sampling_std.wz * scales.wz(j), 2) *
+          sequence.wz(j) * (state_.cwz(i, j) - sequence.wz(j));
+      }
+      EXPECT_NEAR(costs_(i), expected, 1e-4f * std::max(1.0f, std::abs(expected)));
+    }
+  }
+
+  float getSampledVx(size_t i, size_t j) {return state_.cvx(i, j);}
+
+  float getSampledWz(size_t i, size_t j) {return state_.cwz(i, j);}
+
+  models::ControlSequence seedNominalSequenceWrapper(
+    models::NominalSequence nominal, const models::Path & path)
+  {
+    path_ = path;
+    control_sequence_.vx.fill(0.1f);
+    setNominalSequence(nominal);
+    seedNominalSequence();
+    return control_sequence_;
+  }
+
+  void fillCostsPermutation()
+  {
+    // Distinct costs, as 37 and the batch size of 100 are coprime
+    for (size_t i = 0; i != settings_.batch_size; i++) {
+      costs_(i) = static_cast<float>((i * 37) % settings_.batch_size);
+      xt::view(generated_trajectories_.x, i, xt::all()) = static_cast<float>(i);
+    }
+  }
+
+  void saveWarmStartSamplesWrapper() {saveWarmStartSamples();}
+
+  void generateNoisedTrajectoriesWrapper() {generateNoisedTrajectories();}
+
+  void testScreening()
+  {
+    // Coarse rollouts of the whole screening batch, the last step grouping one time step
+    EXPECT_EQ(screening_trajectories_.x.shape(0), 400u);
+    EXPECT_EQ(screening_trajectories_.x.shape(1), 6u);
+    EXPECT_NEAR(screening_dts_(0), 0.1, 1e-6);
+    EXPECT_NEAR(screening_dts_(5), 0.05, 1e-6);
+    EXPECT_NEAR(screening_data_.model_dt, 0.1, 1e-6);
+
+    // Survivors are the refined batch, at full resolution
+    for (size_t k = 0; k != settings_.batch_size; k++) {
+      for (size_t t = 0; t != settings_.time_steps; t++) {
+        EXPECT_EQ(state_.cvx(k, t), screening_samples_.cvx(screening_ids_[k], t));
+        EXPECT_EQ(state_.cwz(k, t), screening_samples_.cwz(screening_ids_[k], t));
+      }
+      EXPECT_EQ(screening_state_.cvx(screening_ids_[k], 3), state_.cvx(k, 6));
+    }
+  }
+
+  // Adapts the batch size and applies it, as the next cycle does
+  void adaptBatchSizeWrapper(double cycle_time)
+  {
+    adaptBatchSize(cycle_time);
+    applyPendingBatchSize();
+  }
+
+  void deferBatchSizeWrapper(double cycle_time) {adaptBatchSize(cycle_time);}
+
+  void applyPendingBatchSizeWrapper() {applyPendingBatchSize();}
+
+  const float * getRolloutStorage() {return generated_trajectories_.x.data();}
+
+  const float * getControlsStorage() {return state_.cvx.data();}
+
+  const float * getCostsStorage() {return costs_.data();}
+
+  const float * getStagedRolloutStorage()
+  {
+    std::lock_guard<std::mutex> guard(staging_lock_);
+    return staged_buffers_ ? staged_buffers_->generated_trajectories.x.data() : nullptr;
+  }
+
+  unsigned int getIterationCount() {return settings_.iteration_count;}
+
+  bool isHolonomicWrapper() {return isHolonomic();}
+
+  unsigned int getBatchSize()
+  {
+    // Every batch buffer follows the effective batch size
+    EXPECT_EQ(state_.cvx.shape(0), settings_.batch_size);
+    EXPECT_EQ(costs_.shape(0), settings_.batch_size);
+    EXPECT_EQ(generated_trajectories_.x.shape(0), settings_.batch_size);
+    return settings_.batch_size;
+  }
 };
 
 TEST(OptimizerTests, BasicInitializedFunctions)
@@ -345,6 +502,51 @@ TEST(OptimizerTests, FallbackTests)
   EXPECT_THROW(optimizer_tester.fallbackWrapper(true), std::runtime_error);
 }
 
+TEST(OptimizerTests, FallbackRecoveryTests)
+{
+  nav2_costmap_2d::Costmap2D costmap(100, 100, 0.05, -2.5, -2.5, nav2_costmap_2d::FREE_SPACE);
+  HeadlessCostmap headless;
+  headless.costmap = &costmap;
+  ParametersHandler param_handler(
+    {rclcpp::Parameter("controller_frequency", 20.0), rclcpp::Parameter("mppic.batch_size", 100),
+      rclcpp::Parameter("mppic.time_steps", 10), rclcpp::Parameter("mppic.noise_seed", 3),
+      rclcpp::Parameter("mppic.deterministic_noises", true),
+      rclcpp::Parameter("mppic.retry_attempt_limit", 2),
+      rclcpp::Parameter("mppic.fallback_recovery", true)});
+  OptimizerTester optimizer_tester;
+  optimizer_tester.initialize("mppic", headless, &param_handler);
+
+  models::ControlSequence sequence;
+  sequence.reset(10);
+  sequence.vx.fill(0.2f);
+  optimizer_tester.setControlSequence(sequence);
+  optimizer_tester.generateNoisedTrajectoriesWrapper();
+  float spread = 0.0f;
+  for (size_t i = 0; i != 100; i++) {
+    spread += std::abs(optimizer_tester.getSampledVx(i, 5) - 0.2f);
+  }
+
+  // Retries keep the control sequence, and sample wider with recovery primitives first
+  EXPECT_TRUE(optimizer_tester.fallbackWrapper(true));
+  EXPECT_EQ(optimizer_tester.getControlSequence().vx, sequence.vx);
+  optimizer_tester.generateNoisedTrajectoriesWrapper();
+  EXPECT_EQ(optimizer_tester.getSampledVx(0, 5), 0.0f);
+  EXPECT_EQ(optimizer_tester.getSampledVx(1, 5), -0.35f);
+  EXPECT_EQ(optimizer_tester.getSampledWz(2, 5), 1.9f);
+  EXPECT_EQ(optimizer_tester.getSampledWz(3, 5), -1.9f);
+  float widened = 0.0f;
+  for (size_t i = 4; i != 100; i++) {
+    widened += std::abs(optimizer_tester.getSampledVx(i, 5) - 0.2f);
+  }
+  EXPECT_GT(widened, 1.5f * spread);
+
+  // Still failing past the limit resets and reports the failure
+  EXPECT_TRUE(optimizer_tester.fallbackWrapper(true));
+  EXPECT_THROW(optimizer_tester.fallbackWrapper(true), std::runtime_error);
+  EXPECT_EQ(optimizer_tester.getControlSequence().vx, xt::zeros<float>({10}));
+  optimizer_tester.shutdown();
+}
+
 TEST(OptimizerTests, PrepareTests)
 {
   auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
@@ -402,8 +604,17 @@ TEST(OptimizerTests, shiftControlSequenceTests)
 
   optimizer_tester.resetMotionModel();
   optimizer_tester.testSetOmniModel();
+  const float * vx_data = sequence.vx.data();
+  const float * vy_data = sequence.vy.data();
+  const float * wz_data = sequence.wz.data();
   optimizer_tester.shiftControlSequenceWrapper();
 
+  // Shifting happens in place, keeping the buffers the rest of the cycle holds on to
+  EXPECT_EQ(sequence.vx.data(), vx_data);
+  EXPECT_EQ(sequence.vy.data(), vy_data);
+  EXPECT_EQ(sequence.wz.data(), wz_data);
+  EXPECT_EQ(sequence.vx(99), sequence.vx(98));
+
   EXPECT_EQ(sequence.vx(0), 6);
   EXPECT_EQ(sequence.vy(0), 6);
   EXPECT_EQ(sequence.wz(0), 6);
@@ -634,3 +845,891 @@ TEST(OptimizerTests, integrateStateVelocitiesTests)
     EXPECT_NEAR(traj.y(1, i), y, 1e-6);
   }
 }
+
+TEST(OptimizerTests, workerThreadsTests)
+{
+  // Splitting the batch over workers should give the same control update as a single thread
+  std::vector<models::ControlSequence> results;
+  for (int threads : {1, 4}) {
+    auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+    OptimizerTester optimizer_tester;
+    node->declare_parameter("controller_frequency", rclcpp::ParameterValue(30.0));
+    node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(1001));
+    node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(50));
+    node->declare_parameter("mppic.worker_threads", rclcpp::ParameterValue(threads));
+    auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+      "dummy_costmap", "", "dummy_costmap", true);
+    ParametersHandler param_handler(node);
+    rclcpp_lifecycle::State lstate;
+    costmap_ros->on_configure(lstate);
+    optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+
+    results.push_back(optimizer_tester.updateControlSequenceFromPattern());
+    optimizer_tester.shutdown();
+  }
+
+  for (unsigned int i = 0; i != results[0].vx.shape(0); i++) {
+    EXPECT_NEAR(results[0].vx(i), results[1].vx(i), 1e-5);
+    EXPECT_NEAR(results[0].wz(i), results[1].wz(i), 1e-5);
+  }
+}
+
+TEST(OptimizerTests, streamingSoftmaxTests)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  OptimizerTester optimizer_tester;
+  node->declare_parameter("controller_frequency", rclcpp::ParameterValue(30.0));
+  node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(1001));
+  node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(50));
+  node->declare_parameter("mppic.worker_threads", rclcpp::ParameterValue(4));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+  optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+
+  // From a zero control sequence, so without control costs, chunks merged from their
+  // own running min costs give the softmax weighted average over the whole batch
+  auto control_sequence = optimizer_tester.updateControlSequenceFromPattern();
+  const float temperature = 0.3f;
+  std::vector<double> weights(1001);
+  double normalizer = 0.0;
+  for (size_t i = 0; i != weights.size(); i++) {
+    weights[i] = std::exp(-static_cast<double>(i % 17) / temperature);
+    normalizer += weights[i];
+  }
+  for (size_t j = 0; j != 50; j++) {
+    double vx = 0.0, wz = 0.0;
+    for (size_t i = 0; i != weights.size(); i++) {
+      vx += weights[i] / normalizer * 0.01 * ((i * 7 + j) % 13);
+      wz += weights[i] / normalizer * 0.02 * ((i * 3 + j) % 11);
+    }
+    EXPECT_NEAR(control_sequence.vx(j), vx, 1e-5);
+    EXPECT_NEAR(control_sequence.wz(j), wz, 1e-5);
+  }
+  optimizer_tester.shutdown();
+}
+
+TEST(OptimizerTests, adaptiveSamplingControlCostsTests)
+{
+  nav2_costmap_2d::Costmap2D costmap(100, 100, 0.05, -2.5, -2.5, nav2_costmap_2d::FREE_SPACE);
+  HeadlessCostmap headless;
+  headless.costmap = &costmap;
+  ParametersHandler param_handler(
+    {rclcpp::Parameter("controller_frequency", 20.0), rclcpp::Parameter("mppic.batch_size", 100),
+      rclcpp::Parameter("mppic.time_steps", 10), rclcpp::Parameter("mppic.gamma", 0.1),
+      rclcpp::Parameter("mppic.adaptive_sampling", true),
+      rclcpp::Parameter("mppic.adaptive_sampling_rate", 1.0)});
+  OptimizerTester optimizer_tester;
+  optimizer_tester.initialize("mppic", headless, &param_handler);
+  param_handler.start();
+  optimizer_tester.testAdaptedControlCosts();
+  optimizer_tester.shutdown();
+
+  // The adapted deviations divide the control costs, so they cannot shrink to 0
+  ParametersHandler invalid_handler(
+    {rclcpp::Parameter("controller_frequency", 20.0),
+      rclcpp::Parameter("mppic.adaptive_sampling", true),
+      rclcpp::Parameter("mppic.min_sampling_std_ratio", 0.0)});
+  OptimizerTester invalid_tester;
+  EXPECT_THROW(
+    invalid_tester.initialize("mppic", headless, &invalid_handler), std::runtime_error);
+  EXPECT_FALSE(
+    param_handler.dynamicParamsCallback(
+      {rclcpp::Parameter("mppic.min_sampling_std_ratio", 0.0)}).successful);
+}
+
+TEST(OptimizerTests, latencyProfilerTests)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  OptimizerTester optimizer_tester;
+  node->declare_parameter("controller_frequency", rclcpp::ParameterValue(30.0));
+  node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(100));
+  node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(20));
+  node->declare_parameter("mppic.iteration_count", rclcpp::ParameterValue(2));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+  optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+
+  geometry_msgs::msg::PoseStamped pose;
+  geometry_msgs::msg::Twist speed;
+  nav_msgs::msg::Path plan;
+  plan.poses.resize(10);
+  for (unsigned int i = 0; i != plan.poses.size(); i++) {
+    plan.poses[i].pose.position.x = 0.1 * i;
+  }
+  for (unsigned int i = 0; i != 3; i++) {
+    optimizer_tester.evalControl(pose, speed, plan, nullptr);
+  }
+
+  // Every stage is recorded once per cycle, or once per iteration inside optimize()
+  const auto & profiler = optimizer_tester.getLatencyProfiler();
+  EXPECT_FALSE(profiler.getStats("unknown_stage").has_value());
+  for (const auto & name : {"evalControl", "prepare", "smoothing"}) {
+    ASSERT_TRUE(profiler.getStats(name).has_value());
+    EXPECT_EQ(profiler.getStats(name)->count, 3u);
+  }
+  for (const auto & name : {"noise", "rollout", "critics", "update"}) {
+    ASSERT_TRUE(profiler.getStats(name).has_value());
+    EXPECT_EQ(profiler.getStats(name)->count, 6u);
+  }
+
+  const auto total = *profiler.getStats("evalControl");
+  EXPECT_GT(total.max, 0.0f);
+  EXPECT_GE(total.max, profiler.getStats("rollout")->max);
+  optimizer_tester.shutdown();
+}
+
+TEST(OptimizerTests, deadTrajectoriesTests)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  OptimizerTester optimizer_tester;
+  node->declare_parameter("controller_frequency", rclcpp::ParameterValue(30.0));
+  node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(100));
+  node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(20));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+  optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+
+  // With a single trajectory alive, it gets all the weight
+  std::vector<uint8_t> dead(100, 1);
+  dead[42] = 0;
+  auto control_sequence = optimizer_tester.updateControlSequenceFromPattern(dead);
+  for (unsigned int j = 0; j != 20; j++) {
+    EXPECT_NEAR(control_sequence.vx(j), optimizer_tester.getSampledVx(42, j), 1e-5);
+  }
+
+  // With every trajectory dead there is nothing to prune, as without a mask
+  const auto unmasked = optimizer_tester.updateControlSequenceFromPattern();
+  control_sequence = optimizer_tester.updateControlSequenceFromPattern(
+    std::vector<uint8_t>(100, 1));
+  for (unsigned int j = 0; j != 20; j++) {
+    EXPECT_EQ(control_sequence.vx(j), unmasked.vx(j));
+    EXPECT_EQ(control_sequence.wz(j), unmasked.wz(j));
+  }
+  optimizer_tester.shutdown();
+}
+
+TEST(OptimizerTests, adaptiveBatchSizeTests)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  OptimizerTester optimizer_tester;
+  node->declare_parameter("controller_frequency", rclcpp::ParameterValue(20.0));
+  node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(1000));
+  node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(20));
+  node->declare_parameter("mppic.adaptive_batch_size", rclcpp::ParameterValue(true));
+  node->declare_parameter("mppic.min_batch_size", rclcpp::ParameterValue(200));
+  node->declare_parameter("mppic.batch_size_step", rclcpp::ParameterValue(100));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+  optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 1000u);
+
+  // A cycle of twice the 0.05s period shrinks to the step fitting 90% of it
+  optimizer_tester.adaptBatchSizeWrapper(0.1);
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 400u);
+
+  // Within budget without enough headroom, the batch is kept
+  optimizer_tester.adaptBatchSizeWrapper(0.04);
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 400u);
+
+  // Grows by a step only after sustained headroom
+  for (unsigned int i = 0; i != 9; i++) {
+    optimizer_tester.adaptBatchSizeWrapper(0.01);
+  }
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 400u);
+  optimizer_tester.adaptBatchSizeWrapper(0.01);
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 500u);
+
+  // Bounded by min_batch_size and max_batch_size, defaulting to batch_size
+  optimizer_tester.adaptBatchSizeWrapper(10.0);
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 200u);
+  for (unsigned int i = 0; i != 200; i++) {
+    optimizer_tester.adaptBatchSizeWrapper(0.01);
+  }
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 1000u);
+
+  geometry_msgs::msg::PoseStamped pose;
+  geometry_msgs::msg::Twist speed;
+  nav_msgs::msg::Path plan;
+  plan.poses.resize(10);
+  for (unsigned int i = 0; i != plan.poses.size(); i++) {
+    plan.poses[i].pose.position.x = 0.1 * i;
+  }
+
+  // A new size waits for the next cycle, so this cycle's trajectories stay published
+  optimizer_tester.evalControl(pose, speed, plan, nullptr);
+  const models::Trajectories published = optimizer_tester.getGeneratedTrajectories();
+  const float * rollouts = optimizer_tester.getRolloutStorage();
+  const float * controls = optimizer_tester.getControlsStorage();
+  const float * costs = optimizer_tester.getCostsStorage();
+  optimizer_tester.deferBatchSizeWrapper(0.1);
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 1000u);
+  EXPECT_EQ(optimizer_tester.getGeneratedTrajectories().x, published.x);
+
+  // Resized within the storage reserved for the largest batch, keeping the leading rows
+  optimizer_tester.applyPendingBatchSizeWrapper();
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 400u);
+  EXPECT_EQ(optimizer_tester.getRolloutStorage(), rollouts);
+  EXPECT_EQ(optimizer_tester.getControlsStorage(), controls);
+  EXPECT_EQ(optimizer_tester.getCostsStorage(), costs);
+  EXPECT_EQ(
+    optimizer_tester.getGeneratedTrajectories().x,
+    xt::view(published.x, xt::range(0, 400), xt::all()));
+
+  // Cycles run on a shrunk batch with the noises sampled for the largest one
+  for (unsigned int i = 0; i != 3; i++) {
+    EXPECT_NO_THROW(optimizer_tester.evalControl(pose, speed, plan, nullptr));
+  }
+  const unsigned int batch_size = optimizer_tester.getBatchSize();
+  EXPECT_GE(batch_size, 200u);
+  EXPECT_LE(batch_size, 1000u);
+  EXPECT_EQ(batch_size % 100, 0u);
+  optimizer_tester.shutdown();
+}
+
+TEST(OptimizerTests, computeTimeBudgetTests)
+{
+  // Iterations per cycle: a huge cost improvement threshold stops on the first
+  // finite improvement, a tiny budget stops after the first iteration
+  const std::vector<std::tuple<double, double, size_t>> cases = {
+    {1e6, 1e30, 2}, {1e-6, -1e30, 1}};
+  for (const auto & [max_compute_time_ms, min_cost_improvement, iterations] : cases) {
+    auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+    OptimizerTester optimizer_tester;
+    node->declare_parameter("controller_frequency", rclcpp::ParameterValue(30.0));
+    node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(100));
+    node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(20));
+    node->declare_parameter(
+      "mppic.max_compute_time_ms", rclcpp::ParameterValue(max_compute_time_ms));
+    node->declare_parameter(
+      "mppic.min_cost_improvement", rclcpp::ParameterValue(min_cost_improvement));
+    auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+      "dummy_costmap", "", "dummy_costmap", true);
+    ParametersHandler param_handler(node);
+    rclcpp_lifecycle::State lstate;
+    costmap_ros->on_configure(lstate);
+    optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+
+    geometry_msgs::msg::PoseStamped pose;
+    geometry_msgs::msg::Twist speed;
+    nav_msgs::msg::Path plan;
+    plan.poses.resize(10);
+    for (unsigned int i = 0; i != plan.poses.size(); i++) {
+      plan.poses[i].pose.position.x = 0.1 * i;
+    }
+    for (unsigned int i = 0; i != 3; i++) {
+      EXPECT_NO_THROW(optimizer_tester.evalControl(pose, speed, plan, nullptr));
+    }
+
+    const auto & profiler = optimizer_tester.getLatencyProfiler();
+    EXPECT_EQ(profiler.getStats("evalControl")->count, 3u);
+    EXPECT_EQ(profiler.getStats("update")->count, 3u * iterations);
+    optimizer_tester.shutdown();
+  }
+}
+
+TEST(OptimizerTests, watchdogTests)
+{
+  // A tiny budget overruns from the start: the default order skips the visualization and
+  // the expensive critics for a first iteration, then drops the others. Reusing the
+  // previous sequence runs none
+  const std::vector<std::pair<std::vector<std::string>, size_t>> cases = {
+    {{"skip_visualization", "drop_iterations", "disable_expensive_critics",
+        "reuse_previous_sequence"}, 1},
+    {{"reuse_previous_sequence"}, 0}};
+  for (const auto & [order, iterations] : cases) {
+    auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+    OptimizerTester optimizer_tester;
+    node->declare_parameter("controller_frequency", rclcpp::ParameterValue(30.0));
+    node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(100));
+    node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(20));
+    node->declare_parameter("mppic.iteration_count", rclcpp::ParameterValue(3));
+    node->declare_parameter("mppic.watchdog_budget_ms", rclcpp::ParameterValue(1e-6));
+    node->declare_parameter("mppic.watchdog_degradation_order", rclcpp::ParameterValue(order));
+    auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+      "dummy_costmap", "", "dummy_costmap", true);
+    ParametersHandler param_handler(node);
+    rclcpp_lifecycle::State lstate;
+    costmap_ros->on_configure(lstate);
+    optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+
+    models::ControlSequence previous;
+    previous.reset(20);
+    previous.vx.fill(0.2f);
+    optimizer_tester.setControlSequence(previous);
+
+    geometry_msgs::msg::PoseStamped pose;
+    geometry_msgs::msg::Twist speed;
+    nav_msgs::msg::Path plan;
+    plan.poses.resize(10);
+    for (unsigned int i = 0; i != plan.poses.size(); i++) {
+      plan.poses[i].pose.position.x = 0.1 * i;
+    }
+    for (unsigned int i = 0; i != 3; i++) {
+      EXPECT_NO_THROW(optimizer_tester.evalControl(pose, speed, plan, nullptr));
+    }
+
+    const auto & profiler = optimizer_tester.getLatencyProfiler();
+    EXPECT_EQ(profiler.getStats("update")->count, 3u * iterations);
+    const auto & stats = optimizer_tester.getWatchdogStats();
+    EXPECT_EQ(stats.cycles, 3u);
+    EXPECT_EQ(stats.overruns, 3u);
+    const size_t degradations = 3u * iterations;
+    EXPECT_EQ(stats.skipped_visualizations, degradations);
+    EXPECT_EQ(optimizer_tester.isVisualizationSkipped(), iterations != 0);
+    EXPECT_EQ(stats.dropped_iterations, degradations);
+    EXPECT_EQ(stats.disabled_expensive_critics, degradations);
+    EXPECT_EQ(stats.reused_sequences, 3u - degradations);
+    if (iterations == 0) {
+      // Only smoothed, which keeps a constant sequence past the history
+      EXPECT_NEAR(optimizer_tester.getControlSequence().vx(10), 0.2f, 1e-5);
+    }
+    optimizer_tester.shutdown();
+  }
+}
+
+TEST(OptimizerTests, pipelinedRolloutsTests)
+{
+  // Pipelined or not, the same noises give the same commands, up to float rounding
+  nav2_costmap_2d::Costmap2D costmap(100, 100, 0.05, -2.5, -2.5, nav2_costmap_2d::FREE_SPACE);
+  HeadlessCostmap headless;
+  headless.costmap = &costmap;
+  std::vector<geometry_msgs::msg::TwistStamped> cmds[2];
+  for (const bool pipelined : {false, true}) {
+    ParametersHandler param_handler(
+      {rclcpp::Parameter("controller_frequency", 20.0),
+        rclcpp::Parameter("mppic.batch_size", 100), rclcpp::Parameter("mppic.time_steps", 20),
+        rclcpp::Parameter("mppic.noise_seed", 5),
+        rclcpp::Parameter("mppic.deterministic_noises", true),
+        rclcpp::Parameter("mppic.pipelined_rollouts", pipelined),
+        rclcpp::Parameter(
+          "mppic.critics", std::vector<std::string>{"GoalCritic", "PathFollowCritic"})});
+    OptimizerTester optimizer_tester;
+    optimizer_tester.initialize("mppic", headless, &param_handler);
+    param_handler.start();
+
+    geometry_msgs::msg::PoseStamped pose;
+    pose.pose.position.x = 0.3;
+    pose.pose.position.y = -0.2;
+    pose.pose.orientation.z = std::sin(0.15);
+    pose.pose.orientation.w = std::cos(0.15);
+    geometry_msgs::msg::Twist speed;
+    speed.linear.x = 0.2;
+    speed.angular.z = 0.1;
+    nav_msgs::msg::Path plan;
+    plan.poses.resize(20);
+    for (unsigned int i = 0; i != plan.poses.size(); i++) {
+      plan.poses[i].pose.position.x = 0.3 + 0.1 * i;
+    }
+    for (unsigned int i = 0; i != 3; i++) {
+      cmds[pipelined].push_back(optimizer_tester.evalControl(pose, speed, plan, nullptr));
+      optimizer_tester.startPreroll();
+      pose.pose.position.x += 0.01;
+    }
+    optimizer_tester.finishPreroll();
+    EXPECT_EQ(
+      optimizer_tester.getLatencyProfiler().getStats("preroll")->count, pipelined ? 3u : 0u);
+    optimizer_tester.shutdown();
+  }
+
+  for (size_t i = 0; i != 3; i++) {
+    EXPECT_NEAR(cmds[1][i].twist.linear.x, cmds[0][i].twist.linear.x, 1e-3);
+    EXPECT_NEAR(cmds[1][i].twist.angular.z, cmds[0][i].twist.angular.z, 1e-3);
+  }
+}
+
+TEST(OptimizerTests, parameterChangesDuringPrerollTests)
+{
+  nav2_costmap_2d::Costmap2D costmap(100, 100, 0.05, -2.5, -2.5, nav2_costmap_2d::FREE_SPACE);
+  HeadlessCostmap headless;
+  headless.costmap = &costmap;
+  ParametersHandler param_handler(
+    {rclcpp::Parameter("controller_frequency", 20.0),
+      rclcpp::Parameter("mppic.batch_size", 100), rclcpp::Parameter("mppic.time_steps", 20),
+      rclcpp::Parameter("mppic.pipelined_rollouts", true),
+      rclcpp::Parameter(
+        "mppic.critics", std::vector<std::string>{"GoalCritic", "PathFollowCritic"})});
+  OptimizerTester optimizer_tester;
+  optimizer_tester.initialize("mppic", headless, &param_handler);
+  param_handler.start();
+
+  geometry_msgs::msg::PoseStamped pose;
+  geometry_msgs::msg::Twist speed;
+  nav_msgs::msg::Path plan;
+  plan.poses.resize(20);
+  for (unsigned int i = 0; i != plan.poses.size(); i++) {
+    plan.poses[i].pose.position.x = 0.1 * i;
+  }
+
+  // Changes applied while the next cycle is pre-rolled wait for it, then reallocate
+  for (const int batch_size : {400, 50}) {
+    EXPECT_NO_THROW(optimizer_tester.evalControl(pose, speed, plan, nullptr));
+    optimizer_tester.startPreroll();
+    param_handler.dynamicParamsCallback({rclcpp::Parameter("mppic.batch_size", batch_size)});
+    EXPECT_EQ(optimizer_tester.getBatchSize(), static_cast<unsigned int>(batch_size));
+    EXPECT_NO_THROW(optimizer_tester.evalControl(pose, speed, plan, nullptr));
+    EXPECT_EQ(
+      optimizer_tester.getGeneratedTrajectories().x.shape(0), static_cast<size_t>(batch_size));
+    optimizer_tester.startPreroll();
+  }
+  optimizer_tester.finishPreroll();
+  EXPECT_GT(optimizer_tester.getLatencyProfiler().getStats("preroll")->count, 0u);
+  optimizer_tester.shutdown();
+}
+
+TEST(OptimizerTests, warmStartTests)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  OptimizerTester optimizer_tester;
+  node->declare_parameter("controller_frequency", rclcpp::ParameterValue(30.0));
+  node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(100));
+  node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(20));
+  node->declare_parameter("mppic.warm_start_samples", rclcpp::ParameterValue(10));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+  optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+
+  // Whether a sampled row is one of the 12 lowest cost pattern rows, shifted in time
+  auto isBestPatternRow = [&](size_t row, size_t shift) {
+      for (size_t i = 0; i != 100; i++) {
+        bool same = i % 17 <= 1;
+        for (size_t j = 0; same && j != 20; j++) {
+          const size_t t = std::min<size_t>(j + shift, 19);
+          same = optimizer_tester.getSampledVx(row, j) == 0.01f * ((i * 7 + t) % 13);
+        }
+        if (same) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+  optimizer_tester.updateControlSequenceFromPattern();
+  optimizer_tester.saveWarmStartSamplesWrapper();
+  optimizer_tester.generateNoisedTrajectoriesWrapper();
+  EXPECT_FALSE(isBestPatternRow(0, 0));
+  for (size_t row = 90; row != 100; row++) {
+    EXPECT_TRUE(isBestPatternRow(row, 0));
+  }
+
+  // Shifted along with the control sequence
+  optimizer_tester.shiftControlSequenceWrapper();
+  optimizer_tester.generateNoisedTrajectoriesWrapper();
+  for (size_t row = 90; row != 100; row++) {
+    EXPECT_TRUE(isBestPatternRow(row, 1));
+  }
+
+  // Forgotten on reset
+  optimizer_tester.reset();
+  optimizer_tester.generateNoisedTrajectoriesWrapper();
+  for (size_t row = 90; row != 100; row++) {
+    EXPECT_FALSE(isBestPatternRow(row, 1));
+  }
+  optimizer_tester.shutdown();
+}
+
+TEST(OptimizerTests, memoryUsageTests)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  OptimizerTester optimizer_tester;
+  node->declare_parameter("controller_frequency", rclcpp::ParameterValue(30.0));
+  node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(100));
+  node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(20));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+  optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+
+  auto bytesOf = [&](const std::string & component) {
+      for (const auto & usage : optimizer_tester.getMemoryUsage()) {
+        if (usage.component == component) {
+          return usage.bytes;
+        }
+      }
+      ADD_FAILURE() << "No memory usage for " << component;
+      return size_t{0};
+    };
+
+  // Diff drive stores no lateral velocities: 4 of 100 x 20 floats
+  EXPECT_EQ(bytesOf("state"), 4u * 100u * 20u * sizeof(float));
+  EXPECT_EQ(bytesOf("trajectories"), 3u * 100u * 20u * sizeof(float));
+  EXPECT_EQ(bytesOf("noise_bank"), 0u);
+
+  // Omni velocities are lateral too
+  optimizer_tester.resetMotionModel();
+  optimizer_tester.testSetOmniModel();
+  EXPECT_EQ(bytesOf("state"), 6u * 100u * 20u * sizeof(float));
+
+  optimizer_tester.shutdown();
+}
+
+TEST(OptimizerTests, topTrajectoriesTests)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  OptimizerTester optimizer_tester;
+  node->declare_parameter("controller_frequency", rclcpp::ParameterValue(30.0));
+  node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(100));
+  node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(20));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+  optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+  optimizer_tester.fillCostsPermutation();
+
+  // The 5 lowest costs 0 to 4, by increasing cost, with their trajectories
+  models::Trajectories top;
+  xt::xtensor<float, 1> costs;
+  optimizer_tester.getTopTrajectories(5, top, costs);
+  ASSERT_EQ(costs.shape(0), 5u);
+  ASSERT_EQ(top.x.shape(0), 5u);
+  EXPECT_EQ(top.x.shape(1), 20u);
+  for (size_t k = 0; k != 5; k++) {
+    EXPECT_EQ(costs(k), static_cast<float>(k));
+    const size_t id = static_cast<size_t>(top.x(k, 19));
+    EXPECT_EQ((id * 37) % 100, k);
+  }
+
+  // Clamped to the batch size, then all of them sorted
+  optimizer_tester.getTopTrajectories(1000, top, costs);
+  ASSERT_EQ(costs.shape(0), 100u);
+  EXPECT_EQ(costs(99), 99.0f);
+  optimizer_tester.shutdown();
+}
+
+TEST(OptimizerTests, nominalSequenceTests)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  OptimizerTester optimizer_tester;
+  node->declare_parameter("controller_frequency", rclcpp::ParameterValue(30.0));
+  node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(100));
+  node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(20));
+  node->declare_parameter("mppic.vx_max", rclcpp::ParameterValue(0.5));
+  node->declare_parameter("mppic.vx_min", rclcpp::ParameterValue(-0.35));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+  optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+
+  // Path straight ahead, then one turning left
+  models::Path straight, left;
+  straight.reset(50);
+  left.reset(50);
+  for (size_t i = 0; i != 50; i++) {
+    straight.x(i) = 0.05f * i;
+    left.y(i) = 0.05f * i;
+  }
+
+  auto previous = optimizer_tester.seedNominalSequenceWrapper(
+    models::NominalSequence::Previous, straight);
+  EXPECT_NEAR(previous.vx(5), 0.1, 1e-6);
+
+  auto stop = optimizer_tester.seedNominalSequenceWrapper(models::NominalSequence::Stop, straight);
+  EXPECT_EQ(stop.vx, xt::zeros<float>({20}));
+
+  auto reverse = optimizer_tester.seedNominalSequenceWrapper(
+    models::NominalSequence::Reverse, straight);
+  EXPECT_NEAR(reverse.vx(5), -0.35, 1e-6);
+  EXPECT_NEAR(reverse.wz(5), 0.0, 1e-6);
+
+  auto forward = optimizer_tester.seedNominalSequenceWrapper(
+    models::NominalSequence::PathFeedforward, straight);
+  EXPECT_NEAR(forward.vx(5), 0.5, 1e-6);
+  EXPECT_NEAR(forward.wz(5), 0.0, 1e-6);
+
+  auto turning = optimizer_tester.seedNominalSequenceWrapper(
+    models::NominalSequence::PathFeedforward, left);
+  EXPECT_GT(turning.wz(0), 0.0);
+
+  // Control sequences are only taken over from optimizers of the same horizon
+  models::ControlSequence other;
+  other.reset(10);
+  EXPECT_THROW(optimizer_tester.setControlSequence(other), std::runtime_error);
+  other.reset(20);
+  other.vx.fill(0.2f);
+  optimizer_tester.setControlSequence(other);
+  EXPECT_EQ(optimizer_tester.getControlSequence().vx, other.vx);
+  optimizer_tester.shutdown();
+}
+
+TEST(OptimizerTests, growingTimeStepsTests)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  OptimizerTester optimizer_tester;
+  node->declare_parameter("controller_frequency", rclcpp::ParameterValue(20.0));
+  node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(100));
+  node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(11));
+  node->declare_parameter("mppic.model_dt", rclcpp::ParameterValue(0.05));
+  node->declare_parameter("mppic.model_dt_max", rclcpp::ParameterValue(0.15));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+  optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+
+  const auto & model_dts = optimizer_tester.getModelDts();
+  ASSERT_EQ(model_dts.shape(0), 11u);
+  EXPECT_NEAR(model_dts(0), 0.05, 1e-6);
+  EXPECT_NEAR(model_dts(5), 0.10, 1e-6);
+  EXPECT_NEAR(model_dts(10), 0.15, 1e-6);
+
+  // A control ramping with time is resampled one controller period later
+  std::vector<float> starts(11, 0.0f);
+  for (size_t t = 1; t != 11; t++) {
+    starts[t] = starts[t - 1] + model_dts(t - 1);
+  }
+  auto & sequence = optimizer_tester.grabControlSequence();
+  for (size_t t = 0; t != 11; t++) {
+    sequence.vx(t) = starts[t];
+  }
+  optimizer_tester.shiftControlSequenceWrapper();
+  for (size_t t = 0; t != 10; t++) {
+    EXPECT_NEAR(sequence.vx(t), std::min(starts[t] + 0.05f, starts[10]), 1e-5);
+  }
+  EXPECT_NEAR(sequence.vx(10), starts[10], 1e-6);
+  optimizer_tester.shutdown();
+}
+
+TEST(OptimizerTests, twoStageSamplingTests)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  OptimizerTester optimizer_tester;
+  node->declare_parameter("controller_frequency", rclcpp::ParameterValue(20.0));
+  node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(100));
+  node->declare_parameter("mppic.time_steps", rclcpp::ParameterValue(11));
+  node->declare_parameter("mppic.screening_batch_size", rclcpp::ParameterValue(400));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State lstate;
+  costmap_ros->on_configure(lstate);
+  optimizer_tester.initialize(node, "mppic", costmap_ros, &param_handler);
+
+  optimizer_tester.generateNoisedTrajectoriesWrapper();
+  optimizer_tester.testScreening();
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 100u);
+  optimizer_tester.shutdown();
+
+  // The screening batch must be larger than the refined one
+  auto small_node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("small_node");
+  OptimizerTester small_tester;
+  small_node->declare_parameter("controller_frequency", rclcpp::ParameterValue(20.0));
+  small_node->declare_parameter("mppic.batch_size", rclcpp::ParameterValue(100));
+  small_node->declare_parameter("mppic.screening_batch_size", rclcpp::ParameterValue(50));
+  ParametersHandler small_param_handler(small_node);
+  EXPECT_THROW(
+    small_tester.initialize(small_node, "mppic", costmap_ros, &small_param_handler),
+    std::runtime_error);
+}
+
+TEST(OptimizerTests, headlessTests)
+{
+  // Many optimizers in a process, without any node or Costmap2DROS
+  nav2_costmap_2d::Costmap2D costmap(100, 100, 0.05, -2.5, -2.5, nav2_costmap_2d::FREE_SPACE);
+  for (unsigned int i = 60; i != 70; i++) {
+    costmap.setCost(i, 50, nav2_costmap_2d::LETHAL_OBSTACLE);
+  }
+  HeadlessCostmap headless;
+  headless.costmap = &costmap;
+  headless.footprint.resize(4);
+  const double corners[4][2] = {{0.2, 0.15}, {0.2, -0.15}, {-0.2, -0.15}, {-0.2, 0.15}};
+  for (size_t i = 0; i != 4; i++) {
+    headless.footprint[i].x = corners[i][0];
+    headless.footprint[i].y = corners[i][1];
+  }
+  headless.base_frame_id = "robot_base";
+  headless.inflation_scaling_factor = 10.0;
+  headless.inflation_radius = 0.5;
+
+  const std::vector<rclcpp::Parameter> parameters{
+    rclcpp::Parameter("controller_frequency", 30.0),
+    rclcpp::Parameter("mppic.batch_size", 100),
+    rclcpp::Parameter("mppic.time_steps", 15),
+    rclcpp::Parameter("mppic.critics", std::vector<std::string>{"ObstaclesCritic", "GoalCritic"}),
+    rclcpp::Parameter("mppic.ObstaclesCritic.consider_footprint", true)};
+
+  geometry_msgs::msg::PoseStamped pose;
+  geometry_msgs::msg::Twist speed;
+  nav_msgs::msg::Path plan;
+  plan.poses.resize(10);
+  for (unsigned int i = 0; i != plan.poses.size(); i++) {
+    plan.poses[i].pose.position.x = 0.1 * i;
+  }
+
+  std::vector<std::unique_ptr<ParametersHandler>> param_handlers;
+  std::vector<std::unique_ptr<OptimizerTester>> optimizers;
+  for (size_t i = 0; i != 3; i++) {
+    param_handlers.push_back(std::make_unique<ParametersHandler>(parameters));
+    optimizers.push_back(std::make_unique<OptimizerTester>());
+    optimizers.back()->initialize("mppic", headless, param_handlers.back().get());
+    param_handlers.back()->start();
+    EXPECT_EQ(optimizers.back()->getBatchSize(), 100u);
+  }
+
+  for (auto & optimizer : optimizers) {
+    geometry_msgs::msg::TwistStamped cmd;
+    EXPECT_NO_THROW(cmd = optimizer->evalControl(pose, speed, plan, nullptr));
+    EXPECT_EQ(cmd.header.frame_id, "robot_base");
+  }
+
+  // Parameters not given take their defaults, and change through the handler
+  EXPECT_EQ(optimizers[0]->getIterationCount(), 1u);
+  param_handlers[0]->dynamicParamsCallback({rclcpp::Parameter("mppic.iteration_count", 2)});
+  EXPECT_EQ(optimizers[0]->getIterationCount(), 2u);
+  for (auto & optimizer : optimizers) {
+    optimizer->shutdown();
+  }
+
+  // A headless costmap must be given its costmap
+  ParametersHandler param_handler(parameters);
+  OptimizerTester optimizer_tester;
+  EXPECT_THROW(
+    optimizer_tester.initialize("mppic", HeadlessCostmap{}, &param_handler), std::runtime_error);
+}
+
+TEST(OptimizerTests, sharedParameterChangesTests)
+{
+  // Hypotheses' optimizers share the controller's handler and namespace
+  nav2_costmap_2d::Costmap2D costmap(100, 100, 0.05, -2.5, -2.5, nav2_costmap_2d::FREE_SPACE);
+  HeadlessCostmap headless;
+  headless.costmap = &costmap;
+  ParametersHandler param_handler(
+    {rclcpp::Parameter("controller_frequency", 20.0), rclcpp::Parameter("mppic.batch_size", 100),
+      rclcpp::Parameter("mppic.time_steps", 10)});
+  std::vector<std::unique_ptr<OptimizerTester>> optimizers;
+  for (size_t i = 0; i != 3; i++) {
+    optimizers.push_back(std::make_unique<OptimizerTester>());
+    optimizers.back()->initialize("mppic", headless, &param_handler);
+  }
+  param_handler.start();
+
+  // Every optimizer follows the changes, the motion model included
+  param_handler.dynamicParamsCallback(
+    {rclcpp::Parameter("mppic.iteration_count", 3),
+      rclcpp::Parameter("mppic.batch_size", 120),
+      rclcpp::Parameter("mppic.motion_model", std::string("Omni"))});
+  for (auto & optimizer : optimizers) {
+    EXPECT_EQ(optimizer->getIterationCount(), 3u);
+    EXPECT_EQ(optimizer->getBatchSize(), 120u);
+    EXPECT_TRUE(optimizer->isHolonomicWrapper());
+    optimizer->shutdown();
+  }
+}
+
+TEST(OptimizerTests, parameterChangesTests)
+{
+  nav2_costmap_2d::Costmap2D costmap(100, 100, 0.05, -2.5, -2.5, nav2_costmap_2d::FREE_SPACE);
+  HeadlessCostmap headless;
+  headless.costmap = &costmap;
+  ParametersHandler param_handler(
+    {rclcpp::Parameter("controller_frequency", 20.0), rclcpp::Parameter("mppic.batch_size", 100),
+      rclcpp::Parameter("mppic.time_steps", 10)});
+  OptimizerTester optimizer_tester;
+  optimizer_tester.initialize("mppic", headless, &param_handler);
+  param_handler.start();
+
+  models::ControlSequence sequence;
+  sequence.reset(10);
+  for (size_t t = 0; t != 10; t++) {
+    sequence.vx(t) = 0.01f * static_cast<float>(t);
+    sequence.wz(t) = -0.02f * static_cast<float>(t);
+  }
+  optimizer_tester.setControlSequence(sequence);
+
+  // Non-structural changes keep the warm control sequence as is
+  param_handler.dynamicParamsCallback({rclcpp::Parameter("mppic.temperature", 0.5)});
+  EXPECT_EQ(optimizer_tester.getControlSequence().vx, sequence.vx);
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 100u);
+
+  // Structural ones reallocate, resampling it and holding its last value past its horizon
+  param_handler.dynamicParamsCallback({rclcpp::Parameter("mppic.time_steps", 15)});
+  const auto & resized = optimizer_tester.getControlSequence();
+  ASSERT_EQ(resized.vx.shape(0), 15u);
+  for (size_t t = 0; t != 15; t++) {
+    EXPECT_NEAR(resized.vx(t), sequence.vx(std::min<size_t>(t, 9)), 1e-6);
+    EXPECT_NEAR(resized.wz(t), sequence.wz(std::min<size_t>(t, 9)), 1e-6);
+  }
+  param_handler.dynamicParamsCallback({rclcpp::Parameter("mppic.batch_size", 150)});
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 150u);
+  EXPECT_NEAR(optimizer_tester.getControlSequence().vx(14), sequence.vx(9), 1e-6);
+  optimizer_tester.shutdown();
+}
+
+TEST(OptimizerTests, stagedParameterChangesTests)
+{
+  nav2_costmap_2d::Costmap2D costmap(100, 100, 0.05, -2.5, -2.5, nav2_costmap_2d::FREE_SPACE);
+  HeadlessCostmap headless;
+  headless.costmap = &costmap;
+  ParametersHandler param_handler(
+    {rclcpp::Parameter("controller_frequency", 20.0), rclcpp::Parameter("mppic.batch_size", 100),
+      rclcpp::Parameter("mppic.time_steps", 10)});
+  OptimizerTester optimizer_tester;
+  optimizer_tester.initialize("mppic", headless, &param_handler);
+  param_handler.start();
+
+  // Holds the change once the optimizer built its buffers, as a long reallocation would
+  std::promise<void> built, release;
+  auto released = release.get_future().share();
+  param_handler.addStageCallback(
+    [&](const std::vector<rclcpp::Parameter> &) {
+      return std::function<void()>(
+        [&built, released]() {
+          built.set_value();
+          released.wait();
+        });
+    });
+
+  geometry_msgs::msg::PoseStamped pose;
+  geometry_msgs::msg::Twist speed;
+  nav_msgs::msg::Path plan;
+  plan.poses.resize(20);
+  for (unsigned int i = 0; i != plan.poses.size(); i++) {
+    plan.poses[i].pose.position.x = 0.1 * i;
+  }
+
+  std::thread parameters([&]() {
+      param_handler.deferParamsCallback({rclcpp::Parameter("mppic.batch_size", 300)});
+    });
+  ASSERT_EQ(built.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  const float * staged_storage = optimizer_tester.getStagedRolloutStorage();
+  EXPECT_NE(staged_storage, nullptr);
+
+  // A cycle run meanwhile neither waits for the reallocation nor applies the change
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(param_handler.applyPendingChanges());
+  {
+    std::lock_guard<std::mutex> lock(*param_handler.getLock());
+    EXPECT_NO_THROW(optimizer_tester.evalControl(pose, speed, plan, nullptr));
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 100u);
+
+  // Once built, applying the change swaps the staged buffers in rather than allocating
+  release.set_value();
+  parameters.join();
+  EXPECT_EQ(optimizer_tester.getBatchSize(), 300u);
+  EXPECT_EQ(optimizer_tester.getRolloutStorage(), staged_storage);
+  EXPECT_NO_THROW(optimizer_tester.evalControl(pose, speed, plan, nullptr));
+  EXPECT_EQ(optimizer_tester.getGeneratedTrajectories().x.shape(0), 300u);
+  optimizer_tester.shutdown();
+}
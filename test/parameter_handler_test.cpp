@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <chrono>
+#include <future>
 #include <thread>
 
 #include "gtest/gtest.h"
@@ -179,3 +180,132 @@ TEST(ParameterHandlerTest, DynamicAndStaticParametersTest)
   EXPECT_EQ(p1, 10);
   EXPECT_EQ(p2, 7);
 }
+
+TEST(ParameterHandlerTest, DeferredChangesTest)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("deferred_node");
+  node->declare_parameter("dynamic_int", rclcpp::ParameterValue(7));
+  ParametersHandlerWrapper handler(node);
+  size_t post_count = 0;
+  handler.addPostCallback([&]() {post_count++;});
+  handler.start(true);
+
+  auto getParamer = handler.getParamGetter("");
+  int p1 = 0;
+  getParamer(p1, "dynamic_int", 0, ParameterType::Dynamic);
+  EXPECT_FALSE(handler.applyPendingChanges());
+
+  auto rec_param = std::make_shared<rclcpp::AsyncParametersClient>(
+    node->get_node_base_interface(), node->get_node_topics_interface(),
+    node->get_node_graph_interface(),
+    node->get_node_services_interface());
+  {
+    // A control cycle holds the lock, the change is queued until picked up
+    std::promise<void> locked, done;
+    std::thread cycle([&]() {
+        std::lock_guard<std::mutex> cycle_lock(*handler.getLock());
+        locked.set_value();
+        done.get_future().wait();
+      });
+    locked.get_future().wait();
+    auto results = rec_param->set_parameters_atomically({rclcpp::Parameter("dynamic_int", 10)});
+    rclcpp::spin_until_future_complete(node->get_node_base_interface(), results);
+    EXPECT_EQ(p1, 7);
+    EXPECT_EQ(post_count, 0u);
+    done.set_value();
+    cycle.join();
+  }
+  EXPECT_TRUE(handler.applyPendingChanges());
+  EXPECT_EQ(p1, 10);
+  EXPECT_EQ(post_count, 1u);
+  EXPECT_FALSE(handler.applyPendingChanges());
+
+  // Without a control cycle running, the change is applied right away
+  auto results = rec_param->set_parameters_atomically({rclcpp::Parameter("dynamic_int", 12)});
+  rclcpp::spin_until_future_complete(node->get_node_base_interface(), results);
+  EXPECT_EQ(p1, 12);
+  EXPECT_EQ(post_count, 2u);
+  EXPECT_FALSE(handler.applyPendingChanges());
+}
+
+TEST(ParameterHandlerTest, StagedChangesTest)
+{
+  ParametersHandlerWrapper handler;
+  int p1 = 7;
+  size_t post_count = 0;
+  handler.addPostCallback([&]() {post_count++;});
+  handler.setDynamicParamCallback(p1, "dynamic_int");
+
+  // The stage callback sees the value the change leads to, the setting left as is
+  int staged_p1 = 0;
+  std::promise<void> building, release;
+  auto released = release.get_future().share();
+  handler.addStageCallback(
+    [&](const std::vector<rclcpp::Parameter> & parameters) {
+      staged_p1 = handler.stageSettings(p1, parameters);
+      return std::function<void()>(
+        [&building, released]() {
+          building.set_value();
+          released.wait();
+        });
+    });
+
+  std::thread parameters([&]() {
+      EXPECT_TRUE(handler.deferParamsCallback({rclcpp::Parameter("dynamic_int", 10)}).successful);
+    });
+  ASSERT_EQ(building.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  EXPECT_EQ(staged_p1, 10);
+
+  // A cycle starting while the change is built neither waits for it nor applies it
+  EXPECT_FALSE(handler.applyPendingChanges());
+  EXPECT_TRUE(handler.getLock()->try_lock());
+  handler.getLock()->unlock();
+  EXPECT_EQ(p1, 7);
+  EXPECT_EQ(post_count, 0u);
+
+  // Once built, it is applied right away as no cycle runs
+  release.set_value();
+  parameters.join();
+  EXPECT_EQ(p1, 10);
+  EXPECT_EQ(post_count, 1u);
+  EXPECT_FALSE(handler.applyPendingChanges());
+}
+
+TEST(ParameterHandlerTest, RejectedChangesTest)
+{
+  ParametersHandlerWrapper handler;
+  int p1 = 0;
+  unsigned int p2 = 0;
+  size_t post_count = 0;
+  handler.addPostCallback([&]() {post_count++;});
+  handler.setDynamicParamCallback(p1, "int_param");
+  handler.setDynamicParamCallback(p2, "unsigned_param");
+  handler.addParamVerifier(
+    "int_param", [](const rclcpp::Parameter & param) {
+      return param.as_int() > 100 ? std::string("int_param needs to be at most 100") :
+      std::string();
+    });
+
+  // Values of the wrong type, out of range or negative for unsigned settings are rejected
+  EXPECT_FALSE(handler.dynamicParamsCallback({rclcpp::Parameter("int_param", 1.5)}).successful);
+  EXPECT_FALSE(handler.dynamicParamsCallback({rclcpp::Parameter("int_param", 101)}).successful);
+  EXPECT_FALSE(
+    handler.dynamicParamsCallback({rclcpp::Parameter("unsigned_param", -1)}).successful);
+
+  // All the changes are rejected with one invalid value
+  auto result = handler.dynamicParamsCallback(
+    {rclcpp::Parameter("int_param", 5), rclcpp::Parameter("unsigned_param", -1)});
+  EXPECT_FALSE(result.successful);
+  EXPECT_FALSE(result.reason.empty());
+  EXPECT_EQ(p1, 0);
+  EXPECT_EQ(p2, 0u);
+  EXPECT_EQ(post_count, 0u);
+
+  result = handler.dynamicParamsCallback(
+    {rclcpp::Parameter("int_param", 5), rclcpp::Parameter("unsigned_param", 3),
+      rclcpp::Parameter("unknown_param", "hello")});
+  EXPECT_TRUE(result.successful);
+  EXPECT_EQ(p1, 5);
+  EXPECT_EQ(p2, 3u);
+  EXPECT_EQ(post_count, 1u);
+}
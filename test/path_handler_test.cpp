@@ -14,9 +14,12 @@
 
 #include <chrono>
 #include <thread>
+#include <utility>
 
 #include "gtest/gtest.h"
 #include "rclcpp/rclcpp.hpp"
+#include "angles/angles.h"
+#include "tf2/utils.h"
 #include "mppic/tools/path_handler.hpp"
 
 // Tests path handling
@@ -65,6 +68,11 @@ public:
     return transformPlanPosesToCostmapFrame(begin, end, stamp);
   }
 
+  size_t getStoredPlanSize()
+  {
+    return global_plan_.poses.size();
+  }
+
   geometry_msgs::msg::PoseStamped transformToGlobalPlanFrameWrapper(
     const geometry_msgs::msg::PoseStamped & pose)
   {
@@ -91,6 +99,32 @@ TEST(PathHandlerTests, GetAndPrunePath)
   EXPECT_EQ(rtn2_path.poses.size(), 6u);
 }
 
+TEST(PathHandlerTests, AmortizedPruning)
+{
+  nav_msgs::msg::Path path;
+  PathHandlerWrapper handler;
+  path.header.frame_id = "fkframe";
+  path.poses.resize(100);
+  for (unsigned int i = 0; i != path.poses.size(); i++) {
+    path.poses[i].pose.position.x = i;
+  }
+
+  // Taken over without copying the poses
+  handler.setPath(std::move(path));
+  EXPECT_EQ(handler.getStoredPlanSize(), 100u);
+
+  // Pruning a few poses keeps them stored until they are most of the plan
+  handler.pruneGlobalPlanWrapper(handler.getPath().poses.begin() + 10);
+  EXPECT_EQ(handler.getStoredPlanSize(), 100u);
+  auto & rtn_path = handler.getPath();
+  EXPECT_EQ(rtn_path.poses.size(), 90u);
+  EXPECT_EQ(rtn_path.poses.front().pose.position.x, 10.0);
+
+  handler.pruneGlobalPlanWrapper(rtn_path.poses.begin() + 60);
+  EXPECT_EQ(handler.getStoredPlanSize(), 30u);
+  EXPECT_EQ(handler.getPath().poses.front().pose.position.x, 70.0);
+}
+
 TEST(PathHandlerTests, TestBounds)
 {
   PathHandlerWrapper handler;
@@ -168,3 +202,244 @@ TEST(PathHandlerTests, TestTransforms)
   auto final_path = handler.transformPath(robot_pose);
   EXPECT_EQ(final_path.poses.size(), path_out.poses.size());
 }
+
+TEST(PathHandlerTests, TestIncrementalTransforms)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  node->declare_parameter("incremental.incremental_path_handling", rclcpp::ParameterValue(true));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State state;
+  costmap_ros->on_configure(state);
+  auto tf_buffer = costmap_ros->getTfBuffer();
+
+  PathHandlerWrapper handler, incremental_handler;
+  handler.initialize(node, "dummy", costmap_ros, tf_buffer, &param_handler);
+  incremental_handler.initialize(node, "incremental", costmap_ros, tf_buffer, &param_handler);
+
+  // Plan in another frame than the costmap's
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = costmap_ros->getGlobalFrameID();
+  transform.child_frame_id = "odom";
+  transform.transform.translation.x = 0.5;
+  transform.transform.rotation.w = 1.0;
+  tf_buffer->setTransform(transform, "test", true);
+
+  nav_msgs::msg::Path path;
+  path.header.frame_id = "odom";
+  path.poses.resize(100);
+  for (unsigned int i = 0; i != path.poses.size(); i++) {
+    path.poses[i].pose.position.x = 0.1 * i;
+  }
+  handler.setPath(path);
+  incremental_handler.setPath(path);
+
+  geometry_msgs::msg::PoseStamped robot_pose;
+  robot_pose.header.frame_id = "odom";
+
+  // Reusing the cached poses, and re-transforming them once the transform changes,
+  // gives the same path tensors as transforming every pose every cycle
+  models::Path path_tensors, incremental_tensors;
+  size_t window_poses = 0;
+  for (unsigned int cycle = 0; cycle != 10; cycle++) {
+    if (cycle == 5) {
+      transform.transform.translation.x = 0.7;
+      tf_buffer->setTransform(transform, "test", true);
+    }
+    robot_pose.pose.position.x = 1.0 + 0.3 * cycle;
+    handler.transformPath(robot_pose, path_tensors);
+    const auto before = incremental_handler.getTransformCacheStats();
+    incremental_handler.transformPath(robot_pose, incremental_tensors);
+    const auto & after = incremental_handler.getTransformCacheStats();
+    ASSERT_EQ(path_tensors.x.shape(0), incremental_tensors.x.shape(0));
+    EXPECT_GT(path_tensors.x.shape(0), 0u);
+    EXPECT_EQ(path_tensors.x, incremental_tensors.x);
+    EXPECT_EQ(path_tensors.y, incremental_tensors.y);
+    EXPECT_EQ(path_tensors.yaws, incremental_tensors.yaws);
+
+    // Every pose is transformed on the first cycle and once the transform changed,
+    // otherwise only those entering the window, the others being reused
+    const size_t reused = after.reused_poses - before.reused_poses;
+    const size_t transformed = after.transformed_poses - before.transformed_poses;
+    EXPECT_EQ(reused + transformed, incremental_tensors.x.shape(0));
+    if (cycle == 0 || cycle == 5) {
+      EXPECT_EQ(reused, 0u);
+    } else {
+      EXPECT_GT(reused, 0u);
+      EXPECT_LT(transformed, incremental_tensors.x.shape(0));
+    }
+    window_poses += incremental_tensors.x.shape(0);
+  }
+  EXPECT_EQ(handler.getPath().poses.size(), incremental_handler.getPath().poses.size());
+  EXPECT_EQ(handler.getTransformCacheStats().reused_poses, 0u);
+  EXPECT_EQ(handler.getTransformCacheStats().transformed_poses, window_poses);
+}
+
+TEST(PathHandlerTests, TestIncrementalCacheCompaction)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  node->declare_parameter("incremental.incremental_path_handling", rclcpp::ParameterValue(true));
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State state;
+  costmap_ros->on_configure(state);
+  auto tf_buffer = costmap_ros->getTfBuffer();
+
+  PathHandlerWrapper handler, incremental_handler, incremental_tensor_handler;
+  handler.initialize(node, "dummy", costmap_ros, tf_buffer, &param_handler);
+  incremental_handler.initialize(node, "incremental", costmap_ros, tf_buffer, &param_handler);
+  incremental_tensor_handler.initialize(
+    node, "incremental", costmap_ros, tf_buffer, &param_handler);
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = costmap_ros->getGlobalFrameID();
+  transform.child_frame_id = "odom";
+  transform.transform.translation.x = 0.5;
+  transform.transform.rotation.w = 1.0;
+  tf_buffer->setTransform(transform, "test", true);
+
+  nav_msgs::msg::Path path;
+  path.header.frame_id = "odom";
+  path.poses.resize(100);
+  for (unsigned int i = 0; i != path.poses.size(); i++) {
+    path.poses[i].pose.position.x = 0.1 * i;
+  }
+  handler.setPath(path);
+  incremental_handler.setPath(path);
+  incremental_tensor_handler.setPath(path);
+
+  geometry_msgs::msg::PoseStamped robot_pose;
+  robot_pose.header.frame_id = "odom";
+
+  // Advancing a pose per cycle drops one cached pose at a time, the cache and the plan
+  // being compacted along the way, while all poses but the new ones are reused
+  models::Path incremental_tensors;
+  for (unsigned int cycle = 0; cycle != 30; cycle++) {
+    robot_pose.pose.position.x = 1.0 + 0.1 * cycle;
+    auto plan = handler.transformPath(robot_pose);
+    const auto before = incremental_handler.getTransformCacheStats();
+    auto incremental_plan = incremental_handler.transformPath(robot_pose);
+    const auto & after = incremental_handler.getTransformCacheStats();
+    incremental_tensor_handler.transformPath(robot_pose, incremental_tensors);
+
+    ASSERT_EQ(plan.poses.size(), incremental_plan.poses.size());
+    ASSERT_EQ(plan.poses.size(), incremental_tensors.x.shape(0));
+    for (size_t i = 0; i != plan.poses.size(); i++) {
+      EXPECT_EQ(plan.poses[i].header.frame_id, incremental_plan.poses[i].header.frame_id);
+      EXPECT_NEAR(plan.poses[i].pose.position.x, incremental_plan.poses[i].pose.position.x, 1e-9);
+      EXPECT_NEAR(plan.poses[i].pose.position.x, incremental_tensors.x(i), 1e-5);
+      EXPECT_NEAR(plan.poses[i].pose.position.y, incremental_tensors.y(i), 1e-5);
+    }
+    if (cycle != 0) {
+      EXPECT_GE(after.reused_poses - before.reused_poses, plan.poses.size() - 2);
+    }
+  }
+  EXPECT_EQ(
+    incremental_handler.getTransformCacheStats().reused_poses,
+    incremental_tensor_handler.getTransformCacheStats().reused_poses);
+  EXPECT_EQ(handler.getTransformCacheStats().reused_poses, 0u);
+}
+
+TEST(PathHandlerTests, TestTensorTransforms)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State state;
+  costmap_ros->on_configure(state);
+  auto tf_buffer = costmap_ros->getTfBuffer();
+
+  PathHandlerWrapper handler, tensor_handler;
+  handler.initialize(node, "dummy", costmap_ros, tf_buffer, &param_handler);
+  tensor_handler.initialize(node, "dummy", costmap_ros, tf_buffer, &param_handler);
+
+  // Plan in a frame shifted and rotated from the costmap's
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = costmap_ros->getGlobalFrameID();
+  transform.child_frame_id = "odom";
+  transform.transform.translation.x = 0.5;
+  transform.transform.translation.y = -0.2;
+  transform.transform.rotation = nav2_util::geometry_utils::orientationAroundZAxis(0.3);
+  tf_buffer->setTransform(transform, "test", true);
+
+  nav_msgs::msg::Path path;
+  path.header.frame_id = "odom";
+  path.poses.resize(100);
+  for (unsigned int i = 0; i != path.poses.size(); i++) {
+    path.poses[i].pose.position.x = 0.1 * i;
+    path.poses[i].pose.position.y = 0.01 * i;
+    path.poses[i].pose.orientation = nav2_util::geometry_utils::orientationAroundZAxis(3.0);
+  }
+  handler.setPath(path);
+  tensor_handler.setPath(path);
+
+  geometry_msgs::msg::PoseStamped robot_pose;
+  robot_pose.header.frame_id = "odom";
+  robot_pose.pose.position.x = 1.0;
+
+  // The planar transform into tensors matches transforming each pose through TF
+  auto plan = handler.transformPath(robot_pose);
+  models::Path tensor_plan;
+  tensor_handler.transformPath(robot_pose, tensor_plan);
+  ASSERT_EQ(plan.poses.size(), tensor_plan.x.shape(0));
+  for (size_t i = 0; i != plan.poses.size(); i++) {
+    EXPECT_NEAR(plan.poses[i].pose.position.x, tensor_plan.x(i), 1e-5);
+    EXPECT_NEAR(plan.poses[i].pose.position.y, tensor_plan.y(i), 1e-5);
+    const double yaw = tf2::getYaw(plan.poses[i].pose.orientation);
+    EXPECT_NEAR(angles::shortest_angular_distance(yaw, tensor_plan.yaws(i)), 0.0, 1e-5);
+  }
+  EXPECT_EQ(handler.getPath().poses.size(), tensor_handler.getPath().poses.size());
+}
+
+TEST(PathHandlerTests, TestTransformCache)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>(
+    "dummy_costmap", "", "dummy_costmap", true);
+  ParametersHandler param_handler(node);
+  rclcpp_lifecycle::State state;
+  costmap_ros->on_configure(state);
+  auto tf_buffer = costmap_ros->getTfBuffer();
+
+  PathHandlerWrapper handler;
+  handler.initialize(node, "dummy", costmap_ros, tf_buffer, &param_handler);
+
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = costmap_ros->getGlobalFrameID();
+  transform.child_frame_id = "odom";
+  transform.transform.translation.x = 0.5;
+  transform.transform.rotation.w = 1.0;
+  tf_buffer->setTransform(transform, "test", true);
+
+  nav_msgs::msg::Path path;
+  path.header.frame_id = "odom";
+  path.poses.resize(100);
+  for (unsigned int i = 0; i != path.poses.size(); i++) {
+    path.poses[i].pose.position.x = 0.1 * i;
+  }
+  handler.setPath(path);
+
+  geometry_msgs::msg::PoseStamped robot_pose;
+  robot_pose.header.frame_id = "odom";
+  robot_pose.header.stamp.sec = 10;
+  robot_pose.pose.position.x = 1.0;
+
+  // One lookup for the whole window, shifted by the transform
+  auto plan = handler.transformPath(robot_pose);
+  ASSERT_GT(plan.poses.size(), 0u);
+  EXPECT_NEAR(plan.poses[0].pose.position.x, 1.5, 1e-6);
+  EXPECT_EQ(plan.poses[0].header.frame_id, costmap_ros->getGlobalFrameID());
+  EXPECT_EQ(handler.getTransformCacheStats().misses, 1u);
+  EXPECT_EQ(handler.getTransformCacheStats().hits, 0u);
+
+  // The same stamp is served from the cache, a new one is looked up again
+  handler.transformPath(robot_pose);
+  EXPECT_EQ(handler.getTransformCacheStats().hits, 1u);
+  robot_pose.header.stamp.sec = 11;
+  handler.transformPath(robot_pose);
+  EXPECT_EQ(handler.getTransformCacheStats().misses, 2u);
+  EXPECT_EQ(handler.getTransformCacheStats().failures, 0u);
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <limits>
+#include <optional>
+
+#include <xtensor/xrandom.hpp>
+#include "gtest/gtest.h"
+#include "mppic/tools/path_index.hpp"
+#include "mppic/tools/utils.hpp"
+
+// Tests the path spatial index against brute force search
+
+using namespace mppi;  // NOLINT
+
+PathIndex::Nearest bruteForceNearest(const models::Path & path, float x, float y, size_t end)
+{
+  PathIndex::Nearest best;
+  for (size_t i = 0; i < end; i++) {
+    const float dx = path.x(i) - x;
+    const float dy = path.y(i) - y;
+    const float dist_sq = dx * dx + dy * dy;
+    if (dist_sq < best.dist_sq) {
+      best.dist_sq = dist_sq;
+      best.idx = i;
+    }
+  }
+  return best;
+}
+
+models::Path getWindingPath(size_t size)
+{
+  models::Path path;
+  path.reset(size);
+  float heading = 0.0f;
+  for (size_t i = 1; i < size; i++) {
+    heading += 0.05f * std::sin(0.1f * i);
+    path.x(i) = path.x(i - 1) + 0.05f * std::cos(heading);
+    path.y(i) = path.y(i - 1) + 0.05f * std::sin(heading);
+  }
+  return path;
+}
+
+TEST(PathIndexTest, MatchesBruteForce)
+{
+  const auto path = getWindingPath(300);
+  PathIndex index;
+  index.build(path);
+  EXPECT_EQ(index.size(), 300u);
+  EXPECT_GT(index.getCellSize(), 0.0f);
+
+  // Near the path, far away from it and restricted to a leading part of it
+  const xt::xtensor<float, 1> xs = xt::random::rand<float>({2000}, -20.0, 30.0);
+  const xt::xtensor<float, 1> ys = xt::random::rand<float>({2000}, -20.0, 20.0);
+  for (size_t q = 0; q != xs.shape(0); q++) {
+    const size_t end = q % 3 == 0 ? path.x.shape(0) : q % path.x.shape(0);
+    const auto expected = bruteForceNearest(path, xs(q), ys(q), end);
+    const auto result = index.nearest(xs(q), ys(q), end);
+    EXPECT_EQ(result.idx, expected.idx);
+    EXPECT_EQ(result.dist_sq, expected.dist_sq);
+  }
+}
+
+TEST(PathIndexTest, EdgeCases)
+{
+  PathIndex index;
+  models::Path path;
+  path.reset(0);
+  index.build(path);
+  EXPECT_EQ(index.nearest(1.0f, 1.0f).idx, 0u);
+  EXPECT_EQ(index.nearest(1.0f, 1.0f).dist_sq, std::numeric_limits<float>::max());
+
+  // Duplicated points resolve to the lowest index, like a linear scan
+  path.reset(5);
+  path.x = xt::ones<float>({5});
+  path.y = xt::ones<float>({5});
+  path.x(0) = -1.0f;
+  index.build(path);
+  EXPECT_EQ(index.nearest(1.0f, 1.0f).idx, 1u);
+  EXPECT_EQ(index.nearest(1.0f, 1.0f).dist_sq, 0.0f);
+  EXPECT_EQ(index.nearest(1.0f, 1.0f, 1).idx, 0u);
+  EXPECT_EQ(index.nearest(1.0f, 1.0f, 0).dist_sq, std::numeric_limits<float>::max());
+
+  // Rebuilding for a different path replaces the previous one
+  path = getWindingPath(50);
+  index.build(path);
+  EXPECT_EQ(index.size(), 50u);
+  EXPECT_EQ(index.nearest(path.x(30), path.y(30)).idx, 30u);
+}
+
+TEST(PathIndexTest, SharedThroughCriticData)
+{
+  models::State state;
+  models::Trajectories trajectories;
+  trajectories.reset(100, 10);
+  trajectories.x = xt::random::rand<float>({100, 10}, -1.0, 10.0);
+  trajectories.y = xt::random::rand<float>({100, 10}, -3.0, 3.0);
+  const auto path = getWindingPath(200);
+  models::BatchTensor<1> costs = xt::zeros<float>({100});
+  float model_dt = 0.1;
+
+  PathIndex index;
+  index.build(path);
+
+  CriticData data =
+  {state, trajectories, path, costs, model_dt, false, nullptr, nullptr,
+    std::nullopt, std::nullopt};  /// Caution, keep references
+  CriticData indexed_data =
+  {state, trajectories, path, costs, model_dt, false, nullptr, nullptr,
+    std::nullopt, std::nullopt, nullptr, nullptr, &index};  /// Caution, keep references
+
+  EXPECT_EQ(
+    utils::findPathFurthestReachedPoint(indexed_data),
+    utils::findPathFurthestReachedPoint(data));
+  EXPECT_EQ(
+    utils::findPathTrajectoryInitialPoint(indexed_data),
+    utils::findPathTrajectoryInitialPoint(data));
+}
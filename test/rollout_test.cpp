@@ -0,0 +1,232 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <xtensor/xrandom.hpp>
+#include "gtest/gtest.h"
+#include "tf2/LinearMath/Quaternion.h"
+#include "mppic/tools/rollout.hpp"
+
+// Tests the fused rollout kernel against the reference implementation
+
+using namespace mppi;  // NOLINT
+
+models::State makeState(unsigned int batch_size, unsigned int time_steps)
+{
+  models::State state;
+  state.reset(batch_size, time_steps);
+  state.vx = xt::random::randn<float>({batch_size, time_steps}, 0.2f, 0.5f);
+  state.vy = xt::random::randn<float>({batch_size, time_steps}, 0.0f, 0.3f);
+  state.wz = xt::random::randn<float>({batch_size, time_steps}, 0.0f, 1.5f);
+
+  tf2::Quaternion quat;
+  quat.setRPY(0.0, 0.0, 2.9);
+  state.pose.pose.position.x = 3.5;
+  state.pose.pose.position.y = -1.25;
+  state.pose.pose.orientation.x = quat.x();
+  state.pose.pose.orientation.y = quat.y();
+  state.pose.pose.orientation.z = quat.z();
+  state.pose.pose.orientation.w = quat.w();
+  return state;
+}
+
+void expectTrajectoriesNear(
+  const models::Trajectories & lhs, const models::Trajectories & rhs, float tolerance)
+{
+  ASSERT_EQ(lhs.x.shape(), rhs.x.shape());
+  for (size_t i = 0; i != lhs.x.size(); i++) {
+    EXPECT_NEAR(lhs.x.data()[i], rhs.x.data()[i], tolerance);
+    EXPECT_NEAR(lhs.y.data()[i], rhs.y.data()[i], tolerance);
+    EXPECT_NEAR(
+      std::abs(angles::shortest_angular_distance(lhs.yaws.data()[i], rhs.yaws.data()[i])),
+      0.0, tolerance);
+  }
+}
+
+TEST(RolloutTest, FusedMatchesReference)
+{
+  // Batch size not a multiple of the SIMD width to exercise the scalar tail
+  const unsigned int batch_size = 1003, time_steps = 56;
+  const float model_dt = 0.1f;
+  auto state = makeState(batch_size, time_steps);
+
+  for (bool is_holonomic : {false, true}) {
+    models::Trajectories fused, reference;
+    fused.reset(batch_size, time_steps);
+    reference.reset(batch_size, time_steps);
+
+    rollout::integrate(fused, state, 0, batch_size, model_dt, is_holonomic);
+    rollout::integrateReference(reference, state, 0, batch_size, model_dt, is_holonomic);
+    expectTrajectoriesNear(fused, reference, 1e-3f);
+  }
+}
+
+TEST(RolloutTest, FastMathMatchesFused)
+{
+  const unsigned int batch_size = 1003, time_steps = 56;
+  const float model_dt = 0.1f;
+  auto state = makeState(batch_size, time_steps);
+
+  TiledTensor vx, vy, wz;
+  vx.pack(state.vx);
+  vy.pack(state.vy);
+  wz.pack(state.wz);
+
+  for (bool is_holonomic : {false, true}) {
+    models::Trajectories fused, fast;
+    fused.reset(batch_size, time_steps);
+    fast.reset(batch_size, time_steps);
+    rollout::integrate(fused, state, 0, batch_size, model_dt, is_holonomic);
+    rollout::integrate(fast, state, 0, batch_size, model_dt, is_holonomic, true);
+    expectTrajectoriesNear(fast, fused, 1e-4f);
+
+    TiledTensor x, y, yaws;
+    x.reset(batch_size, time_steps);
+    y.reset(batch_size, time_steps);
+    yaws.reset(batch_size, time_steps);
+    rollout::integrateTiles(
+      x, y, yaws, vx, vy, wz, state.pose.pose, 0, vx.tiles(), model_dt, is_holonomic, true);
+    models::Trajectories tiled;
+    x.unpack(tiled.x);
+    y.unpack(tiled.y);
+    yaws.unpack(tiled.yaws);
+    expectTrajectoriesNear(tiled, fast, 1e-5f);
+  }
+}
+
+TEST(RolloutTest, StoredYawTrigMatchesFused)
+{
+  const unsigned int batch_size = 1003, time_steps = 56;
+  const float model_dt = 0.1f;
+  auto state = makeState(batch_size, time_steps);
+
+  for (bool is_holonomic : {false, true}) {
+    models::Trajectories fused, trig;
+    fused.reset(batch_size, time_steps);
+    trig.reset(batch_size, time_steps, true);
+    EXPECT_FALSE(fused.hasYawTrig());
+    ASSERT_TRUE(trig.hasYawTrig());
+
+    rollout::integrate(fused, state, 0, batch_size, model_dt, is_holonomic);
+    rollout::integrate(trig, state, 0, batch_size, model_dt, is_holonomic);
+    expectTrajectoriesNear(trig, fused, 1e-4f);
+
+    for (size_t i = 0; i != trig.yaws.size(); i++) {
+      EXPECT_LE(std::abs(trig.yaws.data()[i]), M_PI + 1e-5);
+      EXPECT_NEAR(trig.yaw_cos.data()[i], std::cos(trig.yaws.data()[i]), 1e-5);
+      EXPECT_NEAR(trig.yaw_sin.data()[i], std::sin(trig.yaws.data()[i]), 1e-5);
+    }
+  }
+}
+
+TEST(RolloutTest, TiledMatchesFused)
+{
+  const unsigned int batch_size = 1003, time_steps = 56;
+  const float model_dt = 0.1f;
+  auto state = makeState(batch_size, time_steps);
+
+  TiledTensor vx, vy, wz;
+  vx.pack(state.vx);
+  vy.pack(state.vy);
+  wz.pack(state.wz);
+
+  for (bool is_holonomic : {false, true}) {
+    models::Trajectories fused, tiled;
+    fused.reset(batch_size, time_steps);
+    rollout::integrate(fused, state, 0, batch_size, model_dt, is_holonomic);
+
+    TiledTensor x, y, yaws;
+    x.reset(batch_size, time_steps);
+    y.reset(batch_size, time_steps);
+    yaws.reset(batch_size, time_steps);
+    rollout::integrateTiles(
+      x, y, yaws, vx, vy, wz, state.pose.pose, 0, vx.tiles(), model_dt, is_holonomic);
+    x.unpack(tiled.x);
+    y.unpack(tiled.y);
+    yaws.unpack(tiled.yaws);
+    expectTrajectoriesNear(tiled, fused, 1e-5f);
+  }
+}
+
+TEST(RolloutTest, FusedRespectsRange)
+{
+  // Trajectories outside of the range should be left untouched
+  const unsigned int batch_size = 40, time_steps = 12;
+  auto state = makeState(batch_size, time_steps);
+
+  models::Trajectories fused, reference;
+  fused.reset(batch_size, time_steps);
+  reference.reset(batch_size, time_steps);
+
+  rollout::integrate(fused, state, 3, 29, 0.1f, false);
+  rollout::integrateReference(reference, state, 3, 29, 0.1f, false);
+  expectTrajectoriesNear(fused, reference, 1e-4f);
+
+  for (size_t j = 0; j != time_steps; j++) {
+    EXPECT_EQ(fused.x(0, j), 0.0f);
+    EXPECT_EQ(fused.x(2, j), 0.0f);
+    EXPECT_EQ(fused.x(29, j), 0.0f);
+  }
+
+  EXPECT_NE(fused.x(3, 0), 0.0f);
+}
+
+TEST(RolloutTest, GrowingTimeStepsMatchReference)
+{
+  const unsigned int batch_size = 1003, time_steps = 56;
+  const float model_dt = 0.05f;
+  auto state = makeState(batch_size, time_steps);
+
+  models::OptimizerSettings settings;
+  settings.time_steps = time_steps;
+  settings.model_dt = model_dt;
+  settings.model_dt_max = 0.2f;
+  const auto model_dts = utils::getModelDts(settings);
+  EXPECT_FLOAT_EQ(model_dts(0), model_dt);
+  EXPECT_FLOAT_EQ(model_dts(time_steps - 1), 0.2f);
+
+  TiledTensor vx, vy, wz;
+  vx.pack(state.vx);
+  vy.pack(state.vy);
+  wz.pack(state.wz);
+
+  for (bool is_holonomic : {false, true}) {
+    models::Trajectories fused, reference, uniform, tiled;
+    fused.reset(batch_size, time_steps);
+    reference.reset(batch_size, time_steps);
+    uniform.reset(batch_size, time_steps);
+
+    rollout::integrate(
+      fused, state, 0, batch_size, model_dt, is_holonomic, false, model_dts.data());
+    rollout::integrateReference(
+      reference, state, 0, batch_size, model_dt, is_holonomic, model_dts.data());
+    expectTrajectoriesNear(fused, reference, 1e-3f);
+
+    TiledTensor x, y, yaws;
+    x.reset(batch_size, time_steps);
+    y.reset(batch_size, time_steps);
+    yaws.reset(batch_size, time_steps);
+    rollout::integrateTiles(
+      x, y, yaws, vx, vy, wz, state.pose.pose, 0, vx.tiles(), model_dt, is_holonomic, false,
+      model_dts.data());
+    x.unpack(tiled.x);
+    y.unpack(tiled.y);
+    yaws.unpack(tiled.yaws);
+    expectTrajectoriesNear(tiled, fused, 1e-5f);
+
+    // Only the first step is as long as the uniform one
+    rollout::integrate(uniform, state, 0, batch_size, model_dt, is_holonomic);
+    EXPECT_NEAR(uniform.x(0, 0), fused.x(0, 0), 1e-6f);
+    EXPECT_NE(uniform.x(0, time_steps - 1), fused.x(0, time_steps - 1));
+  }
+}
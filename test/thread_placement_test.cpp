@@ -0,0 +1,128 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mppic/tools/thread_placement.hpp"
+#include "mppic/tools/thread_pool.hpp"
+
+// Tests the placement of threads on CPUs and their scheduling
+
+using namespace mppi;  // NOLINT
+
+namespace
+{
+
+int firstAllowedCpu()
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+  for (int cpu = 0; cpu != CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &set)) {
+      return cpu;
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+
+TEST(ThreadPlacementTest, PlacementParameters)
+{
+  auto placement = makeThreadPlacement({0, 2}, "fifo", 50);
+  EXPECT_EQ(placement.cpus, (std::vector<int>{0, 2}));
+  EXPECT_EQ(placement.scheduling, models::ThreadScheduling::Fifo);
+  EXPECT_EQ(placement.priority, 50);
+
+  placement = makeThreadPlacement({}, "other", 5);
+  EXPECT_TRUE(placement.cpus.empty());
+  EXPECT_EQ(placement.scheduling, models::ThreadScheduling::Other);
+  EXPECT_EQ(placement.priority, 5);
+
+  EXPECT_THROW(makeThreadPlacement({-1}, "other", 0), std::runtime_error);
+  EXPECT_THROW(makeThreadPlacement({}, "rr", 0), std::runtime_error);
+  EXPECT_THROW(makeThreadPlacement({}, "fifo", 0), std::runtime_error);
+  EXPECT_THROW(makeThreadPlacement({}, "fifo", 100), std::runtime_error);
+  EXPECT_THROW(makeThreadPlacement({}, "other", 20), std::runtime_error);
+}
+
+TEST(ThreadPlacementTest, ApplyPlacement)
+{
+  // Run on their own threads, so the test process keeps its own placement
+  std::thread(
+    []() {
+      // A default placement leaves the thread as it is
+      std::string report;
+      EXPECT_TRUE(applyThreadPlacement(models::ThreadPlacement{}, report));
+      EXPECT_EQ(report, describeThreadPlacement());
+      EXPECT_NE(report.find("CPUs "), std::string::npos);
+      EXPECT_NE(report.find("SCHED_OTHER nice "), std::string::npos);
+
+      // Pinning to a CPU the thread may run on and lowering its priority are always allowed
+      const int cpu = firstAllowedCpu();
+      ASSERT_GE(cpu, 0);
+      auto placement = makeThreadPlacement({cpu}, "other", 19);
+      EXPECT_TRUE(applyThreadPlacement(placement, report));
+      EXPECT_EQ(report.find("CPUs " + std::to_string(cpu) + ","), 0u);
+      EXPECT_NE(report.find("SCHED_OTHER nice 19"), std::string::npos);
+    }).join();
+
+  std::thread(
+    []() {
+      // Real-time scheduling may not be permitted, which is reported rather than thrown
+      std::string report;
+      const bool applied = applyThreadPlacement(makeThreadPlacement({}, "fifo", 10), report);
+      if (applied) {
+        EXPECT_NE(report.find("SCHED_FIFO priority 10"), std::string::npos);
+      } else {
+        EXPECT_NE(report.find("cannot set SCHED_FIFO priority 10"), std::string::npos);
+      }
+    }).join();
+}
+
+TEST(ThreadPlacementTest, PoolWorkersPlacement)
+{
+  const int cpu = firstAllowedCpu();
+  ASSERT_GE(cpu, 0);
+
+  ThreadPool pool;
+  pool.initialize(3, makeThreadPlacement({cpu}, "other", 0));
+  const auto & reports = pool.getPlacementReports();
+  ASSERT_EQ(reports.size(), 2u);
+  for (const auto & report : reports) {
+    EXPECT_TRUE(report.applied);
+    EXPECT_EQ(report.description.find("CPUs " + std::to_string(cpu) + ","), 0u);
+  }
+
+  // The workers still split jobs as usual
+  std::vector<int> visits(100, 0);
+  pool.parallelFor(
+    visits.size(), [&](size_t begin, size_t end) {
+      for (size_t i = begin; i != end; i++) {
+        visits[i]++;
+      }
+    });
+  for (const int visit : visits) {
+    EXPECT_EQ(visit, 1);
+  }
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mppic/tools/thread_pool.hpp"
+
+// Tests the batch worker pool
+
+using namespace mppi;  // NOLINT
+
+TEST(ThreadPoolTest, ThreadPoolLifecycle)
+{
+  // Tests shuts down internal threads cleanly, also when reinitialized
+  ThreadPool pool;
+  EXPECT_EQ(pool.size(), 1u);
+  pool.initialize(4);
+  EXPECT_EQ(pool.size(), 4u);
+  pool.initialize(2);
+  EXPECT_EQ(pool.size(), 2u);
+  pool.shutdown();
+  EXPECT_EQ(pool.size(), 1u);
+
+  pool.initialize(0);
+  EXPECT_GE(pool.size(), 1u);
+}
+
+TEST(ThreadPoolTest, ThreadPoolCoversRange)
+{
+  ThreadPool pool;
+  pool.initialize(4);
+
+  // Every element should be visited exactly once per call, in contiguous chunks
+  std::vector<int> visits(1003, 0);
+  std::atomic<size_t> chunks{0};
+  for (unsigned int i = 0; i != 100; i++) {
+    pool.parallelFor(
+      visits.size(), [&](size_t begin, size_t end) {
+        EXPECT_LT(begin, end);
+        chunks++;
+        for (size_t j = begin; j != end; j++) {
+          visits[j]++;
+        }
+      });
+  }
+
+  EXPECT_EQ(chunks, 400u);
+  EXPECT_TRUE(std::all_of(visits.begin(), visits.end(), [](int v) {return v == 100;}));
+
+  // Smaller than the pool only creates as many chunks as elements
+  chunks = 0;
+  pool.parallelFor(2, [&](size_t, size_t) {chunks++;});
+  EXPECT_EQ(chunks, 2u);
+
+  // Empty ranges are processed inline
+  pool.parallelFor(0, [&](size_t begin, size_t end) {EXPECT_EQ(begin, end);});
+}
+
+TEST(ThreadPoolTest, SingleThreadRunsInline)
+{
+  ThreadPool pool;
+  pool.initialize(1);
+
+  size_t calls = 0;
+  pool.parallelFor(
+    1000, [&](size_t begin, size_t end) {
+      calls++;
+      EXPECT_EQ(begin, 0u);
+      EXPECT_EQ(end, 1000u);
+    });
+  EXPECT_EQ(calls, 1u);
+}
+
+TEST(ThreadPoolTest, WorkerExceptionsAreRethrown)
+{
+  ThreadPool pool;
+  pool.initialize(4);
+
+  // An exception thrown by a worker's chunk reaches the caller instead of terminating
+  const auto caller = std::this_thread::get_id();
+  std::atomic<bool> thrown_by_worker{false};
+  EXPECT_THROW(
+    pool.parallelFor(
+      400, [&](size_t begin, size_t) {
+        if (std::this_thread::get_id() != caller) {
+          thrown_by_worker = true;
+          throw std::runtime_error("chunk " + std::to_string(begin) + " failed");
+        }
+        // Leaves the chunks to the workers long enough for one of them to claim one
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }),
+    std::runtime_error);
+  EXPECT_TRUE(thrown_by_worker);
+
+  // So does one thrown by the caller's chunk, after the workers are done with theirs
+  EXPECT_THROW(
+    pool.parallelFor(
+      400, [&](size_t, size_t) {
+        if (std::this_thread::get_id() == caller) {
+          throw std::length_error("caller chunk failed");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }),
+    std::length_error);
+
+  // The pool keeps working after a failed job
+  std::atomic<size_t> visited{0};
+  pool.parallelFor(400, [&](size_t begin, size_t end) {visited += end - begin;});
+  EXPECT_EQ(visited, 400u);
+}
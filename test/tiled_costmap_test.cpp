@@ -0,0 +1,111 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <limits>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "mppic/tools/tiled_costmap.hpp"
+
+// Tests the tiled costmap mirror
+
+using namespace mppi;  // NOLINT
+
+TEST(TiledCostmapTest, MortonCode)
+{
+  EXPECT_EQ(TiledCostmap::mortonCode(0, 0), 0u);
+  EXPECT_EQ(TiledCostmap::mortonCode(1, 0), 1u);
+  EXPECT_EQ(TiledCostmap::mortonCode(0, 1), 2u);
+  EXPECT_EQ(TiledCostmap::mortonCode(1, 1), 3u);
+  EXPECT_EQ(TiledCostmap::mortonCode(2, 0), 4u);
+  EXPECT_EQ(TiledCostmap::mortonCode(3, 5), 0b100111u);
+  EXPECT_EQ(TiledCostmap::mortonCode(0xffff, 0xffff), 0xffffffffu);
+}
+
+TEST(TiledCostmapTest, MirrorsCostsAndDistances)
+{
+  // Neither side a multiple of the tiles, to exercise the partial tiles
+  nav2_costmap_2d::Costmap2D costmap(75, 50, 0.05, -1.0, 0.5, nav2_costmap_2d::FREE_SPACE);
+  for (unsigned int y = 0; y != 50; y++) {
+    for (unsigned int x = 0; x != 75; x++) {
+      costmap.setCost(x, y, static_cast<unsigned char>((x * 7 + y * 13) % 200));
+    }
+  }
+  costmap.setCost(10, 10, nav2_costmap_2d::LETHAL_OBSTACLE);
+  costmap.setCost(70, 45, nav2_costmap_2d::LETHAL_OBSTACLE);
+
+  TiledCostmap tiled;
+  tiled.update(costmap);
+  EXPECT_EQ(tiled.getCopiedCells(), 75u * 50u);
+  EXPECT_FALSE(tiled.hasDistances());
+  for (unsigned int y = 0; y != 50; y++) {
+    for (unsigned int x = 0; x != 75; x++) {
+      EXPECT_EQ(tiled.costAtCell(x, y), costmap.getCost(x, y));
+    }
+  }
+
+  // World queries land in the containing cell, outside is as given
+  EXPECT_EQ(
+    tiled.cost(-1.0 + 10 * 0.05 + 0.01, 0.5 + 10 * 0.05 + 0.01, 0),
+    nav2_costmap_2d::LETHAL_OBSTACLE);
+  EXPECT_EQ(
+    tiled.cost(-2.0, 0.0, nav2_costmap_2d::NO_INFORMATION), nav2_costmap_2d::NO_INFORMATION);
+
+  DistanceField field;
+  field.update(costmap, true);
+  tiled.updateDistances(field);
+  EXPECT_TRUE(tiled.hasDistances());
+  for (unsigned int y = 0; y != 50; y++) {
+    for (unsigned int x = 0; x != 75; x++) {
+      const float wx = -1.0f + (x + 0.5f) * 0.05f;
+      const float wy = 0.5f + (y + 0.5f) * 0.05f;
+      const float expected = field.distanceAtCell(x, y);
+      EXPECT_NEAR(tiled.distance(wx, wy), expected, expected * std::ldexp(1.0f, -11));
+    }
+  }
+  EXPECT_EQ(tiled.distance(-2.0, 0.0), std::numeric_limits<float>::max());
+
+  // Each cell is held once, plus the padding of the partial tiles
+  EXPECT_EQ(tiled.getMemoryUsage(), 3u * 2u * 32u * 32u * 3u + 6u * sizeof(size_t));
+}
+
+TEST(TiledCostmapTest, CopiesChangedTiles)
+{
+  nav2_costmap_2d::Costmap2D costmap(100, 100, 0.05, 0.0, 0.0, nav2_costmap_2d::FREE_SPACE);
+  CostmapSnapshot snapshot;
+  snapshot.update(costmap, false);
+
+  TiledCostmap tiled;
+  EXPECT_TRUE(tiled.update(snapshot));
+  EXPECT_EQ(tiled.getCopiedCells(), 100u * 100u);
+  EXPECT_FALSE(tiled.update(snapshot));
+  EXPECT_EQ(tiled.getCopiedCells(), 0u);
+
+  // A change copies its tile alone, even if mirrored a few snapshots later
+  costmap.setCost(40, 70, nav2_costmap_2d::LETHAL_OBSTACLE);
+  snapshot.update(costmap, false);
+  snapshot.update(costmap, false);
+  EXPECT_TRUE(tiled.update(snapshot));
+  EXPECT_EQ(tiled.getCopiedCells(), 32u * 32u);
+  EXPECT_EQ(tiled.costAtCell(40, 70), nav2_costmap_2d::LETHAL_OBSTACLE);
+  EXPECT_EQ(tiled.costAtCell(41, 70), nav2_costmap_2d::FREE_SPACE);
+
+  // Moving the map origin relays the tiles out
+  costmap.updateOrigin(1.0, 0.0);
+  snapshot.update(costmap, false);
+  EXPECT_TRUE(tiled.update(snapshot));
+  EXPECT_EQ(tiled.getCopiedCells(), 100u * 100u);
+  EXPECT_EQ(tiled.costAtCell(20, 70), nav2_costmap_2d::LETHAL_OBSTACLE);
+}
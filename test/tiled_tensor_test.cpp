@@ -0,0 +1,61 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <xtensor/xrandom.hpp>
+#include "gtest/gtest.h"
+#include "mppic/tools/tiled_tensor.hpp"
+
+// Tests the tiled batch x time layout
+
+using namespace mppi;  // NOLINT
+
+TEST(TiledTensorTest, PackUnpack)
+{
+  // Batch size not a multiple of the tile size to exercise the padded last tile
+  const size_t batch_size = 2 * TiledTensor::tile_size + 3, time_steps = 7;
+  const xt::xtensor<float, 2> tensor = xt::random::randn<float>({batch_size, time_steps});
+
+  TiledTensor tiled;
+  tiled.pack(tensor);
+  EXPECT_EQ(tiled.batchSize(), batch_size);
+  EXPECT_EQ(tiled.timeSteps(), time_steps);
+  EXPECT_EQ(tiled.tiles(), 3u);
+
+  // A time step of a tile holds consecutive trajectories
+  for (size_t i = 0; i != batch_size; i++) {
+    for (size_t t = 0; t != time_steps; t++) {
+      EXPECT_EQ(tiled(i, t), tensor(i, t));
+      EXPECT_EQ(tiled.at(i / TiledTensor::tile_size, t)[i % TiledTensor::tile_size], tensor(i, t));
+    }
+  }
+  for (size_t l = 3; l != TiledTensor::tile_size; l++) {
+    EXPECT_EQ(tiled.at(2, time_steps - 1)[l], 0.0f);
+  }
+
+  xt::xtensor<float, 2> unpacked;
+  tiled.unpack(unpacked);
+  EXPECT_EQ(unpacked, tensor);
+
+  // Loads and stores a whole time step of a tile
+  tiled.store(1, 4, tiled.load(0, 2));
+  for (size_t l = 0; l != TiledTensor::tile_size; l++) {
+    EXPECT_EQ(tiled(TiledTensor::tile_size + l, 4), tensor(l, 2));
+  }
+
+  // Reset zeroes, including storage reused from a larger size
+  tiled.reset(5, 3);
+  EXPECT_EQ(tiled.tiles(), 1u);
+  tiled.unpack(unpacked);
+  EXPECT_EQ(unpacked, xt::zeros<float>({5, 3}));
+}
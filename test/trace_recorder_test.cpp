@@ -0,0 +1,124 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "mppic/tools/latency_profiler.hpp"
+#include "mppic/tools/trace_recorder.hpp"
+
+// Tests the per thread trace event timeline
+
+using namespace mppi;  // NOLINT
+
+TEST(TraceRecorderTest, RecordsOnlyWhenEnabled)
+{
+  TraceRecorder recorder;
+  const uint32_t stage = recorder.addName("stage");
+  EXPECT_EQ(recorder.addName("other"), stage + 1);
+  EXPECT_EQ(recorder.addName("stage"), stage);
+  EXPECT_EQ(recorder.getName(stage), "stage");
+
+  {
+    ScopedTrace trace(&recorder, stage);
+  }
+  EXPECT_TRUE(recorder.collect().empty());
+
+  recorder.setEnabled(true);
+  {
+    ScopedTrace trace(&recorder, stage);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const auto events = recorder.collect();
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_EQ(events[0].name, stage);
+  EXPECT_GE(events[0].duration_ns, 1000000);
+  EXPECT_GE(events[0].begin_ns, 0);
+
+  // A null recorder is a no-op
+  ScopedTrace trace(nullptr, stage);
+}
+
+TEST(TraceRecorderTest, KeepsLastEventsOfEveryThread)
+{
+  TraceRecorder recorder;
+  recorder.setBufferSize(10);
+  recorder.setEnabled(true);
+  const uint32_t main_stage = recorder.addName("main");
+  const uint32_t worker_stage = recorder.addName("worker");
+
+  const auto now = std::chrono::steady_clock::now();
+  for (int i = 0; i != 25; i++) {
+    recorder.record(
+      main_stage, now + std::chrono::microseconds(i), now + std::chrono::microseconds(i + 1));
+  }
+  std::thread worker([&]() {
+      recorder.nameThread("worker thread");
+      for (int i = 0; i != 3; i++) {
+        recorder.record(worker_stage, now, now + std::chrono::microseconds(i));
+      }
+    });
+  worker.join();
+
+  const auto events = recorder.collect();
+  ASSERT_EQ(events.size(), 13u);
+  for (size_t i = 0; i != 10; i++) {
+    EXPECT_EQ(events[i].name, main_stage);
+    EXPECT_EQ(events[i].begin_ns, events[0].begin_ns + static_cast<int64_t>(i) * 1000);
+  }
+  EXPECT_EQ(events[10].name, worker_stage);
+  EXPECT_NE(events[10].thread, events[0].thread);
+  EXPECT_EQ(events[12].duration_ns, 2000);
+
+  std::stringstream json;
+  EXPECT_EQ(recorder.writeJson(json), 13u);
+  const std::string text = json.str();
+  EXPECT_EQ(text.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0u);
+  EXPECT_NE(text.find("\"args\":{\"name\":\"worker thread\"}"), std::string::npos);
+  EXPECT_NE(text.find("{\"name\":\"worker\",\"cat\":\"mppi\",\"ph\":\"X\""), std::string::npos);
+  EXPECT_NE(text.find("\"dur\":2.000}"), std::string::npos);
+}
+
+TEST(TraceRecorderTest, TracesProfiledStages)
+{
+  // Entries registered before and after the recorder is set are both traced
+  LatencyProfiler profiler;
+  const size_t first = profiler.addEntry("first");
+  TraceRecorder recorder;
+  recorder.setEnabled(true);
+  profiler.setTraceRecorder(&recorder);
+  const size_t second = profiler.addEntry("second");
+
+  {
+    ScopedLatencyTimer timer(&profiler, second);
+  }
+  {
+    ScopedLatencyTimer timer(&profiler, first);
+  }
+  const auto events = recorder.collect();
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_EQ(recorder.getName(events[0].name), "second");
+  EXPECT_EQ(recorder.getName(events[1].name), "first");
+  EXPECT_EQ(profiler.getStats("first")->count, 1u);
+
+  profiler.setTraceRecorder(nullptr);
+  {
+    ScopedLatencyTimer timer(&profiler, first);
+  }
+  EXPECT_EQ(recorder.collect().size(), 2u);
+  EXPECT_EQ(profiler.getStats("first")->count, 2u);
+}
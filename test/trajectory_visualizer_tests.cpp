@@ -66,6 +66,34 @@ TEST(TrajectoryVisualizerTests, VisPathRepub)
   EXPECT_EQ(recieved_path.header.frame_id, "fake_frame");
 }
 
+TEST(TrajectoryVisualizerTests, VisTensorPathRepub)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  auto parameters_handler = std::make_unique<ParametersHandler>(node);
+  nav_msgs::msg::Path recieved_path;
+  models::Path pub_path;
+  pub_path.reset(5);
+  pub_path.x(4) = 2.0;
+  pub_path.yaws(4) = 1.0;
+
+  auto my_sub = node->create_subscription<nav_msgs::msg::Path>(
+    "transformed_global_plan", 10,
+    [&](const nav_msgs::msg::Path msg) {recieved_path = msg;});
+
+  TrajectoryVisualizer vis;
+  vis.on_configure(node, "my_name", "map", parameters_handler.get());
+  vis.on_activate();
+  builtin_interfaces::msg::Time stamp;
+  vis.visualize(pub_path, stamp);
+
+  // The message is built in the visualizer's frame from the path tensors
+  rclcpp::spin_some(node->get_node_base_interface());
+  ASSERT_EQ(recieved_path.poses.size(), 5u);
+  EXPECT_EQ(recieved_path.header.frame_id, "map");
+  EXPECT_EQ(recieved_path.poses[4].pose.position.x, 2.0);
+  EXPECT_NEAR(tf2::getYaw(recieved_path.poses[4].pose.orientation), 1.0, 1e-6);
+}
+
 TEST(TrajectoryVisualizerTests, VisOptimalTrajectory)
 {
   auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
@@ -153,3 +181,139 @@ TEST(TrajectoryVisualizerTests, VisCandidateTrajectories)
   // 40 * 4, for 5 trajectory steps + 3 point steps
   EXPECT_EQ(recieved_msg.markers.size(), 160u);
 }
+
+TEST(TrajectoryVisualizerTests, VisLineStrips)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  node->declare_parameter("my_name.TrajectoryVisualizer.line_strips", rclcpp::ParameterValue(true));
+  auto parameters_handler = std::make_unique<ParametersHandler>(node);
+
+  TrajectoryVisualizer vis;
+  vis.on_configure(node, "my_name", "fkmap", parameters_handler.get());
+  vis.on_activate();
+
+  // Nothing to build without subscribers
+  EXPECT_FALSE(vis.shouldVisualizeTrajectories());
+  vis.reset();
+
+  visualization_msgs::msg::MarkerArray recieved_msg;
+  size_t recieved_count = 0;
+  auto my_sub = node->create_subscription<visualization_msgs::msg::MarkerArray>(
+    "/trajectories", 10,
+    [&](const visualization_msgs::msg::MarkerArray msg) {
+      recieved_msg = msg;
+      recieved_count++;
+    });
+
+  models::Trajectories candidate_trajectories;
+  candidate_trajectories.x = xt::ones<float>({200, 12});
+  candidate_trajectories.y = xt::ones<float>({200, 12});
+  candidate_trajectories.yaws = xt::ones<float>({200, 12});
+  xt::xtensor<float, 2> optimal_trajectory = xt::ones<float>({20, 2});
+  nav_msgs::msg::Path bogus_path;
+
+  // Same markers over cycles, reusing their storage
+  for (size_t cycle = 0; cycle != 2; cycle++) {
+    EXPECT_TRUE(vis.shouldVisualizeTrajectories());
+    vis.add(candidate_trajectories);
+    vis.add(optimal_trajectory);
+    vis.visualize(bogus_path);
+    rclcpp::spin_some(node->get_node_base_interface());
+
+    // 40 candidate strips of 4 vertices, for 5 trajectory steps + 3 point steps
+    ASSERT_EQ(recieved_msg.markers.size(), 41u);
+    const auto & candidate = recieved_msg.markers[0];
+    EXPECT_EQ(candidate.type, visualization_msgs::msg::Marker::LINE_STRIP);
+    EXPECT_EQ(candidate.header.frame_id, "fkmap");
+    EXPECT_EQ(candidate.points.size(), 4u);
+    EXPECT_EQ(candidate.colors.size(), 4u);
+    EXPECT_LT(candidate.colors[0].g, candidate.colors[3].g);
+    EXPECT_GT(candidate.colors[0].b, candidate.colors[3].b);
+
+    const auto & optimal = recieved_msg.markers[40];
+    EXPECT_EQ(optimal.id, 40);
+    EXPECT_EQ(optimal.points.size(), 20u);
+    EXPECT_EQ(optimal.points[19].x, 1.0);
+    EXPECT_EQ(optimal.points[19].z, 0.06);
+  }
+  EXPECT_EQ(recieved_count, 2u);
+}
+
+TEST(TrajectoryVisualizerTests, VisPublishRate)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  node->declare_parameter(
+    "my_name.TrajectoryVisualizer.publish_rate", rclcpp::ParameterValue(0.01));
+  auto parameters_handler = std::make_unique<ParametersHandler>(node);
+
+  size_t recieved_count = 0;
+  auto my_sub = node->create_subscription<visualization_msgs::msg::MarkerArray>(
+    "/trajectories", 10,
+    [&](const visualization_msgs::msg::MarkerArray) {recieved_count++;});
+
+  TrajectoryVisualizer vis;
+  vis.on_configure(node, "my_name", "fkmap", parameters_handler.get());
+  vis.on_activate();
+
+  // Published on the first cycle, then not before 100 s
+  xt::xtensor<float, 2> optimal_trajectory = xt::ones<float>({20, 2});
+  nav_msgs::msg::Path bogus_path;
+  for (size_t cycle = 0; cycle != 3; cycle++) {
+    EXPECT_EQ(vis.shouldVisualizeTrajectories(), cycle == 0);
+    vis.add(optimal_trajectory);
+    vis.visualize(bogus_path);
+    rclcpp::spin_some(node->get_node_base_interface());
+  }
+  EXPECT_EQ(recieved_count, 1u);
+}
+
+TEST(TrajectoryVisualizerTests, VisAsync)
+{
+  auto node = std::make_shared<rclcpp_lifecycle::LifecycleNode>("my_node");
+  node->declare_parameter("my_name.TrajectoryVisualizer.async", rclcpp::ParameterValue(true));
+  auto parameters_handler = std::make_unique<ParametersHandler>(node);
+
+  visualization_msgs::msg::MarkerArray recieved_msg;
+  nav_msgs::msg::Path recieved_path;
+  auto my_sub = node->create_subscription<visualization_msgs::msg::MarkerArray>(
+    "/trajectories", 10,
+    [&](const visualization_msgs::msg::MarkerArray msg) {recieved_msg = msg;});
+  auto path_sub = node->create_subscription<nav_msgs::msg::Path>(
+    "transformed_global_plan", 10,
+    [&](const nav_msgs::msg::Path msg) {recieved_path = msg;});
+
+  TrajectoryVisualizer vis;
+  vis.on_configure(node, "my_name", "fkmap", parameters_handler.get());
+  vis.on_activate();
+
+  models::Trajectories candidate_trajectories;
+  candidate_trajectories.x = xt::ones<float>({200, 12});
+  candidate_trajectories.y = xt::ones<float>({200, 12});
+  candidate_trajectories.yaws = xt::ones<float>({200, 12});
+  models::Path plan;
+  plan.reset(5);
+  plan.x(4) = 2.0;
+  builtin_interfaces::msg::Time stamp;
+
+  // The trajectories are copied, so they may change right after the hand off
+  vis.add(candidate_trajectories);
+  vis.visualize(plan, stamp);
+  candidate_trajectories.x.fill(3.0f);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  rclcpp::spin_some(node->get_node_base_interface());
+  ASSERT_EQ(recieved_msg.markers.size(), 160u);
+  EXPECT_EQ(recieved_msg.markers[0].pose.position.x, 1.0);
+  ASSERT_EQ(recieved_path.poses.size(), 5u);
+  EXPECT_EQ(recieved_path.poses[4].pose.position.x, 2.0);
+
+  // Handing off never waits for the publisher thread, frames are dropped instead
+  for (size_t cycle = 0; cycle != 100; cycle++) {
+    vis.add(candidate_trajectories);
+    vis.visualize(plan, stamp);
+  }
+  EXPECT_LT(vis.getDroppedFrames(), 100u);
+
+  vis.on_deactivate();
+  vis.on_cleanup();
+}
@@ -12,7 +12,10 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <limits>
 #include <thread>
 
 #include <xtensor/xrandom.hpp>
@@ -202,7 +205,7 @@ TEST(UtilsTests, FurthestAndClosestReachedPoint)
   models::State state;
   models::Trajectories generated_trajectories;
   models::Path path;
-  xt::xtensor<float, 1> costs;
+  models::BatchTensor<1> costs;
   float model_dt = 0.1;
 
   CriticData data =
@@ -239,6 +242,97 @@ TEST(UtilsTests, FurthestAndClosestReachedPoint)
     std::nullopt, std::nullopt};  /// Caution, keep references
   EXPECT_EQ(findPathFurthestReachedPoint(data3), 5u);
   EXPECT_EQ(findPathTrajectoryInitialPoint(data3), 5u);
+
+  // Each trajectory reaches its own nearest point, however near another one got
+  generated_trajectories.x = xt::zeros<float>({2, 2});
+  generated_trajectories.y = xt::zeros<float>({2, 2});
+  generated_trajectories.x(0, 1) = 0.4;
+  generated_trajectories.x(1, 1) = 1.4;
+  generated_trajectories.y(1, 1) = 0.1;
+  EXPECT_EQ(findPathFurthestReachedPoint(data3), 7u);
+}
+
+TEST(UtilsTests, FurthestReachedPointMatchesBruteForce)
+{
+  // Winding path, so that skipping path points along it is put to the test
+  models::Path path;
+  path.reset(300);
+  for (size_t j = 0; j != 300; j++) {
+    const float s = 0.05f * j;
+    path.x(j) = s;
+    path.y(j) = std::sin(s);
+  }
+
+  for (size_t batch_size : {1u, 15u, 16u, 17u, 1000u}) {
+    xt::xtensor<float, 2> x = xt::random::rand<float>({batch_size, 3}, -1.0, 16.0);
+    xt::xtensor<float, 2> y = xt::random::rand<float>({batch_size, 3}, -2.0, 2.0);
+
+    size_t expected = 0;
+    for (size_t i = 0; i != batch_size; i++) {
+      float best = std::numeric_limits<float>::max();
+      size_t best_id = 0;
+      for (size_t j = 0; j != 300; j++) {
+        const float dx = x(i, 2) - path.x(j);
+        const float dy = y(i, 2) - path.y(j);
+        if (dx * dx + dy * dy < best) {
+          best = dx * dx + dy * dy;
+          best_id = j;
+        }
+      }
+      expected = std::max(expected, best_id);
+    }
+
+    EXPECT_EQ(findFurthestNearestPathPoint(path, x.data() + 2, y.data() + 2, 3, batch_size),
+      expected) << batch_size;
+  }
+  EXPECT_EQ(findFurthestNearestPathPoint(path, nullptr, nullptr, 3, 0), 0u);
+}
+
+TEST(UtilsTests, CycleContextMemoization)
+{
+  models::State state;
+  models::Trajectories generated_trajectories;
+  models::Path path;
+  models::BatchTensor<1> costs;
+  float model_dt = 0.1;
+  CycleContext cycle_context;
+
+  CriticData data =
+  {state, generated_trajectories, path, costs, model_dt, false, nullptr, nullptr,
+    std::nullopt, std::nullopt};  /// Caution, keep references
+  data.cycle_context = &cycle_context;
+
+  generated_trajectories.x = xt::ones<float>({100, 2});
+  generated_trajectories.y = xt::zeros<float>({100, 2});
+  generated_trajectories.yaws = xt::zeros<float>({100, 2});
+
+  nav_msgs::msg::Path plan;
+  plan.poses.resize(10);
+  for (unsigned int i = 0; i != plan.poses.size(); i++) {
+    plan.poses[i].pose.position.x = 0.2 * i;
+    plan.poses[i].pose.position.y = 0.0;
+  }
+  path = toTensor(plan);
+  state.pose.pose.position.x = 1.6;
+
+  EXPECT_EQ(findPathTrajectoryInitialPoint(data), 5u);
+  EXPECT_TRUE(withinPositionGoalTolerance(0.25f, data));
+  EXPECT_FALSE(withinPositionGoalTolerance(0.1f, data));
+
+  // Within a cycle, results hold even if the inputs they depend on are changed
+  generated_trajectories.x = xt::zeros<float>({100, 2});
+  state.pose.pose.position.x = 0.0;
+  EXPECT_EQ(findPathTrajectoryInitialPoint(data), 5u);
+  EXPECT_TRUE(withinPositionGoalTolerance(0.25f, data));
+  EXPECT_FALSE(withinPositionGoalTolerance(0.1f, data));
+
+  // A new cycle recomputes them
+  cycle_context.reset();
+  EXPECT_EQ(findPathTrajectoryInitialPoint(data), 0u);
+  EXPECT_FALSE(withinPositionGoalTolerance(0.25f, data));
+
+  // Without a goal checker, never within its tolerance
+  EXPECT_FALSE(withinPositionGoalTolerance(data));
 }
 
 TEST(UtilsTests, findPathCosts)
@@ -246,7 +340,7 @@ TEST(UtilsTests, findPathCosts)
   models::State state;
   models::Trajectories generated_trajectories;
   models::Path path;
-  xt::xtensor<float, 1> costs;
+  models::BatchTensor<1> costs;
   float model_dt = 0.1;
 
   CriticData data =
@@ -303,6 +397,58 @@ TEST(UtilsTests, findPathCosts)
   }
 }
 
+TEST(UtilsTests, GatherCosts)
+{
+  // 5x5m costmap at 10cm resolution with an offset origin
+  nav2_costmap_2d::Costmap2D costmap(50, 50, 0.1, -1.0, 2.0, nav2_costmap_2d::FREE_SPACE);
+  for (unsigned int i = 0; i != 50; i++) {
+    for (unsigned int j = 0; j != 50; j++) {
+      costmap.setCost(i, j, static_cast<unsigned char>((i * 7 + j * 3) % 256));
+    }
+  }
+
+  // Odd number of time steps to exercise the scalar tail
+  models::Trajectories trajectories;
+  trajectories.reset(20, 37);
+  // Points are kept away from cell borders, where float and double rounding may differ
+  const xt::xtensor<float, 2> cell_x =
+    xt::floor(xt::random::rand<float>({20, 37}, -10.0, 60.0));
+  const xt::xtensor<float, 2> cell_y =
+    xt::floor(xt::random::rand<float>({20, 37}, -10.0, 60.0));
+  const xt::xtensor<float, 2> jitter_x = xt::random::rand<float>({20, 37}, 0.1, 0.9);
+  const xt::xtensor<float, 2> jitter_y = xt::random::rand<float>({20, 37}, 0.1, 0.9);
+  trajectories.x = -1.0f + (cell_x + jitter_x) * 0.1f;
+  trajectories.y = 2.0f + (cell_y + jitter_y) * 0.1f;
+  trajectories.x(3, 5) = std::numeric_limits<float>::quiet_NaN();
+
+  xt::xtensor<float, 2> costs;
+  gatherCosts(costmap, trajectories, costs, 255.0f);
+  ASSERT_EQ(costs.shape(0), 20u);
+  ASSERT_EQ(costs.shape(1), 37u);
+
+  unsigned int mx, my;
+  size_t out_of_bounds = 0;
+  for (size_t i = 0; i != 20; i++) {
+    for (size_t j = 0; j != 37; j++) {
+      if (costmap.worldToMap(trajectories.x(i, j), trajectories.y(i, j), mx, my)) {
+        EXPECT_EQ(costs(i, j), costmap.getCost(mx, my));
+      } else {
+        EXPECT_EQ(costs(i, j), 255.0f);
+        out_of_bounds++;
+      }
+    }
+  }
+  EXPECT_GT(out_of_bounds, 0u);
+  EXPECT_EQ(costs(3, 5), 255.0f);
+
+  // A range only writes its own trajectories
+  xt::xtensor<float, 2> partial = xt::zeros<float>({20, 37});
+  gatherCosts(costmap, trajectories, partial, 5, 10, 255.0f);
+  EXPECT_TRUE(xt::view(partial, xt::range(5, 10), xt::all()) ==
+    xt::view(costs, xt::range(5, 10), xt::all()));
+  EXPECT_EQ(xt::amax(xt::view(partial, xt::range(0, 5), xt::all()))(), 0.0f);
+}
+
 TEST(UtilsTests, SmootherTest)
 {
   models::ControlSequence noisey_sequence, sequence_init;
@@ -355,3 +501,43 @@ TEST(UtilsTests, SmootherTest)
 
   EXPECT_LT(smoothed_val, original_val);
 }
+
+TEST(UtilsTests, SmootherWindowsTest)
+{
+  // Quadratic coefficients keep constant and linear sequences as they are
+  std::array<float, 12> ramp, constant;
+  for (size_t i = 0; i != ramp.size(); i++) {
+    ramp[i] = static_cast<float>(i);
+    constant[i] = 2.0f;
+  }
+  std::array<std::array<float, 3>, 2> history = {{{-3.0f, -2.0f, -1.0f}, {2.0f, 2.0f, 2.0f}}};
+  savitzkyGolaySmooth<7, 2>({ramp.data(), constant.data()}, history, ramp.size());
+  for (size_t i = 0; i != ramp.size() - 3; i++) {
+    EXPECT_NEAR(ramp[i], static_cast<float>(i), 1e-5);
+    EXPECT_NEAR(constant[i], 2.0f, 1e-5);
+  }
+
+  // Every window smooths noise, with the history shifted by one control
+  for (unsigned int window : {5u, 7u, 9u}) {
+    models::ControlSequence sequence;
+    sequence.reset(30);
+    sequence.vx = 0.2 + xt::random::randn<float>({30}, 0.0, 0.2);
+    sequence.wz = 0.3 + xt::random::randn<float>({30}, 0.0, 0.2);
+    const models::ControlSequence sequence_init = sequence;
+
+    std::array<mppi::models::Control, 4> history;
+    history.fill({0.2f, 0.0f, 0.3f});
+    history[0].vx = 0.1f;
+    models::OptimizerSettings settings;
+    settings.smoothing_window = window;
+    savitskyGolayFilter(sequence, history, settings);
+
+    EXPECT_EQ(history[0].vx, 0.2f);
+    EXPECT_EQ(history[3].vx, sequence.vx(0));
+    const float smoothed = xt::sum(xt::abs(sequence.vx - 0.2f))() +
+      xt::sum(xt::abs(sequence.wz - 0.3f))();
+    const float original = xt::sum(xt::abs(sequence_init.vx - 0.2f))() +
+      xt::sum(xt::abs(sequence_init.wz - 0.3f))();
+    EXPECT_LT(smoothed, original);
+  }
+}
@@ -0,0 +1,232 @@
+// Copyright (c) 2022 Samsung Research America, @artofnothingness Alexey Budyakov
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "rclcpp/rclcpp.hpp"
+#include "mppic/optimizer.hpp"
+#include "mppic/tools/workspace.hpp"
+
+// Tests the scratch workspace and that steady state control evaluation does not allocate
+
+// Counts heap allocations of the tracked threads while counting is enabled: the test
+// thread and the threads started once tracking new threads is enabled, such as the
+// optimizer's workers and noise thread, but not the middleware's which allocate on their
+// own schedule. xtensor's aligned allocator and operator new both go through malloc
+std::atomic<bool> g_count_allocations{false};
+std::atomic<bool> g_track_new_threads{false};
+std::atomic<size_t> g_allocations{0};
+thread_local bool t_tracked = g_track_new_threads.load();
+
+#ifdef __GLIBC__
+extern "C" void * __libc_malloc(size_t size);
+
+extern "C" void * malloc(size_t size)
+{
+  if (g_count_allocations.load(std::memory_order_relaxed) && t_tracked) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  return __libc_malloc(size);
+}
+#endif
+
+class RosLockGuard
+{
+public:
+  RosLockGuard() {rclcpp::init(0, nullptr);}
+  ~RosLockGuard() {rclcpp::shutdown();}
+};
+RosLockGuard g_rclcpp;
+
+using namespace mppi;  // NOLINT
+
+namespace
+{
+
+models::Path straightPath(size_t size, float spacing)
+{
+  models::Path path;
+  path.reset(size);
+  for (size_t i = 0; i != size; i++) {
+    path.x(i) = spacing * i;
+  }
+  return path;
+}
+
+// Heap allocations of the control evaluations of a few cycles once warmed up on the plan
+size_t steadyStateAllocations(
+  Optimizer & optimizer, const models::Path & plan, float yaw)
+{
+  geometry_msgs::msg::PoseStamped pose;
+  pose.pose.orientation.z = std::sin(yaw / 2.0f);
+  pose.pose.orientation.w = std::cos(yaw / 2.0f);
+  geometry_msgs::msg::Twist speed;
+  speed.linear.x = 0.2;
+  builtin_interfaces::msg::Time stamp;
+
+  // The optimizer swaps the path in, handing back the previous cycle's one
+  models::Path path;
+  for (unsigned int i = 0; i != 3; i++) {
+    path = plan;
+    optimizer.evalControl(pose, speed, path, stamp, nullptr);
+  }
+
+  g_allocations = 0;
+  g_count_allocations = true;
+  for (unsigned int i = 0; i != 5; i++) {
+    optimizer.evalControl(pose, speed, path, stamp, nullptr);
+  }
+  g_count_allocations = false;
+  return g_allocations;
+}
+
+}  // namespace
+
+TEST(WorkspaceTest, BatchBufferLeases)
+{
+  Workspace workspace;
+  workspace.reset(100);
+  const size_t initial_buffers = workspace.numBatchBuffers();
+  EXPECT_GT(initial_buffers, 1u);
+
+  const float * first_data = nullptr;
+  {
+    auto buffer = workspace.batchBuffer(100);
+    EXPECT_EQ(buffer->shape(0), 100u);
+    EXPECT_EQ(xt::amax(*buffer)(), 0.0f);
+    first_data = buffer->data();
+    buffer->fill(5.0f);
+  }
+
+  // A released buffer is handed out again, zeroed
+  {
+    auto buffer = workspace.batchBuffer(100);
+    EXPECT_EQ(buffer->data(), first_data);
+    EXPECT_EQ(xt::amax(*buffer)(), 0.0f);
+
+    // Concurrent leases get distinct buffers
+    auto other = workspace.batchBuffer(100);
+    EXPECT_NE(other->data(), buffer->data());
+  }
+
+  // Leasing more buffers than available grows the workspace once
+  {
+    std::vector<std::unique_ptr<ScratchBuffer>> leases;
+    for (size_t i = 0; i != initial_buffers + 2; i++) {
+      leases.push_back(std::make_unique<ScratchBuffer>(&workspace, 100));
+    }
+  }
+  EXPECT_EQ(workspace.numBatchBuffers(), initial_buffers + 2);
+
+  // Without a workspace, the buffer owns its storage
+  ScratchBuffer local(nullptr, 10);
+  EXPECT_EQ(local->shape(0), 10u);
+  EXPECT_EQ(xt::amax(*local)(), 0.0f);
+}
+
+TEST(WorkspaceTest, PathValidityReused)
+{
+  Workspace workspace;
+  std::optional<std::vector<bool>> path_pts_valid;
+
+  workspace.acquirePathValidity(path_pts_valid, 50);
+  ASSERT_TRUE(path_pts_valid.has_value());
+  EXPECT_EQ(path_pts_valid->size(), 50u);
+  const size_t capacity = path_pts_valid->capacity();
+
+  workspace.releasePathValidity(path_pts_valid);
+  EXPECT_FALSE(path_pts_valid.has_value());
+
+  // Storage moves back without reallocating for smaller or equal sizes
+  workspace.acquirePathValidity(path_pts_valid, 40);
+  EXPECT_EQ(path_pts_valid->size(), 40u);
+  EXPECT_EQ(path_pts_valid->capacity(), capacity);
+  for (size_t i = 0; i != path_pts_valid->size(); i++) {
+    EXPECT_FALSE((*path_pts_valid)[i]);
+  }
+}
+
+TEST(WorkspaceTest, PathLengthsReused)
+{
+  Workspace workspace;
+  std::vector<float> path_lengths;
+
+  workspace.acquirePathLengths(path_lengths, 50);
+  EXPECT_EQ(path_lengths.size(), 50u);
+  path_lengths.back() = 1.0f;
+  const float * data = path_lengths.data();
+  workspace.releasePathLengths(path_lengths);
+
+  // Storage moves back zeroed without reallocating for smaller or equal sizes
+  std::vector<float> other;
+  workspace.acquirePathLengths(other, 40);
+  EXPECT_EQ(other.size(), 40u);
+  EXPECT_EQ(other.data(), data);
+  for (const float length : other) {
+    EXPECT_EQ(length, 0.0f);
+  }
+}
+
+TEST(WorkspaceTest, ControlEvaluationSteadyStateDoesNotAllocate)
+{
+#ifndef __GLIBC__
+  GTEST_SKIP() << "malloc counting requires glibc";
+#endif
+  t_tracked = true;
+
+  // Free space, but for an obstacle beside the path, with the inflation to repel from it
+  nav2_costmap_2d::Costmap2D costmap(100, 100, 0.05, -2.5, -2.5, nav2_costmap_2d::FREE_SPACE);
+  for (unsigned int i = 55; i != 65; i++) {
+    costmap.setCost(i, 62, nav2_costmap_2d::LETHAL_OBSTACLE);
+  }
+  HeadlessCostmap headless;
+  headless.costmap = &costmap;
+  headless.inflation_scaling_factor = 10.0;
+  headless.inflation_radius = 0.5;
+
+  const std::vector<std::string> critics = {
+    "ConstraintCritic", "ObstaclesCritic", "GoalCritic", "GoalAngleCritic", "PathAlignCritic",
+    "PathFollowCritic", "PathAngleCritic", "PreferForwardCritic", "TwirlingCritic"};
+
+  // The fast math and stored yaw trig variants of the critics too
+  for (const bool fast_math : {false, true}) {
+    ParametersHandler param_handler(
+      {rclcpp::Parameter("controller_frequency", 30.0),
+        rclcpp::Parameter("mppic.batch_size", 1000), rclcpp::Parameter("mppic.time_steps", 50),
+        rclcpp::Parameter("mppic.worker_threads", 2),
+        rclcpp::Parameter("mppic.fast_math", fast_math),
+        rclcpp::Parameter("mppic.store_yaw_trig", fast_math),
+        rclcpp::Parameter("mppic.critics", critics)});
+
+    // Workers and the noise thread are started by the initialization
+    Optimizer optimizer;
+    g_track_new_threads = true;
+    optimizer.initialize("mppic", headless, &param_handler);
+    g_track_new_threads = false;
+    param_handler.start();
+
+    // Far from the goal, heading away from the path so the path angle is scored as well
+    EXPECT_EQ(steadyStateAllocations(optimizer, straightPath(60, 0.04f), 1.5f), 0u);
+
+    // Within reach of the goal, where the goal critics take over
+    EXPECT_EQ(steadyStateAllocations(optimizer, straightPath(8, 0.04f), 0.0f), 0u);
+    optimizer.shutdown();
+  }
+}